@@ -58,6 +58,7 @@
 #define REND_SOFT   3   // Or .. something [ null atm ]
 #define REND_WII	4
 #define REND_PS2	5
+#define REND_NULL	6   // Draws nothing, host profiling of the PVR (drkPvr/nullRend.cpp)
 
 
 // Add defs to IDE/makefile whatever as _cpuname, _osname
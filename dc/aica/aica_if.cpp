@@ -2,6 +2,7 @@
 #include "aica_if.h"
 #include "dc/mem/sh4_mem.h"
 #include "dc/mem/sb.h"
+#include "dc/mem/mem_prof.h"
 #include "plugins/plugin_manager.h"
 #include "dc/asic/asic.h"
 
@@ -120,6 +121,8 @@ u32 FASTCALL ReadMem_aica_reg(u32 addr, u32 sz)
 {
     u32 offset = addr & 0x7FFF;
 
+    MEMPROF_REG(MPB_AICA, addr, false);
+
     if (sz == 1)
     {
         if (offset == VREG_OFFSET_8)
@@ -138,6 +141,8 @@ void FASTCALL WriteMem_aica_reg(u32 addr, u32 data, u32 sz)
 {
     u32 offset = addr & 0x7FFF;
 
+    MEMPROF_REG(MPB_AICA, addr, true);
+
     if (sz == 1)
     {
         if (offset == VREG_OFFSET_8)
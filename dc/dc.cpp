@@ -353,7 +353,7 @@ void LoadBiosFiles()
 	char* flash_path = BuildFilePath(base_path, "dc_flash_wb.bin");
 	if (flash_path)
 	{
-		if (LoadFileToSh4Flashrom(flash_path))
+		if (LoadFileToSh4Flashrom(flash_path, true))
 		{
 			printf("Loaded dc_flash_wb.bin (writeback)\n");
 			any_loaded = true;
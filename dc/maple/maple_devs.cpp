@@ -5,6 +5,13 @@
 #include "maple_cfg.h"
 #include <time.h>
 
+#if HOST_OS == OS_LINUX
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define VMU_MMAP
+#endif
+
 const char* maple_sega_controller_name = "Dreamcast Controller";
 const char* maple_sega_vmu_name = "Visual Memory";
 const char* maple_sega_kbd_name = "Emulated Dreamcast Keyboard";
@@ -232,19 +239,64 @@ struct maple_sega_controller: maple_base
 	Sega Dreamcast Visual Memory Unit
 	This is pretty much done (?)
 */
+#define VMU_FLASH_SIZE (128*1024)
+
 struct maple_sega_vmu: maple_base
 {
 	FILE* file;
-	u8 flash_data[128*1024];
+	//points to flash_buff, or to the save file mapping (settings.emulator.MapFiles)
+	u8* flash_data;
+	bool flash_mapped;
+	u8 flash_buff[VMU_FLASH_SIZE];
 	u8 lcd_data[192];
 	u8 lcd_data_decoded[48*32];
-	
+
+#ifdef VMU_MMAP
+	//Maps the save MAP_SHARED: block writes land in the page cache and reach
+	//the file lazily, no fwrite/fflush per block
+	bool MapSaveFile(const char* path)
+	{
+		int fd=open(path,O_RDWR | O_CREAT,0644);
+		if (fd<0)
+			return false;
+
+		//new (or short) saves are zero filled, same as the fread path
+		off_t len=lseek(fd,0,SEEK_END);
+		if (len<VMU_FLASH_SIZE && ftruncate(fd,VMU_FLASH_SIZE)!=0)
+		{
+			close(fd);
+			return false;
+		}
+
+		void* ptr=mmap(0,VMU_FLASH_SIZE,PROT_READ | PROT_WRITE,MAP_SHARED,fd,0);
+		close(fd);
+		if (ptr==MAP_FAILED)
+			return false;
+
+		flash_data=(u8*)ptr;
+		flash_mapped=true;
+		return true;
+	}
+#endif
+
 	virtual void OnSetup()
 	{
-		memset(flash_data,0,sizeof(flash_data));
+		file=0;
+		flash_data=flash_buff;
+		flash_mapped=false;
+		memset(flash_buff,0,sizeof(flash_buff));
 		memset(lcd_data,0,sizeof(lcd_data));
 		wchar temp[512];
 		sprintf(temp,"vmu_save_%s.bin",logical_port);
+
+#ifdef VMU_MMAP
+		if (settings.emulator.MapFiles && MapSaveFile(temp))
+		{
+			printf("Mapped vmu save file \"%s\"\n",temp);
+			return;
+		}
+#endif
+
 		file=fopen(temp,"rb+");
 		if (!file)
 		{
@@ -258,12 +310,19 @@ struct maple_sega_vmu: maple_base
 		}
 		else
 		{
-			fread(flash_data,1,sizeof(flash_data),file);
+			fread(flash_data,1,VMU_FLASH_SIZE,file);
 		}
 	}
 	virtual ~maple_sega_vmu()
 	{
 		if (file) fclose(file);
+#ifdef VMU_MMAP
+		if (flash_mapped)
+		{
+			msync(flash_data,VMU_FLASH_SIZE,MS_SYNC);
+			munmap(flash_data,VMU_FLASH_SIZE);
+		}
+#endif
 	}
 	virtual u32 dma(u32 cmd)
 	{
@@ -458,13 +517,14 @@ struct maple_sega_vmu: maple_base
 						u32 write_len=r_count();
 						rptr(&flash_data[write_adr],write_len);
 
+						//a mapped save already has the data in the file mapping
 						if (file)
 						{
 							fseek(file,write_adr,SEEK_SET);
 							fwrite(&flash_data[write_adr],1,write_len,file);
 							fflush(file);
 						}
-						else
+						else if (!flash_mapped)
 						{
 							printf("Failed to save vmu %s data\n",logical_port);
 						}
@@ -14,6 +14,11 @@
 #include "dc/aica/aica_if.h"
 #include "dc/pvr/pvr_if.h"
 #include "sh4_mem.h"
+#include "mem_prof.h"
+
+#if HOST_OS == OS_LINUX
+#include <sys/mman.h>
+#endif
 
 // ---------------------------------------------------------------------------
 // Constants
@@ -75,6 +80,7 @@ static INLINE T fastcall _vmem_readt(u32 addr)
     {
         // MMIO / handler path
         const u32 id = (u32)iirf;
+        MEMPROF_HANDLER(id / 4, false);
         if (sz == 1)
             return (T)_vmem_RF8[id / 4](addr);
         else if (sz == 2)
@@ -93,6 +99,7 @@ static INLINE T fastcall _vmem_readt(u32 addr)
     else
     {
         // Direct RAM/VRAM path
+        MEMPROF_PAGE(addr, false);
         u32 shift = (u32)(iirf & HANDLER_MAX);
         addr <<= shift;
         addr >>= shift;
@@ -117,6 +124,7 @@ static INLINE void fastcall _vmem_writet(u32 addr, T data)
     {
         // MMIO / handler path
         const u32 id = (u32)iirf;
+        MEMPROF_HANDLER(id / 4, true);
         if (sz == 1)
             _vmem_WF8[id / 4](addr, (u8)data);
         else if (sz == 2)
@@ -134,6 +142,7 @@ static INLINE void fastcall _vmem_writet(u32 addr, T data)
     else
     {
         // Direct RAM/VRAM path
+        MEMPROF_PAGE(addr, true);
         u32 shift = (u32)(iirf & HANDLER_MAX);
         addr <<= shift;
         addr >>= shift;
@@ -379,10 +388,46 @@ void _vmem_term()
 // ---------------------------------------------------------------------------
 // Memory reservation
 // ---------------------------------------------------------------------------
+u8* _vmem_arena = 0;
+bool _vmem_arena_hugetlb = false;
+
 #if HOST_OS == OS_PSP
 #define SLIM_RAM ((u8*)0x0A000000)
-#elif HOST_OS != OS_WII
-ALIGN(256) u8 SLIM_RAM[ARAM_SIZE + VRAM_SIZE + RAM_SIZE];
+#elif HOST_OS != OS_WII && HOST_OS != OS_LINUX
+ALIGN(256) u8 SLIM_RAM[ARENA_SIZE];
+#endif
+
+#if HOST_OS == OS_LINUX
+// Explicit huge pages first (needs hugetlbfs pages reserved by the admin),
+// then a normal mapping with a transparent huge page hint.
+static u8* _vmem_map_arena()
+{
+    void* rv = MAP_FAILED;
+
+#ifdef MAP_HUGETLB
+    rv = mmap(0, ARENA_SIZE, PROT_READ | PROT_WRITE,
+              MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (rv != MAP_FAILED)
+    {
+        printf("[vmem] arena: %u MB, MAP_HUGETLB\n", ARENA_SIZE >> 20);
+        _vmem_arena_hugetlb = true;
+        return (u8*)rv;
+    }
+#endif
+
+    rv = mmap(0, ARENA_SIZE, PROT_READ | PROT_WRITE,
+              MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (rv == MAP_FAILED)
+        return 0;
+
+#ifdef MADV_HUGEPAGE
+    madvise(rv, ARENA_SIZE, MADV_HUGEPAGE);
+    printf("[vmem] arena: %u MB, THP hint\n", ARENA_SIZE >> 20);
+#else
+    printf("[vmem] arena: %u MB\n", ARENA_SIZE >> 20);
+#endif
+    return (u8*)rv;
+}
 #endif
 
 bool _vmem_reserve()
@@ -393,7 +438,7 @@ bool _vmem_reserve()
     u8* ram_alloc = (u8*)SYS_GetArena2Lo();
     // Align to 256 bytes (required by _vmem_map_block).
     ram_alloc = (u8*)(((unat)ram_alloc + 255) & ~(unat)255);
-    SYS_SetArena2Lo(ram_alloc + ARAM_SIZE + VRAM_SIZE + RAM_SIZE);
+    SYS_SetArena2Lo(ram_alloc + ARENA_SIZE);
 
     extern u8* vram_buffer;
     vram_buffer = (u8*)SYS_GetArena2Lo();
@@ -405,27 +450,42 @@ bool _vmem_reserve()
     printf("[vmem] Wii RAM: %p  VRAM buffer: %p  GDDR3 free: %.2f MB\n",
            ram_alloc, vram_buffer,
            ((unat)SYS_GetArena2Hi() - (unat)SYS_GetArena2Lo()) / (1024.f * 1024.f));
+#elif HOST_OS == OS_LINUX
+    u8* ram_alloc = _vmem_map_arena();
+    if (!ram_alloc)
+        return false;
 #else
     u8* ram_alloc = SLIM_RAM;
 #endif
 
+    _vmem_arena = ram_alloc;
+
     aica_ram.size = ARAM_SIZE;
-    aica_ram.data = ram_alloc;
-    ram_alloc += ARAM_SIZE;
+    aica_ram.data = _vmem_arena + ARENA_ARAM_OFFSET;
 
     vram.size = VRAM_SIZE;
-    vram.data = ram_alloc;
-    ram_alloc += VRAM_SIZE;
+    vram.data = _vmem_arena + ARENA_VRAM_OFFSET;
 
     mem_b.size = RAM_SIZE;
-    mem_b.data = ram_alloc;
-    ram_alloc += RAM_SIZE;
+    mem_b.data = _vmem_arena + ARENA_RAM_OFFSET;
+
+    bios_b.size = BIOS_SIZE;
+    bios_b.data = _vmem_arena + ARENA_BIOS_OFFSET;
+
+    flash_b.size = FLASH_SIZE;
+    flash_b.data = _vmem_arena + ARENA_FLASH_OFFSET;
 
     return true;
 }
 
 void _vmem_release()
 {
-    // Memory is either statically allocated (non-Wii) or managed by the Wii
-    // arena allocator; no explicit free is needed here.
+#if HOST_OS == OS_LINUX
+    if (_vmem_arena)
+        munmap(_vmem_arena, ARENA_SIZE);
+#endif
+    // Elsewhere the arena is either static (non-Wii) or taken from the Wii
+    // MEM2 arena allocator; no explicit free is needed.
+    _vmem_arena = 0;
+    _vmem_arena_hugetlb = false;
 }
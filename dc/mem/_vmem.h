@@ -32,6 +32,43 @@ void _vmem_term  ();
 bool _vmem_reserve ();
 void _vmem_release ();
 
+// ---- Guest memory arena ---------------------------------------------------
+// _vmem_reserve() carves every guest memory from a single reservation, at
+// fixed offsets from _vmem_arena:
+//
+//   ARAM | VRAM | RAM | BIOS | FLASH | (pad) | code cache (Linux only)
+//
+// Keeping the whole guest state in one range means one write for a snapshot,
+// a single base for mirrored/fastmem style mappings, and lets the host back
+// it with large pages (fewer TLB misses on the RAM/VRAM hot paths).
+#define ARENA_ARAM_OFFSET   0
+#define ARENA_VRAM_OFFSET   (ARENA_ARAM_OFFSET  + ARAM_SIZE)
+#define ARENA_RAM_OFFSET    (ARENA_VRAM_OFFSET  + VRAM_SIZE)
+#define ARENA_BIOS_OFFSET   (ARENA_RAM_OFFSET   + RAM_SIZE)
+#define ARENA_FLASH_OFFSET  (ARENA_BIOS_OFFSET  + BIOS_SIZE)
+#define ARENA_GUEST_SIZE    (ARENA_FLASH_OFFSET + FLASH_SIZE)
+
+// Host large page size the code cache region is aligned to.
+#define ARENA_PAGE_ALIGN    (2*1024*1024)
+
+#if HOST_OS == OS_LINUX
+// The dynarec needs an executable mapping; it gets its own large-page
+// aligned slice at the end of the arena so it can be mprotect'ed alone.
+#define ARENA_CODE_OFFSET   ((ARENA_GUEST_SIZE + ARENA_PAGE_ALIGN - 1) & ~(ARENA_PAGE_ALIGN - 1))
+#define ARENA_CODE_SIZE     (8*1024*1024)
+#define ARENA_SIZE          (ARENA_CODE_OFFSET + ARENA_CODE_SIZE)
+#else
+// Other hosts keep the code cache where it is (MEM1 on the Wii, which is
+// faster than the MEM2 arena the guest memories come from).
+#define ARENA_SIZE          ARENA_GUEST_SIZE
+#endif
+
+// Base of the reservation (NULL before _vmem_reserve / after _vmem_release)
+extern u8* _vmem_arena;
+// True when the arena is backed by explicit huge pages; file mappings can't
+// then be placed over parts of it (see memutil.cpp).
+extern bool _vmem_arena_hugetlb;
+
 // ---- Handler registration -------------------------------------------------
 // Pass NULL for any function pointer to get a "not-mapped" default that logs
 // and returns 0 (reads) / is a no-op (writes).
@@ -0,0 +1,247 @@
+#include "types.h"
+#include "mem_prof.h"
+
+#ifdef MEM_PROFILER
+#include <algorithm>
+#if HOST_OS == OS_LINUX
+#include <signal.h>
+#endif
+
+// ---------------------------------------------------------------------------
+// Counter storage
+// ---------------------------------------------------------------------------
+#define MEMPROF_HANDLERS   32                     // _vmem HANDLER_COUNT
+#define MEMPROF_PAGES      (0x20000000 >> 16)     // 512 MB physical / 64 KB
+#define MEMPROF_REPORT_TOP 24                     // rows per console section
+
+struct MemProfCounter
+{
+	u64 reads;
+	u64 writes;
+};
+
+static const struct
+{
+	const char* name;
+	u32 base;       // first register address
+	u32 slots;      // number of 32 bit register slots
+} memprof_blocks[MPB_COUNT] =
+{
+	{ "SB",   0x005F6800, 0x1500 >> 2 },
+	{ "PVR",  0x005F8000, 0x2000 >> 2 },
+	{ "AICA", 0x00700000, 0x8000 >> 2 },
+};
+
+static MemProfCounter memprof_handlers[MEMPROF_HANDLERS];
+static MemProfCounter memprof_pages[MEMPROF_PAGES];
+static MemProfCounter memprof_sb  [0x1500 >> 2];
+static MemProfCounter memprof_pvr [0x2000 >> 2];
+static MemProfCounter memprof_aica[0x8000 >> 2];
+
+static MemProfCounter* const memprof_regs[MPB_COUNT] =
+{
+	memprof_sb,
+	memprof_pvr,
+	memprof_aica,
+};
+
+// Used to name handlers in the report (first page mapped to each id)
+extern void* _vmem_MemInfo_ptr[0x100];
+
+// ---------------------------------------------------------------------------
+// Hooks
+// ---------------------------------------------------------------------------
+void memprof_handler(u32 handler, bool write)
+{
+	MemProfCounter& c = memprof_handlers[handler & (MEMPROF_HANDLERS - 1)];
+	if (write) c.writes++; else c.reads++;
+}
+
+void memprof_page(u32 addr, bool write)
+{
+	MemProfCounter& c = memprof_pages[(addr & 0x1FFFFFFF) >> 16];
+	if (write) c.writes++; else c.reads++;
+}
+
+void memprof_reg(MemProfBlock block, u32 addr, bool write)
+{
+	u32 index = ((addr & 0x1FFFFFFF) - memprof_blocks[block].base) >> 2;
+	if (index >= memprof_blocks[block].slots)
+		return;
+
+	MemProfCounter& c = memprof_regs[block][index];
+	if (write) c.writes++; else c.reads++;
+}
+
+// ---------------------------------------------------------------------------
+// Report
+// ---------------------------------------------------------------------------
+static MemProfCounter* memprof_sort_src;
+
+static bool memprof_hotter(u32 a, u32 b)
+{
+	return (memprof_sort_src[a].reads + memprof_sort_src[a].writes) >
+	       (memprof_sort_src[b].reads + memprof_sort_src[b].writes);
+}
+
+// Sorts the non-zero entries of 'src' by total accesses, returns their count.
+static u32 memprof_sorted(MemProfCounter* src, u32 count, u32* order)
+{
+	u32 used = 0;
+	for (u32 i = 0; i < count; i++)
+	{
+		if (src[i].reads | src[i].writes)
+			order[used++] = i;
+	}
+
+	memprof_sort_src = src;
+	std::sort(order, order + used, memprof_hotter);
+	return used;
+}
+
+static u32 memprof_handler_page(u32 handler)
+{
+	for (u32 p = 0; p < 0x100; p++)
+	{
+		if ((unat)_vmem_MemInfo_ptr[p] == handler * 4)
+			return p << 24;
+	}
+	return 0;
+}
+
+static void memprof_print(const char* title, MemProfCounter* src, u32 count,
+                          u32 base, u32 stride, u32 top)
+{
+	static u32 order[MEMPROF_PAGES];
+	u32 used = memprof_sorted(src, count, order);
+
+	printf("-- %s (%u active) --\n", title, used);
+	for (u32 i = 0; i < used && i < top; i++)
+	{
+		u32 idx = order[i];
+		printf("  %08X : %12llu reads %12llu writes\n", base + idx * stride,
+		       (unsigned long long)src[idx].reads, (unsigned long long)src[idx].writes);
+	}
+}
+
+static void memprof_csv(FILE* f, const char* kind, const char* block,
+                        MemProfCounter* src, u32 count, u32 base, u32 stride)
+{
+	for (u32 i = 0; i < count; i++)
+	{
+		if (!(src[i].reads | src[i].writes))
+			continue;
+		fprintf(f, "%s,%s,%u,0x%08X,%llu,%llu\n", kind, block, i, base + i * stride,
+		        (unsigned long long)src[i].reads, (unsigned long long)src[i].writes);
+	}
+}
+
+void memprof_Reset()
+{
+	memset(memprof_handlers, 0, sizeof(memprof_handlers));
+	memset(memprof_pages, 0, sizeof(memprof_pages));
+	for (u32 b = 0; b < MPB_COUNT; b++)
+		memset(memprof_regs[b], 0, memprof_blocks[b].slots * sizeof(MemProfCounter));
+}
+
+void memprof_Dump(const char* csv_path)
+{
+	printf("==== Guest memory access profile ====\n");
+
+	printf("-- Handlers --\n");
+	for (u32 h = 1; h < MEMPROF_HANDLERS; h++)
+	{
+		if (!(memprof_handlers[h].reads | memprof_handlers[h].writes))
+			continue;
+		printf("  handler %2u (first page %08X) : %12llu reads %12llu writes\n",
+		       h, memprof_handler_page(h),
+		       (unsigned long long)memprof_handlers[h].reads,
+		       (unsigned long long)memprof_handlers[h].writes);
+	}
+
+	for (u32 b = 0; b < MPB_COUNT; b++)
+	{
+		memprof_print(memprof_blocks[b].name, memprof_regs[b], memprof_blocks[b].slots,
+		              memprof_blocks[b].base, 4, MEMPROF_REPORT_TOP);
+	}
+
+	memprof_print("64KB pages", memprof_pages, MEMPROF_PAGES, 0, 0x10000, MEMPROF_REPORT_TOP);
+
+	if (!csv_path)
+		return;
+
+	FILE* f = fopen(csv_path, "w");
+	if (!f)
+	{
+		printf("memprof: unable to open %s\n", csv_path);
+		return;
+	}
+
+	fprintf(f, "kind,block,index,address,reads,writes\n");
+	for (u32 h = 1; h < MEMPROF_HANDLERS; h++)
+	{
+		if (!(memprof_handlers[h].reads | memprof_handlers[h].writes))
+			continue;
+		fprintf(f, "handler,vmem,%u,0x%08X,%llu,%llu\n", h, memprof_handler_page(h),
+		        (unsigned long long)memprof_handlers[h].reads,
+		        (unsigned long long)memprof_handlers[h].writes);
+	}
+	for (u32 b = 0; b < MPB_COUNT; b++)
+	{
+		memprof_csv(f, "reg", memprof_blocks[b].name, memprof_regs[b],
+		            memprof_blocks[b].slots, memprof_blocks[b].base, 4);
+	}
+	memprof_csv(f, "page", "phys", memprof_pages, MEMPROF_PAGES, 0, 0x10000);
+
+	fclose(f);
+	printf("memprof: wrote %s\n", csv_path);
+}
+
+// ---------------------------------------------------------------------------
+// On demand dumps
+// ---------------------------------------------------------------------------
+// The signal handler only raises a flag, the dump runs from memprof_Poll on
+// the emulation thread.
+static volatile u32 memprof_dump_requested = 0;
+static u64 memprof_dump_cycles = 0;
+
+#if HOST_OS == OS_LINUX
+static void memprof_sigusr1(int)
+{
+	memprof_dump_requested = 1;
+}
+#endif
+
+void memprof_Poll(u32 cycles)
+{
+#if HOST_OS == OS_LINUX
+	static bool installed = false;
+	if (!installed)
+	{
+		signal(SIGUSR1, memprof_sigusr1);
+		installed = true;
+	}
+#endif
+
+	memprof_dump_cycles += cycles;
+	if (MEMPROF_DUMP_SECONDS && memprof_dump_cycles >= (u64)MEMPROF_DUMP_SECONDS * SH4_CLOCK)
+		memprof_dump_requested = 1;
+
+	if (!memprof_dump_requested)
+		return;
+
+	memprof_dump_requested = 0;
+	memprof_dump_cycles = 0;
+
+	char* csv_path = GetEmuPath("data/");
+	strcat(csv_path, "mem_profile.csv");
+	memprof_Dump(csv_path);
+	free(csv_path);
+}
+
+#else
+
+void memprof_Reset() { }
+void memprof_Dump(const char* csv_path) { }
+
+#endif
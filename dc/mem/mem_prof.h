@@ -0,0 +1,72 @@
+#pragma once
+#include "types.h"
+
+// ---------------------------------------------------------------------------
+// Guest memory access profiler
+// ---------------------------------------------------------------------------
+// Optional instrumentation that counts guest memory accesses:
+//   • per _vmem handler id (MMIO path of _vmem_readt/_vmem_writet)
+//   • per 64 KB page for directly mapped memory (RAM, VRAM, ...)
+//   • per register for the SB, PVR (TA/core) and AICA register blocks
+//
+// The interpreter and the dynarec slow path both reach memory through
+// _vmem_readt/_vmem_writet, so they are covered by the first two counters.
+// With the profiler on, the dynarec also routes constant-address MMIO reads
+// through the generic accessors instead of calling the handler directly.
+// RAM accesses the dynarec emits inline (its fast path) never go through
+// _vmem and are NOT counted: with the dynarec the page totals only cover its
+// slow path, the interpreter gives complete ones.
+//
+// Dumps: on demand with SIGUSR1 (Linux), every MEMPROF_DUMP_SECONDS of
+// emulated time (0 = off), and at mem_Term. Each one goes to the console and
+// data/mem_profile.csv; the counters keep running.
+//
+// Disabled by default: uncomment MEM_PROFILER (or pass -DMEM_PROFILER) to
+// compile it in. When disabled every hook compiles to nothing.
+// ---------------------------------------------------------------------------
+
+// #define MEM_PROFILER
+
+#ifndef MEMPROF_DUMP_SECONDS
+#define MEMPROF_DUMP_SECONDS 30
+#endif
+
+enum MemProfBlock
+{
+	MPB_SB,      // 0x005F6800 - 0x005F7CFF, System Bus registers
+	MPB_PVR,     // 0x005F8000 - 0x005F9FFF, TA / PVR core registers
+	MPB_AICA,    // 0x00700000 - 0x00707FFF, AICA registers
+	MPB_COUNT
+};
+
+#ifdef MEM_PROFILER
+
+void memprof_handler(u32 handler, bool write);
+void memprof_page(u32 addr, bool write);
+void memprof_reg(MemProfBlock block, u32 addr, bool write);
+
+#define MEMPROF_HANDLER(handler, write)   memprof_handler(handler, write)
+#define MEMPROF_PAGE(addr, write)         memprof_page(addr, write)
+#define MEMPROF_REG(block, addr, write)   memprof_reg(block, addr, write)
+
+// Runs the pending dumps, from the SH4 update cascade ('cycles' since the
+// last call)
+void memprof_Poll(u32 cycles);
+#define MEMPROF_POLL(cycles)              memprof_Poll(cycles)
+
+#else
+
+#define MEMPROF_HANDLER(handler, write)   ((void)0)
+#define MEMPROF_PAGE(addr, write)         ((void)0)
+#define MEMPROF_REG(block, addr, write)   ((void)0)
+#define MEMPROF_POLL(cycles)              ((void)0)
+
+#endif
+
+// Clear all counters.
+void memprof_Reset();
+
+// Print the hottest handlers, registers and pages to the console and, if
+// 'csv_path' is not NULL, write every non-zero counter to a CSV file
+// (kind,block,index,address,reads,writes). No-op when compiled out.
+void memprof_Dump(const char* csv_path);
@@ -2,8 +2,97 @@
 #include "memutil.h"
 #include "sh4_mem.h"
 
+#if HOST_OS == OS_LINUX
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define MEMUTIL_MMAP
+#endif
+
 // *FIXME* ENDIAN
 
+// ---------------------------------------------------------------------------
+// File mapping mode (settings.emulator.MapFiles, POSIX hosts only)
+// ---------------------------------------------------------------------------
+// Instead of fread'ing the images, the files are mmap'ed with MAP_FIXED over
+// their slots in the _vmem arena, so bios_b/flash_b keep their addresses:
+//   • BIOS                 : read-only, private -> no copy at startup
+//   • flash (writeback)    : read/write, MAP_SHARED -> guest writes reach the
+//                            file lazily through the page cache, saving is
+//                            an msync
+//   • flash (default image): read/write, MAP_PRIVATE -> pages are copied on
+//                            the first guest write, the pristine image is
+//                            never modified, the first save creates the
+//                            writeback file as before
+// The guest writes flash_b directly (sh4_area0.cpp), so a flash mapping is
+// always writable, only the BIOS one is read-only.
+// Anything that doesn't fit (huge page arena, odd sizes, dev unit offsets)
+// falls back to the normal fread path.
+#ifdef MEMUTIL_MMAP
+static bool bios_mapped  = false;
+static bool flash_mapped = false;
+static bool flash_shared = false;
+static char flash_mapped_path[512];
+
+// Returns the mapped size, 0 if the file could not be mapped ('dst' is then
+// left untouched). 'writable' maps the pages PROT_WRITE, 'shared' also sends
+// the writes to the file.
+static u32 MapFileOverArena(const char* file, u8* dst, u32 max_size, bool writable, bool shared)
+{
+	if (!settings.emulator.MapFiles || _vmem_arena_hugetlb)
+		return 0;
+	if (((unat)dst & (sysconf(_SC_PAGESIZE) - 1)) != 0)
+		return 0;
+
+	int fd = open(file, shared ? O_RDWR : O_RDONLY);
+	if (fd < 0)
+		return 0;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size <= 0 || (u64)st.st_size > max_size ||
+	    (shared && (u32)st.st_size != max_size))
+	{
+		close(fd);
+		return 0;
+	}
+
+	void* rv = mmap(dst, st.st_size, writable ? (PROT_READ | PROT_WRITE) : PROT_READ,
+	                (shared ? MAP_SHARED : MAP_PRIVATE) | MAP_FIXED, fd, 0);
+	close(fd);
+
+	if (rv == MAP_FAILED)
+		return 0;
+
+	return (u32)st.st_size;
+}
+
+// Puts plain anonymous memory back over a slot
+static void UnmapFileFromArena(u8* dst, u32 size)
+{
+	mmap(dst, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+}
+#endif
+
+void UnmapSh4RomFiles()
+{
+#ifdef MEMUTIL_MMAP
+	if (bios_mapped)
+	{
+		UnmapFileFromArena(bios_b.data, BIOS_SIZE);
+		bios_mapped = false;
+	}
+	if (flash_mapped)
+	{
+		if (flash_shared)
+			msync(flash_b.data, FLASH_SIZE, MS_SYNC);
+		UnmapFileFromArena(flash_b.data, FLASH_SIZE);
+		flash_mapped = false;
+		flash_shared = false;
+	}
+#endif
+}
+
 // Helper: open a file and get its size. Returns NULL on failure.
 // Caller is responsible for fclose().
 static FILE* OpenFileAndGetSize(const char* file, int* out_size)
@@ -88,6 +177,15 @@ u32 LoadBinfileToSh4Mem(u32 offset, char* file)
 
 bool LoadFileToSh4Bootrom(wchar* szFile)
 {
+#if defined(MEMUTIL_MMAP) && !defined(BUILD_DEV_UNIT)
+	if (u32 mapped = MapFileOverArena(szFile, bios_b.data, BIOS_SIZE, false, false))
+	{
+		bios_mapped = true;
+		printf("LoadFileToSh4Bootrom: mapped \"%s\", %u bytes\n", szFile, mapped);
+		return true;
+	}
+#endif
+
 	FILE* fd = fopen(szFile, "rb");
 	if (!fd) {
 		printf("LoadFileToSh4Bootrom: can't load file \"%s\", file not found\n", szFile);
@@ -128,8 +226,21 @@ bool LoadFileToSh4Bootrom(wchar* szFile)
 	return true;
 }
 
-bool LoadFileToSh4Flashrom(wchar* szFile)
+bool LoadFileToSh4Flashrom(wchar* szFile, bool writeback)
 {
+#ifdef MEMUTIL_MMAP
+	if (u32 mapped = MapFileOverArena(szFile, flash_b.data, FLASH_SIZE, true, writeback))
+	{
+		flash_mapped = true;
+		flash_shared = writeback;
+		strncpy(flash_mapped_path, szFile, sizeof(flash_mapped_path) - 1);
+		flash_mapped_path[sizeof(flash_mapped_path) - 1] = 0;
+		printf("LoadFileToSh4Flashrom: mapped \"%s\" (%s), %u bytes\n", szFile,
+		       writeback ? "shared" : "copy-on-write", mapped);
+		return true;
+	}
+#endif
+
 	FILE* fd = fopen(szFile, "rb");
 	if (!fd) {
 		printf("LoadFileToSh4Flashrom: can't load file \"%s\", file not found\n", szFile);
@@ -161,6 +272,16 @@ bool LoadFileToSh4Flashrom(wchar* szFile)
 
 bool SaveSh4FlashromToFile(wchar* szFile)
 {
+#ifdef MEMUTIL_MMAP
+	// The mapping already is the file, just make sure it hit the disk
+	if (flash_shared && strcmp(szFile, flash_mapped_path) == 0)
+	{
+		msync(flash_b.data, FLASH_SIZE, MS_SYNC);
+		printf("SaveSh4FlashromToFile: synced mapped flash \"%s\"\n", szFile);
+		return true;
+	}
+#endif
+
 	FILE* fd = fopen(szFile, "wb");
 	if (!fd) {
 		printf("SaveSh4FlashromToFile: can't open file \"%s\"\n", szFile);
@@ -4,5 +4,8 @@
 u32 LoadFileToSh4Mem(u32 offset,char*file);
 bool LoadFileToSh4Bootrom(wchar *szFile);
 u32 LoadBinfileToSh4Mem(u32 offset,char*file);
-bool LoadFileToSh4Flashrom(wchar *szFile);
+//writeback: szFile is the flash writeback file (may be mapped shared, see memutil.cpp)
+bool LoadFileToSh4Flashrom(wchar *szFile,bool writeback=false);
 bool SaveSh4FlashromToFile(wchar *szFile);
+//Drops bios/flash file mappings (flushing the flash) before the slots are reused
+void UnmapSh4RomFiles();
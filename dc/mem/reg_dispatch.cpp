@@ -0,0 +1,159 @@
+#include "types.h"
+#include "reg_dispatch.h"
+
+// ---------------------------------------------------------------------------
+// Read stubs
+// ---------------------------------------------------------------------------
+template <u32 sz>
+static u32 RegDisp_ReadData(RegisterStruct* reg, u32 addr)
+{
+	if (sz == 4)      return *reg->data32;
+	else if (sz == 2) return *reg->data16;
+	else              return *reg->data8;
+}
+
+static u32 RegDisp_ReadFunc(RegisterStruct* reg, u32 addr)
+{
+	return reg->readFunction();
+}
+
+static u32 RegDisp_ReadWriteOnly(RegisterStruct* reg, u32 addr)
+{
+	EMUERROR2("ERROR [read from write only register] , addr=%x", addr);
+	return 0;
+}
+
+static u32 RegDisp_ReadNotImpl(RegisterStruct* reg, u32 addr)
+{
+	EMUERROR2("Read from register , not  implemented , addr=%x", addr);
+	return 0;
+}
+
+#ifdef TRACE
+template <u32 sz>
+static u32 RegDisp_ReadWrongSize(RegisterStruct* reg, u32 addr)
+{
+	EMUERROR3("ERROR [wrong size read on register] , addr=%x,sz=%d", addr, sz);
+	return 0;
+}
+#endif
+
+// ---------------------------------------------------------------------------
+// Write stubs
+// ---------------------------------------------------------------------------
+template <u32 sz>
+static void RegDisp_WriteData(RegisterStruct* reg, u32 addr, u32 data)
+{
+	if (sz == 4)      *reg->data32 = data;
+	else if (sz == 2) *reg->data16 = (u16)data;
+	else              *reg->data8  = (u8)data;
+}
+
+static void RegDisp_WriteFunc(RegisterStruct* reg, u32 addr, u32 data)
+{
+	reg->writeFunction(data);
+}
+
+static void RegDisp_WriteConst(RegisterStruct* reg, u32 addr, u32 data)
+{
+	EMUERROR3("Error [Write to read olny register , const] , addr=%x,data=%x", addr, data);
+}
+
+static void RegDisp_WriteReadOnly(RegisterStruct* reg, u32 addr, u32 data)
+{
+	EMUERROR3("ERROR [Write to read olny register] , addr=%x,data=%x", addr, data);
+}
+
+static void RegDisp_WriteNotImpl(RegisterStruct* reg, u32 addr, u32 data)
+{
+	EMUERROR3("Write to register , not  implemented , addr=%x,data=%x", addr, data);
+}
+
+#ifdef TRACE
+template <u32 sz>
+static void RegDisp_WriteWrongSize(RegisterStruct* reg, u32 addr, u32 data)
+{
+	EMUERROR4("ERROR :wrong size write on register ; addr=%x , data=%x,sz=%d", addr, data, sz);
+}
+#endif
+
+// ---------------------------------------------------------------------------
+// Stub selection, first match wins: REG_NOT_IMPL, wrong size (TRACE only),
+// then data register, register function, and the read/write only error.
+// The old per-access code tested REG_NOT_IMPL last, so a slot flagged both
+// not implemented and data now gets the not implemented stub.
+// ---------------------------------------------------------------------------
+template <u32 sz>
+static RegDispReadFP* RegDisp_SelectRead(const RegisterStruct& reg)
+{
+	if (reg.flags & REG_NOT_IMPL)
+		return RegDisp_ReadNotImpl;
+#ifdef TRACE
+	if (!(reg.flags & sz))
+		return RegDisp_ReadWrongSize<sz>;
+#endif
+	if (reg.flags & REG_READ_DATA)
+		return RegDisp_ReadData<sz>;
+	if (reg.readFunction)
+		return RegDisp_ReadFunc;
+	return RegDisp_ReadWriteOnly;
+}
+
+template <u32 sz>
+static RegDispWriteFP* RegDisp_SelectWrite(const RegisterStruct& reg)
+{
+	if (reg.flags & REG_NOT_IMPL)
+		return RegDisp_WriteNotImpl;
+#ifdef TRACE
+	if (!(reg.flags & sz))
+		return RegDisp_WriteWrongSize<sz>;
+#endif
+	if (reg.flags & REG_WRITE_DATA)
+		return RegDisp_WriteData<sz>;
+	if (reg.flags & REG_CONST)
+		return RegDisp_WriteConst;
+	if (reg.writeFunction)
+		return RegDisp_WriteFunc;
+	return RegDisp_WriteReadOnly;
+}
+
+void RegDispatch::Build(Array<RegisterStruct>& src, u32 slots)
+{
+	verify(slots >= src.Size);
+
+	regs.Resize(slots, false);
+	regs.Zero();
+	for (u32 i = 0; i < slots; i++)
+	{
+		if (i < src.Size)
+			regs[i] = src[i];
+		else
+			regs[i].flags = REG_NOT_IMPL;
+	}
+
+	for (u32 s = 0; s < 3; s++)
+	{
+		read[s].Resize(slots, false);
+		write[s].Resize(slots, false);
+	}
+
+	for (u32 i = 0; i < slots; i++)
+	{
+		read[0][i]  = RegDisp_SelectRead<1>(regs[i]);
+		read[1][i]  = RegDisp_SelectRead<2>(regs[i]);
+		read[2][i]  = RegDisp_SelectRead<4>(regs[i]);
+		write[0][i] = RegDisp_SelectWrite<1>(regs[i]);
+		write[1][i] = RegDisp_SelectWrite<2>(regs[i]);
+		write[2][i] = RegDisp_SelectWrite<4>(regs[i]);
+	}
+}
+
+void RegDispatch::Free()
+{
+	regs.Free();
+	for (u32 s = 0; s < 3; s++)
+	{
+		read[s].Free();
+		write[s].Free();
+	}
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include "types.h"
+
+// ---------------------------------------------------------------------------
+// Table-driven register dispatch
+// ---------------------------------------------------------------------------
+// A RegisterStruct array describes every register of a block through flags
+// (REG_READ_DATA, REG_WRITE_DATA, REG_CONST, REG_NOT_IMPL, ...). Testing
+// those flags on every guest access is wasted work: they never change once
+// the owning module has been initialised.
+//
+// RegDispatch resolves the flags once, in Build(), into one read and one
+// write table per access size. Each slot holds a small stub (direct load /
+// store for plain data registers, a call through readFunction/writeFunction
+// for the rest, an error stub otherwise), so an access is one indexed
+// indirect call.
+//
+// Build() must run after every module that patches the RegisterStruct array
+// has been initialised; changes made to the array afterwards are not seen
+// until Build() is called again.
+// ---------------------------------------------------------------------------
+
+typedef u32  RegDispReadFP (RegisterStruct* reg, u32 addr);
+typedef void RegDispWriteFP(RegisterStruct* reg, u32 addr, u32 data);
+
+struct RegDispatch
+{
+	// Private copy of the register array, padded up to 'slots' entries so
+	// that every index the caller can produce hits a valid stub.
+	Array<RegisterStruct> regs;
+
+	// Indexed by size>>1 : [0]=8 bit, [1]=16 bit, [2]=32 bit
+	Array<RegDispReadFP*>  read[3];
+	Array<RegDispWriteFP*> write[3];
+
+	// Build the tables from 'src'. 'slots' is the number of 32-bit register
+	// slots the block decodes (>= src.Size); extra slots are unimplemented.
+	void Build(Array<RegisterStruct>& src, u32 slots);
+	void Free();
+
+	// 'index' is the register index (byte offset >> 2), 'addr' is only used
+	// for diagnostics.
+	template <u32 sz>
+	INLINE u32 Read(u32 index, u32 addr)
+	{
+		return read[sz >> 1].data[index](&regs.data[index], addr);
+	}
+
+	template <u32 sz>
+	INLINE void Write(u32 index, u32 addr, u32 data)
+	{
+		write[sz >> 1].data[index](&regs.data[index], addr, data);
+	}
+};
@@ -8,6 +8,8 @@
 #include "dc/gdrom/gdrom_if.h"
 #include "dc/maple/maple_if.h"
 #include "dc/aica/aica_if.h"
+#include "reg_dispatch.h"
+#include "mem_prof.h"
 
 Array<RegisterStruct> sb_regs(0x540);	
 
@@ -332,6 +334,9 @@ u32 SB_SDDIV;
 //0x005F7CF8	SB_PDLEND	R	PVR-DMA transfer counter 
  u32 SB_PDLEND;
 
+//Per-size dispatch tables, built from sb_regs at the end of sb_Init
+RegDispatch sb_disp;
+
 u32 sb_ReadMem(u32 addr,u32 sz)
 {	
 	u32 offset = addr-SB_BASE;
@@ -345,40 +350,14 @@ u32 sb_ReadMem(u32 addr,u32 sz)
 
 	offset>>=2;
 
-#ifdef TRACE
-	if (sb_regs[offset].flags & sz)
-	{
-#endif
-		if (sb_regs[offset].flags & REG_READ_DATA )
-		{
-			if (sz==4)
-				return  *sb_regs[offset].data32;
-			else if (sz==2)
-				return  *sb_regs[offset].data16;
-			else 
-				return  *sb_regs[offset].data8;
-		}
-		else
-		{
-			if (sb_regs[offset].readFunction)
-				return sb_regs[offset].readFunction();
-			else
-			{
-				if (!(sb_regs[offset].flags& REG_NOT_IMPL))
-					EMUERROR("ERROR [readed write olny register]");
-			}
-		}
-#ifdef TRACE
-	}
+	MEMPROF_REG(MPB_SB,addr,false);
+
+	if (sz==4)
+		return sb_disp.Read<4>(offset,addr);
+	else if (sz==2)
+		return sb_disp.Read<2>(offset,addr);
 	else
-	{
-		if (!(sb_regs[offset].flags& REG_NOT_IMPL))
-			EMUERROR("ERROR [wrong size read on register]");
-	}
-#endif
-	if ((sb_regs[offset].flags& REG_NOT_IMPL))
-		EMUERROR2("Read from System Control Regs , not  implemented , addr=%x",addr);
-	return 0;
+		return sb_disp.Read<1>(offset,addr);
 }
 
 void sb_WriteMem(u32 addr,u32 data,u32 sz)
@@ -391,49 +370,16 @@ void sb_WriteMem(u32 addr,u32 data,u32 sz)
 		EMUERROR("unallinged System bus register write");
 	}
 #endif
-offset>>=2;
-#ifdef TRACE
-	if (sb_regs[offset].flags & sz)
-	{
-#endif
-		if (sb_regs[offset].flags & REG_WRITE_DATA)
-		{
-			if (sz==4)
-				*sb_regs[offset].data32=data;
-			else if (sz==2)
-				*sb_regs[offset].data16=(u16)data;
-			else
-				*sb_regs[offset].data8=(u8)data;
-			return;
-		}
-		else
-		{
-			if (sb_regs[offset].flags & REG_CONST)
-				EMUERROR("Error [Write to read olny register , const]");
-			else
-			{
-				if (sb_regs[offset].writeFunction)
-				{
-					sb_regs[offset].writeFunction(data);
-					return;
-				}
-				else
-				{
-					if (!(sb_regs[offset].flags& REG_NOT_IMPL))
-						EMUERROR("ERROR [Write to read olny register]");
-				}
-			}
-		}
-#ifdef TRACE
-	}
+	offset>>=2;
+
+	MEMPROF_REG(MPB_SB,addr,true);
+
+	if (sz==4)
+		sb_disp.Write<4>(offset,addr,data);
+	else if (sz==2)
+		sb_disp.Write<2>(offset,addr,data);
 	else
-	{
-		if (!(sb_regs[offset].flags& REG_NOT_IMPL))
-			EMUERROR4("ERROR :wrong size write on register ; offset=%x , data=%x,sz=%d",offset,data,sz);
-	}
-#endif
-	if ((sb_regs[offset].flags& REG_NOT_IMPL))
-		EMUERROR3("Write to System Control Regs , not  implemented , addr=%x,data=%x",addr,data);
+		sb_disp.Write<1>(offset,addr,data);
 }
 
 u32 SB_FFST_rc;
@@ -1479,6 +1425,9 @@ void sb_Init()
 	pvr_sb_Init();
 	maple_Init();
 	aica_sb_Init();
+
+	//The subsystem inits above patch sb_regs, so resolve the tables last
+	sb_disp.Build(sb_regs,sb_regs.Size);
 }
 
 void sb_Reset(bool Manual)
@@ -1497,4 +1446,6 @@ void sb_Term()
 	pvr_sb_Term();
 	gdrom_reg_Term();
 	asic_reg_Term();
+
+	sb_disp.Free();
 }
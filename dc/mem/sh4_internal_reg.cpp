@@ -13,6 +13,7 @@
 #include "dc/sh4/ubc.h"
 #include "_vmem.h"
 #include "mmu.h"
+#include "reg_dispatch.h"
 
 
 // 64 bytes of store queue buffer (256-byte aligned for hardware compatibility)
@@ -36,103 +37,50 @@ Array<RegisterStruct> SCI(8,  true);   // SCI  : 8 registers  (serial comm inter
 Array<RegisterStruct> SCIF(10, true);  // SCIF : 10 registers (serial comm FIFO)
 
 
+// Per-size dispatch tables, resolved from the arrays above at the end of
+// sh4_internal_reg_Init(). Each table covers the full 0x100-byte window
+// (64 slots) decoded by area7, slots past the array end are unimplemented.
+static const u32 A7_MODULE_SLOTS = 0x100 >> 2;
+
+RegDispatch CCN_disp;
+RegDispatch UBC_disp;
+RegDispatch BSC_disp;
+RegDispatch DMAC_disp;
+RegDispatch CPG_disp;
+RegDispatch RTC_disp;
+RegDispatch INTC_disp;
+RegDispatch TMU_disp;
+RegDispatch SCI_disp;
+RegDispatch SCIF_disp;
+
+
 // ---------------------------------------------------------------------------
 // Register read/write helpers
 // ---------------------------------------------------------------------------
 // Template parameter 'size' is the access size in bytes (1, 2, or 4).
-// 'offset' is the byte offset within the module's register block.
+// 'addr' is the area7 address; its low byte selects the register.
 
 template <u32 size>
-INLINE u32 RegSRead(Array<RegisterStruct>& reg, u32 offset)
+INLINE u32 RegSRead(RegDispatch& disp, u32 addr)
 {
 #ifdef TRACE
 // Minimum alignment is 4 bytes for all SH4 internal registers
-	if (offset & 3)
+	if (addr & 3)
 		EMUERROR("Unaligned register read");
 #endif
 
-	offset >>= 2; // Convert byte offset to register index
-
-#ifdef TRACE
-	if (reg[offset].flags & size)
-	{
-#endif
-		if (reg[offset].flags & REG_READ_DATA)
-		{
-			if (size == 4)      return *reg[offset].data32;
-			else if (size == 2) return *reg[offset].data16;
-			else                return *reg[offset].data8;
-		}
-		else
-		{
-			if (reg[offset].readFunction)
-				return reg[offset].readFunction();
-			else if (!(reg[offset].flags & REG_NOT_IMPL))
-				EMUERROR("Read from write-only register");
-		}
-#ifdef TRACE
-	}
-	else
-	{
-		if (!(reg[offset].flags & REG_NOT_IMPL))
-			EMUERROR("Wrong size read on register");
-	}
-#endif
-
-	if (reg[offset].flags & REG_NOT_IMPL)
-		EMUERROR2("Read from unimplemented internal register, offset=0x%x", offset);
-
-	return 0;
+	return disp.Read<size>((addr & 0xFF) >> 2, addr);
 }
 
 template <u32 size>
-INLINE void RegSWrite(Array<RegisterStruct>& reg, u32 offset, u32 data)
+INLINE void RegSWrite(RegDispatch& disp, u32 addr, u32 data)
 {
 #ifdef TRACE
-	if (offset & 3)
+	if (addr & 3)
 		EMUERROR("Unaligned register write");
 #endif
 
-	offset >>= 2;
-
-#ifdef TRACE
-	if (reg[offset].flags & size)
-	{
-#endif
-		if (reg[offset].flags & REG_WRITE_DATA)
-		{
-			if (size == 4)      *reg[offset].data32 = data;
-			else if (size == 2) *reg[offset].data16 = (u16)data;
-			else                *reg[offset].data8  = (u8)data;
-			return;
-		}
-		else
-		{
-			if (reg[offset].flags & REG_CONST)
-			{
-				EMUERROR("Write to read-only (const) register");
-			}
-			else if (reg[offset].writeFunction)
-			{
-				reg[offset].writeFunction(data);
-				return;
-			}
-			else if (!(reg[offset].flags & REG_NOT_IMPL))
-			{
-				EMUERROR("Write to read-only register (no write function)");
-			}
-		}
-#ifdef TRACE
-	}
-	else
-	{
-		if (!(reg[offset].flags & REG_NOT_IMPL))
-			EMUERROR4("Wrong size write on register; offset=0x%x, data=0x%x, sz=%d", offset, data, size);
-	}
-#endif
-
-	if (reg[offset].flags & REG_NOT_IMPL)
-		EMUERROR3("Write to unimplemented internal register, offset=0x%x, data=0x%x", offset, data);
+	disp.Write<size>((addr & 0xFF) >> 2, addr, data);
 }
 
 
@@ -379,19 +327,19 @@ T FASTCALL ReadMem_area7(u32 addr)
 
 	case A7_REG_HASH(CCN_BASE_addr):
 		if (addr <= 0x1F00003C)
-			return (T)RegSRead<sz>(CCN, addr & 0xFF);
+			return (T)RegSRead<sz>(CCN_disp, addr);
 		EMUERROR2("CCN register out of range, addr=0x%x", addr);
 		break;
 
 	case A7_REG_HASH(UBC_BASE_addr):
 		if (addr <= 0x1F200020)
-			return (T)RegSRead<sz>(UBC, addr & 0xFF);
+			return (T)RegSRead<sz>(UBC_disp, addr);
 		EMUERROR2("UBC register out of range, addr=0x%x", addr);
 		break;
 
 	case A7_REG_HASH(BSC_BASE_addr):
 		if (addr <= 0x1F800048)
-			return (T)RegSRead<sz>(BSC, addr & 0xFF);
+			return (T)RegSRead<sz>(BSC_disp, addr);
 		else if (addr >= BSC_SDMR2_addr && addr <= 0x1F90FFFF)
 			EMUERROR("Read from write-only SDMR2 (DRAM settings)");
 		else if (addr >= BSC_SDMR3_addr && addr <= 0x1F94FFFF)
@@ -402,43 +350,43 @@ T FASTCALL ReadMem_area7(u32 addr)
 
 	case A7_REG_HASH(DMAC_BASE_addr):
 		if (addr <= 0x1FA00040)
-			return (T)RegSRead<sz>(DMAC, addr & 0xFF);
+			return (T)RegSRead<sz>(DMAC_disp, addr);
 		EMUERROR2("DMAC register out of range, addr=0x%x", addr);
 		break;
 
 	case A7_REG_HASH(CPG_BASE_addr):
 		if (addr <= 0x1FC00010)
-			return (T)RegSRead<sz>(CPG, addr & 0xFF);
+			return (T)RegSRead<sz>(CPG_disp, addr);
 		EMUERROR2("CPG register out of range, addr=0x%x", addr);
 		break;
 
 	case A7_REG_HASH(RTC_BASE_addr):
 		if (addr <= 0x1FC8003C)
-			return (T)RegSRead<sz>(RTC, addr & 0xFF);
+			return (T)RegSRead<sz>(RTC_disp, addr);
 		EMUERROR2("RTC register out of range, addr=0x%x", addr);
 		break;
 
 	case A7_REG_HASH(INTC_BASE_addr):
 		if (addr <= 0x1FD0000C)
-			return (T)RegSRead<sz>(INTC, addr & 0xFF);
+			return (T)RegSRead<sz>(INTC_disp, addr);
 		EMUERROR2("INTC register out of range, addr=0x%x", addr);
 		break;
 
 	case A7_REG_HASH(TMU_BASE_addr):
 		if (addr <= 0x1FD8002C)
-			return (T)RegSRead<sz>(TMU, addr & 0xFF);
+			return (T)RegSRead<sz>(TMU_disp, addr);
 		EMUERROR2("TMU register out of range, addr=0x%x", addr);
 		break;
 
 	case A7_REG_HASH(SCI_BASE_addr):
 		if (addr <= 0x1FE0001C)
-			return (T)RegSRead<sz>(SCI, addr & 0xFF);
+			return (T)RegSRead<sz>(SCI_disp, addr);
 		EMUERROR2("SCI register out of range, addr=0x%x", addr);
 		break;
 
 	case A7_REG_HASH(SCIF_BASE_addr):
 		if (addr <= 0x1FE80024)
-			return (T)RegSRead<sz>(SCIF, addr & 0xFF);
+			return (T)RegSRead<sz>(SCIF_disp, addr);
 		EMUERROR2("SCIF register out of range, addr=0x%x", addr);
 		break;
 
@@ -466,7 +414,7 @@ void FASTCALL WriteMem_area7(u32 addr, T data)
 	case A7_REG_HASH(CCN_BASE_addr):
 		if (addr <= 0x1F00003C)
 		{
-			RegSWrite<sz>(CCN, addr & 0xFF, data);
+			RegSWrite<sz>(CCN_disp, addr, data);
 			return;
 		}
 		EMUERROR2("CCN register out of range, addr=0x%x", addr);
@@ -475,7 +423,7 @@ void FASTCALL WriteMem_area7(u32 addr, T data)
 	case A7_REG_HASH(UBC_BASE_addr):
 		if (addr <= 0x1F200020)
 		{
-			RegSWrite<sz>(UBC, addr & 0xFF, data);
+			RegSWrite<sz>(UBC_disp, addr, data);
 			return;
 		}
 		EMUERROR2("UBC register out of range, addr=0x%x", addr);
@@ -484,7 +432,7 @@ void FASTCALL WriteMem_area7(u32 addr, T data)
 	case A7_REG_HASH(BSC_BASE_addr):
 		if (addr <= 0x1F800048)
 		{
-			RegSWrite<sz>(BSC, addr & 0xFF, data);
+			RegSWrite<sz>(BSC_disp, addr, data);
 			return;
 		}
 		else if (addr >= BSC_SDMR2_addr && addr <= 0x1F90FFFF)
@@ -497,7 +445,7 @@ void FASTCALL WriteMem_area7(u32 addr, T data)
 	case A7_REG_HASH(DMAC_BASE_addr):
 		if (addr <= 0x1FA00040)
 		{
-			RegSWrite<sz>(DMAC, addr & 0xFF, data);
+			RegSWrite<sz>(DMAC_disp, addr, data);
 			return;
 		}
 		EMUERROR2("DMAC register out of range, addr=0x%x", addr);
@@ -506,7 +454,7 @@ void FASTCALL WriteMem_area7(u32 addr, T data)
 	case A7_REG_HASH(CPG_BASE_addr):
 		if (addr <= 0x1FC00010)
 		{
-			RegSWrite<sz>(CPG, addr & 0xFF, data);
+			RegSWrite<sz>(CPG_disp, addr, data);
 			return;
 		}
 		EMUERROR2("CPG register out of range, addr=0x%x", addr);
@@ -515,7 +463,7 @@ void FASTCALL WriteMem_area7(u32 addr, T data)
 	case A7_REG_HASH(RTC_BASE_addr):
 		if (addr <= 0x1FC8003C)
 		{
-			RegSWrite<sz>(RTC, addr & 0xFF, data);
+			RegSWrite<sz>(RTC_disp, addr, data);
 			return;
 		}
 		EMUERROR2("RTC register out of range, addr=0x%x", addr);
@@ -524,7 +472,7 @@ void FASTCALL WriteMem_area7(u32 addr, T data)
 	case A7_REG_HASH(INTC_BASE_addr):
 		if (addr <= 0x1FD0000C)
 		{
-			RegSWrite<sz>(INTC, addr & 0xFF, data);
+			RegSWrite<sz>(INTC_disp, addr, data);
 			return;
 		}
 		EMUERROR2("INTC register out of range, addr=0x%x", addr);
@@ -533,7 +481,7 @@ void FASTCALL WriteMem_area7(u32 addr, T data)
 	case A7_REG_HASH(TMU_BASE_addr):
 		if (addr <= 0x1FD8002C)
 		{
-			RegSWrite<sz>(TMU, addr & 0xFF, data);
+			RegSWrite<sz>(TMU_disp, addr, data);
 			return;
 		}
 		EMUERROR2("TMU register out of range, addr=0x%x", addr);
@@ -542,7 +490,7 @@ void FASTCALL WriteMem_area7(u32 addr, T data)
 	case A7_REG_HASH(SCI_BASE_addr):
 		if (addr <= 0x1FE0001C)
 		{
-			RegSWrite<sz>(SCI, addr & 0xFF, data);
+			RegSWrite<sz>(SCI_disp, addr, data);
 			return;
 		}
 		EMUERROR2("SCI register out of range, addr=0x%x", addr);
@@ -551,7 +499,7 @@ void FASTCALL WriteMem_area7(u32 addr, T data)
 	case A7_REG_HASH(SCIF_BASE_addr):
 		if (addr <= 0x1FE80024)
 		{
-			RegSWrite<sz>(SCIF, addr & 0xFF, data);
+			RegSWrite<sz>(SCIF_disp, addr, data);
 			return;
 		}
 		EMUERROR2("SCIF register out of range, addr=0x%x", addr);
@@ -640,6 +588,18 @@ void sh4_internal_reg_Init()
 	scif_Init();
 	tmu_Init();
 	ubc_Init();
+
+	// Module inits are done patching the arrays, resolve the dispatch tables
+	CCN_disp.Build(CCN, A7_MODULE_SLOTS);
+	UBC_disp.Build(UBC, A7_MODULE_SLOTS);
+	BSC_disp.Build(BSC, A7_MODULE_SLOTS);
+	DMAC_disp.Build(DMAC, A7_MODULE_SLOTS);
+	CPG_disp.Build(CPG, A7_MODULE_SLOTS);
+	RTC_disp.Build(RTC, A7_MODULE_SLOTS);
+	INTC_disp.Build(INTC, A7_MODULE_SLOTS);
+	TMU_disp.Build(TMU, A7_MODULE_SLOTS);
+	SCI_disp.Build(SCI, A7_MODULE_SLOTS);
+	SCIF_disp.Build(SCIF, A7_MODULE_SLOTS);
 }
 
 void sh4_internal_reg_Reset(bool Manual)
@@ -672,6 +632,17 @@ void sh4_internal_reg_Term()
 	ccn_Term();
 	bsc_Term();
 	OnChipRAM.Free();
+
+	CCN_disp.Free();
+	UBC_disp.Free();
+	BSC_disp.Free();
+	DMAC_disp.Free();
+	CPG_disp.Free();
+	RTC_disp.Free();
+	INTC_disp.Free();
+	TMU_disp.Free();
+	SCI_disp.Free();
+	SCIF_disp.Free();
 }
 
 
@@ -11,14 +11,15 @@
 #include "dc/dc.h"
 #include "_vmem.h"
 #include "mmu.h"
+#include "mem_prof.h"
 
 // ---------------------------------------------------------------------------
 // Main memory banks
 // ---------------------------------------------------------------------------
 
 VArray2  mem_b;      // Main system RAM  (16 MB)
-Array<u8> bios_b;   // BIOS ROM         (2 MB)
-Array<u8> flash_b;  // Flash / NVRAM    (128 KB)
+VArray2  bios_b;     // BIOS ROM         (2 MB)
+VArray2  flash_b;    // Flash / NVRAM    (128 KB)
 
 // ---------------------------------------------------------------------------
 // Forward declarations
@@ -165,9 +166,7 @@ void mem_map_defualt()
 
 void mem_Init()
 {
-	bios_b.Resize(BIOS_SIZE, false);
-	flash_b.Resize(FLASH_SIZE, false);
-
+	// bios_b / flash_b live in the _vmem arena, set up by _vmem_reserve()
 	sh4_area0_Init();
 	sh4_internal_reg_Init();
 	MMU_Init();
@@ -178,9 +177,12 @@ void mem_Reset(bool Manual)
 	if (!Manual)
 	{
 		// Hard reset – clear all RAM and reload firmware
+		// (file mappings go first, zeroing them would write through to disk)
+		UnmapSh4RomFiles();
 		mem_b.Zero();
-		bios_b.Zero();
-		flash_b.Zero();
+		// Arena backed, no region lock to drop (VArray2::Zero would log one)
+		memset(bios_b.data, 0, bios_b.size);
+		memset(flash_b.data, 0, flash_b.size);
 		LoadBiosFiles();
 	}
 
@@ -200,9 +202,14 @@ void mem_Term()
 	strcat(temp_path, "dc_flash_wb.bin");
 	SaveSh4FlashromToFile(temp_path);
 	free(temp_path);
+	UnmapSh4RomFiles();
 
-	flash_b.Free();
-	bios_b.Free();
+#ifdef MEM_PROFILER
+	temp_path = GetEmuPath("data/");
+	strcat(temp_path, "mem_profile.csv");
+	memprof_Dump(temp_path);
+	free(temp_path);
+#endif
 
 	_vmem_term();
 }
@@ -6,8 +6,8 @@
 // ---------------------------------------------------------------------------
 
 extern VArray2   mem_b;    // Main system RAM  (16 MB)
-extern Array<u8> bios_b;  // BIOS ROM         (2 MB)
-extern Array<u8> flash_b; // Flash / NVRAM    (128 KB)
+extern VArray2   bios_b;   // BIOS ROM         (2 MB)
+extern VArray2   flash_b;  // Flash / NVRAM    (128 KB)
 
 // ---------------------------------------------------------------------------
 // Calling convention
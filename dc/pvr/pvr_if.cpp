@@ -1,10 +1,12 @@
 #include "types.h"
 #include "pvr_if.h"
 #include "pvrLock.h"
+#include "pvr_yuv.h"
 #include "dc/sh4/intc.h"
 #include "dc/mem/_vmem.h"
 #include "plugins/plugin_manager.h"
 #include "dc/asic/asic.h"
+#include "dc/mem/mem_prof.h"
 
 //==============================================================================
 // PowerVR Interface Implementation
@@ -39,63 +41,13 @@ static u32 YUV_x_curr = 0;         // Current X position in output
 static u32 YUV_y_curr = 0;         // Current Y position in output
 static u32 YUV_x_size = 0;         // Output width in pixels
 static u32 YUV_y_size = 0;         // Output height in pixels
+static u32 YUV_block_size = 0;     // Input bytes per macroblock
+static bool YUV_is422 = false;     // Input format, latched from TA_YUV_TEX_CTRL
 
 //------------------------------------------------------------------------------
-// YUV Helper Functions
+// YUV Converter
 //------------------------------------------------------------------------------
 
-/**
- * Write 2 pixels (4 bytes) to VRAM at current position
- * @param x X offset from current position
- * @param y Y offset from current position
- * @param pixdata YUYV packed pixel data (2 pixels)
- */
-INLINE void YUV_putpixel2(u32 x, u32 y, u32 pixdata)
-{
-    u32 offset = YUV_dest + (YUV_x_curr + x + (YUV_y_curr + y) * YUV_x_size) * 2;
-    *(u32*)(&vram.data[offset]) = pixdata;
-}
-
-/**
- * Extract Y (luminance) component from 4:2:0 macroblock
- * @param x X coordinate (0-15)
- * @param y Y coordinate (0-15)
- * @param base Pointer to Y component data (256 bytes)
- * @return Y value
- */
-INLINE u8 GetY420(int x, int y, u8* base)
-{
-    // 4:2:0 format stores Y in 8x8 sub-blocks
-    if (x > 7) {
-        x -= 8;
-        base += 64;  // Move to right 8x8 block
-    }
-    
-    if (y > 7) {
-        y -= 8;
-        base += 128; // Move to bottom 8x8 block
-    }
-    
-    return *host_ptr_xor(&base[x + y * 8]);
-}
-
-/**
- * Extract U or V (chrominance) component from 4:2:0 macroblock
- * U and V are subsampled 2:1 in both dimensions (8x8 for 16x16 block)
- * @param x X coordinate (0-15)
- * @param y Y coordinate (0-15)
- * @param base Pointer to U or V component data (64 bytes)
- * @return U or V value
- */
-INLINE u8 GetUV420(int x, int y, u8* base)
-{
-    // Subsample coordinates
-    int realx = x >> 1;
-    int realy = y >> 1;
-    
-    return base[realx + realy * 8];
-}
-
 /**
  * Initialize YUV converter state from hardware registers
  */
@@ -127,56 +79,38 @@ void YUV_init()
         YUV_x_size = blocks_x * YUV_MACROBLOCK_SIZE;
         YUV_y_size = blocks_y * YUV_MACROBLOCK_SIZE;
     }
+    
+    // Input format
+    YUV_is422 = ((TA_YUV_TEX_CTRL >> 24) & 1) != 0;
+    YUV_block_size = YUV_is422 ? YUV_BLOCK_SIZE_422 : YUV_BLOCK_SIZE_420;
 }
 
 /**
  * Convert one YUV macroblock (16x16 pixels) to YUYV format and write to VRAM
+ * @param block Macroblock data (YUV_block_size bytes, 4-byte aligned)
  */
-INLINE void YUV_ConvertMacroBlock()
+INLINE void YUV_ConvertMacroBlock(const u8* block)
 {
-    u32 TA_YUV_TEX_CTRL = pvr_readreg_TA(TA_YUV_TEX_CTRL_ADDR, 4);
-    
     YUV_doneblocks++;
     YUV_index = 0;
     
-    // Determine block format
-    bool is_yuv420 = ((TA_YUV_TEX_CTRL & (1 << 24)) == 0);
+    // Output rows are contiguous in the 64-bit VRAM view
+    u32 pitch = YUV_x_size * 2;
+    u8* dst = &vram.data[YUV_dest + YUV_x_curr * 2 + YUV_y_curr * pitch];
     
-    if (is_yuv420) {
-        // YUV 4:2:0 format (384 bytes per macroblock)
-        // Layout: 64 bytes U, 64 bytes V, 256 bytes Y
-        u8* U = (u8*)&YUV_tempdata[0];
-        u8* V = (u8*)&YUV_tempdata[64 / 4];
-        u8* Y = (u8*)&YUV_tempdata[(64 + 64) / 4];
-        
-        u8 yuyv[4]; // Temporary buffer for 2 pixels
-        
-        // Convert 16x16 block
-        for (int y = 0; y < YUV_MACROBLOCK_SIZE; y++) {
-            for (int x = 0; x < YUV_MACROBLOCK_SIZE; x += 2) {
-                // Pack YUYV format: Y0 U Y1 V
-                yuyv[1] = GetY420(x, y, Y);      // Y0
-                yuyv[0] = GetUV420(x, y, U);     // U (shared)
-                yuyv[3] = GetY420(x + 1, y, Y);  // Y1
-                yuyv[2] = GetUV420(x, y, V);     // V (shared)
-                
-                // Write 2 pixels at once
-                YUV_putpixel2(x, y, *(u32*)yuyv);
-            }
-        }
-        
-        // Advance to next macroblock position
-        YUV_x_curr += YUV_MACROBLOCK_SIZE;
-        if (YUV_x_curr >= YUV_x_size) {
-            YUV_x_curr = 0;
-            YUV_y_curr += YUV_MACROBLOCK_SIZE;
-            if (YUV_y_curr >= YUV_y_size) {
-                YUV_y_curr = 0;
-            }
+    if (YUV_is422)
+        YUV_Block422(block, dst, pitch);
+    else
+        YUV_Block420(block, dst, pitch);
+    
+    // Advance to next macroblock position
+    YUV_x_curr += YUV_MACROBLOCK_SIZE;
+    if (YUV_x_curr >= YUV_x_size) {
+        YUV_x_curr = 0;
+        YUV_y_curr += YUV_MACROBLOCK_SIZE;
+        if (YUV_y_curr >= YUV_y_size) {
+            YUV_y_curr = 0;
         }
-    } else {
-        // YUV 4:2:2 format not currently implemented
-        printf("YUV 4:2:2 format not supported in YUV converter\n");
     }
     
     // Check if all blocks are processed
@@ -200,32 +134,38 @@ void YUV_data(u32* data, u32 count)
         YUV_init();
     }
     
-    u32 TA_YUV_TEX_CTRL = pvr_readreg_TA(TA_YUV_TEX_CTRL_ADDR, 4);
-    
-    // Determine block size based on format
-    u32 block_size = ((TA_YUV_TEX_CTRL & (1 << 24)) == 0) 
-                     ? YUV_BLOCK_SIZE_420 
-                     : YUV_BLOCK_SIZE_422;
+    u32 block_size = YUV_block_size;
     
     // Convert count from 32-byte blocks to bytes
     count *= 32;
     
-    // Process data in chunks
-    while (count > 0) {
-        u32 bytes_til_block_end = block_size - YUV_index;
+    // Complete a macroblock left over from the previous transfer
+    if (YUV_index != 0) {
+        u32 bytes = block_size - YUV_index;
+        if (bytes > count)
+            bytes = count;
         
-        if (count >= bytes_til_block_end) {
-            // Complete at least one full block
-            memcpy(&YUV_tempdata[YUV_index >> 2], data, bytes_til_block_end);
-            data += bytes_til_block_end >> 2;
-            count -= bytes_til_block_end;
-            YUV_ConvertMacroBlock();
-        } else {
-            // Partial block - buffer it
-            memcpy(&YUV_tempdata[YUV_index >> 2], data, count);
-            YUV_index += count;
-            count = 0;
-        }
+        memcpy((u8*)YUV_tempdata + YUV_index, data, bytes);
+        YUV_index += bytes;
+        data += bytes >> 2;
+        count -= bytes;
+        
+        if (YUV_index < block_size)
+            return;
+        YUV_ConvertMacroBlock((u8*)YUV_tempdata);
+    }
+    
+    // Whole macroblocks are converted straight from the source
+    while (count >= block_size) {
+        YUV_ConvertMacroBlock((u8*)data);
+        data += block_size >> 2;
+        count -= block_size;
+    }
+    
+    // Buffer the partial macroblock
+    if (count != 0) {
+        memcpy(YUV_tempdata, data, count);
+        YUV_index = count;
     }
 }
 
@@ -238,6 +178,8 @@ void YUV_data(u32* data, u32 count)
  */
 u32 pvr_readreg_TA(u32 addr, u32 sz)
 {
+    MEMPROF_REG(MPB_PVR, addr, false);
+
     // Handle YUV block counter register specially
     if ((addr & 0xFFFFFF) == TA_YUV_TEX_CNT_ADDR) {
         return YUV_doneblocks;
@@ -252,6 +194,8 @@ u32 pvr_readreg_TA(u32 addr, u32 sz)
  */
 void pvr_writereg_TA(u32 addr, u32 data, u32 sz)
 {
+    MEMPROF_REG(MPB_PVR, addr, true);
+
     // Delegate to plugin implementation
     libPvr_WriteReg(addr, data, sz);
     
@@ -265,6 +209,20 @@ void pvr_writereg_TA(u32 addr, u32 data, u32 sz)
 // VRAM Access Functions (32-bit to 64-bit address conversion)
 //------------------------------------------------------------------------------
 
+// Set by the plugin: [first, last] 64-bit offset, empty by default
+u32 pvr_vram_readback[2] = { 0xFFFFFFFF, 0 };
+
+/**
+ * Let the plugin write back what it holds for a VRAM range before it is accessed
+ * @param addr 64-bit VRAM offset
+ * @param size Bytes accessed
+ */
+INLINE void pvr_vram_access(u32 addr, u32 size)
+{
+    if (addr <= pvr_vram_readback[1] && addr + size > pvr_vram_readback[0])
+        libPvr_VramRead(addr, size);
+}
+
 u8 FASTCALL pvr_read_area1_8(u32 addr)
 {
     printf("Warning: 8-bit VRAM reads are not supported by hardware\n");
@@ -274,12 +232,14 @@ u8 FASTCALL pvr_read_area1_8(u32 addr)
 u16 FASTCALL pvr_read_area1_16(u32 addr)
 {
     addr = vramlock_ConvOffset32toOffset64(addr);
+    pvr_vram_access(addr, 2);
     return *host_ptr_xor((u16*)&vram[addr]);
 }
 
 u32 FASTCALL pvr_read_area1_32(u32 addr)
 {
     addr = vramlock_ConvOffset32toOffset64(addr);
+    pvr_vram_access(addr, 4);
     return *(u32*)&vram[addr];
 }
 
@@ -291,12 +251,14 @@ void FASTCALL pvr_write_area1_8(u32 addr, u8 data)
 void FASTCALL pvr_write_area1_16(u32 addr, u16 data)
 {
     addr = vramlock_ConvOffset32toOffset64(addr);
+    pvr_vram_access(addr, 2);
     *host_ptr_xor((u16*)&vram[addr]) = data;
 }
 
 void FASTCALL pvr_write_area1_32(u32 addr, u32 data)
 {
     addr = vramlock_ConvOffset32toOffset64(addr);
+    pvr_vram_access(addr, 4);
     *(u32*)&vram[addr] = data;
 }
 
@@ -324,6 +286,7 @@ void FASTCALL TAWrite(u32 address, u32* data, u32 count)
     } else {
         // Direct VRAM write (16MB+ range)
         // Note: This works on real hardware, respects lock modes
+        pvr_vram_access(address & VRAM_MASK, count * 32);
         memcpy(&vram.data[address & VRAM_MASK], data, count * 32);
     }
 }
@@ -344,6 +307,7 @@ void FASTCALL TAWriteSQ(u32 address, u32* data)
         YUV_data(data, 1);
     } else {
         // Direct VRAM write
+        pvr_vram_access(address & VRAM_MASK, 32);
         memcpy(&vram.data[address & VRAM_MASK], data, 32);
     }
 }
@@ -378,4 +342,6 @@ void pvr_Reset(bool Manual)
     YUV_y_curr = 0;
     YUV_x_size = 0;
     YUV_y_size = 0;
+    YUV_block_size = 0;
+    YUV_is422 = false;
 }
@@ -13,6 +13,9 @@
 //------------------------------------------------------------------------------
 extern VArray2 vram;
 
+// VRAM range the PVR plugin holds newer data for, see pvr_init_params::vram_readback
+extern u32 pvr_vram_readback[2];
+
 //------------------------------------------------------------------------------
 // PVR Register Interface
 //------------------------------------------------------------------------------
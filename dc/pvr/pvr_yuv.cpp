@@ -0,0 +1,83 @@
+/*
+ * YUV Converter Macroblock Decoders (see pvr_yuv.h)
+ *
+ * Each output row takes 16 Y, 8 U and 8 V bytes. Y is read as in the
+ * old per-pixel converter: through host_ptr_xor, i.e. pixel n of a
+ * 32-bit Y word is its bits 8n..8n+7 on either host. U and V are read
+ * as plain bytes.
+ */
+
+#include "pvr_yuv.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define YUV_SSE2
+#endif
+
+#ifndef YUV_SSE2
+/**
+ * Pack 4 pixels (2 texels) from a Y word and 2 U/V samples
+ */
+static INLINE void YUV_Quad(u32 yw, const u8* U, const u8* V, u32* dst)
+{
+#if HOST_ENDIAN == ENDIAN_BIG
+    dst[0] = (U[0] << 24) | ((yw & 0xFF) << 16) | (V[0] << 8) | ((yw >> 8) & 0xFF);
+    dst[1] = (U[1] << 24) | (yw & 0xFF0000) | (V[1] << 8) | (yw >> 24);
+#else
+    dst[0] = U[0] | ((yw & 0xFF) << 8) | (V[0] << 16) | ((yw & 0xFF00) << 16);
+    dst[1] = U[1] | ((yw >> 8) & 0xFF00) | (V[1] << 16) | (yw & 0xFF000000);
+#endif
+}
+#endif
+
+/**
+ * Convert one 16 pixel row
+ * @param Yl Y pixels 0-7, Yr Y pixels 8-15
+ */
+static INLINE void YUV_Row(const u8* Yl, const u8* Yr, const u8* U, const u8* V, u8* dst)
+{
+#ifdef YUV_SSE2
+    __m128i y = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*)Yl),
+                                   _mm_loadl_epi64((const __m128i*)Yr));
+    __m128i uv = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)U),
+                                   _mm_loadl_epi64((const __m128i*)V));
+
+    // U0 Y0 V0 Y1 U1 Y2 V1 Y3 ...
+    _mm_storeu_si128((__m128i*)dst, _mm_unpacklo_epi8(uv, y));
+    _mm_storeu_si128((__m128i*)(dst + 16), _mm_unpackhi_epi8(uv, y));
+#else
+    u32* out = (u32*)dst;
+    YUV_Quad(((const u32*)Yl)[0], U + 0, V + 0, out + 0);
+    YUV_Quad(((const u32*)Yl)[1], U + 2, V + 2, out + 2);
+    YUV_Quad(((const u32*)Yr)[0], U + 4, V + 4, out + 4);
+    YUV_Quad(((const u32*)Yr)[1], U + 6, V + 6, out + 6);
+#endif
+}
+
+/**
+ * Convert one macroblock with 'uv_rows' rows of chroma (8 for 4:2:0, 16 for 4:2:2)
+ */
+template<u32 uv_rows>
+static INLINE void YUV_Block(const u8* src, u8* dst, u32 pitch)
+{
+    const u8* U = src;
+    const u8* V = U + uv_rows * 8;
+    const u8* Y = V + uv_rows * 8;
+
+    for (u32 y = 0; y < 16; y++, dst += pitch) {
+        const u8* Yl = Y + (y >> 3) * 128 + (y & 7) * 8;
+        u32 c = (uv_rows == 16 ? y : y >> 1) * 8;
+
+        YUV_Row(Yl, Yl + 64, U + c, V + c, dst);
+    }
+}
+
+void YUV_Block420(const u8* src, u8* dst, u32 pitch)
+{
+    YUV_Block<8>(src, dst, pitch);
+}
+
+void YUV_Block422(const u8* src, u8* dst, u32 pitch)
+{
+    YUV_Block<16>(src, dst, pitch);
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "types.h"
+
+//==============================================================================
+// YUV Converter Macroblock Decoders
+//==============================================================================
+// A macroblock is 16x16 pixels. It is written as YUV422 texels (U Y0 V Y1
+// per pixel pair, 32 bytes per row) to the 64-bit VRAM view, where a
+// texture row is contiguous, so every row is stored in one go.
+//
+// Input layouts:
+//   4:2:0 (384 bytes): U 8x8, V 8x8, Y as four 8x8 blocks (TL, TR, BL, BR)
+//   4:2:2 (512 bytes): U 8x16, V 8x16, Y as for 4:2:0
+//
+// Uses SSE2 byte interleaves where available, 32-bit word packing otherwise.
+//==============================================================================
+
+/**
+ * Convert one 4:2:0 macroblock
+ * @param src 384 bytes of macroblock data, 4-byte aligned
+ * @param dst First output row
+ * @param pitch Bytes between output rows
+ */
+void YUV_Block420(const u8* src, u8* dst, u32 pitch);
+
+/**
+ * Convert one 4:2:2 macroblock
+ * @param src 512 bytes of macroblock data, 4-byte aligned
+ * @param dst First output row
+ * @param pitch Bytes between output rows
+ */
+void YUV_Block422(const u8* src, u8* dst, u32 pitch);
@@ -87,8 +87,8 @@ extern volatile bool sh4_int_bCpuRun;
 #if HOST_OS == OS_WII
 u8 CodeCache[CODE_SIZE] __attribute__((aligned(32)));
 #elif HOST_OS == OS_LINUX
-// Linux needs an executable mapping; allocate with a page-alignment margin.
-u8  pMemBuff[CODE_SIZE + 4095];
+// Linux needs an executable mapping; carved from the tail of the _vmem arena
+// (large-page aligned, see ARENA_CODE_OFFSET) and mprotect'ed on init.
 u8* CodeCache;
 #else
 u8 CodeCache[CODE_SIZE];
@@ -535,9 +535,9 @@ void recSh4_Init()
 	       CodeCache, CODE_SIZE / 1024);
 
 #elif HOST_OS == OS_LINUX
-	CodeCache = (u8*)(((uintptr_t)pMemBuff + 4095) & ~(uintptr_t)4095);
-	printf("recSh4: code cache at %p (aligned from %p, Linux)\n",
-	       CodeCache, pMemBuff);
+	verify(CODE_SIZE <= ARENA_CODE_SIZE);
+	CodeCache = _vmem_arena + ARENA_CODE_OFFSET;
+	printf("recSh4: code cache at %p (vmem arena, Linux)\n", CodeCache);
 
 	if (mprotect(CodeCache, CODE_SIZE, PROT_EXEC | PROT_READ | PROT_WRITE))
 	{
@@ -22,6 +22,7 @@
 #include "plugs/vbaARM/arm_aica.h"  // ARM7 CPU tick (vbaARM)
 #include "dmac.h"
 #include "dc/gdrom/gdrom_if.h"
+#include "dc/mem/mem_prof.h"
 #include "dc/maple/maple_if.h"
 #include "intc.h"
 #include "tmu.h"
@@ -310,6 +311,7 @@ void FASTCALL VerySlowUpdate()
 		settings.dreamcast.RTC++;
 	}
 	maple_Update(s_timeslice * s_vslow_period);
+	MEMPROF_POLL(s_timeslice * s_vslow_period);
 }
 
 void FASTCALL SlowUpdate()
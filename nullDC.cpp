@@ -11,10 +11,6 @@
 #include "plugins/plugin_manager.h"
 #include "cl/cl.h"
 
-// Frameskipping (preparation : working on it)
-int g_current_frameskip = 0; // 0 = no skip, 1 = skip 1 frame, 2 = skip 2 frame
-int g_frame_counter = 0;
-
 
 __settings settings;
 
@@ -141,6 +137,7 @@ void LoadSettings()
 
 	settings.emulator.AutoStart=cfgLoadInt("nullDC","Emulator.AutoStart",0)!=0;
 	settings.emulator.NoConsole=cfgLoadInt("nullDC","Emulator.NoConsole",0)!=0;
+	settings.emulator.MapFiles=cfgLoadInt("nullDC","Emulator.MapFiles",0)!=0;
 	printf("Loaded settings\n");
 }
 void SaveSettings()
@@ -152,4 +149,5 @@ void SaveSettings()
 	cfgSaveInt("nullDC","Dreamcast.RTC",settings.dreamcast.RTC);
 	cfgSaveInt("nullDC","Emulator.AutoStart",settings.emulator.AutoStart);
 	cfgSaveInt("nullDC","Emulator.NoConsole",settings.emulator.NoConsole);
+	cfgSaveInt("nullDC","Emulator.MapFiles",settings.emulator.MapFiles);
 }
@@ -258,6 +258,7 @@ s32 plugins_Init_()
 	pvr_init_params pvr_info;
 	pvr_info.RaiseInterrupt=asic_RaiseInterrupt;
 	pvr_info.vram=&vram[0];
+	pvr_info.vram_readback=pvr_vram_readback;
 
 	if (s32 rv = libPvr_Init(&pvr_info))
 		return rv;
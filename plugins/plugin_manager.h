@@ -33,6 +33,7 @@ void plugins_Term();
 	//Will be called only when pvr locking is enabled
 	void FASTCALL libPvr_LockedBlockWrite(vram_block* block,u32 addr);	//set to 0 if not used
 	void FASTCALL libPvr_Update(u32 cycles);				//called every ~1800 cycles, set to 0 if not used
+	void FASTCALL libPvr_VramRead(u32 offset64,u32 size);	//VRAM range is about to be accessed, see pvr_init_params::vram_readback
 
 
 //AICA
@@ -117,6 +117,11 @@ struct pvr_init_params
 
 	//Vram is allocated by the emu.A pointer is given to the buffer here :)
 	u8*					vram; 
+
+	//First and last byte (64 bit offsets) of the VRAM the plugin has newer data for
+	//(render to texture). Set by the plugin. 32 bit area accesses and TA direct
+	//VRAM writes to it call libPvr_VramRead first. Empty when [0] > [1].
+	u32*				vram_readback;
 };
 
 //******************************************************
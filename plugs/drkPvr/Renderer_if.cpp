@@ -4,3 +4,456 @@
 u32 VertexCount=0;
 u32 FrameCount=0;
 
+#if REND_API != REND_SOFT
+
+/*
+Frame driver of the backend renderers (see Renderer_if.h).
+
+Everything here only depends on the TA output, the PVR registers and the
+texture cache, so it costs the same whatever backend draws the frame: the
+null backend measures exactly this part.
+*/
+
+#include "ta_vtx.h"
+#include "TexCache.h"
+#include "regs.h"
+
+#if REND_API == REND_WII
+#include "gxRend.h"
+static RendBackend &backend = gx_backend;
+#elif REND_API == REND_NULL
+#include "nullRend.h"
+static RendBackend &backend = null_backend;
+#else
+#error "No renderer backend for this REND_API"
+#endif
+
+using namespace TASplitter;
+
+char fps_text[512];
+
+static struct
+{
+  u32 frames;
+  u32 strips;
+  u32 draws;
+  u32 state_changes;
+  u32 placeholder;    // textured batches drawn before their texture was ready
+  u32 rebases;        // batches moved to a new base vertex (BatchReach)
+} rl_stats;
+
+// ============================
+// Render list compiler
+// ============================
+// The TA hands over one strip per VertexList, most of them only a few
+// vertices long, and games emit long runs of strips with the same state.
+// Before drawing, consecutive strips whose PolyParam state (ISP/TSP/TCW, the
+// texture enable and the shadow bit) is identical are merged into one batch, and every
+// strip is unrolled into indexed triangles (keeping the strip winding) so a
+// batch is a single draw with no degenerate stitching vertices. Strips
+// are never reordered: DC draw order matters for coplanar geometry (GEQUAL)
+// and for the translucent list.
+//
+// Vertex colours are swapped in place to the byte order the backends fetch
+// (little endian), the vertex array is then read by index for position,
+// colour and UV.
+//
+// With autosort the translucent strips are replaced by the depth sorted
+// triangles from TA_SortTranslucent, merged the same way.
+//
+// Indices are 16 bit, relative to a base vertex of the batch, so a frame is
+// not limited to 65536 vertices: a batch whose next strip or triangle is out
+// of reach goes on in a new batch, with the same state, based near it.
+
+struct RenderBatch
+{
+  PolyParam *mod;   // state for the batch
+  u32 base;         // vertex the batch's indices are relative to
+  u32 first;        // first index in rl_indices
+  u32 count;        // index count, a multiple of 3
+};
+
+static Array<u16> rl_indices;           // grow as needed, kept between frames
+static Array<RenderBatch> rl_batches;
+static u32 rl_batch_count;
+static u32 rl_trans_batch;      // first translucent batch
+
+static bool SameRenderState(const PolyParam *a, const PolyParam *b)
+{
+  return a->isp.full == b->isp.full && a->tsp.full == b->tsp.full &&
+         a->tcw.full == b->tcw.full && a->pcw.Texture == b->pcw.Texture &&
+         a->pcw.Shadow == b->pcw.Shadow;
+}
+
+static RenderBatch *OpenBatch(PolyParam *mod, u32 first)
+{
+  RenderBatch *batch = &rl_batches[rl_batch_count++];
+  batch->mod = mod;
+  batch->base = rl_batch_count > 1 ? batch[-1].base : 0;
+  batch->first = first;
+  batch->count = 0;
+  return batch;
+}
+
+// Indices are 16 bit, relative to the batch base. Vertices lo..hi past the
+// reach of the batch go on in a new batch, with the same state, based at
+// 'base'.
+static RenderBatch *BatchReach(RenderBatch *batch, u32 lo, u32 hi, u32 base, u32 first)
+{
+  if (lo >= batch->base && hi - batch->base <= 0xFFFF)
+    return batch;
+
+  if (batch->count)
+    batch = OpenBatch(batch->mod, first);
+  batch->base = base;
+  rl_stats.rebases++;
+  return batch;
+}
+
+static RenderBatch *CompileSorted(RenderBatch *batch, u16 *&idx, u32 sort_mode)
+{
+  u32 count;
+  const SortTri *tri = TA_SortTranslucent(sort_mode, &count);
+
+  for (u32 i = 0; i < count; i++, tri++)
+  {
+    PolyParam *mod = &listModes[tri->mod];
+    if (!batch || !SameRenderState(batch->mod, mod))
+    {
+      if (batch && batch->count == 0)
+        batch->mod = mod;
+      else
+        batch = OpenBatch(mod, idx - rl_indices.data);
+    }
+
+    // Sorted triangles come from anywhere in the array, a new base is put
+    // half a reach below them. A triangle is 3 consecutive strip vertices.
+    u32 lo = tri->v[0] < tri->v[1] ? tri->v[0] : tri->v[1];
+    batch = BatchReach(batch, lo, lo + 2, lo > 0x8000 ? lo - 0x8000 : 0, idx - rl_indices.data);
+
+    idx[0] = tri->v[0] - batch->base;
+    idx[1] = tri->v[1] - batch->base;
+    idx[2] = tri->v[2] - batch->base;
+    idx += 3;
+    batch->count += 3;
+  }
+  return batch;
+}
+
+static void CompileRenderList()
+{
+  Vertex *vtx = vertices;
+  PolyParam *mod = listModes;
+  RenderBatch *batch = 0;
+  rl_batch_count = 0;
+  rl_trans_batch = ~0u;
+
+  u32 sort_mode = TA_SortMode();
+  VertexList *sort_end = TA_SortEnd(sort_mode);
+
+  // One batch per PolyParam at most, plus the translucent boundary, plus one
+  // per triangle when sorting, plus the new bases (a strip batch moves by
+  // 65536 - TA_VTX_SLACK vertices at least, and once around the sorted ones)
+  u32 max_batches = (curMod - listModes) + 4 + (sort_end ? curVTX - vertices : 0) +
+                    (curVTX - vertices) / 0x8000;
+  if (max_batches > rl_batches.Size)
+    rl_batches.Resize(max_batches + max_batches / 2, false);
+
+  // A strip of n vertices has n-2 triangles
+  u32 max_indices = (curVTX - vertices) * 3;
+  if (max_indices > rl_indices.Size)
+    rl_indices.Resize(max_indices + max_indices / 2, false);
+  u16 *idx = rl_indices.data;
+
+  for (VertexList *lst = lists; lst != curLST; lst++)
+  {
+    if (lst == sort_end)
+      batch = CompileSorted(batch, idx, sort_mode);
+
+    // Never merge across the opaque/translucent boundary
+    if (lst == TransLST)
+    {
+      rl_trans_batch = rl_batch_count;
+      if (batch)
+        batch = OpenBatch(batch->mod, idx - rl_indices.data);
+    }
+
+    // Autosorted strips are added at the end of the translucent list
+    bool sorted = sort_end && lst >= TransLST && lst < sort_end;
+
+    s32 count = lst->count;
+    if (count < 0)
+    {
+      if (!sorted && (!batch || !SameRenderState(batch->mod, mod)))
+      {
+        if (batch && batch->count == 0)
+          batch->mod = mod;   // nothing drawn with the previous state
+        else
+          batch = OpenBatch(mod, idx - rl_indices.data);
+      }
+      mod++;
+      count &= 0x7FFF;
+    }
+
+    rl_stats.strips++;
+
+    u32 base = vtx - vertices;
+    for (s32 i = 0; i < count; i++)
+      vtx[i].col = HOST_TO_LE32(vtx[i].col);
+    vtx += count;
+
+    // Strip geometry before the first PolyParam has no state to draw with
+    if (!batch || count < 3 || sorted)
+      continue;
+
+    batch = BatchReach(batch, base, base + count - 1, base, idx - rl_indices.data);
+
+    for (s32 i = 0; i < count - 2; i++)
+    {
+      u32 v = base + i - batch->base;
+      if (i & 1)
+      {
+        idx[0] = v + 1;
+        idx[1] = v;
+      }
+      else
+      {
+        idx[0] = v;
+        idx[1] = v + 1;
+      }
+      idx[2] = v + 2;
+      idx += 3;
+    }
+    batch->count = (idx - rl_indices.data) - batch->first;
+  }
+
+  if (sort_end == curLST)
+    CompileSorted(batch, idx, sort_mode);
+}
+
+// ============================
+// Textures
+// ============================
+
+// TCW/TSP -> cache entry, for the textures already bound this frame.
+// Cache entries used in a frame are pinned, so the pointers stay valid
+// until the next TexCache_BeginFrame.
+#define TEX_BIND_SIZE 64   // power of 2
+
+struct TexBind
+{
+  u32 tcw;
+  u32 tsp;
+  u32 frame;
+  TexCacheEntry *entry;
+};
+
+static TexBind tex_binds[TEX_BIND_SIZE];
+static u32 tex_bind_frame = 1;
+
+static void BindTexture(PolyParam *mod)
+{
+  TexBind *bind = &tex_binds[(mod->tcw.full ^ (mod->tcw.full >> 11) ^ mod->tsp.full) & (TEX_BIND_SIZE - 1)];
+  if (bind->frame == tex_bind_frame && bind->tcw == mod->tcw.full && bind->tsp == mod->tsp.full)
+  {
+    backend.BindTexture(bind->entry);
+    return;
+  }
+
+  // A previous render to texture, sampled as a plain stride texture
+  if (mod->tcw.NO_PAL.ScanOrder && !mod->tcw.NO_PAL.VQ_Comp && mod->tcw.NO_PAL.PixelFmt < 3)
+  {
+    TexCacheRTT *rt = TexCache_FindRTT((mod->tcw.NO_PAL.TexAddr << 3) & VRAM_MASK);
+    if (rt)
+    {
+      backend.BindRenderTarget(rt, mod);
+      return;
+    }
+  }
+
+  u32 w = 8 << mod->tsp.TexU;
+  u32 h = 8 << mod->tsp.TexV;
+
+  u32 src_addr;
+  u32 src_size = TexCache_SourceRange(mod->tcw, mod->tsp, &src_addr);
+  TexCacheKey key = TexCache_MakeKey(mod->tcw, mod->tsp, backend.tsp_bits);
+
+  TexCacheEntry *entry;
+  TexCacheResult res = TexCache_Lookup(key, src_addr, src_size,
+                                       backend.TextureSize(mod, w, h), &entry);
+  if (res == TC_FAIL)
+  {
+    backend.BindTexture(0);
+    return;
+  }
+
+  // Only re-process texture if it is new or its VRAM contents changed.
+  if (res == TC_CONVERT)
+    backend.UpdateTexture(entry, mod, w, h);
+
+  // Not converted yet: vertex colours only
+  if (!entry->valid)
+  {
+    rl_stats.placeholder++;
+    backend.BindTexture(0);
+    return;
+  }
+
+  backend.BindTexture(entry);
+
+  bind->tcw = mod->tcw.full;
+  bind->tsp = mod->tsp.full;
+  bind->frame = tex_bind_frame;
+  bind->entry = entry;
+}
+
+// ============================
+// Frames
+// ============================
+
+// to_texture: render into a TexCacheRTT instead of the display
+static void RenderFrame(bool to_texture)
+{
+  CompileRenderList();
+
+  backend.BeginFrame(to_texture);
+  TexCache_BeginFrame();
+  tex_bind_frame++;
+
+  // Process opaque and then translucent batches.
+  for (u32 i = 0; i < rl_batch_count; i++)
+  {
+    RenderBatch *batch = &rl_batches[i];
+
+    if (i == rl_trans_batch)
+      backend.BeginTranslucent();
+
+    if (batch->count == 0)
+      continue;
+
+    PolyParam *mod = batch->mod;
+    backend.BindState(mod);
+    if (mod->pcw.Texture)
+      BindTexture(mod);
+    rl_stats.state_changes++;
+
+    backend.DrawBatch(batch->base, &rl_indices[batch->first], batch->count);
+    rl_stats.draws++;
+  }
+  rl_stats.frames++;
+
+  backend.EndFrame(to_texture);
+
+  reset_vtx_state();
+}
+
+void StartRender()
+{
+  u32 VtxCnt = curVTX - vertices;
+  VertexCount += VtxCnt;
+
+  // Render to texture: FB_W_SOF1 in the texture area
+  if ((FB_W_SOF1 & 0x1000000) && VtxCnt)
+  {
+    RenderFrame(true);
+    return;
+  }
+
+  if (FB_W_SOF1 & 0x1000000)
+  {
+    // 2D direct framebuffer mode (logo screens): the display shows what was
+    // written to VRAM, render targets included
+    TexCache_ReadbackRender(0, VRAM_SIZE - 1);
+    backend.Present2D();
+    FrameCount++;
+    return;
+  }
+
+  RenderFrame(false);
+
+  FrameCount++;
+}
+
+void EndRender() {}
+
+void VBlank() {}
+
+void SetFpsText(char *text)
+{
+  strcpy(fps_text, text);
+  printf(text);
+  if (settings.OSD.ShowStats)
+  {
+    TexCache_PrintStats();
+    backend.PrintStats();
+
+    if (rl_stats.frames)
+    {
+      double frames = rl_stats.frames;
+      printf("%s: %.0f strips, %.0f draw calls, %.0f state changes per frame, %u untextured (not ready), %u rebased\n",
+             backend.name, rl_stats.strips / frames, rl_stats.draws / frames,
+             rl_stats.state_changes / frames, rl_stats.placeholder, rl_stats.rebases);
+    }
+    memset(&rl_stats, 0, sizeof(rl_stats));
+
+    if (ta_sort_stats.frames)
+      printf("autosort: %.0f tris, %.3f ms per frame\n",
+             (double)ta_sort_stats.tris / ta_sort_stats.frames, ta_sort_stats.time * 1000 / ta_sort_stats.frames);
+    memset(&ta_sort_stats, 0, sizeof(ta_sort_stats));
+
+    TA_ArenaPrintStats();
+  }
+}
+
+bool InitRenderer()
+{
+  if (!backend.Init())
+    return false;
+  return TileAccel_Init();
+}
+
+void TermRenderer()
+{
+  backend.Term();
+  TileAccel_Term();
+}
+
+void ResetRenderer(bool Manual)
+{
+  TileAccel_Reset(Manual);
+  backend.Reset(Manual);
+  TexCache_Clear();
+  VertexCount = 0;
+  FrameCount = 0;
+}
+
+bool ThreadStart()
+{
+  return true;
+}
+
+void ThreadEnd()
+{
+}
+
+void ListCont()
+{
+  TileAccel_ListCont();
+}
+
+void ListInit()
+{
+  TileAccel_ListInit();
+}
+
+void SoftReset()
+{
+  TileAccel_SoftReset();
+}
+
+void VramLockedWrite(vram_block *bl)
+{
+  TexCache_Invalidate(bl->start, bl->end);
+}
+
+#endif // REND_API != REND_SOFT
@@ -7,8 +7,102 @@ extern u32 VertexCount;
 extern u32 FrameCount;
 
 // #include "gsRend.h" // PS2
-#include "gxRend.h" // Wii
-// #include "nullRend.h" // PSP
 // #include "glesRend.h" // DirectX 11 ? OpenGL ? PS3 ?
-// #include "softRend.h" // Sofware Render
+#if REND_API == REND_SOFT
+#include "softRend.h" // Sofware Render
+#else
 
+// ============================================================================
+// Renderer backends
+// ============================================================================
+// Everything but the software renderer goes through the frame driver
+// (Renderer_if.cpp). The driver implements the rend_* entry points: it tells
+// 3D frames, renders to texture and 2D framebuffer frames apart, compiles the
+// TA lists into batches, resolves textures through the texture cache and
+// keeps the statistics. The backend only does what touches the host GPU:
+//
+//   REND_WII   gx_backend   (gxRend.cpp)
+//   REND_NULL  null_backend (nullRend.cpp), prepares every frame the way the
+//              GX backend sees it but draws nothing, to profile the CPU side
+//              of the PVR on a host
+//
+// A 3D frame is: lists compiled, BeginFrame, for every batch BindState then
+// BindTexture / BindRenderTarget for textured ones and DrawBatch, with
+// BeginTranslucent before the first translucent batch, then EndFrame.
+// ============================================================================
+
+struct PolyParam;
+struct TexCacheEntry;
+struct TexCacheRTT;
+
+struct RendBackend
+{
+    const char* name;
+    u32 tsp_bits;           // TSP bits baked into a converted texture besides
+                            // the size (TexCache_MakeKey), set by Init
+
+    bool (*Init)();         // TexCache_Init is up to the backend
+    void (*Term)();
+    void (*Reset)(bool manual);     // before the texture cache is cleared
+
+    // to_texture: render into a TexCacheRTT (FB_W_SOF1) instead of the display
+    void (*BeginFrame)(bool to_texture);
+    void (*EndFrame)(bool to_texture);
+    // Frame without 3D: show the 2D framebuffer (FB_R_SOF1)
+    void (*Present2D)();
+
+    void (*BeginTranslucent)();
+    void (*BindState)(const PolyParam* mod);
+
+    // Backend storage of a texture cache entry, and its conversion after a
+    // TC_CONVERT lookup. The conversion may finish later, entry->valid tells.
+    u32 (*TextureSize)(const PolyParam* mod, u32 w, u32 h);
+    void (*UpdateTexture)(TexCacheEntry* entry, const PolyParam* mod, u32 w, u32 h);
+    // NULL: draw the batch with its vertex colours
+    void (*BindTexture)(TexCacheEntry* entry);
+    void (*BindRenderTarget)(TexCacheRTT* rt, const PolyParam* mod);
+
+    // Indexed triangles of the TA vertex array, 'count' a multiple of 3. The
+    // 16 bit indices are relative to vertices[base].
+    void (*DrawBatch)(u32 base, const u16* idx, u32 count);
+
+    // Backend lines of rend_set_fps_text, with OSD.ShowStats
+    void (*PrintStats)();
+};
+
+bool InitRenderer();
+void TermRenderer();
+void ResetRenderer(bool Manual);
+
+bool ThreadStart();
+void ThreadEnd();
+void VBlank();
+void StartRender();
+void EndRender();
+
+void ListCont();
+void ListInit();
+void SoftReset();
+
+void SetFpsText(char* text);
+
+
+#define rend_init         InitRenderer
+#define rend_term         TermRenderer
+#define rend_reset        ResetRenderer
+
+#define rend_thread_start ThreadStart
+#define rend_thread_end	  ThreadEnd
+#define rend_vblank       VBlank
+#define rend_start_render StartRender
+#define rend_end_render   EndRender
+
+#define rend_list_cont ListCont
+#define rend_list_init ListInit
+#define rend_list_srst SoftReset
+
+#define rend_set_fps_text SetFpsText
+#define rend_set_render_rect(rect,sht)
+#define rend_set_fb_scale(x,y)
+
+#endif
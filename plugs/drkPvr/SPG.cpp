@@ -6,25 +6,173 @@
 #include "spg.h"
 #include "Renderer_if.h"
 #include "regs.h"
+#include "ta_vtx.h"
 
 u32 spg_InVblank = 0;
-s32 spg_ScanlineSh4CycleCounter = 0;
 u32 spg_ScanlineCount = 512;
-u32 spg_CurrentScanline = (u32)-1;  // Explicit -1 cast, avoids signed/unsigned warning
+u32 spg_CurrentScanline = 0;
 u32 spg_VblankCount = 0;
 s32 spg_LineSh4Cycles = 0;
 u32 spg_FrameSh4Cycles = 0;
 
+// Event scheduling: instead of stepping every scanline, the SPG computes how
+// many SH4 cycles from the start of the current scanline the next scanline
+// with something to do is (SCANINT1/2, vblank in/out). UpdatePvr only adds
+// the cycles up until that point is reached. SPG_STATUS is worked out when
+// it is read.
+static u32 spg_LineElapsed = 0;     // cycles since spg_CurrentScanline started
+static u32 spg_NextEvent = 0;       // cycles from its start to the next event line
+
+// Frame skip: every FS_WINDOW vblanks the host time they took is compared
+// with their emulated length (spg_FrameSh4Cycles). Slower than FS_SLOW of
+// it skips one more frame, faster than FS_FAST one less; the gap between
+// the two keeps the count from flapping as skipping speeds things up.
+#define FS_WINDOW 16
+#define FS_SLOW   1.05
+#define FS_FAST   0.90
+
+u32 spg_FrameSkip = 0;
+static double fs_window_start = 0;
+
+static void spg_UpdateFrameSkip(double now)
+{
+    if (!settings.Emulation.FrameSkip || !spg_FrameSh4Cycles)
+    {
+        spg_FrameSkip = 0;
+        fs_window_start = now;
+        return;
+    }
+
+    double frame_time = (now - fs_window_start) / FS_WINDOW;
+    double budget = (double)spg_FrameSh4Cycles / SH4_CLOCK;
+    fs_window_start = now;
+
+    if (frame_time > budget * FS_SLOW && spg_FrameSkip < settings.Emulation.FrameSkip)
+        spg_FrameSkip++;
+    else if (frame_time < budget * FS_FAST && spg_FrameSkip > 0)
+        spg_FrameSkip--;
+}
+
+// ============================
+// Telemetry
+// ============================
+// Low frequency hook, run every FS_WINDOW vblanks with the host time read
+// for the frame skip: prints the speed and frame statistics every 2 seconds.
+
 double spg_last_vps = 0;
 
+static void spg_Telemetry(double now)
+{
+    double tdiff = now - spg_last_vps;
+    if (tdiff <= 2.0)
+        return;
+
+    spg_last_vps = now;
+
+    double spd_fps = FrameCount    / tdiff;
+    double spd_vbs = spg_VblankCount / tdiff;
+    double spd_cpu = (spd_vbs * spg_FrameSh4Cycles) / 1000000.0;
+    double fullvbs = (spd_vbs / spd_cpu) * 200.0;
+    double mv      = VertexCount  / 1000.0;
+
+    u32 skipped    = ta_skip_count;
+    u32 lost       = ta_skip_lost;
+
+    VertexCount    = 0;
+    FrameCount     = 0;
+    spg_VblankCount = 0;
+    ta_skip_count  = 0;
+    ta_skip_lost   = 0;
+
+    // Determine video mode strings
+    const char* mode;
+    const char* res;
+
+    if (SPG_CONTROL.NTSC == 0 && SPG_CONTROL.PAL == 1)
+    {
+        mode = "PAL";
+        res  = SPG_CONTROL.interlace ? "480i" : "240p";
+    }
+    else if (SPG_CONTROL.NTSC == 1 && SPG_CONTROL.PAL == 0)
+    {
+        mode = "NTSC";
+        res  = SPG_CONTROL.interlace ? "480i" : "240p";
+    }
+    else
+    {
+        mode = "VGA";
+        res  = SPG_CONTROL.interlace ? "480i" : "480p";
+    }
+
+    char fpsStr[256];
+    sprintf(fpsStr,
+        "%3.2f%% VPS:%3.2f(%s%s%3.2f)RPS:%3.2f vt:%4.2fK %4.2fK",
+        spd_cpu * 100.0 / 200.0, spd_vbs,
+        mode, res, fullvbs,
+        spd_fps,
+        (spd_fps > 0.0 ? mv / spd_fps / tdiff : 0.0),
+        mv / tdiff);
+
+    if (settings.Emulation.FrameSkip)
+        sprintf(fpsStr + strlen(fpsStr), " skip:%u (%3.2f/s)", spg_FrameSkip, skipped / tdiff);
+    if (lost)
+        sprintf(fpsStr + strlen(fpsStr), " rtt lost:%u", lost);
+
+    rend_set_fps_text(fpsStr);
+
+#ifndef TARGET_PSP
+    printf("%s\n", fpsStr);
+#endif
+    // PSP profiler logging removed for Wii build — not applicable
+}
+
 // 54 MHz pixel clock (register defines it as 27 MHz, doubled here)
 //54 mhz pixel clock (actually, this is defined as 27 .. why ? --drk)
 
 #define PIXEL_CLOCK (27000000) // (54 * 1000 * 1000 / 2)
 
+// Scanlines from the current one to the next one 'line' (1..count)
+static INLINE u32 spg_LinesTo(u32 line)
+{
+    u32 d = (line + spg_ScanlineCount - spg_CurrentScanline) % spg_ScanlineCount;
+    return d ? d : spg_ScanlineCount;
+}
+
+// Works out spg_NextEvent from the current scanline and the SPG registers
+static void spg_Schedule()
+{
+    u32 lines = spg_LinesTo(SPG_VBLANK_INT.vblank_in_interrupt_line_number);
+    u32 d = spg_LinesTo(SPG_VBLANK_INT.vblank_out_interrupt_line_number);
+    if (d < lines) lines = d;
+    d = spg_LinesTo(SPG_VBLANK.vbstart);
+    if (d < lines) lines = d;
+    d = spg_LinesTo(SPG_VBLANK.vbend);
+    if (d < lines) lines = d;
+
+    spg_NextEvent = lines * spg_LineSh4Cycles;
+}
+
+// Moves spg_CurrentScanline up to the line being drawn, spg_LineElapsed keeps
+// only the cycles into it. Between events UpdatePvr only adds to
+// spg_LineElapsed, which can then span several lines without events.
+static void spg_Resync()
+{
+    if (spg_LineSh4Cycles < 1)
+        return;
+
+    u32 lines = spg_LineElapsed / spg_LineSh4Cycles;
+    spg_CurrentScanline = (spg_CurrentScanline + lines) % spg_ScanlineCount;
+    spg_LineElapsed -= lines * spg_LineSh4Cycles;
+}
+
 // Called when SPG registers are updated
 void CalculateSync()
 {
+    // Lines already drawn are counted with the old line length, and the new
+    // events are scheduled from the line being drawn
+    spg_Resync();
+    s32 old_line = spg_LineSh4Cycles;
+
     u32 pixel_clock = FB_R_CTRL.vclk_div ? PIXEL_CLOCK : PIXEL_CLOCK / 2;
 
     spg_ScanlineCount = SPG_LOAD.vcount + 1;
@@ -45,107 +193,100 @@ void CalculateSync()
              (SPG_CONTROL.NTSC == 1 && SPG_CONTROL.PAL == 1)) ? 1.0f : 0.5f);
     }
 
+    if (spg_LineSh4Cycles < 1)
+        spg_LineSh4Cycles = 1;
     spg_FrameSh4Cycles = spg_ScanlineCount * spg_LineSh4Cycles;
-}
 
-s32 render_end_pending_cycles = 0;
+    // Same point of the line, in cycles of the new length
+    if (old_line > 0)
+        spg_LineElapsed = (u32)((u64)spg_LineElapsed * spg_LineSh4Cycles / old_line);
 
-// Called from SH4 context each dispatch; updates PVR/TA state
-void FASTCALL libPvr_UpdatePvr(u32 cycles)
+    spg_CurrentScanline %= spg_ScanlineCount;
+    spg_Schedule();
+}
+
+// Start of vblank
+static void spg_Vblank()
 {
-    spg_ScanlineSh4CycleCounter -= (s32)cycles;
+    spg_VblankCount++;
+
+    // Interlaced field toggle
+    SPG_STATUS.fieldnum = SPG_CONTROL.interlace ? (~SPG_STATUS.fieldnum & 1) : 0;
+
+    // Note: holly_HBLank is actually VBlank on real HW — HBlank not yet emulated
+    params.RaiseInterrupt(holly_HBLank);
 
-    if (spg_ScanlineSh4CycleCounter < spg_LineSh4Cycles)
+    // Don't let SQ data sit in the batch across frames
+    TASplitter::TA_SQFlush();
+
+    rend_vblank();
+
+    // The host clock is read once per FS_WINDOW vblanks
+    static u32 slow_vblanks = 0;
+    if (++slow_vblanks >= FS_WINDOW)
     {
-        // A full scanline has elapsed
-        spg_CurrentScanline = (spg_CurrentScanline + 1) % spg_ScanlineCount;
-        spg_ScanlineSh4CycleCounter += spg_LineSh4Cycles;
+        slow_vblanks = 0;
+        double now = os_GetSeconds();
+        spg_UpdateFrameSkip(now);
+        spg_Telemetry(now);
+    }
+}
 
-        // Scanline-triggered interrupts
-        if (SPG_VBLANK_INT.vblank_in_interrupt_line_number == spg_CurrentScanline)
-            params.RaiseInterrupt(holly_SCANINT1);
+// Runs the events of the scanline just entered
+static void spg_LineEvents(u32 line)
+{
+    if (SPG_VBLANK_INT.vblank_in_interrupt_line_number == line)
+        params.RaiseInterrupt(holly_SCANINT1);
 
-        if (SPG_VBLANK_INT.vblank_out_interrupt_line_number == spg_CurrentScanline)
-            params.RaiseInterrupt(holly_SCANINT2);
+    if (SPG_VBLANK_INT.vblank_out_interrupt_line_number == line)
+        params.RaiseInterrupt(holly_SCANINT2);
 
-        // Vblank window
-        if (SPG_VBLANK.vbstart == spg_CurrentScanline)
-            spg_InVblank = 1;
+    if (SPG_VBLANK.vbstart == line)
+        spg_InVblank = 1;
 
-        if (SPG_VBLANK.vbend == spg_CurrentScanline)
-            spg_InVblank = 0;
+    if (SPG_VBLANK.vbend == line)
+        spg_InVblank = 0;
 
-        // Interlaced field toggle
-        SPG_STATUS.fieldnum = SPG_CONTROL.interlace ? (~SPG_STATUS.fieldnum & 1) : 0;
+    SPG_STATUS.vsync   = spg_InVblank;
+    SPG_STATUS.scanline = line;
 
-        SPG_STATUS.vsync   = spg_InVblank;
-        SPG_STATUS.scanline = spg_CurrentScanline;
+    if (SPG_VBLANK.vbstart == line)
+        spg_Vblank();
+}
 
-        // Start of vblank
-        if (SPG_VBLANK.vbstart == spg_CurrentScanline)
-        {
-            spg_VblankCount++;
-
-            // Note: holly_HBLank is actually VBlank on real HW — HBlank not yet emulated
-            params.RaiseInterrupt(holly_HBLank);
-
-            rend_vblank();
-
-            // Update FPS display every 2 seconds
-            double now = os_GetSeconds();
-            double tdiff = now - spg_last_vps;
-
-            if (tdiff > 2.0)
-            {
-                spg_last_vps = now;
-
-                double spd_fps = FrameCount    / tdiff;
-                double spd_vbs = spg_VblankCount / tdiff;
-                double spd_cpu = (spd_vbs * spg_FrameSh4Cycles) / 1000000.0;
-                double fullvbs = (spd_vbs / spd_cpu) * 200.0;
-                double mv      = VertexCount  / 1000.0;
-
-                VertexCount    = 0;
-                FrameCount     = 0;
-                spg_VblankCount = 0;
-
-                // Determine video mode strings
-                const char* mode;
-                const char* res;
-
-                if (SPG_CONTROL.NTSC == 0 && SPG_CONTROL.PAL == 1)
-                {
-                    mode = "PAL";
-                    res  = SPG_CONTROL.interlace ? "480i" : "240p";
-                }
-                else if (SPG_CONTROL.NTSC == 1 && SPG_CONTROL.PAL == 0)
-                {
-                    mode = "NTSC";
-                    res  = SPG_CONTROL.interlace ? "480i" : "240p";
-                }
-                else
-                {
-                    mode = "VGA";
-                    res  = SPG_CONTROL.interlace ? "480i" : "480p";
-                }
-
-                char fpsStr[256];
-                sprintf(fpsStr,
-                    "%3.2f%% VPS:%3.2f(%s%s%3.2f)RPS:%3.2f vt:%4.2fK %4.2fK",
-                    spd_cpu * 100.0 / 200.0, spd_vbs,
-                    mode, res, fullvbs,
-                    spd_fps,
-                    (spd_fps > 0.0 ? mv / spd_fps / tdiff : 0.0),
-                    mv / tdiff);
-
-                rend_set_fps_text(fpsStr);
+// Brings SPG_STATUS up to the cycle, for reads
+void spg_UpdateStatus()
+{
+    u32 line = (spg_CurrentScanline + spg_LineElapsed / spg_LineSh4Cycles) % spg_ScanlineCount;
+    u32 vbstart = SPG_VBLANK.vbstart;
+    u32 vbend = SPG_VBLANK.vbend;
 
-#ifndef TARGET_PSP
-                printf("%s\n", fpsStr);
-#endif
-                // PSP profiler logging removed for Wii build — not applicable
-            }
-        }
+    bool in_vblank = vbstart <= vbend ? (line >= vbstart && line < vbend)
+                                      : (line >= vbstart || line < vbend);
+
+    SPG_STATUS.vsync = in_vblank;
+    SPG_STATUS.scanline = line;
+}
+
+s32 render_end_pending_cycles = 0;
+
+// Called from SH4 context each dispatch; updates PVR/TA state
+void FASTCALL libPvr_UpdatePvr(u32 cycles)
+{
+    // List end interrupts from the threaded TA
+    TASplitter::TA_Update();
+
+    spg_LineElapsed += cycles;
+
+    while (spg_LineElapsed >= spg_NextEvent)
+    {
+        // Skip to the event line, nothing happens on the lines before it
+        u32 lines = spg_NextEvent / spg_LineSh4Cycles;
+        spg_CurrentScanline = (spg_CurrentScanline + lines) % spg_ScanlineCount;
+        spg_LineElapsed -= spg_NextEvent;
+
+        spg_LineEvents(spg_CurrentScanline);
+        spg_Schedule();
     }
 
     // Deferred render completion interrupt
@@ -154,6 +295,9 @@ void FASTCALL libPvr_UpdatePvr(u32 cycles)
         render_end_pending_cycles -= (s32)cycles;
         if (render_end_pending_cycles <= 0)
         {
+            // With the threaded TA the frame may still be drawing
+            TASplitter::TA_WaitRender();
+
             params.RaiseInterrupt(holly_RENDER_DONE);
             params.RaiseInterrupt(holly_RENDER_DONE_isp);
             params.RaiseInterrupt(holly_RENDER_DONE_vd);
@@ -162,8 +306,18 @@ void FASTCALL libPvr_UpdatePvr(u32 cycles)
     }
 }
 
+// Scanline 0 starts with the next update
+static void spg_Start()
+{
+    CalculateSync();
+    spg_CurrentScanline = spg_ScanlineCount - 1;
+    spg_LineElapsed = spg_LineSh4Cycles;
+    spg_Schedule();
+}
+
 bool spg_Init()
 {
+    spg_Start();
     return true;
 }
 
@@ -173,5 +327,7 @@ void spg_Term()
 
 void spg_Reset(bool Manual)
 {
-    CalculateSync();
+    spg_FrameSkip = 0;
+    fs_window_start = os_GetSeconds();
+    spg_Start();
 }
\ No newline at end of file
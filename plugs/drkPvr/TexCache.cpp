@@ -0,0 +1,928 @@
+#include "TexCache.h"
+#include "ta.h"
+#include "regs.h"
+#include <malloc.h>
+
+/*
+Entries come from a fixed pool and are found through a small hash table on
+the key. Live entries are also kept on an LRU list (head = most recently
+used), which is what eviction and invalidation walk.
+
+Backend storage is either carved out of the pool passed to TexCache_Init (the
+MEM2 block on Wii, so the GPU can read it directly) with a first fit
+allocator, or taken from the heap when no pool is given.
+
+Palettes live in a small array of slots with their storage in one heap block,
+searched linearly: that only happens when a bank was written to.
+*/
+
+#define TC_MAX_ENTRIES  4096
+#define TC_BUCKETS      1024       // power of 2
+#define TC_ALIGN        32
+
+static TexCacheEntry tc_entries[TC_MAX_ENTRIES];
+static TexCacheEntry* tc_buckets[TC_BUCKETS];
+static TexCacheEntry* tc_free_entries;
+static TexCacheEntry* tc_lru_head;
+static TexCacheEntry* tc_lru_tail;
+
+static u32 tc_frame;
+static u32 tc_budget;
+static u32 tc_used;                // bytes of backend storage alive
+static u32 tc_live;                // live entries
+static double tc_convert_start;
+
+static struct
+{
+    u32 lookups;
+    u32 hits;
+    u32 misses;                    // key not cached
+    u32 changed;                   // key cached, source content changed
+    u32 evictions;
+    u32 failures;
+    u32 hashed;                    // bytes hashed
+    double convert_time;
+    u32 rtt_renders;
+    u32 rtt_hits;                  // textures taken from a render target
+    u32 rtt_readbacks;
+    u32 rtt_dropped;               // overwritten in VRAM
+    u32 pal_lookups;
+    u32 pal_hashes;                // banks rehashed after a write
+    u32 pal_converts;
+} tc_stats;
+
+static TexCacheRTT tc_rtt[TC_MAX_RTT];
+static u32 tc_rtt_dirty;           // render targets VRAM is behind on
+static u32 tc_rtt_serial;
+static TexCacheReadbackFP* tc_readback;
+
+// ============================
+// Storage
+// ============================
+
+// Block header, blocks are laid out back to back over the pool
+struct TcBlock
+{
+    u32 size;                      // including the header
+    u32 used;
+    TcBlock* prev;                 // physically previous block, NULL for the first
+};
+
+#define TC_HDR TC_ALIGN
+
+static u8* tc_pool;
+static u8* tc_pool_end;
+
+static INLINE TcBlock* tc_next(TcBlock* b)
+{
+    return (TcBlock*)((u8*)b + b->size);
+}
+
+static void* tc_alloc(u32 size)
+{
+    if (!tc_pool)
+        return memalign(TC_ALIGN, size);
+
+    u32 need = (size + TC_HDR + TC_ALIGN - 1) & ~(TC_ALIGN - 1);
+
+    for (TcBlock* b = (TcBlock*)tc_pool; (u8*)b < tc_pool_end; b = tc_next(b))
+    {
+        if (b->used || b->size < need)
+            continue;
+
+        // split, if what is left can hold anything
+        if (b->size - need >= 2 * TC_HDR)
+        {
+            TcBlock* rest = (TcBlock*)((u8*)b + need);
+            rest->size = b->size - need;
+            rest->used = 0;
+            rest->prev = b;
+            b->size = need;
+
+            TcBlock* after = tc_next(rest);
+            if ((u8*)after < tc_pool_end)
+                after->prev = rest;
+        }
+
+        b->used = 1;
+        return (u8*)b + TC_HDR;
+    }
+
+    return 0;
+}
+
+static void tc_release(void* ptr)
+{
+    if (!tc_pool)
+    {
+        free(ptr);
+        return;
+    }
+
+    TcBlock* b = (TcBlock*)((u8*)ptr - TC_HDR);
+    b->used = 0;
+
+    // merge with the following block
+    TcBlock* next = tc_next(b);
+    if ((u8*)next < tc_pool_end && !next->used)
+    {
+        b->size += next->size;
+        next = tc_next(b);
+        if ((u8*)next < tc_pool_end)
+            next->prev = b;
+    }
+
+    // merge with the preceding block
+    TcBlock* prev = b->prev;
+    if (prev && !prev->used)
+    {
+        prev->size += b->size;
+        if ((u8*)next < tc_pool_end)
+            next->prev = prev;
+    }
+}
+
+// ============================
+// Entries
+// ============================
+
+static INLINE u32 tc_bucket(const TexCacheKey& key)
+{
+    u32 h = key.tcw * 0x9E3779B1;
+    h ^= key.tsp * 0x85EBCA6B;
+    h ^= key.stride * 0xC2B2AE35;
+    return (h ^ (h >> 16)) & (TC_BUCKETS - 1);
+}
+
+static INLINE bool tc_same_key(const TexCacheKey& a, const TexCacheKey& b)
+{
+    return a.tcw == b.tcw && a.tsp == b.tsp && a.stride == b.stride;
+}
+
+static void tc_lru_unlink(TexCacheEntry* e)
+{
+    if (e->lru_prev)
+        e->lru_prev->lru_next = e->lru_next;
+    else
+        tc_lru_head = e->lru_next;
+
+    if (e->lru_next)
+        e->lru_next->lru_prev = e->lru_prev;
+    else
+        tc_lru_tail = e->lru_prev;
+}
+
+static void tc_lru_push(TexCacheEntry* e)
+{
+    e->lru_prev = 0;
+    e->lru_next = tc_lru_head;
+    if (tc_lru_head)
+        tc_lru_head->lru_prev = e;
+    else
+        tc_lru_tail = e;
+    tc_lru_head = e;
+}
+
+static void tc_remove(TexCacheEntry* e)
+{
+    TexCacheEntry** link = &tc_buckets[tc_bucket(e->key)];
+    while (*link != e)
+        link = &(*link)->chain;
+    *link = e->chain;
+
+    tc_lru_unlink(e);
+
+    tc_release(e->data);
+    tc_used -= e->data_size;
+    tc_live--;
+
+    e->chain = tc_free_entries;
+    tc_free_entries = e;
+}
+
+// Evicts the least recently used entry not used this frame
+static bool tc_evict_one()
+{
+    for (TexCacheEntry* e = tc_lru_tail; e && e->used_frame != tc_frame; e = e->lru_prev)
+    {
+        if (e->pending)
+            continue;
+
+        tc_remove(e);
+        tc_stats.evictions++;
+        return true;
+    }
+
+    return false;
+}
+
+// ============================
+// Hashing
+// ============================
+
+static INLINE u32 tc_rotl(u32 v, u32 s)
+{
+    return (v << s) | (v >> (32 - s));
+}
+
+// Hashes 32 bytes into four independent lanes
+static INLINE void tc_hash_line(u32* h, const u32* p)
+{
+    h[0] = tc_rotl(h[0] + p[0] * 0x85EBCA77, 13) * 0x9E3779B1;
+    h[1] = tc_rotl(h[1] + p[1] * 0x85EBCA77, 13) * 0x9E3779B1;
+    h[2] = tc_rotl(h[2] + p[2] * 0x85EBCA77, 13) * 0x9E3779B1;
+    h[3] = tc_rotl(h[3] + p[3] * 0x85EBCA77, 13) * 0x9E3779B1;
+    h[0] = tc_rotl(h[0] + p[4] * 0x85EBCA77, 13) * 0x9E3779B1;
+    h[1] = tc_rotl(h[1] + p[5] * 0x85EBCA77, 13) * 0x9E3779B1;
+    h[2] = tc_rotl(h[2] + p[6] * 0x85EBCA77, 13) * 0x9E3779B1;
+    h[3] = tc_rotl(h[3] + p[7] * 0x85EBCA77, 13) * 0x9E3779B1;
+}
+
+// Content hash of [addr, addr+size) in the 64 bit VRAM view.
+// Sampled mode hashes one 32 byte line out of every four, plus the last line.
+static u32 tc_hash_vram(u32 addr, u32 size)
+{
+    u32 h[4] = { 0x2545F491, 0x9E3779B9, 0x7F4A7C15, size };
+
+    u32 start = addr & ~31;
+    u32 end = (addr + size + 31) & ~31;
+    if (end > VRAM_SIZE)
+        end = VRAM_SIZE;
+
+    u32 step = settings.TexCache.HashMode ? 128 : 32;
+
+    for (u32 a = start; a < end; a += step)
+        tc_hash_line(h, (const u32*)&params.vram[a]);
+    if (step != 32 && end - start >= 32)
+        tc_hash_line(h, (const u32*)&params.vram[end - 32]);
+
+    tc_stats.hashed += (end - start) * 32 / step;
+
+    return tc_rotl(h[0], 1) + tc_rotl(h[1], 7) + tc_rotl(h[2], 12) + tc_rotl(h[3], 18);
+}
+
+u32 TexCache_HashPalette(u32 first, u32 count)
+{
+    u32 h = 0x811C9DC5 ^ (PAL_RAM_CTRL & 3);
+    const u32* pal = &PALETTE_RAM[first & 1023];
+
+    for (u32 i = 0; i < count; i++)
+        h = (h ^ pal[i]) * 0x01000193;
+
+    return h | 1;   // never 0, which means "no palette"
+}
+
+// ============================
+// Palettes
+// ============================
+
+#define TC_PAL_SLOTS 128
+
+static TexCachePalette tc_pals[TC_PAL_SLOTS];
+static u8* tc_pal_data;
+
+// Last lookup of each bank: skips the hash while the bank revision is the same
+struct TcPalMemo
+{
+    u32 rev;
+    u32 format;
+    u32 hash;
+    TexCachePalette* pal;
+};
+
+static TcPalMemo tc_pal_memo_16[64];
+static TcPalMemo tc_pal_memo_256[4];
+
+static void tc_pal_reset()
+{
+    for (u32 i = 0; i < TC_PAL_SLOTS; i++)
+    {
+        tc_pals[i].hash = 0;
+        tc_pals[i].used_frame = 0;
+        tc_pals[i].valid = false;
+    }
+    memset(tc_pal_memo_16, 0, sizeof(tc_pal_memo_16));
+    memset(tc_pal_memo_256, 0, sizeof(tc_pal_memo_256));
+}
+
+TexCacheResult TexCache_LookupPalette(u32 first, u32 count, TexCachePalette** pal)
+{
+    tc_stats.pal_lookups++;
+
+    first &= 1024 - count;
+    u32 format = PAL_RAM_CTRL & 3;
+    TcPalMemo* memo;
+    u32 rev;
+    if (count == 16)
+    {
+        memo = &tc_pal_memo_16[first >> 4];
+        rev = pal_rev_16[first >> 4];
+    }
+    else
+    {
+        memo = &tc_pal_memo_256[first >> 8];
+        rev = pal_rev_256[first >> 8];
+    }
+
+    TexCachePalette* p = memo->pal;
+    if (!p || memo->rev != rev || memo->format != format || p->hash != memo->hash ||
+        p->first != first || p->count != count)
+    {
+        tc_stats.pal_hashes++;
+        u32 hash = TexCache_HashPalette(first, count);
+
+        p = 0;
+        TexCachePalette* victim = 0;
+        for (u32 i = 0; i < TC_PAL_SLOTS; i++)
+        {
+            TexCachePalette* s = &tc_pals[i];
+            if (s->hash == hash && s->first == first && s->count == count && s->format == format)
+            {
+                p = s;
+                break;
+            }
+            if (s->used_frame != tc_frame && (!victim || s->used_frame < victim->used_frame))
+                victim = s;
+        }
+
+        if (!p)
+        {
+            if (!victim || !tc_pal_data)
+            {
+                tc_stats.failures++;
+                return TC_FAIL;
+            }
+            p = victim;
+            p->first = first;
+            p->count = count;
+            p->format = format;
+            p->hash = hash;
+            p->valid = false;
+        }
+
+        memo->rev = rev;
+        memo->format = format;
+        memo->hash = hash;
+        memo->pal = p;
+    }
+
+    p->used_frame = tc_frame;
+    *pal = p;
+
+    if (p->valid)
+        return TC_HIT;
+
+    tc_stats.pal_converts++;
+    return TC_CONVERT;
+}
+
+u32 TexCache_MipLevels(TCW tcw, TSP tsp)
+{
+    u32 fmt = tcw.NO_PAL.PixelFmt;
+    bool twiddled = fmt == 5 || fmt == 6 || !tcw.NO_PAL.ScanOrder;
+    return tcw.NO_PAL.MipMapped && twiddled ? tsp.TexU + 4 : 1;
+}
+
+/*
+A mip chain is stored from 1x1 up. The 1x1 level sits at texel 3, so that
+the 2x2 one starts on texel 4, then every level follows the previous one.
+With VQ each index byte covers 2x2 texels: the 1x1 level has a byte of its
+own at 0 and the 2x2 one starts at 1.
+*/
+u32 TexCache_MipOffset(TCW tcw, u32 level)
+{
+    if (!tcw.NO_PAL.MipMapped)
+        return 0;
+
+    if (tcw.NO_PAL.VQ_Comp && tcw.NO_PAL.PixelFmt != 5 && tcw.NO_PAL.PixelFmt != 6)
+        return level ? 1 + ((1 << (2 * (level - 1))) - 1) / 3 : 0;
+
+    return 3 + ((1 << (2 * level)) - 1) / 3;
+}
+
+u32 TexCache_SourceRange(TCW tcw, TSP tsp, u32* addr)
+{
+    u32 w = 8 << tsp.TexU;
+    u32 h = 8 << tsp.TexV;
+    u32 mip = TexCache_MipOffset(tcw, tsp.TexU + 3);
+
+    *addr = (tcw.NO_PAL.TexAddr << 3) & VRAM_MASK;
+
+    switch (tcw.NO_PAL.PixelFmt)
+    {
+    case 5:     // 4 bpp palette
+        return (mip + w * h) / 2;
+    case 6:     // 8 bpp palette
+        return mip + w * h;
+    }
+
+    if (tcw.NO_PAL.VQ_Comp)
+        return 256 * 4 * 2 + mip + w * h / 4;
+
+    if (tcw.NO_PAL.ScanOrder)
+    {
+        u32 stride = tcw.NO_PAL.StrideSel ? (TEXT_CONTROL & 31) * 32 : w;
+        return stride * h * 2;
+    }
+
+    return (mip + w * h) * 2;
+}
+
+TexCacheKey TexCache_MakeKey(TCW tcw, TSP tsp, u32 tsp_bits)
+{
+    TSP size;
+    size.full = 0;
+    size.TexU = tsp.TexU;
+    size.TexV = tsp.TexV;
+
+    TexCacheKey key;
+    key.tcw = tcw.full;
+    key.tsp = size.full | (tsp.full & tsp_bits);
+    key.stride = 0;
+
+    // Paletted textures are kept as indices, the palette is looked up apart
+    u32 fmt = tcw.NO_PAL.PixelFmt;
+    if (fmt != 5 && fmt != 6 && tcw.NO_PAL.ScanOrder && tcw.NO_PAL.StrideSel)
+        key.stride = TEXT_CONTROL & 31;
+
+    return key;
+}
+
+// ============================
+// Interface
+// ============================
+
+bool TexCache_Init(void* pool, u32 pool_size, u32 budget, TexCacheReadbackFP* readback)
+{
+    tc_readback = readback;
+
+    tc_pool = 0;
+    tc_pool_end = 0;
+
+    if (pool)
+    {
+        u8* start = (u8*)(((unat)pool + TC_ALIGN - 1) & ~(unat)(TC_ALIGN - 1));
+        pool_size -= start - (u8*)pool;
+        pool_size &= ~(TC_ALIGN - 1);
+
+        tc_pool = start;
+        tc_pool_end = start + pool_size;
+
+        TcBlock* b = (TcBlock*)tc_pool;
+        b->size = pool_size;
+        b->used = 0;
+        b->prev = 0;
+
+        // block headers live in the pool too
+        if (budget > pool_size - pool_size / 16)
+            budget = pool_size - pool_size / 16;
+    }
+
+    tc_budget = budget;
+
+    memset(tc_buckets, 0, sizeof(tc_buckets));
+    tc_free_entries = 0;
+    for (int i = TC_MAX_ENTRIES - 1; i >= 0; i--)
+    {
+        tc_entries[i].chain = tc_free_entries;
+        tc_free_entries = &tc_entries[i];
+    }
+    tc_lru_head = tc_lru_tail = 0;
+    tc_used = 0;
+    tc_live = 0;
+    tc_frame = 1;
+    memset(&tc_stats, 0, sizeof(tc_stats));
+
+    tc_pal_data = (u8*)memalign(TC_ALIGN, TC_PAL_SLOTS * TC_PAL_DATA_SIZE);
+    for (u32 i = 0; i < TC_PAL_SLOTS; i++)
+        tc_pals[i].data = tc_pal_data ? tc_pal_data + i * TC_PAL_DATA_SIZE : 0;
+    tc_pal_reset();
+
+    printf("TexCache: %d KB budget, %s storage, %s hashing\n", tc_budget / 1024,
+           tc_pool ? "pool" : "heap", settings.TexCache.HashMode ? "sampled" : "full");
+    return true;
+}
+
+static void tc_rtt_free(TexCacheRTT* rt);
+static void tc_rtt_publish();
+
+void TexCache_Clear()
+{
+    while (tc_lru_head)
+        tc_remove(tc_lru_head);
+
+    for (u32 i = 0; i < TC_MAX_RTT; i++)
+        tc_rtt_free(&tc_rtt[i]);
+    tc_rtt_publish();
+
+    tc_pal_reset();
+}
+
+void TexCache_Term()
+{
+    TexCache_Clear();
+    tc_pool = 0;
+    tc_pool_end = 0;
+
+    free(tc_pal_data);
+    tc_pal_data = 0;
+    for (u32 i = 0; i < TC_PAL_SLOTS; i++)
+        tc_pals[i].data = 0;
+}
+
+void TexCache_BeginFrame()
+{
+    tc_frame++;
+    // 0 is reserved for "never"
+    if (tc_frame == 0)
+        tc_frame = 1;
+}
+
+TexCacheResult TexCache_Lookup(const TexCacheKey& key, u32 src_addr, u32 src_size,
+                               u32 data_size, TexCacheEntry** entry)
+{
+    tc_stats.lookups++;
+    data_size = (data_size + TC_ALIGN - 1) & ~(TC_ALIGN - 1);
+
+    // Something is sampled out of a render target: give VRAM its pixels
+    if (tc_rtt_dirty)
+        TexCache_ReadbackRender(src_addr, src_addr + src_size - 1);
+
+    TexCacheEntry** bucket = &tc_buckets[tc_bucket(key)];
+
+    for (TexCacheEntry* e = *bucket; e; e = e->chain)
+    {
+        if (!tc_same_key(e->key, key))
+            continue;
+
+        tc_lru_unlink(e);
+        tc_lru_push(e);
+        e->used_frame = tc_frame;
+        *entry = e;
+
+        if (e->hash_frame != tc_frame)
+        {
+            e->hash_frame = tc_frame;
+            u32 hash = tc_hash_vram(src_addr, src_size);
+            if (hash != e->hash)
+            {
+                e->hash = hash;
+                tc_stats.changed++;
+                tc_convert_start = os_GetSeconds();
+                return TC_CONVERT;
+            }
+        }
+
+        tc_stats.hits++;
+        return TC_HIT;
+    }
+
+    // New entry : make room first. Entries used this frame are never evicted.
+    void* data = 0;
+    for (;;)
+    {
+        if (tc_free_entries && tc_used + data_size <= tc_budget)
+        {
+            data = tc_alloc(data_size);
+            if (data)
+                break;
+        }
+        if (!tc_evict_one())
+        {
+            tc_stats.failures++;
+            return TC_FAIL;
+        }
+    }
+
+    TexCacheEntry* e = tc_free_entries;
+    tc_free_entries = e->chain;
+
+    e->key = key;
+    e->src_addr = src_addr;
+    e->src_size = src_size;
+    e->hash = tc_hash_vram(src_addr, src_size);
+    e->hash_frame = tc_frame;
+    e->used_frame = tc_frame;
+    e->data = (u8*)data;
+    e->data_size = data_size;
+    e->valid = false;
+    e->pending = 0;
+
+    e->chain = *bucket;
+    *bucket = e;
+    tc_lru_push(e);
+
+    tc_used += data_size;
+    tc_live++;
+    tc_stats.misses++;
+
+    *entry = e;
+    tc_convert_start = os_GetSeconds();
+    return TC_CONVERT;
+}
+
+void TexCache_Converted(TexCacheEntry* entry)
+{
+    tc_stats.convert_time += os_GetSeconds() - tc_convert_start;
+}
+
+void TexCache_Invalidate(u32 start, u32 end)
+{
+    // Only forces a re-hash: an entry may still be referenced by this frame's draws
+    for (TexCacheEntry* e = tc_lru_head; e; e = e->lru_next)
+    {
+        if (e->src_addr <= end && e->src_addr + e->src_size > start)
+            e->hash_frame = 0;
+    }
+}
+
+// ============================
+// Render targets
+// ============================
+
+// Tells the core which VRAM range reads have to be reported for
+static void tc_rtt_publish()
+{
+    u32 start = 0xFFFFFFFF;
+    u32 end = 0;
+
+    tc_rtt_dirty = 0;
+    for (u32 i = 0; i < TC_MAX_RTT; i++)
+    {
+        TexCacheRTT* rt = &tc_rtt[i];
+        if (!rt->data || !rt->dirty)
+            continue;
+
+        tc_rtt_dirty++;
+        if (rt->addr < start)
+            start = rt->addr;
+        if (rt->addr + rt->size - 1 > end)
+            end = rt->addr + rt->size - 1;
+    }
+
+    // The core tests the range on every VRAM access, without a lock: the render
+    // targets are made visible first, and the range is widened before it is
+    // narrowed, so the two words read apart never miss a dirty target
+    if (params.vram_readback)
+    {
+        u32* range = params.vram_readback;
+        ta_barrier();
+        if (start < range[0])
+            range[0] = start;
+        if (end > range[1])
+            range[1] = end;
+        ta_barrier();
+        range[0] = start;
+        range[1] = end;
+        ta_barrier();
+    }
+}
+
+static void tc_rtt_free(TexCacheRTT* rt)
+{
+    free(rt->data);
+    memset(rt, 0, sizeof(*rt));
+}
+
+// Writes a dirty render target to VRAM. Returns false, and drops the render
+// target, if VRAM was written to since it was rendered (64 bit area accesses
+// are not reported): the newer data wins.
+static bool tc_rtt_write(TexCacheRTT* rt)
+{
+    if (tc_hash_vram(rt->addr, rt->size) != rt->hash)
+    {
+        tc_rtt_free(rt);
+        tc_stats.rtt_dropped++;
+        return false;
+    }
+
+    tc_readback(rt);
+    rt->dirty = false;
+    rt->hash = tc_hash_vram(rt->addr, rt->size);
+    rt->hash_frame = tc_frame;
+    tc_stats.rtt_readbacks++;
+
+    // Textures converted from what was there before
+    TexCache_Invalidate(rt->addr, rt->addr + rt->size - 1);
+    return true;
+}
+
+static u32 tc_rtt_bpp(u32 fb_w_ctrl)
+{
+    u32 packmode = fb_w_ctrl & 7;
+    return packmode < 4 ? 2 : (packmode == 4 ? 3 : 4);
+}
+
+TexCacheRTT* TexCache_BeginRTT(u32 max_width, u32 max_height, u32 texel_size)
+{
+    u32 addr = FB_W_SOF1 & VRAM_MASK;
+    u32 width = FB_X_CLIP.max + 1;
+    u32 height = FB_Y_CLIP.max + 1;
+    if (width > max_width)
+        width = max_width;
+    if (height > max_height)
+        height = max_height;
+    u32 data_size = ((width + 3) & ~3) * ((height + 3) & ~3) * texel_size;
+
+    u32 bpp = tc_rtt_bpp(FB_W_CTRL);
+    u32 stride = (FB_W_LINESTRIDE & 0x1FF) * 8;
+    if (stride < width * bpp)
+        stride = width * bpp;
+    u32 size = stride * (height - 1) + width * bpp;
+
+    // Older render targets under this one are superseded. Whatever of them
+    // is left outside of it still has to reach VRAM.
+    TexCacheRTT* rt = 0;
+    TexCacheRTT* oldest = &tc_rtt[0];
+    for (u32 i = 0; i < TC_MAX_RTT; i++)
+    {
+        TexCacheRTT* r = &tc_rtt[i];
+        if (!r->data)
+        {
+            if (!rt)
+                rt = r;
+            continue;
+        }
+        if (oldest->data && r->serial < oldest->serial)
+            oldest = r;
+
+        if (r->addr >= addr + size || r->addr + r->size <= addr)
+            continue;
+
+        if (r->addr == addr && r->size == size && r->data_size >= data_size)
+        {
+            rt = r;
+            continue;
+        }
+        if (r->dirty)
+            tc_rtt_write(r);
+        tc_rtt_free(r);
+        if (!rt)
+            rt = r;
+    }
+
+    if (!rt)
+    {
+        rt = oldest;
+        if (rt->dirty)
+            tc_rtt_write(rt);
+        tc_rtt_free(rt);
+    }
+
+    if (!rt->data)
+    {
+        rt->data = (u8*)memalign(TC_ALIGN, data_size);
+        rt->data_size = data_size;
+        if (!rt->data)
+        {
+            tc_rtt_free(rt);
+            tc_rtt_publish();
+            return 0;
+        }
+    }
+
+    // What the render target shadows
+    rt->hash = tc_hash_vram(addr, size);
+    rt->hash_frame = tc_frame;
+
+    rt->addr = addr;
+    rt->size = size;
+    rt->width = width;
+    rt->height = height;
+    rt->stride = stride;
+    rt->fb_w_ctrl = FB_W_CTRL;
+    rt->serial = ++tc_rtt_serial;
+    rt->dirty = false;
+    tc_stats.rtt_renders++;
+
+    return rt;
+}
+
+void TexCache_EndRTT(TexCacheRTT* rt)
+{
+    rt->dirty = true;
+    // The threaded TA writes it at the next STARTRENDER, on the SH4
+    if (settings.TexCache.RTTWriteBack && !TASplitter::TA_ThreadActive())
+        tc_rtt_write(rt);
+    tc_rtt_publish();
+}
+
+TexCacheRTT* TexCache_FindRTT(u32 addr)
+{
+    for (u32 i = 0; i < TC_MAX_RTT; i++)
+    {
+        TexCacheRTT* rt = &tc_rtt[i];
+        if (!rt->data || rt->addr != addr)
+            continue;
+
+        // Once per frame: did the game put something else there ?
+        if (rt->hash_frame != tc_frame)
+        {
+            rt->hash_frame = tc_frame;
+            if (tc_hash_vram(rt->addr, rt->size) != rt->hash)
+            {
+                tc_rtt_free(rt);
+                tc_rtt_publish();
+                tc_stats.rtt_dropped++;
+                return 0;
+            }
+        }
+
+        tc_stats.rtt_hits++;
+        return rt;
+    }
+    return 0;
+}
+
+void TexCache_Readback(u32 start, u32 end)
+{
+    bool written = false;
+    for (u32 i = 0; i < TC_MAX_RTT; i++)
+    {
+        TexCacheRTT* rt = &tc_rtt[i];
+        if (!rt->data || !rt->dirty || rt->addr > end || rt->addr + rt->size <= start)
+            continue;
+
+        tc_rtt_write(rt);
+        written = true;
+    }
+    if (written)
+        tc_rtt_publish();
+}
+
+void TexCache_ReadbackRender(u32 start, u32 end)
+{
+    if (!TASplitter::TA_ThreadActive())
+        TexCache_Readback(start, end);
+}
+
+void TexCache_PackRTTLine(const TexCacheRTT* rt, u32 y, const u32* argb)
+{
+    u32 packmode = rt->fb_w_ctrl & 7;
+    u32 kval = (rt->fb_w_ctrl >> 8) & 0xFF;
+    u32 threshold = (rt->fb_w_ctrl >> 16) & 0xFF;
+    u32 bpp = tc_rtt_bpp(rt->fb_w_ctrl);
+
+    u32 line = (rt->addr + y * rt->stride) & VRAM_MASK;
+    u32 width = rt->width;
+    if (line + width * bpp > VRAM_SIZE)
+        width = (VRAM_SIZE - line) / bpp;
+
+    u8* dst = &params.vram[line];
+    u16* dst16 = (u16*)dst;
+    u32* dst32 = (u32*)dst;
+
+    for (u32 x = 0; x < width; x++)
+    {
+        u32 c = argb[x];
+        u32 a = c >> 24, r = (c >> 16) & 0xFF, g = (c >> 8) & 0xFF, b = c & 0xFF;
+
+        switch (packmode)
+        {
+        case 0: // 0555 KRGB
+            dst16[x] = ((kval & 0x80) << 8) | ((r >> 3) << 10) | ((g >> 3) << 5) | (b >> 3);
+            break;
+        case 1: // 565 RGB
+            dst16[x] = ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3);
+            break;
+        case 2: // 4444 ARGB
+            dst16[x] = ((a >> 4) << 12) | ((r >> 4) << 8) | ((g >> 4) << 4) | (b >> 4);
+            break;
+        case 3: // 1555 ARGB
+            dst16[x] = (a >= threshold ? 0x8000 : 0) | ((r >> 3) << 10) | ((g >> 3) << 5) | (b >> 3);
+            break;
+        case 4: // 888 RGB, packed
+            dst[x * 3 + 0] = b;
+            dst[x * 3 + 1] = g;
+            dst[x * 3 + 2] = r;
+            break;
+        case 5: // 0888 KRGB
+            dst32[x] = (kval << 24) | (c & 0xFFFFFF);
+            break;
+        default: // 8888 ARGB
+            dst32[x] = c;
+            break;
+        }
+    }
+}
+
+void TexCache_PrintStats()
+{
+    u32 lookups = tc_stats.lookups ? tc_stats.lookups : 1;
+
+    printf("TexCache: %d lookups, %d%% hit, %d new, %d changed, %d evicted, %d failed\n",
+           tc_stats.lookups, tc_stats.hits * 100 / lookups, tc_stats.misses,
+           tc_stats.changed, tc_stats.evictions, tc_stats.failures);
+    printf("TexCache: %d entries, %d/%d KB, %d KB hashed, %.2f ms converting\n",
+           tc_live, tc_used / 1024, tc_budget / 1024, tc_stats.hashed / 1024,
+           tc_stats.convert_time * 1000);
+    if (tc_stats.rtt_renders || tc_stats.rtt_hits)
+        printf("TexCache: %d renders to texture, %d texture hits, %d readbacks, %d dropped\n",
+               tc_stats.rtt_renders, tc_stats.rtt_hits, tc_stats.rtt_readbacks,
+               tc_stats.rtt_dropped);
+    if (tc_stats.pal_lookups)
+        printf("TexCache: %d palette lookups, %d rehashed, %d converted\n",
+               tc_stats.pal_lookups, tc_stats.pal_hashes, tc_stats.pal_converts);
+
+    memset(&tc_stats, 0, sizeof(tc_stats));
+}
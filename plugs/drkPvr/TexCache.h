@@ -0,0 +1,210 @@
+#pragma once
+#include "drkPvr.h"
+
+// ============================================================================
+// Texture cache
+// ============================================================================
+// Keeps converted (backend format) textures between frames. An entry is keyed
+// by everything that changes the converted result:
+//   - the TCW (address, pixel format, scan order, VQ, mipmaps, palette select)
+//   - the TSP bits the backend bakes into its texture object (size, wrap/clamp,
+//     filtering)
+//   - the stride for stride textures
+// and validated against a content hash of its source VRAM range. The hash is
+// checked at most once per frame, on the first lookup of the frame, so guest
+// VRAM is never written to and a texture that is bound many times in a frame
+// costs one hash.
+//
+// Memory is bounded by a budget; when it is exceeded the least recently used
+// entries that were not used in the current frame are evicted (textures bound
+// this frame may still be referenced by queued draws). Entries with a
+// conversion in flight are skipped as well.
+//
+// Each entry carries 'data_size' bytes of backend storage, 32 byte aligned,
+// which the backend lays out as it wants (object header, texels, TLUT ...).
+// ============================================================================
+
+struct TexCacheKey
+{
+    u32 tcw;
+    u32 tsp;        // backend relevant TSP bits only
+    u32 stride;     // TEXT_CONTROL stride for stride textures, 0 otherwise
+};
+
+struct TexCacheEntry
+{
+    TexCacheKey key;
+
+    u32 src_addr;           // source range, 64 bit VRAM view
+    u32 src_size;
+    u32 hash;               // content hash of the source range
+    u32 hash_frame;         // frame the hash was last checked in
+    u32 used_frame;         // frame the entry was last looked up in
+
+    u8* data;               // backend storage
+    u32 data_size;
+    bool valid;             // data holds a converted texture (set by the backend)
+    u32 pending;            // conversions in flight, never evicted while non zero
+
+    TexCacheEntry* lru_prev;
+    TexCacheEntry* lru_next;
+    TexCacheEntry* chain;   // hash bucket chain
+};
+
+// ============================================================================
+// Palette cache
+// ============================================================================
+// Paletted textures are cached as indices, without their palette. Palettes
+// are cached on their own, converted to the backend format, keyed by bank
+// (first entry and size), PAL_RAM_CTRL format and a hash of the entries, so a
+// palette swap or a palette animation costs one palette conversion and upload
+// instead of a texture conversion.
+//
+// PALETTE_RAM writes bump a revision per bank (regs.cpp), a bank is only
+// rehashed when it was written to since its last lookup. Palettes used in the
+// current frame are never recycled.
+// ============================================================================
+
+#define TC_PAL_DATA_SIZE 1024   // 256 entries of up to 4 bytes
+
+struct TexCachePalette
+{
+    u32 first;              // PALETTE_RAM index
+    u32 count;              // 16 or 256
+    u32 format;             // PAL_RAM_CTRL & 3
+    u32 hash;               // TexCache_HashPalette, 0 for a free slot
+    u32 used_frame;
+    bool valid;             // data holds the converted palette (set by the backend)
+
+    u8* data;               // backend storage, TC_PAL_DATA_SIZE bytes, 32 byte aligned
+};
+
+// ============================================================================
+// Render targets
+// ============================================================================
+// A render to texture (FB_W_SOF1 in the 64 bit texture area) stays on the
+// backend side in its own format. Textures that start at a render target
+// address are taken from the backend copy. Guest VRAM only gets the pixels,
+// converted to the FB_W_CTRL packmode, when something reads the range: a CPU
+// access through the 32 bit VRAM area (libPvr_VramRead), a texture that
+// overlaps the render target without starting at it, or the 2D framebuffer.
+//
+// A render target is dropped when a new one overlaps it, and when its VRAM
+// range changes under it (the game uploaded something else there).
+// ============================================================================
+
+#define TC_MAX_RTT 8
+
+struct TexCacheRTT
+{
+    u32 addr;               // 64 bit VRAM view
+    u32 size;               // stride * height
+    u32 width;              // rendered area, pixels
+    u32 height;
+    u32 stride;             // bytes per VRAM line
+    u32 fb_w_ctrl;          // FB_W_CTRL at render time (packmode, kval, alpha threshold)
+    u32 serial;             // bumped on every render into it
+
+    u32 hash;               // VRAM contents under the render target
+    u32 hash_frame;
+    bool dirty;             // VRAM does not hold the pixels yet
+
+    u8* data;               // backend storage, 32 byte aligned
+    u32 data_size;
+};
+
+// Writes a render target to VRAM, with TexCache_PackRTTLine (backend)
+typedef void TexCacheReadbackFP(TexCacheRTT* rt);
+
+enum TexCacheResult
+{
+    TC_HIT,         // entry is up to date
+    TC_CONVERT,     // entry is new or its source changed: fill entry->data
+    TC_FAIL,        // out of entries or memory, draw untextured
+};
+
+/**
+ * Initialise the cache.
+ * @param pool      Memory to carve entries from, or NULL to use the heap
+ * @param pool_size Size of 'pool' in bytes
+ * @param budget    Maximum bytes of backend storage kept alive
+ * @param readback  Writes a render target back to VRAM
+ */
+bool TexCache_Init(void* pool, u32 pool_size, u32 budget, TexCacheReadbackFP* readback);
+void TexCache_Term();
+
+// Drop every entry (reset, manual flush)
+void TexCache_Clear();
+
+// Start a new frame: entries used from now on are pinned until the next call
+void TexCache_BeginFrame();
+
+/**
+ * Find or create the entry for 'key'.
+ * On TC_CONVERT the caller converts into (*entry)->data and then calls
+ * TexCache_Converted(*entry) so the conversion time is accounted for.
+ */
+TexCacheResult TexCache_Lookup(const TexCacheKey& key, u32 src_addr, u32 src_size,
+                               u32 data_size, TexCacheEntry** entry);
+void TexCache_Converted(TexCacheEntry* entry);
+
+/**
+ * Build the key for a texture.
+ * @param tsp_bits  Mask of the TSP bits the backend bakes into its converted
+ *                  texture besides the size (wrap/clamp, filtering ...)
+ */
+TexCacheKey TexCache_MakeKey(TCW tcw, TSP tsp, u32 tsp_bits);
+
+// Source range of a texture in the 64 bit VRAM view: the whole mip chain and
+// the VQ codebook. Returns the size in bytes.
+u32 TexCache_SourceRange(TCW tcw, TSP tsp, u32* addr);
+
+// Levels of a texture: 1, or for a mipmapped twiddled texture every level
+// from the TexU size down to 1x1
+u32 TexCache_MipLevels(TCW tcw, TSP tsp);
+
+// Start of the level of size (1 << level) of a twiddled texture, relative to
+// the texture address (after the codebook for VQ): in texels, or in index
+// bytes for VQ. Levels are stored smallest first. 0 without mipmaps.
+u32 TexCache_MipOffset(TCW tcw, u32 level);
+
+// Forget every entry whose source overlaps [start,end] (64 bit VRAM view)
+void TexCache_Invalidate(u32 start, u32 end);
+
+// Hash of 'count' PALETTE_RAM entries starting at 'first', with the format
+u32 TexCache_HashPalette(u32 first, u32 count);
+
+/**
+ * Find or create the palette of 'count' entries starting at 'first'.
+ * On TC_CONVERT the caller converts PALETTE_RAM into (*pal)->data and sets
+ * (*pal)->valid.
+ */
+TexCacheResult TexCache_LookupPalette(u32 first, u32 count, TexCachePalette** pal);
+
+/**
+ * Start a render to texture at FB_W_SOF1, with the FB_W_* registers.
+ * The rendered area is clipped to max_width x max_height. Returns the render
+ * target with storage for its size rounded up to 4x4 blocks of 'texel_size'
+ * bytes, for the backend to fill, or NULL if out of memory.
+ */
+TexCacheRTT* TexCache_BeginRTT(u32 max_width, u32 max_height, u32 texel_size);
+
+// Done filling the storage: VRAM is now behind the render target
+void TexCache_EndRTT(TexCacheRTT* rt);
+
+// Render target starting at 'addr' (64 bit VRAM view), or NULL
+TexCacheRTT* TexCache_FindRTT(u32 addr);
+
+// Write the render targets overlapping [start,end] back to VRAM
+void TexCache_Readback(u32 start, u32 end);
+
+// Same, from the renderer before it reads VRAM. Does nothing with the
+// threaded TA: the render thread does not write VRAM, the SH4 wrote the
+// render targets back before queuing the frame (ta.cpp).
+void TexCache_ReadbackRender(u32 start, u32 end);
+
+// Convert one line of a render target, ARGB8888, to VRAM
+void TexCache_PackRTTLine(const TexCacheRTT* rt, u32 y, const u32* argb);
+
+// Print and clear the hit/miss/convert statistics
+void TexCache_PrintStats();
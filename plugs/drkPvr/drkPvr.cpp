@@ -22,6 +22,8 @@ Multithreading for tile rendering
 
 #include "drkPvr.h"
 #include "ta.h"
+#include "ta_capture.h"
+#include "TexCache.h"
 #include "spg.h"
 #include "regs.h"
 #include "Renderer_if.h"
@@ -56,6 +58,18 @@ void FASTCALL libPvr_vramLockCB(vram_block* block, u32 addr)
     // rend_text_invl(block);
 }
 
+/**
+ * VRAM is about to be accessed through the 32 bit area or a TA direct write
+ * Writes back the render to texture results the renderer holds for the range
+ * @param offset64 First byte, 64 bit VRAM view
+ * @param size     Bytes accessed
+ */
+void FASTCALL libPvr_VramRead(u32 offset64, u32 size)
+{
+    TASplitter::TA_ThreadSync();
+    TexCache_Readback(offset64, offset64 + size - 1);
+}
+
 /**
  * Plugin load - called when plugin is first loaded by emulator
  * Performs one-time initialization
@@ -83,6 +97,8 @@ void FASTCALL libPvr_Unload()
  */
 void FASTCALL libPvr_Reset(bool Manual)
 {
+    TASplitter::TA_ThreadSync();
+    TASplitter::TA_SQDiscard();
     Regs_Reset(Manual);
     spg_Reset(Manual);
     rend_reset(Manual);
@@ -131,6 +147,12 @@ s32 FASTCALL libPvr_Init(pvr_init_params* param)
         return rv_error;
     }
 
+    // Threaded TA, if enabled (falls back to inline parsing on failure)
+    TASplitter::TA_ThreadStart();
+
+    // TA capture, if enabled
+    TaCapture_Init();
+
     return rv_ok;
 }
 
@@ -141,6 +163,8 @@ s32 FASTCALL libPvr_Init(pvr_init_params* param)
 void FASTCALL libPvr_Term()
 {
     // Cleanup in reverse order of initialization
+    TaCapture_Term();
+    TASplitter::TA_ThreadStop();
     rend_thread_end();
     rend_term();
     spg_Term();
@@ -182,11 +206,28 @@ void LoadSettings()
     settings.Emulation.PaletteMode      = cfgGetInt("Emulation.PaletteMode", 1);
     settings.Emulation.ModVolMode       = cfgGetInt("Emulation.ModVolMode", 1);
     settings.Emulation.ZBufferMode      = cfgGetInt("Emulation.ZBufferMode", 0);
+    settings.Emulation.ThreadedTA       = cfgGetInt("Emulation.ThreadedTA", 0);
+    settings.Emulation.MaxVertices      = cfgGetInt("Emulation.MaxVertices", 256);
+    settings.Emulation.FrameSkip        = cfgGetInt("Emulation.FrameSkip", 0);
 
     // OSD settings - display overlays
     settings.OSD.ShowFPS                = cfgGetInt("OSD.ShowFPS", 0);
     settings.OSD.ShowStats              = cfgGetInt("OSD.ShowStats", 0);
 
+    // Software renderer settings
+    settings.SoftRend.Threads           = cfgGetInt("SoftRend.Threads", 0);
+    settings.SoftRend.DumpFrames        = cfgGetInt("SoftRend.DumpFrames", 0);
+
+    // Texture cache
+    settings.TexCache.BudgetMB          = cfgGetInt("TexCache.BudgetMB", 12);
+    settings.TexCache.HashMode          = cfgGetInt("TexCache.HashMode", 0);
+    settings.TexCache.AsyncDecode       = cfgGetInt("TexCache.AsyncDecode", 1);
+    settings.TexCache.RTTWriteBack      = cfgGetInt("TexCache.RTTWriteBack", 0);
+
+    // TA capture
+    settings.Capture.Frames             = cfgGetInt("Capture.Frames", 0);
+    settings.Capture.Skip               = cfgGetInt("Capture.Skip", 0);
+
     // Fullscreen settings - defaults to auto-detect (-1)
     settings.Fullscreen.Enabled         = cfgGetInt("Fullscreen.Enabled", 0);
     settings.Fullscreen.Res_X           = cfgGetInt("Fullscreen.Res_X", -1);
@@ -210,11 +251,28 @@ void SaveSettings()
     cfgSetInt("Emulation.PaletteMode", settings.Emulation.PaletteMode);
     cfgSetInt("Emulation.ModVolMode", settings.Emulation.ModVolMode);
     cfgSetInt("Emulation.ZBufferMode", settings.Emulation.ZBufferMode);
+    cfgSetInt("Emulation.ThreadedTA", settings.Emulation.ThreadedTA);
+    cfgSetInt("Emulation.MaxVertices", settings.Emulation.MaxVertices);
+    cfgSetInt("Emulation.FrameSkip", settings.Emulation.FrameSkip);
 
     // OSD settings
     cfgSetInt("OSD.ShowFPS", settings.OSD.ShowFPS);
     cfgSetInt("OSD.ShowStats", settings.OSD.ShowStats);
 
+    // Software renderer settings
+    cfgSetInt("SoftRend.Threads", settings.SoftRend.Threads);
+    cfgSetInt("SoftRend.DumpFrames", settings.SoftRend.DumpFrames);
+
+    // Texture cache
+    cfgSetInt("TexCache.BudgetMB", settings.TexCache.BudgetMB);
+    cfgSetInt("TexCache.HashMode", settings.TexCache.HashMode);
+    cfgSetInt("TexCache.AsyncDecode", settings.TexCache.AsyncDecode);
+    cfgSetInt("TexCache.RTTWriteBack", settings.TexCache.RTTWriteBack);
+
+    // TA capture
+    cfgSetInt("Capture.Frames", settings.Capture.Frames);
+    cfgSetInt("Capture.Skip", settings.Capture.Skip);
+
     // Fullscreen settings
     cfgSetInt("Fullscreen.Enabled", settings.Fullscreen.Enabled);
     cfgSetInt("Fullscreen.Res_X", settings.Fullscreen.Res_X);
@@ -48,8 +48,10 @@ void SaveSettings();
     #define REND_NAME "WIIgx DHA"
 #elif REND_API == REND_PS2
     #define REND_NAME "PS2gs DHA"
+#elif REND_API == REND_NULL
+    #define REND_NAME "Null"
 #else
-    #error "Invalid REND_API configuration. Must be one of: REND_PSP/REND_GLES2/REND_SOFT/REND_WII/REND_PS2"
+    #error "Invalid REND_API configuration. Must be one of: REND_PSP/REND_GLES2/REND_SOFT/REND_WII/REND_PS2/REND_NULL"
 #endif
 
 /**
@@ -80,8 +82,11 @@ struct _settings_type
     {
         u32 PaletteMode;    // Palette texture handling mode
         u32 AlphaSortMode;  // Alpha sorting algorithm (0=off, 1=per-strip, 2=per-triangle)
-        u32 ModVolMode;     // Modifier volume rendering mode
+        u32 ModVolMode;     // Modifier volume rendering mode (0=off, 1=shadows)
         u32 ZBufferMode;    // Z-buffer algorithm selection
+        u32 ThreadedTA;     // Parse and render TA data on a separate thread (0=off)
+        u32 MaxVertices;    // TA vertex storage cap, in K vertices (16..256)
+        u32 FrameSkip;      // Most frames skipped in a row when too slow (0=off)
     } Emulation;
 
     // On-Screen Display options
@@ -90,6 +95,29 @@ struct _settings_type
         u32 ShowFPS;        // Display frames per second counter
         u32 ShowStats;      // Display detailed rendering statistics
     } OSD;
+
+    // Software renderer (REND_SOFT) options
+    struct
+    {
+        u32 Threads;        // Raster threads (0=one per host CPU)
+        u32 DumpFrames;     // Save every Nth frame to data/soft_NNNNN.ppm (0=off)
+    } SoftRend;
+
+    // Texture cache options
+    struct
+    {
+        u32 BudgetMB;       // Converted textures kept alive, in MB
+        u32 HashMode;       // Source validation: 0=full hash, 1=sampled (1 line in 4)
+        u32 AsyncDecode;    // Decode on a worker thread, 0=inline (exact, may stutter)
+        u32 RTTWriteBack;   // Render to texture results to VRAM: 0=when read, 1=always
+    } TexCache;
+
+    // TA capture (see ta_capture.h)
+    struct
+    {
+        u32 Frames;         // Record this many frames to data/ta_capture.bin (0=off)
+        u32 Skip;           // Frames to let through before recording
+    } Capture;
 };
 
 // Global settings instance
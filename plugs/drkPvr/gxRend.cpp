@@ -13,6 +13,11 @@ What still doesn't looks good :
 
 */
 
+#include "config.h"
+
+// GX backend, only built for REND_WII (softRend.cpp is the REND_SOFT one)
+#if REND_API == REND_WII
+
 // ============================================================================
 // RUNTIME - PRESET SELECTION
 // ============================================================================
@@ -37,9 +42,9 @@ extern "C" int get_graphism_preset();
 // This is defined in main.cpp
 extern "C" int get_debug_loop();
 
-// This is defined in nullDC.cpp
-extern int g_current_frameskip; // 0 = no skip, 1 = skip 1 frame, 2 = skip 2 frame
-extern int g_frame_counter;
+// Uncomment to check the tile converters against the reference per-block ones
+// at startup and print their throughput (TexConv_SelfTest).
+// #define TEXCONV_SELFTEST
 
 // Aspect ratio selection:
 // true  = stretch to fill the full screen (16:9)
@@ -48,6 +53,8 @@ bool choose_fullscreen = false;
 
 #include "config.h"
 #include "gxRend.h"
+#include "ta_vtx.h"
+#include "TexCache.h"
 #include <gccore.h>
 #include <malloc.h>
 #include "regs.h"
@@ -69,20 +76,21 @@ static u8 gp_fifo[DEFAULT_FIFO_SIZE] __attribute__((aligned(32)));
 static int fb = 0; // Current framebuffer index
 
 // Set once at startup or when preset changes
-static u8 min_filt, mag_filt, bias_clamp, edge_lod, aniso;
+// mip_filt is the minification filter of mipmapped textures
+static u8 min_filt, mip_filt, mag_filt, bias_clamp, edge_lod, aniso;
 static f32 lod_bias;
 
 void ApplyGraphismPreset() {
   switch (get_graphism_preset()) {
-    case 0: min_filt = GX_NEAR; mag_filt = GX_NEAR; lod_bias = 0.0f;
+    case 0: min_filt = GX_NEAR; mip_filt = GX_NEAR_MIP_NEAR; mag_filt = GX_NEAR; lod_bias = 0.0f;
             bias_clamp = GX_DISABLE; edge_lod = GX_DISABLE; aniso = GX_ANISO_1; break;
-    case 1: min_filt = GX_LINEAR; mag_filt = GX_LINEAR; lod_bias = 0.0f;
+    case 1: min_filt = GX_LINEAR; mip_filt = GX_LIN_MIP_NEAR; mag_filt = GX_LINEAR; lod_bias = 0.0f;
             bias_clamp = GX_DISABLE; edge_lod = GX_DISABLE; aniso = GX_ANISO_1; break;
-    case 2: min_filt = GX_LINEAR; mag_filt = GX_LINEAR; lod_bias = -0.5f;
+    case 2: min_filt = GX_LINEAR; mip_filt = GX_LIN_MIP_LIN; mag_filt = GX_LINEAR; lod_bias = -0.5f;
             bias_clamp = GX_ENABLE; edge_lod = GX_ENABLE; aniso = GX_ANISO_2; break;
-    case 3: min_filt = GX_LINEAR; mag_filt = GX_LINEAR; lod_bias = -1.0f;
+    case 3: min_filt = GX_LINEAR; mip_filt = GX_LIN_MIP_LIN; mag_filt = GX_LINEAR; lod_bias = -1.0f;
             bias_clamp = GX_ENABLE; edge_lod = GX_ENABLE; aniso = GX_ANISO_4; break;
-    default: min_filt = GX_LINEAR; mag_filt = GX_LINEAR; lod_bias = 0.0f;
+    default: min_filt = GX_LINEAR; mip_filt = GX_LIN_MIP_NEAR; mag_filt = GX_LINEAR; lod_bias = 0.0f;
               bias_clamp = GX_DISABLE; edge_lod = GX_DISABLE; aniso = GX_ANISO_1; break;
   }
 }
@@ -100,186 +108,16 @@ void ApplyGraphismPreset() {
 
 */
 
-// Vertex structure used to feed the Wii's GX pipeline.
-struct Vertex
-{
-  float u, v;        // Texture coordinates
-  unsigned int col;  // Vertex color
-  float x, y, z;     // 3D coordinates
-};
-
-// Structures to manage the internal drawing lists and state 
-// passed from the Dreamcast's Tile Accelerator.
-struct VertexList
-{
-  union
-  {
-    Vertex *ptr;
-    s32 count;
-  };
-};
-
-struct PolyParam
-{
-  PCW pcw;
-  ISP_TSP isp;
-
-  TSP tsp;
-  TCW tcw;
-};
-
+// Header of a texture cache entry (TexCache.h), followed by the texels.
 struct TextureCacheDesc
 {
   GXTexObj tex;
-  GXTlutObj pal;
-  u32 addr;
-  bool has_pal;
-};
-
-void VBlank() {}
-
-// Static arrays for vertex data to avoid frequent heap allocations.
-// Limited by the Wii's MEM1/MEM2 availability.
-Vertex ALIGN16 vertices[42 * 1024]; // 42*1024 = Wii memory limit
-VertexList ALIGN16 lists[8 * 1024];
-PolyParam ALIGN16 listModes[8 * 1024];
-
-Vertex *curVTX = vertices;
-VertexList *curLST = lists;
-VertexList *TransLST = 0;
-PolyParam *curMod = listModes;
-bool global_regd;
-float vtx_min_Z;
-float vtx_max_Z;
-
-char fps_text[512];
-
-struct VertexDecoder;
-FifoSplitter<VertexDecoder> TileAccel;
-
-union _ISP_BACKGND_T_type
-{
-  struct
-  {
-    u32 tag_offset : 3;
-    u32 tag_address : 21;
-    u32 skip : 3;
-    u32 shadow : 1;
-    u32 cache_bypass : 1;
-  };
-  u32 full;
-};
-
-union _ISP_BACKGND_D_type
-{
-  u32 i;
-  f32 f;
+  bool has_pal;         // CI4/CI8 indices, sampled through GX_TLUT0
+  u32 pal_first;        // palette bank, PALETTE_RAM index
+  u32 pal_count;
 };
 
-// Conversion logic to translate Dreamcast VRAM addressing (32-bit interleaved)
-// into a linear 64-bit bank structure compatible with the emulator's memory map.
-static INLINE u32 fast_ConvOffset32toOffset64(u32 offset32)
-{
-  offset32 &= VRAM_MASK;
-  u32 bank = ((offset32 >> 22) & 0x1) << 2;
-  u32 lower = offset32 & 0x3;
-  u32 addr_shifted = (offset32 & 0x3FFFFC) << 1;
-  return addr_shifted | bank | lower;
-}
-
-// Helpers to read float/int values directly from the virtualized PVR VRAM.
-f32 vrf(u32 addr)
-{
-  return *(f32 *)&params.vram[fast_ConvOffset32toOffset64(addr)];
-}
-
-u32 vri(u32 addr)
-{
-  return *(u32 *)&params.vram[fast_ConvOffset32toOffset64(addr)];
-}
-
-// Converts 16-bit PVR UV coordinates to 32-bit floats.
-static f32 CVT16UV(u32 uv)
-{
-  uv <<= 16;
-  return *(f32 *)&uv;
-}
-
-// Primary decoder that translates raw PVR vertex data into the 'Vertex' struct.
-void decode_pvr_vertex(u32 base, u32 ptr, Vertex *cv)
-{
-  // ISP
-  // TSP
-  // TCW
-  ISP_TSP isp;
-  TSP tsp;
-  TCW tcw;
-
-  isp.full = vri(base);
-  tsp.full = vri(base + 4);
-  tcw.full = vri(base + 8);
-  (void)tsp;
-  (void)tcw; // Currently unused but may be needed later
-
-  // Read coordinates: PVR positions are typically already transformed.
-  // XYZ
-  // UV
-  // Base Col
-  // Offset Col
-
-  // XYZ are _allways_ there :)
-  cv->x = vrf(ptr);
-  ptr += 4;
-  cv->y = vrf(ptr);
-  ptr += 4;
-  cv->z = vrf(ptr);
-  ptr += 4;
-
-  // Handle Texture Coordinates (UVs)
-  if (isp.Texture)
-  { // Do texture , if any
-    if (isp.UV_16b)
-    {
-      u32 uv = vri(ptr);
-      cv->u = CVT16UV((u16)uv);
-      cv->v = CVT16UV((u16)(uv >> 16));
-      ptr += 4;
-    }
-    else
-    {
-      cv->u = vrf(ptr);
-      ptr += 4;
-      cv->v = vrf(ptr);
-      ptr += 4;
-    }
-  }
-
-  // Handle Vertex Color
-  u32 col = vri(ptr);
-  ptr += 4;
-  cv->col = col; // ABGR8888(col);
-  if (isp.Offset)
-  {
-    // Skip offset color for now (used for specular-like highlights)
-    (void)vri(ptr);
-    ptr += 4;
-     //	vert_packed_color_(cv->spc,col);
-  }
-}
-
-// Resets internal pointers for the next frame's vertex list.
-void reset_vtx_state()
-{
-  curVTX = vertices;
-  curLST = lists;
-  curMod = listModes;
-  global_regd = false;
-  vtx_min_Z = 128 * 1024; // if someone uses more, i realy realy dont care
-  vtx_max_Z = 0;          // lower than 0 is invalid for pvr .. i wonder if SA knows that.
-}
-
-#define VTX_TFX(x) (x)
-#define VTX_TFY(y) (y)
+#define TEX_DESC_SIZE ((sizeof(TextureCacheDesc) + 31) & ~31)
 
 // The Dreamcast uses "Twiddled" (Morton Order) textures to improve cache locality.
 // This function converts linear X/Y coordinates into the twiddled memory address.
@@ -377,12 +215,27 @@ void fastcall texture_TW_UNUSED(u8* p_out, u8* p_in, u32 Width, u32 Height)
       val = hi;                \
   }
 
+// Per channel terms of the YUV -> RGB fixed point formula, see BuildYUVTables
+static s32 yuv_y[256], yuv_bu[256], yuv_gu[256], yuv_gv[256], yuv_rv[256];
+
+static void BuildYUVTables()
+{
+  for (s32 i = 0; i < 256; i++)
+  {
+    yuv_y[i] = 76283 * (i - 16);
+    yuv_bu[i] = 132252 * (i - 128);
+    yuv_gu[i] = 25624 * (i - 128);
+    yuv_gv[i] = 53281 * (i - 128);
+    yuv_rv[i] = 104595 * (i - 128);
+  }
+}
+
 // Converts YUV422 data to RGB565 for Wii compatibility.
 u32 YUV422(s32 Y, s32 Yu, s32 Yv)
 {
-  s32 B = (76283 * (Y - 16) + 132252 * (Yu - 128)) >> (16 + 3);                     // 5
-  s32 G = (76283 * (Y - 16) - 53281 * (Yv - 128) - 25624 * (Yu - 128)) >> (16 + 2); // 6
-  s32 R = (76283 * (Y - 16) + 104595 * (Yv - 128)) >> (16 + 3);                     // 5
+  s32 B = (yuv_y[Y] + yuv_bu[Yu]) >> (16 + 3);                // 5
+  s32 G = (yuv_y[Y] - yuv_gv[Yv] - yuv_gu[Yu]) >> (16 + 2);   // 6
+  s32 R = (yuv_y[Y] + yuv_rv[Yv]) >> (16 + 3);                // 5
 
   colclamp(0, 0x1F, B);
   colclamp(0, 0x3F, G);
@@ -499,7 +352,22 @@ pixelcvt_next(convYUV_PL, 4, 1)
 }
 pixelcvt_end;
 
-// Pixel Converters for Twiddled textures.
+#ifdef TEXCONV_SELFTEST
+// Reference YUV422, the fixed point formula without the tables
+u32 YUV422_ref(s32 Y, s32 Yu, s32 Yv)
+{
+  s32 B = (76283 * (Y - 16) + 132252 * (Yu - 128)) >> (16 + 3);
+  s32 G = (76283 * (Y - 16) - 53281 * (Yv - 128) - 25624 * (Yu - 128)) >> (16 + 2);
+  s32 R = (76283 * (Y - 16) + 104595 * (Yv - 128)) >> (16 + 3);
+
+  colclamp(0, 0x1F, B);
+  colclamp(0, 0x3F, G);
+  colclamp(0, 0x1F, R);
+
+  return (R << 11) | (G << 5) | (B);
+}
+
+// Reference Pixel Converters for Twiddled textures (one 2x2 block per call).
 pixelcvt_start(conv565_TW, 2, 2)
 {
     // convert 4x1 565 to 4x1 8888
@@ -550,9 +418,9 @@ pixelcvt_next(convYUV422_TW, 2, 2)
   s32 Yv = (p_in[2] >> 0) & 255; // p_in[2]
 
   // 0,0
-  pb_prel(pb, pbw, x + 0, y + 0, YUV422(Y0, Yu, Yv));
+  pb_prel(pb, pbw, x + 0, y + 0, YUV422_ref(Y0, Yu, Yv));
   // 1,0
-  pb_prel(pb, pbw, x + 1, y + 0, YUV422(Y1, Yu, Yv));
+  pb_prel(pb, pbw, x + 1, y + 0, YUV422_ref(Y1, Yu, Yv));
 
   // next 4 bytes
   // p_in+=2;
@@ -563,117 +431,12 @@ pixelcvt_next(convYUV422_TW, 2, 2)
   Yv = (p_in[3] >> 0) & 255; // p_in[2]
 
  // 0,1
-  pb_prel(pb, pbw, x + 0, y + 1, YUV422(Y0, Yu, Yv));
+  pb_prel(pb, pbw, x + 0, y + 1, YUV422_ref(Y0, Yu, Yv));
   // 1,1
-  pb_prel(pb, pbw, x + 1, y + 1, YUV422(Y1, Yu, Yv));
+  pb_prel(pb, pbw, x + 1, y + 1, YUV422_ref(Y1, Yu, Yv));
 }
 pixelcvt_end;
-
-// VQ (Vector Quantization) Palette Converters. 
-// These handle PVR's compressed texture formats by averaging or selecting colors from the codebook.
-pixelcvt_startVQ(conv565_VQ, 2, 2)
-{
-  // Just use first pixel, no averaging (TEST) : no change with return data[0];
-  // return data[0]; // Delete above and keep this. ACCURACY Opportunity ?
-  u32 R = ABGR0565_R(data[0]) + ABGR0565_R(data[1]) + ABGR0565_R(data[2]) + ABGR0565_R(data[3]);
-  u32 G = ABGR0565_G(data[0]) + ABGR0565_G(data[1]) + ABGR0565_G(data[2]) + ABGR0565_G(data[3]);
-  u32 B = ABGR0565_B(data[0]) + ABGR0565_B(data[1]) + ABGR0565_B(data[2]) + ABGR0565_B(data[3]);
-  R >>= 2;
-  G >>= 2;
-  B >>= 2;
-
-  return R | (G << 5) | (B << 11);
-}
-
-pixelcvt_nextVQ(conv1555_VQ, 2, 2)
-{
-  // Just use first pixel, no averaging (TEST) : no change with return data[0];
-  // return data[0]; // Delete above and keep this. ACCURACY Opportunity ?
-  u32 R = ABGR1555_R(data[0]) + ABGR1555_R(data[1]) + ABGR1555_R(data[2]) + ABGR1555_R(data[3]);
-  u32 G = ABGR1555_G(data[0]) + ABGR1555_G(data[1]) + ABGR1555_G(data[2]) + ABGR1555_G(data[3]);
-  u32 B = ABGR1555_B(data[0]) + ABGR1555_B(data[1]) + ABGR1555_B(data[2]) + ABGR1555_B(data[3]);
-  u32 A = ABGR1555_A(data[0]) + ABGR1555_A(data[1]) + ABGR1555_A(data[2]) + ABGR1555_A(data[3]);
-  R >>= 2;
-  G >>= 2;
-  B >>= 2;
-  A >>= 2;
-
-  return R | (G << 5) | (B << 10) | (A << 15);
-
-    // return ABGR1555(data[0]);
-  /*
-  //convert 4x1 1555 to 4x1 8888
-  u16* p_in=(u16*)data;
-  //0,0
-  pb_prel(pb,pbw,0,0,ABGR1555(p_in[0]));
-  //0,1
-  pb_prel(pb,pbw,0,1,ABGR1555(p_in[1]));
-  //1,0
-  pb_prel(pb,pbw,1,0,ABGR1555(p_in[2]));
-  //1,1
-  pb_prel(pb,pbw,1,1,ABGR1555(p_in[3]));
-  */
-}
-pixelcvt_nextVQ(conv4444_VQ, 2, 2)
-{
-  // Just use first pixel, no averaging (TEST) : no change with return data[0];
-  // return data[0]; // Delete above and keep this. ACCURACY Opportunity ?
-
-  u32 R = ABGR4444_R(data[0]) + ABGR4444_R(data[1]) + ABGR4444_R(data[2]) + ABGR4444_R(data[3]);
-  u32 G = ABGR4444_G(data[0]) + ABGR4444_G(data[1]) + ABGR4444_G(data[2]) + ABGR4444_G(data[3]);
-  u32 B = ABGR4444_B(data[0]) + ABGR4444_B(data[1]) + ABGR4444_B(data[2]) + ABGR4444_B(data[3]);
-  u32 A = ABGR4444_A(data[0]) + ABGR4444_A(data[1]) + ABGR4444_A(data[2]) + ABGR4444_A(data[3]);
-  R >>= 2;
-  G >>= 2;
-  B >>= 2;
-  A >>= 2;
-
-  return R | (G << 4) | (B << 8) | (A << 12);
-  // return ABGR4444(data[0]);
-  /*
-  //convert 4x1 4444 to 4x1 8888
-  u16* p_in=(u16*)data;
-  //0,0
-  pb_prel(pb,pbw,0,0,ABGR4444(p_in[0]));
-  //0,1
-  pb_prel(pb,pbw,0,1,ABGR4444(p_in[1]));
-  //1,0
-  pb_prel(pb,pbw,1,0,ABGR4444(p_in[2]));
-  //1,1
-  pb_prel(pb,pbw,1,1,ABGR4444(p_in[3]));
-  */
-}
-pixelcvt_nextVQ(convYUV422_VQ, 2, 2)
-{
-  // convert 4x1 4444 to 4x1 8888
-  u16 *p_in = (u16 *)data;
-  
-  s32 Y0 = (p_in[0] >> 8) & 255; //
-  s32 Yu = (p_in[0] >> 0) & 255; // p_in[0]
-  s32 Y1 = (p_in[2] >> 8) & 255; // p_in[3]
-  s32 Yv = (p_in[2] >> 0) & 255; // p_in[2]
-
-  return YUV422(16 + ((Y0 - 16) + (Y1 - 16)) / 2.0f, Yu, Yv);
-  /*
-  //0,0
-  pb_prel(pb,pbw,0,0,YUV422(Y0,Yu,Yv));
-  //1,0
-  pb_prel(pb,pbw,1,0,YUV422(Y1,Yu,Yv));
-
-  //next 4 bytes
-  //p_in+=2;
-
-  Y0 = (p_in[1]>>8) &255; //
-  Yu = (p_in[1]>>0) &255; //p_in[0]
-  Y1 = (p_in[3]>>8) &255; //p_in[3]
-  Yv = (p_in[3]>>0) &255; //p_in[2]
-
-  //0,1
-  pb_prel(pb,pbw,0,1,YUV422(Y0,Yu,Yv));
-  //1,1
-  pb_prel(pb,pbw,1,1,YUV422(Y1,Yu,Yv));*/
-}
-pixelcvt_endVQ;
+#endif
 
 // input : address in the yyyyyxxxxx format
 // output : address in the xyxyxyxy format
@@ -708,95 +471,274 @@ u32 fastcall twiddle_razi(u32 x, u32 y, u32 x_sz, u32 y_sz)
 }
 
 #define twop twiddle_razi
-u8 *VramWork;
 
-// Texture untwiddling and conversion template. (Handler)
-template <class PixelConvertor>
-void fastcall texture_TW(u8 *p_in, u32 Width, u32 Height)
+// Morton LUTs : the x and y bits never overlap, so
+// twop(x, y, w, h) == x[x] | y[y]
+// Built on the stack by each conversion, textures are decoded on both the
+// emulation thread and the texture worker.
+struct TwiddleLUT
 {
-  //		u32 p=0;
-  u8 *pb = VramWork;
-  // pb->amove(0,0);
+  u32 x[1024], y[1024];
 
-  const u32 divider = PixelConvertor::xpp * PixelConvertor::ypp;
+  TwiddleLUT(u32 Width, u32 Height)
+  {
+    for (u32 i = 0; i < Width; i++)
+      x[i] = twop(i, 0, Width, Height);
+    for (u32 i = 0; i < Height; i++)
+      y[i] = twop(0, i, Width, Height);
+  }
+};
 
-  for (u32 y = 0; y < Height; y += PixelConvertor::ypp)
+// Twiddled index of each texel of an aligned 4x4 block, in GX tile order
+// (row major). Textures are at least 8x8 so such a block is always 16
+// consecutive texels, which is what lets a whole GX tile be done at once.
+static const u8 tw_tile4[16] =
+{
+  0, 2, 8, 10,
+  1, 3, 9, 11,
+  4, 6, 12, 14,
+  5, 7, 13, 15
+};
+
+// Tile converters : one twiddled 4x4 block to one GX 4x4 tile.
+// Block() converts a single 2x2 block in place order, for VQ codebooks.
+#define tilecvt_16(name, cvt)                                  \
+  struct name                                                  \
+  {                                                            \
+    static INLINE void Tile(u16 *dst, const u16 *src)          \
+    {                                                          \
+      for (u32 i = 0; i < 16; i++)                             \
+        dst[i] = cvt(src[tw_tile4[i]]);                        \
+    }                                                          \
+    static INLINE void Block(u16 *dst, const u16 *src)         \
+    {                                                          \
+      for (u32 i = 0; i < 4; i++)                              \
+        dst[i] = cvt(src[i]);                                  \
+    }                                                          \
+  }
+
+tilecvt_16(conv565_TL, ABGR0565);
+tilecvt_16(conv1555_TL, ABGR1555);
+tilecvt_16(conv4444_TL, ABGR4444);
+
+// YUV422 : horizontal pairs share U (left texel) and V (right texel)
+struct convYUV422_TL
+{
+  static INLINE void Tile(u16 *dst, const u16 *src)
   {
-    for (u32 x = 0; x < Width; x += PixelConvertor::xpp)
+    for (u32 i = 0; i < 16; i += 2)
     {
-      u8 *p = &p_in[(twop(x, y, Width, Height) / divider) << 3];
-      PixelConvertor::Convert((u16 *)pb, x, y, Width, p);
-
-      // pb->rmovex(PixelConvertor::xpp);
-      // pb+=PixelConvertor::xpp*2;
+      u32 l = src[tw_tile4[i]];
+      u32 r = src[tw_tile4[i + 1]];
+      dst[i] = YUV422(l >> 8, l & 255, r & 255);
+      dst[i + 1] = YUV422(r >> 8, l & 255, r & 255);
+    }
+  }
+  // twiddled 2x2 block : 0 = (0,0) 1 = (0,1) 2 = (1,0) 3 = (1,1)
+  static INLINE void Block(u16 *dst, const u16 *src)
+  {
+    for (u32 i = 0; i < 2; i++)
+    {
+      u32 l = src[i];
+      u32 r = src[i + 2];
+      dst[i] = YUV422(l >> 8, l & 255, r & 255);
+      dst[i + 2] = YUV422(r >> 8, l & 255, r & 255);
     }
-    // pb->rmovey(PixelConvertor::ypp);
-    // pb+=Width*(PixelConvertor::ypp-1)*2;
   }
-  memcpy(p_in, VramWork, Width * Height * 2);
+};
+
+// Texture untwiddling and conversion template. (Handler)
+// Walks the output in GX tile order, so p_out is written sequentially.
+template <class TileConvertor>
+void fastcall texture_TW(u8 *p_out, u8 *p_in, u32 Width, u32 Height)
+{
+  const u16 *src = (const u16 *)p_in;
+  u16 *dst = (u16 *)p_out;
+
+  TwiddleLUT tw(Width, Height);
+
+  for (u32 y = 0; y < Height; y += 4)
+  {
+    u32 ty = tw.y[y];
+    for (u32 x = 0; x < Width; x += 4, dst += 16)
+      TileConvertor::Tile(dst, src + (ty | tw.x[x]));
+  }
 }
 
 // Vector Quantization texture conversion template.
-template <class PixelConvertor>
-void fastcall texture_VQ(u8 *p_in, u32 Width, u32 Height, u8 *vq_codebook)
-{
-  // p_in+=256*4*2;
-  //		u32 p=0;
-  // VQ codebook to palette conversion
-  // Codebook: 256 entries × 4 pixels (2x2 blocks) = 1024 pixels
-  // Palette: 256 entries (one averaged/selected pixel per entry)
-
-  u8 *pb = VramWork;
-  // pb->amove(0,0);
-  // Convert VQ cb to PAL8
-  u16 *pal_cb = (u16 *)vq_codebook;
-
-  // Convert codebook entries to palette - write to BEGINNING of codebook
-  // This works because we read 4 pixels (entries 0-3) to make palette[0],
-  // then read 4 pixels (entries 4-7) to make palette[1], etc.
-  // So we're always reading ahead of where we're writing
-  for (u32 palidx = 0; palidx < 256; palidx++)
+// The 256 entry codebook (2x2 blocks, twiddled) is converted to host format
+// once per texture by VQ_Codebook, then every index byte expands to its 2x2
+// block at full resolution.
+template <class TileConvertor>
+static void VQ_Codebook(u16 *cb, const u8 *vq_codebook)
+{
+  const u16 *cb_in = (const u16 *)vq_codebook;
+
+  for (u32 i = 0; i < 256; i++)
+    TileConvertor::Block(&cb[i * 4], &cb_in[i * 4]);
+}
+
+void fastcall texture_VQ(u8 *p_out, u8 *p_in, u32 Width, u32 Height, const u16 *cb)
+{
+  u16 *dst = (u16 *)p_out;
+
+  TwiddleLUT tw(Width, Height);
+
+  for (u32 y = 0; y < Height; y += 4)
   {
-    pal_cb[palidx] = PixelConvertor::Convert(&pal_cb[palidx * 4]);
+    u32 ty = tw.y[y];
+    for (u32 x = 0; x < Width; x += 4, dst += 16)
+    {
+      // the 4 blocks of this tile, one index byte per 4 texels
+      const u8 *idx = p_in + ((ty | tw.x[x]) >> 2);
+
+      for (u32 i = 0; i < 16; i++)
+      {
+        u32 t = tw_tile4[i];
+        dst[i] = cb[idx[t >> 2] * 4 + (t & 3)];
+      }
+    }
   }
-  // Height/=PixelConvertor::ypp;
-  // Width/=PixelConvertor::xpp;
+}
+
+// Palette textures are kept as indices, as GX_TF_CI4 (8x8 texel tiles, two
+// texels per byte, left one in the high nibble) or GX_TF_CI8 (8x4 tiles).
+// 4bpp DC textures hold the first texel of a byte in the low nibble.
+static void texture_PAL4(u8 *p_out, const u8 *p_in, u32 Width, u32 Height)
+{
+  TwiddleLUT tw(Width, Height);
+
+  for (u32 y = 0; y < Height; y += 8)
+    for (u32 x = 0; x < Width; x += 8)
+      for (u32 ty = y; ty < y + 8; ty++)
+      {
+        u32 row = tw.y[ty];
+        for (u32 tx = x; tx < x + 8; tx += 2)
+        {
+          u32 i0 = row | tw.x[tx];
+          u32 i1 = row | tw.x[tx + 1];
+          u32 l = (p_in[i0 >> 1] >> ((i0 & 1) << 2)) & 0xF;
+          u32 r = (p_in[i1 >> 1] >> ((i1 & 1) << 2)) & 0xF;
+          *p_out++ = (l << 4) | r;
+        }
+      }
+}
+
+static void texture_PAL8(u8 *p_out, const u8 *p_in, u32 Width, u32 Height)
+{
+  TwiddleLUT tw(Width, Height);
+
+  for (u32 y = 0; y < Height; y += 4)
+    for (u32 x = 0; x < Width; x += 8)
+      for (u32 ty = y; ty < y + 4; ty++)
+      {
+        u32 row = tw.y[ty];
+        for (u32 tx = x; tx < x + 8; tx++)
+          *p_out++ = p_in[row | tw.x[tx]];
+      }
+}
+
+#ifdef TEXCONV_SELFTEST
+// Reference untwiddle, one 2x2 block at a time with the bit loop twiddle
+template <class PixelConvertor>
+void fastcall texture_TW_ref(u8 *p_out, u8 *p_in, u32 Width, u32 Height)
+{
+  u8 *pb = p_out;
   const u32 divider = PixelConvertor::xpp * PixelConvertor::ypp;
-    // In texture_VQ, after the for loop at line ~662:
-    // if g_debug = 1 (need implementation)
-    // printf("First 16 palette entries:\n");
-    // for (int i = 0; i < 16; i++) {
-    //   printf("  [%d] = %04X\n", i, pal_cb[i]);
-    // }
 
   for (u32 y = 0; y < Height; y += PixelConvertor::ypp)
   {
     for (u32 x = 0; x < Width; x += PixelConvertor::xpp)
     {
-      u8 p = p_in[twop(x, y, Width, Height) / divider];
-      // PixelConvertor::Convert((u16*)pb,Width,&vq_codebook[p*8]);
-      //*pb=p;
-      pb[GX_TexOffs(x, y, Width)] = p;
-      // pb->rmovex(PixelConvertor::xpp);
-      // pb+=1;
+      u8 *p = &p_in[(twop(x, y, Width, Height) / divider) << 3];
+      PixelConvertor::Convert((u16 *)pb, x, y, Width, p);
     }
-    // pb->rmovey(PixelConvertor::ypp);
-    // pb+=Width*(1-1);
   }
-  // align up to 16 bytes
-  u32 p_in_int = (u32)p_in;
-  p_in_int &= ~15;
-  p_in = (u8 *)p_in_int;
+}
+
+// Compares the tile converters with the reference ones on random data and
+// prints the throughput of both. VQ is checked against the reference TW
+// conversion of the same texture decompressed beforehand.
+template <class TileConvertor, class PixelConvertor>
+static bool TexConv_Check(const char *name, u16 *src, u16 *a, u16 *b, u32 w, u32 h)
+{
+  u32 pixels = w * h;
+  const u32 runs = pixels < 65536 ? 1048576 / pixels : 16;
+
+  for (u32 i = 0; i < pixels; i++)
+    src[i] = rand() ^ (rand() << 8);
+
+  double t0 = os_GetSeconds();
+  for (u32 r = 0; r < runs; r++)
+    texture_TW_ref<PixelConvertor>((u8 *)a, (u8 *)src, w, h);
+  double t1 = os_GetSeconds();
+  for (u32 r = 0; r < runs; r++)
+    texture_TW<TileConvertor>((u8 *)b, (u8 *)src, w, h);
+  double t2 = os_GetSeconds();
+
+  bool ok = memcmp(a, b, pixels * 2) == 0;
+
+  // VQ : random codebook + indices, decompressed to a twiddled texture for the reference
+  u8 *vq = (u8 *)(src + pixels);
+  for (u32 i = 0; i < 256 * 4 * 2 + pixels / 4; i++)
+    vq[i] = rand();
+  const u16 *cb = (const u16 *)vq;
+  const u8 *idx = vq + 256 * 4 * 2;
+  for (u32 t = 0; t < pixels; t++)
+    src[t] = cb[idx[t >> 2] * 4 + (t & 3)];
+
+  texture_TW_ref<PixelConvertor>((u8 *)a, (u8 *)src, w, h);
+  double t3 = os_GetSeconds();
+  for (u32 r = 0; r < runs; r++)
+  {
+    u16 host_cb[256 * 4];
+    VQ_Codebook<TileConvertor>(host_cb, (const u8 *)cb);
+    texture_VQ((u8 *)b, (u8 *)idx, w, h, host_cb);
+  }
+  double t4 = os_GetSeconds();
+
+  bool vq_ok = memcmp(a, b, pixels * 2) == 0;
+
+  double mp = pixels * (double)runs / 1000000.0;
+  printf("TexConv %-7s %4dx%-4d ref %6.1f Mpix/s, tile %6.1f Mpix/s, VQ %6.1f Mpix/s : %s%s\n",
+         name, w, h, mp / (t1 - t0), mp / (t2 - t1), mp / (t4 - t3),
+         ok ? "ok" : "MISMATCH", vq_ok ? "" : " (VQ MISMATCH)");
+
+  return ok && vq_ok;
+}
+
+static void TexConv_SelfTest()
+{
+  const u32 max_pixels = 512 * 512;
+  u16 *src = (u16 *)memalign(32, max_pixels * 2 + 256 * 4 * 2 + max_pixels / 4);
+  u16 *a = (u16 *)memalign(32, max_pixels * 2);
+  u16 *b = (u16 *)memalign(32, max_pixels * 2);
+
+  static const u32 sizes[][2] = { {8, 8}, {64, 32}, {32, 128}, {256, 256}, {512, 512} };
+
+  bool ok = true;
+  for (u32 i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+  {
+    u32 w = sizes[i][0], h = sizes[i][1];
+    ok &= TexConv_Check<conv565_TL, conv565_TW>("565", src, a, b, w, h);
+    ok &= TexConv_Check<conv1555_TL, conv1555_TW>("1555", src, a, b, w, h);
+    ok &= TexConv_Check<conv4444_TL, conv4444_TW>("4444", src, a, b, w, h);
+    ok &= TexConv_Check<convYUV422_TL, convYUV422_TW>("YUV422", src, a, b, w, h);
+  }
+  printf("TexConv self test %s\n", ok ? "passed" : "FAILED");
 
-  memcpy(p_in, VramWork, Width * Height / divider);
+  free(src);
+  free(a);
+  free(b);
 }
+#endif
 
 // Planar (Linear) texture conversion.
 template <int type>
-void Plannar(u8 *praw, u32 w, u32 h)
+void Plannar(u8 *p_out, u8 *praw, u32 w, u32 h)
 {
   u16 *ptr = (u16 *)praw;
-  u16 *dst = (u16 *)VramWork;
+  u16 *dst = (u16 *)p_out;
   u32 x, y;
 
   for (y = 0; y < h; y++)
@@ -836,56 +778,213 @@ void Plannar(u8 *praw, u32 w, u32 h)
 // =========================
 // Palette management for indexed textures.
 // =========================
+// Palettes come from the palette cache (TexCache.h) converted to GX TLUTs:
+// 565 stays RGB565, the other formats become RGB5A3, opaque entries keeping
+// 5 bits per channel.
+
+static INLINE u16 GxRGB5A3(u32 a, u32 r, u32 g, u32 b)
+{
+  if (a == 0xFF)
+    return 0x8000 | ((r >> 3) << 10) | ((g >> 3) << 5) | (b >> 3);
+  return ((a >> 5) << 12) | ((r >> 4) << 8) | ((g >> 4) << 4) | (b >> 4);
+}
 
-void SetupPaletteForTexture(u32 palette_index, u32 sz)
+static void ConvertPalette(TexCachePalette *pal)
 {
-  palette_index &= ~(sz - 1);
-  u32 fmtpal = PAL_RAM_CTRL & 3;
+  u16 *dst = (u16 *)pal->data;
+  const u32 *src = &PALETTE_RAM[pal->first];
 
-  if (fmtpal < 3)
-    palette_index >>= 1;
+  for (u32 i = 0; i < pal->count; i++)
+  {
+    u32 c = src[i];
+    switch (pal->format)
+    {
+    case 0: // 1555
+      dst[i] = GxRGB5A3((c & 0x8000) ? 0xFF : 0, ABGR1555_R(c) << 3,
+                        ABGR1555_G(c) << 3, ABGR1555_B(c) << 3);
+      break;
+    case 1: // 565
+      dst[i] = c;
+      break;
+    case 2: // 4444
+      dst[i] = GxRGB5A3(((c >> 12) & 0xF) * 0x11, ABGR4444_R(c) * 0x11,
+                        ABGR4444_G(c) * 0x11, ABGR4444_B(c) * 0x11);
+      break;
+    default: // 8888
+      dst[i] = GxRGB5A3(c >> 24, (c >> 16) & 0xFF, (c >> 8) & 0xFF, c & 0xFF);
+      break;
+    }
+  }
 
-    // sceGuClutMode(PalFMT[fmtpal],0,0xFF,0);//or whatever
-    // sceGuClutLoad(sz/8,&palette_lut[palette_index]);
+  DCFlushRange(pal->data, pal->count * 2);
+  pal->valid = true;
 }
 
-// PVR Mipmap offsets (Dreamcast specific).
-const u32 MipPoint[8] =
-    {
-        0x00006, // 8
-        0x00016, // 16
-        0x00056, // 32
-        0x00156, // 64
-        0x00556, // 128
-        0x01556, // 256
-        0x05556, // 512
-        0x15556  // 1024
+// Palette in GX_TLUT0, so polys sharing a palette load it once per frame
+static TexCachePalette *tlut_pal;
+static u32 tlut_hash;
+
+static bool LoadPalette(u32 first, u32 count)
+{
+  TexCachePalette *pal;
+  TexCacheResult res = TexCache_LookupPalette(first, count, &pal);
+  if (res == TC_FAIL)
+    return false;
+
+  if (res == TC_CONVERT)
+  {
+    ConvertPalette(pal);
+    tlut_pal = 0;
+  }
+
+  if (pal != tlut_pal || pal->hash != tlut_hash)
+  {
+    GXTlutObj tlut;
+    GX_InitTlutObj(&tlut, pal->data, pal->format == 1 ? GX_TL_RGB565 : GX_TL_RGB5A3, count);
+    GX_LoadTlut(&tlut, GX_TLUT0);
+    tlut_pal = pal;
+    tlut_hash = pal->hash;
+  }
+  return true;
+}
+
+// =========================
+// Mip chains
+// =========================
+// A mipmapped texture is converted with all its levels, top level first, as
+// one GX texture sampled with GX LOD selection. Every level is a whole number
+// of 32 byte tiles. Levels smaller than a tile (2x2 and 1x1, up to 4x4 for
+// palette textures) are converted texel by texel into a zero padded tile.
+// DC mip chains are square; non square ones are clamped, not rejected.
+
+// TSP D-adjust (MipMapD, 0.25 steps, 4 = 1.0) as a GX LOD bias: log2(D)
+static const f32 mip_d_bias[16] =
+{
+  0.0f, -2.0f, -1.0f, -0.415f, 0.0f, 0.322f, 0.585f, 0.807f,
+  1.0f, 1.170f, 1.322f, 1.459f, 1.585f, 1.700f, 1.807f, 1.907f
 };
 
-// Macro to encapsulate the logic for twiddled textures (VQ or standard).
-#define twidle_tex(format)                                                                \
-  if (mod->tcw.NO_PAL.VQ_Comp)                                                            \
-  {                                                                                       \
-    vq_codebook = (u8 *)&params.vram[tex_addr];                                           \
-    tex_addr += 256 * 4 * 2;                                                              \
-    if (mod->tcw.NO_PAL.MipMapped)                                                        \
-    { /*int* p=0;*p=4;*/                                                                  \
-      tex_addr += MipPoint[mod->tsp.TexU];                                                  \
-    }                                                                                     \
-    texture_VQ<conv##format##_VQ> /**/ ((u8 *)&params.vram[tex_addr], w, h, vq_codebook); \
-    texVQ = 1;                                                                            \
-  }                                                                                       \
-  else                                                                                    \
-  {                                                                                       \
-    if (mod->tcw.NO_PAL.MipMapped)                                                        \
-      tex_addr += MipPoint[mod->tsp.TexU] << 3;                                           \
-    texture_TW<conv##format##_TW> /*TW*/ ((u8 *)&params.vram[tex_addr], w, h);            \
+static INLINE u32 MipDim(u32 size, u32 level)
+{
+  size >>= level;
+  return size ? size : 1;
+}
+
+// Bytes of one GX level of w x h texels of a DC pixel format
+static u32 GxLevelSize(u32 pixfmt, u32 w, u32 h)
+{
+  if (pixfmt == 5)    // CI4, 8x8 tiles
+    return ((w + 7) / 8) * ((h + 7) / 8) * 32;
+  if (pixfmt == 6)    // CI8, 8x4 tiles
+    return ((w + 7) / 8) * ((h + 3) / 4) * 32;
+  return ((w + 3) / 4) * ((h + 3) / 4) * 32;
+}
+
+// 1x1 or 2x2 level from a converted twiddled 2x2 block
+static void texture_Small16(u8 *p_out, const u16 *block, u32 w, u32 h, u32 size)
+{
+  u16 *dst = (u16 *)p_out;
+  memset(dst, 0, size);
+  for (u32 y = 0; y < h && y < 2; y++)
+    for (u32 x = 0; x < w && x < 2; x++)
+      dst[y * 4 + x] = block[x * 2 + y];
+}
+
+// Twiddled 16 bpp or VQ texture, with its mip chain
+template <class TileConvertor>
+static void texture_TW_chain(const PolyParam *mod, u8 *dst, u32 tex_addr, u32 w, u32 h)
+{
+  u32 levels = TexCache_MipLevels(mod->tcw, mod->tsp);
+  u32 top = mod->tsp.TexU + 3;
+  bool vq = mod->tcw.NO_PAL.VQ_Comp;
+  u16 cb[256 * 4];
+
+  if (vq)
+  {
+    VQ_Codebook<TileConvertor>(cb, &params.vram[tex_addr]);
+    tex_addr += 256 * 4 * 2;
+  }
+
+  for (u32 i = 0; i < levels; i++)
+  {
+    u32 lw = MipDim(w, i), lh = MipDim(h, i);
+    u32 size = GxLevelSize(mod->tcw.NO_PAL.PixelFmt, lw, lh);
+    u32 offs = TexCache_MipOffset(mod->tcw, top - i);
+    u8 *src = &params.vram[tex_addr + (vq ? offs : offs * 2)];
+    bool small = lw < 4 || lh < 4;
+
+    if (vq)
+    {
+      if (small)
+        texture_Small16(dst, &cb[*src * 4], lw, lh, size);
+      else
+        texture_VQ(dst, src, lw, lh, cb);
+    }
+    else if (small)
+    {
+      const u16 *texels = (const u16 *)src;
+      u16 raw[4], block[4];
+      for (u32 t = 0; t < 4; t++)
+        raw[t] = texels[lw * lh == 1 ? 0 : t];
+      TileConvertor::Block(block, raw);
+      texture_Small16(dst, block, lw, lh, size);
+    }
+    else
+      texture_TW<TileConvertor>(dst, src, lw, lh);
+
+    dst += size;
+  }
+}
+
+// Palette texture levels smaller than a CI4/CI8 tile
+static void texture_PALSmall(u8 *p_out, u32 tex_addr, u32 offs, u32 w, u32 h, bool pal4, u32 size)
+{
+  memset(p_out, 0, size);
+  for (u32 y = 0; y < h && y < (pal4 ? 8u : 4u); y++)
+    for (u32 x = 0; x < w && x < 8; x++)
+    {
+      u32 t = offs + twop(x, y, w, h);
+      if (pal4)
+      {
+        u32 idx = (params.vram[tex_addr + (t >> 1)] >> ((t & 1) << 2)) & 0xF;
+        p_out[y * 4 + (x >> 1)] |= idx << ((x & 1) ? 0 : 4);
+      }
+      else
+        p_out[y * 8 + x] = params.vram[tex_addr + t];
+    }
+}
+
+// 4 or 8 bpp palette texture, with its mip chain
+static void texture_PAL_chain(const PolyParam *mod, u8 *dst, u32 tex_addr, u32 w, u32 h)
+{
+  u32 levels = TexCache_MipLevels(mod->tcw, mod->tsp);
+  u32 top = mod->tsp.TexU + 3;
+  bool pal4 = mod->tcw.PAL.PixelFmt == 5;
+
+  for (u32 i = 0; i < levels; i++)
+  {
+    u32 lw = MipDim(w, i), lh = MipDim(h, i);
+    u32 size = GxLevelSize(mod->tcw.PAL.PixelFmt, lw, lh);
+    u32 offs = TexCache_MipOffset(mod->tcw, top - i);
+
+    if (lw < 8 || lh < (pal4 ? 8u : 4u))
+      texture_PALSmall(dst, tex_addr, offs, lw, lh, pal4, size);
+    else if (pal4)
+      texture_PAL4(dst, &params.vram[tex_addr + offs / 2], lw, lh);
+    else
+      texture_PAL8(dst, &params.vram[tex_addr + offs], lw, lh);
+
+    dst += size;
   }
+}
+
+// Twiddled textures (VQ or standard), with their mip chain
+#define twidle_tex(format) texture_TW_chain<conv##format##_TL>(mod, dst, tex_addr, w, h)
 
 #define norm_text(format)        \
   if (mod->tcw.NO_PAL.StrideSel) \
     w = 512;                     \
-  Plannar<format>((u8 *)&params.vram[tex_addr], w, h);
+  Plannar<format>(dst, (u8 *)&params.vram[tex_addr], w, h);
 
   /*u32 sr;\
 if (mod->tcw.NO_PAL.StrideSel)\
@@ -905,33 +1004,491 @@ int TexUV(u32 flip, u32 clamp)
     return GX_REPEAT;
 }
 
-// ========================
-// Processes the Dreamcast's TCW (Texture Control Word) to initialize Wii TexObjects.
-// ========================
-
-static void SetTextureParams(PolyParam *mod)
+// Decodes the texture of 'mod' from guest VRAM into 'dst' (GX tile layout).
+// Returns the GX texture format; 'w' is widened for stride textures.
+// Runs on the emulation thread or on the texture worker.
+static u32 ConvertTexture(const PolyParam *mod, u8 *dst, u32 &w, u32 h)
 {
-  GX_SetTevOp(GX_TEVSTAGE0, GX_MODULATE);
-
   u32 tex_addr = (mod->tcw.NO_PAL.TexAddr << 3) & VRAM_MASK;
-  u32 *ptex = (u32 *)&params.vram[tex_addr];
-  TextureCacheDesc *pbuff = ((TextureCacheDesc *)&vram_buffer[tex_addr * 2]) - 1;
 
   u32 FMT = GX_TF_RGB565; // Default format
-  u32 texVQ = 0;
-  u8 *vq_codebook;
-  u32 w = 8 << mod->tsp.TexU;
-  u32 h = 8 << mod->tsp.TexV;
-
-  // ======================================
-  // OLD CODE (Use later for FAST preset ?)
-  // ======================================
 
-  #if 0 // old code
-		if (*ptex!=0xDEADBEEF || pbuff->addr!=tex_addr)
-		{
-			u32* dst=(u32*)&pbuff[1];
-			u32 sz=(8<<mod->tsp.TexU) * (8<<mod->tsp.TexV)*2;
+  switch (mod->tcw.NO_PAL.PixelFmt)
+  {
+  case 0:
+  case 7:
+    // 0	1555 value: 1 bit; RGB values: 5 bits each
+    // 7	Reserved	Regarded as 1555
+   if (mod->tcw.NO_PAL.ScanOrder)
+    {
+      // verify(tcw.NO_PAL.VQ_Comp==0);
+      norm_text(1555);
+    }
+    else
+    {
+      // verify(tsp.TexU==tsp.TexV);
+      twidle_tex(1555);
+    }
+    FMT = GX_TF_RGB5A3;
+    break;
+
+    // redo_argb:
+
+  case 1:
+    // 565 Format  R value: 5 bits; G value: 6 bits; B value: 5 bits
+    if (mod->tcw.NO_PAL.ScanOrder)
+    {
+      // verify(tcw.NO_PAL.VQ_Comp==0);
+      norm_text(565);
+      //(&pbt,(u16*)&params.vram[sa],w,h);
+    }
+    else
+    {
+      // verify(tsp.TexU==tsp.TexV);
+      twidle_tex(565);
+    }
+    FMT = GX_TF_RGB565;
+    break;
+
+    
+  case 2:
+    // 4444 Format: 4 bits; RGB values: 4 bits each
+    if (mod->tcw.NO_PAL.ScanOrder)
+    {
+      // verify(tcw.NO_PAL.VQ_Comp==0);
+      // argb4444to8888(&pbt,(u16*)&params.vram[sa],w,h);
+      norm_text(4444);
+    }
+    else
+    {
+      twidle_tex(4444);
+    }
+    FMT = GX_TF_RGB5A3;
+    break;
+    
+  case 3:
+    // YUV422 Format 32 bits per 2 pixels; YUYV values: 8 bits each
+    if (mod->tcw.NO_PAL.ScanOrder)
+    {
+      norm_text(422);
+      // norm_text(ANYtoRAW);
+    }
+    else
+    {
+      // it cant be VQ , can it ?
+      // docs say that yuv can't be VQ ...
+      // HW seems to support it ;p
+      twidle_tex(YUV422);
+    }
+    FMT = GX_TF_RGB565; // wha?
+    break;
+    // 4	Bump Map	16 bits/pixel; S value: 8 bits; R value: 8 bits
+  case 5:
+    // 5	4 BPP Palette	Palette texture with 4 bits/pixel
+    // Indices only, the palette is loaded when the texture is bound
+    verify(mod->tcw.PAL.VQ_Comp == 0);
+    texture_PAL_chain(mod, dst, tex_addr, w, h);
+    FMT = GX_TF_CI4;
+    break;
+  case 6:
+    // 6	8 BPP Palette	Palette texture with 8 bits/pixel
+    verify(mod->tcw.PAL.VQ_Comp == 0);
+    texture_PAL_chain(mod, dst, tex_addr, w, h);
+    FMT = GX_TF_CI8;
+    break;
+  default:
+    printf("Unhandled texture\n");
+    // memset(temp_tex_buffer,0xFFEFCFAF,w*h*4);
+  }
+
+  if(get_debug_loop() == 1){
+    printf("Texture:%d %d %dx%d %08X --> %08X\n", mod->tcw.NO_PAL.PixelFmt, mod->tcw.NO_PAL.ScanOrder, 8 << mod->tsp.TexU, 8 << mod->tsp.TexV, tex_addr, (u32)dst);
+  }
+
+  return FMT;
+}
+
+// Converted size: 16 bpp texels (VQ is expanded to full resolution), or
+// the 4/8 bit indices of palette textures, for every mip level.
+static u32 TexelSize(const PolyParam *mod, u32 w, u32 h)
+{
+  u32 fmt = mod->tcw.NO_PAL.PixelFmt;
+  if (fmt != 5 && fmt != 6 && mod->tcw.NO_PAL.StrideSel && mod->tcw.NO_PAL.ScanOrder)
+    return 512 * h * 2;
+
+  u32 size = 0;
+  u32 levels = TexCache_MipLevels(mod->tcw, mod->tsp);
+  for (u32 i = 0; i < levels; i++)
+    size += GxLevelSize(fmt, MipDim(w, i), MipDim(h, i));
+  return size;
+}
+
+// Sets up the texture object of a cache entry once its texels are in place.
+static void InitTexDesc(TexCacheEntry *entry, const PolyParam *mod, u32 FMT, u32 w, u32 h)
+{
+  TextureCacheDesc *pbuff = (TextureCacheDesc *)entry->data;
+  u32 fmt = mod->tcw.NO_PAL.PixelFmt;
+  pbuff->has_pal = fmt == 5 || fmt == 6;
+
+  //			sceGuTexMode(FMT,0,0,0);
+  //			sceGuTexImage(0, w>512?512:w, h>512?512:h, w,
+  //				params.vram + sa );
+
+  // Init Text Object
+  u32 levels = TexCache_MipLevels(mod->tcw, mod->tsp);
+  bool use_mips = levels > 1 ? GX_TRUE : GX_FALSE;
+  if (pbuff->has_pal)
+  {
+    pbuff->pal_count = fmt == 5 ? 16 : 256;
+    pbuff->pal_first = fmt == 5 ? mod->tcw.PAL.PalSelect << 4 : (mod->tcw.PAL.PalSelect >> 4) << 8;
+    GX_InitTexObjCI(&pbuff->tex, entry->data + TEX_DESC_SIZE, w, h, FMT, TexUV(mod->tsp.FlipU, mod->tsp.ClampU),
+                    TexUV(mod->tsp.FlipV, mod->tsp.ClampV), use_mips, GX_TLUT0);
+  }
+  else
+  {
+    GX_InitTexObj(&pbuff->tex, entry->data + TEX_DESC_SIZE, w, h, FMT, TexUV(mod->tsp.FlipU, mod->tsp.ClampU),
+                  TexUV(mod->tsp.FlipV, mod->tsp.ClampV), use_mips);
+  }
+
+  // Values from Apply Graphism Preset (LOW/NORMAL/HIGH/EXTRA), the mip
+  // chain adds the TSP D-adjust to the bias
+  GX_InitTexObjLOD(&pbuff->tex, use_mips ? mip_filt : min_filt, mag_filt,
+                   0.0f, (f32)(levels - 1), lod_bias + (use_mips ? mip_d_bias[mod->tsp.MipMapD] : 0.0f),
+                   bias_clamp, edge_lod, aniso);
+
+  DCFlushRange(entry->data, entry->data_size);
+  entry->valid = true;
+}
+
+// ========================
+// Asynchronous texture conversion
+// ========================
+// With TexCache.AsyncDecode set, texture cache misses are queued to a worker
+// thread running below the emulation thread instead of being decoded inline.
+// Polys whose texture is not decoded yet are drawn with their vertex colours;
+// a texture whose VRAM changed keeps drawing its previous version. Finished
+// jobs are swapped in by TexJob_Retire at the start of the next frame.
+//
+// New textures are decoded straight into their cache entry, changed ones
+// into a staging buffer copied over the old texels on retirement. When the
+// queue is full the texture is decoded inline, as in synchronous mode.
+
+#define TEXJOB_QUEUE_SIZE 32          // power of 2
+#define TEXJOB_STACK_SIZE (64 * 1024)
+#define TEXJOB_PRIORITY   40          // main thread runs at 64
+
+struct TexJob
+{
+  TexCacheEntry *entry;
+  PolyParam mod;      // tcw/tsp of the texture
+  u8 *dst;            // entry texels or staging buffer
+  u8 *staging;        // NULL when decoding in place
+  u32 texel_size;
+  u32 w, h;
+  u32 fmt;            // GX format, set by the worker
+  bool redo;          // source changed again while in flight
+};
+
+static TexJob texjob_queue[TEXJOB_QUEUE_SIZE];
+static u32 texjob_head;               // queued, written by the emulation thread
+static u32 texjob_done;               // finished, written by the worker
+static u32 texjob_tail;               // retired
+static bool texjob_quit;
+static lwp_t texjob_thread = LWP_THREAD_NULL;
+static mutex_t texjob_lock;
+static cond_t texjob_wake;            // job queued or quit
+static cond_t texjob_idle;            // job finished
+static u8 texjob_stack[TEXJOB_STACK_SIZE] __attribute__((aligned(32)));
+
+static struct
+{
+  u32 queued;
+  u32 inline_full;    // decoded inline, queue full
+} texjob_stats;
+
+static void *TexJob_Worker(void *)
+{
+  LWP_MutexLock(texjob_lock);
+  for (;;)
+  {
+    while (texjob_done == texjob_head && !texjob_quit)
+      LWP_CondWait(texjob_wake, texjob_lock);
+    if (texjob_quit)
+      break;
+
+    TexJob *job = &texjob_queue[texjob_done & (TEXJOB_QUEUE_SIZE - 1)];
+    LWP_MutexUnlock(texjob_lock);
+
+    job->fmt = ConvertTexture(&job->mod, job->dst, job->w, job->h);
+
+    LWP_MutexLock(texjob_lock);
+    texjob_done++;
+    LWP_CondSignal(texjob_idle);
+  }
+  LWP_MutexUnlock(texjob_lock);
+
+  return 0;
+}
+
+static void TexJob_Push(const TexJob &job)
+{
+  texjob_queue[texjob_head & (TEXJOB_QUEUE_SIZE - 1)] = job;
+
+  LWP_MutexLock(texjob_lock);
+  texjob_head++;
+  LWP_CondSignal(texjob_wake);
+  LWP_MutexUnlock(texjob_lock);
+}
+
+// Queues the conversion of 'entry'. Returns false if it has to be done inline.
+static bool TexJob_Queue(TexCacheEntry *entry, const PolyParam *mod, u32 w, u32 h, u32 texel_size)
+{
+  if (entry->pending)
+  {
+    // Still in flight: decode again once it finishes
+    for (u32 i = texjob_tail; i != texjob_head; i++)
+    {
+      if (texjob_queue[i & (TEXJOB_QUEUE_SIZE - 1)].entry == entry)
+        texjob_queue[i & (TEXJOB_QUEUE_SIZE - 1)].redo = true;
+    }
+    return true;
+  }
+
+  if (texjob_head - texjob_tail == TEXJOB_QUEUE_SIZE)
+  {
+    texjob_stats.inline_full++;
+    return false;
+  }
+
+  TexJob job;
+  job.entry = entry;
+  job.mod = *mod;
+  job.staging = 0;
+  job.dst = entry->data + TEX_DESC_SIZE;
+  job.texel_size = texel_size;
+  job.w = w;
+  job.h = h;
+  job.redo = false;
+
+  // Keep the previous version drawable until the new one is ready
+  if (entry->valid)
+  {
+    job.staging = (u8 *)memalign(32, texel_size);
+    if (!job.staging)
+      return false;
+    job.dst = job.staging;
+  }
+
+  entry->pending = 1;
+  TexJob_Push(job);
+  texjob_stats.queued++;
+  return true;
+}
+
+// Swaps in the finished conversions, in queue order. With 'wait' set, blocks
+// until every queued job has been retired.
+static void TexJob_Retire(bool wait)
+{
+  while (texjob_tail != texjob_head)
+  {
+    LWP_MutexLock(texjob_lock);
+    while (wait && texjob_done == texjob_tail)
+      LWP_CondWait(texjob_idle, texjob_lock);
+    bool finished = texjob_done != texjob_tail;
+    LWP_MutexUnlock(texjob_lock);
+
+    if (!finished)
+      break;
+
+    TexJob job = texjob_queue[texjob_tail & (TEXJOB_QUEUE_SIZE - 1)];
+    texjob_tail++;
+
+    if (job.redo)
+    {
+      job.redo = false;
+      TexJob_Push(job);
+      continue;
+    }
+
+    if (job.staging)
+    {
+      memcpy(job.entry->data + TEX_DESC_SIZE, job.staging, job.texel_size);
+      free(job.staging);
+    }
+
+    InitTexDesc(job.entry, &job.mod, job.fmt, job.w, job.h);
+    job.entry->pending = 0;
+  }
+}
+
+static void TexJob_Start()
+{
+  texjob_head = texjob_done = texjob_tail = 0;
+  texjob_quit = false;
+
+  LWP_MutexInit(&texjob_lock, false);
+  LWP_CondInit(&texjob_wake);
+  LWP_CondInit(&texjob_idle);
+
+  if (LWP_CreateThread(&texjob_thread, TexJob_Worker, NULL, texjob_stack, TEXJOB_STACK_SIZE, TEXJOB_PRIORITY) < 0)
+  {
+    printf("TexJob: failed to start the texture worker, decoding inline\n");
+    texjob_thread = LWP_THREAD_NULL;
+  }
+}
+
+static void TexJob_Stop()
+{
+  if (texjob_thread == LWP_THREAD_NULL)
+    return;
+
+  TexJob_Retire(true);
+
+  LWP_MutexLock(texjob_lock);
+  texjob_quit = true;
+  LWP_CondSignal(texjob_wake);
+  LWP_MutexUnlock(texjob_lock);
+
+  LWP_JoinThread(texjob_thread, NULL);
+  texjob_thread = LWP_THREAD_NULL;
+
+  LWP_CondDestroy(texjob_wake);
+  LWP_CondDestroy(texjob_idle);
+  LWP_MutexDestroy(texjob_lock);
+}
+
+// ========================
+// Render to texture
+// ========================
+// A render into the texture area is copied out of the EFB with GX_CopyTex
+// into a TexCacheRTT and sampled from there; guest VRAM only gets the
+// pixels when something reads them (GxReadback). The copy is at most
+// 640x480, DC texture coordinates are rescaled to it with GX_TEXMTX0.
+
+static bool rtt_texmtx;     // TEXCOORD0 goes through GX_TEXMTX0
+
+// GX format of a render target for the FB_W_CTRL packmode
+static u32 GxRttFormat(u32 fb_w_ctrl)
+{
+  switch (fb_w_ctrl & 7)
+  {
+  case 1:
+    return GX_TF_RGB565;
+  case 0:
+  case 3:
+    return GX_TF_RGB5A3;
+  default:
+    return GX_TF_RGBA8;
+  }
+}
+
+static void SetTexMtx(bool rtt)
+{
+  if (rtt_texmtx == rtt)
+    return;
+  GX_SetTexCoordGen(GX_TEXCOORD0, GX_TG_MTX2x4, GX_TG_TEX0, rtt ? GX_TEXMTX0 : GX_IDENTITY);
+  rtt_texmtx = rtt;
+}
+
+static void LoadRTT(TexCacheRTT *rt, const PolyParam *mod)
+{
+  bool pow2 = !(rt->width & (rt->width - 1)) && !(rt->height & (rt->height - 1));
+
+  GXTexObj tex;
+  GX_InitTexObj(&tex, rt->data, rt->width, rt->height, GxRttFormat(rt->fb_w_ctrl),
+                pow2 ? TexUV(mod->tsp.FlipU, mod->tsp.ClampU) : GX_CLAMP,
+                pow2 ? TexUV(mod->tsp.FlipV, mod->tsp.ClampV) : GX_CLAMP, GX_FALSE);
+  GX_InitTexObjLOD(&tex, min_filt, mag_filt, 0.0f, 0.0f, lod_bias, bias_clamp, edge_lod, aniso);
+  GX_LoadTexObj(&tex, GX_TEXMAP0);
+
+  // DC coordinates are relative to the TexU/TexV size
+  Mtx m;
+  guMtxScale(m, (f32)(8 << mod->tsp.TexU) / rt->width, (f32)(8 << mod->tsp.TexV) / rt->height, 1);
+  GX_LoadTexMtxImm(m, GX_TEXMTX0, GX_MTX2x4);
+  SetTexMtx(true);
+}
+
+// Untiles a render target to ARGB lines and packs them to VRAM
+static void GxReadback(TexCacheRTT *rt)
+{
+  static u32 line[4][640];
+
+  u32 fmt = GxRttFormat(rt->fb_w_ctrl);
+  u32 tiles_w = (rt->width + 3) / 4;
+  DCInvalidateRange(rt->data, rt->data_size);
+
+  for (u32 ty = 0; ty < rt->height; ty += 4)
+  {
+    for (u32 tx = 0; tx < tiles_w; tx++)
+    {
+      u32 tile = ty / 4 * tiles_w + tx;
+      for (u32 y = 0; y < 4; y++)
+        for (u32 x = 0; x < 4; x++)
+        {
+          u32 c;
+          if (fmt == GX_TF_RGBA8)
+          {
+            // 64 byte tile: AR pairs then GB pairs
+            u16 *t = (u16 *)rt->data + tile * 32;
+            u16 ar = t[y * 4 + x], gb = t[16 + y * 4 + x];
+            c = (ar << 16) | gb;
+          }
+          else
+          {
+            u16 p = ((u16 *)rt->data)[tile * 16 + y * 4 + x];
+            if (fmt == GX_TF_RGB565)
+              c = 0xFF000000 | ((p & 0xF800) << 8) | ((p & 0xE000) << 3) | ((p & 0x07E0) << 5) |
+                  ((p & 0x0600) >> 1) | ((p & 0x001F) << 3) | ((p & 0x001C) >> 2);
+            else if (p & 0x8000)
+              c = 0xFF000000 | ((p & 0x7C00) << 9) | ((p & 0x7000) << 4) | ((p & 0x03E0) << 6) |
+                  ((p & 0x0380) << 1) | ((p & 0x001F) << 3) | ((p & 0x001C) >> 2);
+            else
+              c = ((p & 0x7000) << 17) | ((p & 0x7000) << 14) | ((p & 0x6000) << 11) |
+                  ((p & 0x0F00) << 12) | ((p & 0x0F00) << 8) | ((p & 0x00F0) << 8) |
+                  ((p & 0x00F0) << 4) | ((p & 0x000F) << 4) | (p & 0x000F);
+          }
+          line[y][tx * 4 + x] = c;
+        }
+    }
+
+    for (u32 y = 0; y < 4 && ty + y < rt->height; y++)
+      TexCache_PackRTTLine(rt, ty + y, line[y]);
+  }
+}
+
+// False when the palette of a palette texture could not be cached
+static bool LoadTexDesc(TextureCacheDesc *pbuff)
+{
+  if (pbuff->has_pal && !LoadPalette(pbuff->pal_first, pbuff->pal_count))
+    return false;
+
+  GX_LoadTexObj(&pbuff->tex, GX_TEXMAP0);
+  SetTexMtx(false);
+  return true;
+}
+
+// ========================
+// Textures
+// ========================
+// The driver resolves a TCW/TSP to a texture cache entry (Renderer_if.cpp),
+// here the entry gets a TextureCacheDesc followed by the GX texels.
+
+static u32 GxTextureSize(const PolyParam *mod, u32 w, u32 h)
+{
+  return TEX_DESC_SIZE + TexelSize(mod, w, h);
+}
+
+static void GxUpdateTexture(TexCacheEntry *entry, const PolyParam *mod, u32 w, u32 h)
+{
+  // ======================================
+  // OLD CODE (Use later for FAST preset ?)
+  // ======================================
+
+  #if 0 // old code
+		if (*ptex!=0xDEADBEEF || pbuff->addr!=tex_addr)
+		{
+			u32* dst=(u32*)&pbuff[1];
+			u32 sz=(8<<mod->tsp.TexU) * (8<<mod->tsp.TexV)*2;
 
 			if (mod->tcw.NO_PAL.ScanOrder)
 				memcpy(dst,ptex,sz);
@@ -947,181 +1504,261 @@ static void SetTextureParams(PolyParam *mod)
 		}
   #endif
 
-
-  // Only re-process texture if it has changed (marked by DEADBEEF sentinel).
-  if (*ptex != 0xDEADBEEF || pbuff->addr != tex_addr || (mod->tcw.NO_PAL.StrideSel && mod->tcw.NO_PAL.ScanOrder))
+  u32 texel_size = TexelSize(mod, w, h);
+  bool queued = texjob_thread != LWP_THREAD_NULL && TexJob_Queue(entry, mod, w, h, texel_size);
+  if (!queued)
   {
-    u32 *dst = (u32 *)&pbuff[1];
-    VramWork = (u8 *)dst;
-    pbuff->has_pal = false;
-    pbuff->addr = tex_addr;
-
-    switch (mod->tcw.NO_PAL.PixelFmt)
-    {
-    case 0:
-    case 7:
-      // 0	1555 value: 1 bit; RGB values: 5 bits each
-      // 7	Reserved	Regarded as 1555
-     if (mod->tcw.NO_PAL.ScanOrder)
-      {
-        // verify(tcw.NO_PAL.VQ_Comp==0);
-        norm_text(1555);
-      }
-      else
-      {
-        // verify(tsp.TexU==tsp.TexV);
-        twidle_tex(1555);
-      }
-      FMT = GX_TF_RGB5A3;
-      break;
+    u32 FMT = ConvertTexture(mod, entry->data + TEX_DESC_SIZE, w, h);
+    InitTexDesc(entry, mod, FMT, w, h);
+    TexCache_Converted(entry);
+  }
+}
 
-      // redo_argb:
+static void GxBindTexture(TexCacheEntry *entry)
+{
+  if (entry && LoadTexDesc((TextureCacheDesc *)entry->data))
+    GX_SetTevOp(GX_TEVSTAGE0, GX_MODULATE);
+  else
+    GX_SetTevOp(GX_TEVSTAGE0, GX_PASSCLR);
+}
 
-    case 1:
-      // 565 Format  R value: 5 bits; G value: 6 bits; B value: 5 bits
-      if (mod->tcw.NO_PAL.ScanOrder)
-      {
-        // verify(tcw.NO_PAL.VQ_Comp==0);
-        norm_text(565);
-        //(&pbt,(u16*)&params.vram[sa],w,h);
-      }
-      else
-      {
-        // verify(tsp.TexU==tsp.TexV);
-        twidle_tex(565);
-      }
-      FMT = GX_TF_RGB565;
-      break;
+static void GxBindRenderTarget(TexCacheRTT *rt, const PolyParam *mod)
+{
+  GX_SetTevOp(GX_TEVSTAGE0, GX_MODULATE);
+  LoadRTT(rt, mod);
+}
 
-      
-    case 2:
-      // 4444 Format: 4 bits; RGB values: 4 bits each
-      if (mod->tcw.NO_PAL.ScanOrder)
-      {
-        // verify(tcw.NO_PAL.VQ_Comp==0);
-        // argb4444to8888(&pbt,(u16*)&params.vram[sa],w,h);
-        norm_text(4444);
-      }
-      else
-      {
-        twidle_tex(4444);
-      }
-      FMT = GX_TF_RGB5A3;
-      break;
-      
-    case 3:
-      // YUV422 Format 32 bits per 2 pixels; YUYV values: 8 bits each
-      if (mod->tcw.NO_PAL.ScanOrder)
-      {
-        norm_text(422);
-        // norm_text(ANYtoRAW);
-      }
-      else
-      {
-        // it cant be VQ , can it ?
-        // docs say that yuv can't be VQ ...
-        // HW seems to support it ;p
-        twidle_tex(YUV422);
-      }
-      FMT = GX_TF_RGB565; // wha?
-      break;
-      // 4	Bump Map	16 bits/pixel; S value: 8 bits; R value: 8 bits
-    case 5:
-      // 5	4 BPP Palette	Palette texture with 4 bits/pixel
-      verify(mod->tcw.PAL.VQ_Comp == 0);
-      if (mod->tcw.NO_PAL.MipMapped)
-        tex_addr += MipPoint[mod->tsp.TexU] << 1;
+// ============================
+// Modifier volumes
+// ============================
+// GX has no stencil buffer, the EFB alpha channel stands in for it: frames
+// with volumes are drawn to an RGBA6_Z24 EFB whose alpha is cleared first.
+// Opaque and punch through batches write MV_SHADOW there for polys with the
+// shadow bit (GX_SetDstAlpha). The volume triangles are then drawn with
+// colour writes off, a GREATER Z test without Z writes and an XOR logic op,
+// which leaves MV_PARITY set where an odd number of volume faces is in front
+// of the scene. Before the translucent list the alpha is copied to a texture
+// and a screen quad scales the pixels that have both bits.
+//
+// A single parity bit serves every volume: overlapping volumes cancel where
+// they overlap and exclusion volumes are treated as inclusion ones.
+// Translucent volumes and renders to texture are not modified.
+
+#define MV_SHADOW 0x80    // EFB alpha is 6 bit, multiples of 4 only
+#define MV_PARITY 0x04
+
+static u8 mv_mask[640 * 528] ATTRIBUTE_ALIGN(32);   // EFB alpha, GX_TF_I8
+static Mtx44 mv_proj;                // the frame projection
+static u32 vp_x, vp_w, vp_h;         // EFB area of the frame
+static float mv_w_min, mv_w_max;     // W range the projection keeps
+static u8 efb_format = 0xFF;
+
+// Selects the EFB pixel format, with alpha or the display one. Returns true
+// when it changed: what the last copy clear left in the EFB is then garbage.
+static bool GxEfbFormat(bool alpha)
+{
+  u8 fmt = alpha ? GX_PF_RGBA6_Z24 : rmode->aa ? GX_PF_RGB565_Z16 : GX_PF_RGB8_Z24;
+  if (fmt == efb_format)
+    return false;
+  GX_SetPixelFmt(fmt, GX_ZC_LINEAR);
+  efb_format = fmt;
+  return true;
+}
 
-      SetupPaletteForTexture(mod->tcw.PAL.PalSelect << 4, 16);
+// Screen space quad over the frame, in VTXFMT2 with the current TEV setup
+static void GxScreenQuad(GXColor col)
+{
+  Mtx44 ortho;
+  guOrtho(ortho, 0, 480, 0, 640, 0, 1);
+  GX_LoadProjectionMtx(ortho, GX_ORTHOGRAPHIC);
+
+  GX_Begin(GX_QUADS, GX_VTXFMT2, 4);
+    GX_Position3f32(0,   0,   0); GX_Color4u8(col.r, col.g, col.b, col.a); GX_TexCoord2f32(0, 0);
+    GX_Position3f32(640, 0,   0); GX_Color4u8(col.r, col.g, col.b, col.a); GX_TexCoord2f32(1, 0);
+    GX_Position3f32(640, 480, 0); GX_Color4u8(col.r, col.g, col.b, col.a); GX_TexCoord2f32(1, 1);
+    GX_Position3f32(0,   480, 0); GX_Color4u8(col.r, col.g, col.b, col.a); GX_TexCoord2f32(0, 1);
+  GX_End();
+
+  GX_LoadProjectionMtx(mv_proj, GX_PERSPECTIVE);
+}
 
-      FMT = GX_TF_I4; // wha? the ?
-      break;
-    case 6:
-      {
-      // 6	8 BPP Palette	Palette texture with 8 bits/pixel
-      verify(mod->tcw.PAL.VQ_Comp == 0);
-      if (mod->tcw.NO_PAL.MipMapped)
-        tex_addr += MipPoint[mod->tsp.TexU] << 2;
+static void GxDirectVtx(bool tex)
+{
+  GX_SetVtxAttrFmt(GX_VTXFMT2, GX_VA_POS,  GX_POS_XYZ,  GX_F32,   0);
+  GX_SetVtxAttrFmt(GX_VTXFMT2, GX_VA_CLR0, GX_CLR_RGBA, GX_RGBA8, 0);
+  GX_SetVtxAttrFmt(GX_VTXFMT2, GX_VA_TEX0, GX_TEX_ST,   GX_F32,   0);
+  GX_ClearVtxDesc();
+  GX_SetVtxDesc(GX_VA_POS, GX_DIRECT);
+  GX_SetVtxDesc(GX_VA_CLR0, GX_DIRECT);
+  GX_SetVtxDesc(GX_VA_TEX0, GX_DIRECT);
 
-      SetupPaletteForTexture(mod->tcw.PAL.PalSelect << 4, 256);
+  GX_SetNumTexGens(tex ? 1 : 0);
+  if (tex)
+    GX_SetTevOrder(GX_TEVSTAGE0, GX_TEXCOORD0, GX_TEXMAP0, GX_COLOR0A0);
+  else
+  {
+    GX_SetTevOrder(GX_TEVSTAGE0, GX_TEXCOORDNULL, GX_TEXMAP_NULL, GX_COLOR0A0);
+    GX_SetTevOp(GX_TEVSTAGE0, GX_PASSCLR);
+  }
+}
 
-      FMT = GX_TF_I8; // wha? the ? FUCK!
-    }
-      break;
-    default:
-      printf("Unhandled texture\n");
-      // memset(temp_tex_buffer,0xFFEFCFAF,w*h*4);
-    }
+// Redraws the background, with the alpha cleared. Z is reset to the clear
+// value too (the Z format may have changed with the pixel format).
+static void GxFillBackground(GXColor col)
+{
+  GxDirectVtx(false);
+  GX_SetZMode(GX_TRUE, GX_ALWAYS, GX_TRUE);
+  col.a = 0;
+  GxScreenQuad(col);
+  GX_SetZMode(GX_TRUE, GX_GEQUAL, GX_TRUE);
+}
 
-    if (texVQ)
-    {
-      // TEST: Try RGB5A3 palette format
-      // if g_test = 1 (to be implemented)
-      // GX_InitTlutObj(&pbuff->pal, vq_codebook, GX_TF_RGB5A3, 256);
-      // printf("VQ Texture: Using palette format RGB5A3\n");
-      GX_InitTlutObj(&pbuff->pal, vq_codebook, FMT, 256);
-      FMT = GX_TF_I8;
-      w >>= 1;
-      h >>= 1;
-      pbuff->has_pal = true;
-    }
+static void MvVertex(float x, float y, float z)
+{
+  float w = 1.0f / (z < 0.0001f ? 0.0001f : z);
+  // Outside the W range, the face is nearer or farther than the whole scene
+  // either way: move it to the edge instead of letting it be clipped
+  w = w < mv_w_min ? mv_w_min : w > mv_w_max ? mv_w_max : w;
+  GX_Position3f32(x * w, y * w, w);
+  GX_Color4u8(0, 0, 0, MV_PARITY);
+  GX_TexCoord2f32(0, 0);
+}
 
-    //			sceGuTexMode(FMT,0,0,0);
-    //			sceGuTexImage(0, w>512?512:w, h>512?512:h, w,
-    //				params.vram + sa );
+// Applies the opaque volumes to the EFB, then leaves the state as the batch
+// loop expects it (indexed vertices, blending off, texture state to redo)
+static void MvApply()
+{
+  GX_SetDstAlpha(GX_DISABLE, 0);
+  GxDirectVtx(false);
 
-    // Init Text Object
-    bool use_mips = (mod->tcw.NO_PAL.MipMapped && get_graphism_preset() >= 2) ? GX_TRUE : GX_FALSE;
-    GX_InitTexObj(&pbuff->tex, dst, w, h, FMT, TexUV(mod->tsp.FlipU, mod->tsp.ClampU),
-                  TexUV(mod->tsp.FlipV, mod->tsp.ClampV), use_mips);
+  // Parity
+  GX_SetZMode(GX_TRUE, GX_GREATER, GX_FALSE);
+  GX_SetColorUpdate(GX_FALSE);
+  GX_SetBlendMode(GX_BM_LOGIC, GX_BL_ONE, GX_BL_ZERO, GX_LO_XOR);
 
-    
-    // Values from Apply Graphism Preset (LOW/NORMAL/HIGH/EXTRA)
-    GX_InitTexObjLOD(&pbuff->tex, min_filt, mag_filt,
-                  0.0f, 10.0f, lod_bias,
-                  bias_clamp, edge_lod, aniso);
-    
-                  
-    *ptex = 0xDEADBEEF;
+  for (u32 p = 0; p < modParamCount; p++)
+  {
+    const ModParam &mp = modParams[p];
+    if (mp.list != ListType_Opaque_Modifier_Volume || !mp.count)
+      continue;
 
-    if(get_debug_loop() == 1){
-      printf("Texture:%d %d %dx%d %08X --> %08X\n", mod->tcw.NO_PAL.PixelFmt, mod->tcw.NO_PAL.ScanOrder, 8 << mod->tsp.TexU, 8 << mod->tsp.TexV, tex_addr, (u32)dst);
+    const ModTriangle *t = &modTris[mp.first];
+    GX_Begin(GX_TRIANGLES, GX_VTXFMT2, mp.count * 3);
+    for (u32 i = 0; i < mp.count; i++, t++)
+    {
+      MvVertex(t->x0, t->y0, t->z0);
+      MvVertex(t->x1, t->y1, t->z1);
+      MvVertex(t->x2, t->y2, t->z2);
     }
+    GX_End();
   }
 
-  GX_LoadTexObj(&pbuff->tex, GX_TEXMAP0);
+  // EFB alpha to a texture
+  GX_SetTexCopySrc(vp_x, 0, vp_w, vp_h);
+  GX_SetTexCopyDst(vp_w, vp_h, GX_CTF_A8, GX_FALSE);
+  GX_CopyTex(mv_mask, GX_FALSE);
+  GX_PixModeSync();
+  GX_InvalidateTexAll();
 
-  if (pbuff->has_pal)
-    GX_LoadTlut(&pbuff->pal, GX_TLUT0);
+  GXTexObj tex;
+  GX_InitTexObj(&tex, mv_mask, vp_w, vp_h, GX_TF_I8, GX_CLAMP, GX_CLAMP, GX_FALSE);
+  GX_InitTexObjLOD(&tex, GX_NEAR, GX_NEAR, 0, 0, 0, GX_FALSE, GX_FALSE, GX_ANISO_1);
+  GX_LoadTexObj(&tex, GX_TEXMAP0);
+  SetTexMtx(false);
+
+  // Colour = scale, alpha = mask; the alpha test keeps shadowed pixels
+  // inside a volume (8 bit expansion of MV_SHADOW | MV_PARITY), the blend
+  // multiplies them by the scale
+  GxDirectVtx(true);
+  GX_SetTevColorIn(GX_TEVSTAGE0, GX_CC_ZERO, GX_CC_ZERO, GX_CC_ZERO, GX_CC_RASC);
+  GX_SetTevColorOp(GX_TEVSTAGE0, GX_TEV_ADD, GX_TB_ZERO, GX_CS_SCALE_1, GX_TRUE, GX_TEVPREV);
+  GX_SetTevAlphaIn(GX_TEVSTAGE0, GX_CA_ZERO, GX_CA_ZERO, GX_CA_ZERO, GX_CA_TEXA);
+  GX_SetTevAlphaOp(GX_TEVSTAGE0, GX_TEV_ADD, GX_TB_ZERO, GX_CS_SCALE_1, GX_TRUE, GX_TEVPREV);
+  GX_SetAlphaCompare(GX_GEQUAL, MV_SHADOW | MV_PARITY, GX_AOP_AND, GX_LEQUAL, MV_SHADOW | MV_PARITY | 3);
+  GX_SetZMode(GX_FALSE, GX_ALWAYS, GX_FALSE);
+  GX_SetColorUpdate(GX_TRUE);
+  GX_SetAlphaUpdate(GX_FALSE);
+  GX_SetBlendMode(GX_BM_BLEND, GX_BL_ZERO, GX_BL_SRCCLR, GX_LO_CLEAR);
+
+  // Intensity mode scales by FPU_SHAD_SCALE, parameter selection mode (the
+  // second parameter set is not decoded) is drawn at half intensity
+  u32 scale = (FPU_SHAD_SCALE & 0x100) ? FPU_SHAD_SCALE & 0xFF : 128;
+  GXColor col = {(u8)scale, (u8)scale, (u8)scale, 0xFF};
+  GxScreenQuad(col);
+
+  GX_SetAlphaCompare(GX_ALWAYS, 0, GX_AOP_AND, GX_ALWAYS, 0);
+  GX_SetZMode(GX_TRUE, GX_GEQUAL, GX_TRUE);
+  GX_SetAlphaUpdate(GX_TRUE);
+  GX_SetBlendMode(GX_BM_NONE, GX_BL_SRCALPHA, GX_BL_INVSRCALPHA, GX_LO_CLEAR);
+
+  GX_ClearVtxDesc();
+  GX_SetVtxDesc(GX_VA_POS, GX_INDEX16);
+  GX_SetVtxDesc(GX_VA_CLR0, GX_INDEX16);
+  GX_SetVtxDesc(GX_VA_TEX0, GX_INDEX16);
 }
 
 // ============================
-// The main rendering loop. Executes GX commands to draw the stored vertex lists.
+// 3D frames
 // ============================
+// The driver compiles the lists and walks the batches (Renderer_if.cpp),
+// GX draws them indexed straight from the TA vertex array.
 
-void DoRender()
+static bool frame_mv;         // opaque modifier volumes still to apply
+static u32 array_base;        // vertex the GX arrays start at
+static int last_textured;     // track texture state to skip redundant GX calls
+static int last_shadow;
+
+// 16 bit indices reach 65536 vertices from the array start, batches past
+// that move it (RenderBatch::base)
+static void GxSetArrays(u32 base)
+{
+  array_base = base;
+  GX_SetArray(GX_VA_POS, &vertices[base].x, sizeof(Vertex));
+  GX_SetArray(GX_VA_CLR0, &vertices[base].col, sizeof(Vertex));
+  GX_SetArray(GX_VA_TEX0, &vertices[base].u, sizeof(Vertex));
+}
+
+// to_texture: render into a TexCacheRTT instead of the display
+static void GxBeginFrame(bool to_texture)
 {
   float dc_width = 640;
   float dc_height = 480;
 
   VIDEO_SetBlack(FALSE);
+  frame_mv = !to_texture && TA_ModVolActive();
+
+  // Render targets map 1:1 to the top left of the EFB
+  if (to_texture)
+  {
+    vp_x = 0;
+    vp_w = 640;
+    vp_h = rmode->efbHeight < 480 ? rmode->efbHeight : 480;
+  }
   // Set viewport to a centred 4:3 sub-region of the 16:9 framebuffer.
   // NDC [-1..+1] maps to this viewport, so all DC geometry (which is
   // already in 4:3 screen-space) displays with correct proportions.
   // In fullscreen mode use the whole width (stretched 16:9).
-  if (choose_fullscreen)
+  else if (choose_fullscreen)
   {
-    GX_SetViewport(0, 0, rmode->fbWidth, rmode->efbHeight, 0, 1);
+    vp_x = 0;
+    vp_w = rmode->fbWidth;
+    vp_h = rmode->efbHeight;
   }
   else
   {
     const float ratio  = (4.f / 3.f) / (16.f / 9.f); // 0.75
-    const float vp_w   = rmode->fbWidth * ratio;
-    const float vp_x   = (rmode->fbWidth - vp_w) * 0.5f;
-    GX_SetViewport(vp_x, 0, vp_w, rmode->efbHeight, 0, 1);
+    vp_w = (u32)(rmode->fbWidth * ratio) & ~1;        // EFB copies are in pixel pairs
+    vp_x = ((rmode->fbWidth - vp_w) / 2) & ~1;
+    vp_h = rmode->efbHeight;
   }
+  GX_SetViewport(vp_x, 0, vp_w, vp_h, 0, 1);
+
+  // Packmodes with alpha need an EFB with alpha, so do modifier volumes
+  bool efb_stale = GxEfbFormat((to_texture && (FB_W_CTRL & 7) != 1) || frame_mv);
+  TexJob_Retire(false);
   GX_InvVtxCache();
   GX_InvalidateTexAll();
+  tlut_pal = 0;
 
   // Single vertex format, always 24 bytes/vertex (POS+CLR0+TEX0).
   // VCD never changes mid-stream to avoid CP packet FIFO misalignment.
@@ -1140,36 +1777,12 @@ void DoRender()
   GX_SetVtxDesc(GX_VA_TEX0, GX_DIRECT);
 
   GX_SetTexCoordGen(GX_TEXCOORD0, GX_TG_MTX2x4, GX_TG_TEX0, GX_IDENTITY);
+  rtt_texmtx = false;
 
   // Background polygon handling
-  u32 param_base = PARAM_BASE & 0xF00000;
-  _ISP_BACKGND_D_type bg_d;
-  _ISP_BACKGND_T_type bg_t;
-
-  bg_d.i = ISP_BACKGND_D & ~(0xF);
-  bg_t.full = ISP_BACKGND_T;
-  (void)bg_d; // Currently unused but may be needed later
-
-  bool PSVM = FPU_SHAD_SCALE & 0x100; // double parameters for volumes
-
-  // Get the strip base
-  u32 strip_base = param_base + bg_t.tag_address * 4;
-  // Calculate the vertex size
-  u32 strip_vs = 3 + bg_t.skip;
-  u32 strip_vert_num = bg_t.tag_offset;
-
-  if (PSVM && bg_t.shadow)
-  {
-    strip_vs += bg_t.skip; // 2x the size needed :p
-  }
-  strip_vs *= 4;
-  // Get vertex ptr
-  u32 vertex_ptr = strip_vert_num * strip_vs + strip_base + 3 * 4;
-  // now , all the info is ready :p
-
   Vertex BGTest;
 
-  decode_pvr_vertex(strip_base, vertex_ptr, &BGTest);
+  decode_pvr_background(&BGTest);
 
   // Use the background vertex color as the EFB clear color.
   GX_SetCopyClear((GXColor &)BGTest.col, 0x00000000);
@@ -1234,658 +1847,434 @@ void DoRender()
   {
     vtx_min_Z = 0.001f;
     vtx_max_Z = 100000.0f;  // was 1.0f -- caused flash by collapsing all geometry to near-plane
-  }
-
-  // extend range
-  vtx_max_Z *= 1.001; // to not clip vtx_max verts
-  // vtx_min_Z*=0.999;
-
-  // convert to [-1 .. 0]
-  float p6 = -1 / (1 / vtx_max_Z - 1 / vtx_min_Z);
-  float p5 = p6 / vtx_min_Z;
-
-  // The projection matrix maps DC screen-space coords to GX clip space.
-  // X aspect ratio is NOT corrected here — DC vertices are already in screen
-  // space (x=[0..640]) and z is 1/W (depth), so a perspective matrix would
-  // incorrectly couple x and z. X is remapped at vertex submission instead.
-  Mtx44 mtx =
-      {
-          {(2.f / dc_width), 0, +(640.f / dc_width), 0},
-          {0, -(2.f / dc_height), -(480.f / dc_height), 0},
-          {0, 0, p5, p6},
-          {0, 0, -1, 0}};
-
-  // load the matrix to GX
-  GX_LoadProjectionMtx(mtx, GX_PERSPECTIVE);
-
-  // clear out other matrixes
-  Mtx modelview;
-  guMtxIdentity(modelview);
-  GX_LoadPosMtxImm(modelview, GX_PNMTX0);
-
-  Vertex *drawVTX = vertices;
-  VertexList *drawLST = lists;
-  PolyParam *drawMod = listModes;
-
-  const VertexList *const crLST = curLST; // hint to the compiler that sceGUM cant edit this value !
-
-  GX_SetBlendMode(GX_BM_NONE, GX_BL_SRCALPHA, GX_BL_INVSRCALPHA, GX_LO_CLEAR);
-
-  //		GX_SetAlphaCompare(GX_GREATER,0,GX_AOP,GX_ALWAYS,0);
-
-  GX_SetTevOp(GX_TEVSTAGE0, GX_MODULATE);
-  GX_SetTevOrder(GX_TEVSTAGE0, GX_TEXCOORD0, GX_TEXMAP0, GX_COLOR0A0);
-
-  int last_textured = -1;  // track texture state to skip redundant GX calls
-
-  // Process opaque and then translucent lists.
-  for (; drawLST != crLST; drawLST++)
-  {
-    if (drawLST == TransLST)
-    {
-      // enable blending & blending mode
-      GX_SetBlendMode(GX_BM_BLEND, GX_BL_SRCALPHA, GX_BL_INVSRCALPHA, GX_LO_CLEAR);
-
-      // setup alpha compare
-    }
-
-    s32 count = drawLST->count;
-    if (count < 0)
-    {
-      int is_textured = drawMod->pcw.Texture ? 1 : 0;
-      if (is_textured != last_textured)
-      {
-        if (is_textured)
-        {
-          GX_SetNumTexGens(1);
-          GX_SetTevOrder(GX_TEVSTAGE0, GX_TEXCOORD0, GX_TEXMAP0, GX_COLOR0A0);
-          GX_SetTevOp(GX_TEVSTAGE0, GX_MODULATE);
-        }
-        else
-        {
-          GX_SetNumTexGens(0);
-          GX_SetTevOrder(GX_TEVSTAGE0, GX_TEXCOORDNULL, GX_TEXMAP_NULL, GX_COLOR0A0);
-          GX_SetTevOp(GX_TEVSTAGE0, GX_PASSCLR);
-        }
-        last_textured = is_textured;
-      }
-      if (is_textured)
-        SetTextureParams(drawMod);
-
-      drawMod++;
-      count &= 0x7FFF;
-    }
-
-    if (count)
-    {
-      GX_Begin(GX_TRIANGLESTRIP, GX_VTXFMT0, count);
-      while (count--)
-      {
-        GX_Position3f32(drawVTX->x, drawVTX->y, -drawVTX->z);
-        GX_Color1u32(HOST_TO_LE32(drawVTX->col));
-        GX_TexCoord2f32(drawVTX->u, drawVTX->v);
-        drawVTX++;
-      }
-      GX_End();
-    }
-
-    // sceGuDrawArray(GU_TRIANGLE_STRIP,GU_TEXTURE_32BITF|GU_COLOR_8888|GU_VERTEX_32BITF|GU_TRANSFORM_3D,count,0,drawVTX);
-
-    //			drawVTX+=count;
-  }
-
-  reset_vtx_state();
-
-  GX_DrawDone();
-  GX_CopyDisp(frameBuffer[fb], GX_TRUE);
-
-  VIDEO_SetNextFramebuffer(frameBuffer[fb]);
-
-  VIDEO_Flush();
-
-  wii_audio_frame(); // Audio (Step AICA and push one frame of audio to ASND)
-  VIDEO_WaitVSync();  // Needed for O3 mode (else Dreamcast logo take 5 seconds instead of 9)
-}
-
-// ============================
-// START RENDERING
-// ============================
-
-void StartRender()
-{
-  u32 VtxCnt = curVTX - vertices;
-  VertexCount += VtxCnt;
-
-  render_end_pending_cycles = VtxCnt * 15;
-  if (render_end_pending_cycles < 50000)
-    render_end_pending_cycles = 50000;
-
-  if (FB_W_SOF1 & 0x1000000)
-  {
-    // 2D direct framebuffer mode (logo screens).
-    // Read from FB_R_SOF1 (what the DC video hardware displays),
-    // NOT FB_W_SOF1 (write destination, may be the back buffer).
-    static u16 fb2d_tex[640 * 480] ATTRIBUTE_ALIGN(32);
-
-    u32 vram_addr = FB_R_SOF1 & 0x00FFFFFF;
-    u16 *src = (u16 *)&params.vram[fast_ConvOffset32toOffset64(vram_addr)];
-
-    // Tile into GX 4x4-block layout with LE->BE byte swap per pixel.
-    for (int ty = 0; ty < 480; ty += 4)
-      for (int tx = 0; tx < 640; tx += 4)
-      {
-        u16 *dst = &fb2d_tex[((ty / 4) * (640 / 4) + (tx / 4)) * 16];
-        for (int row = 0; row < 4; row++)
-        {
-          u16 *srow = &src[(ty + row) * 640 + tx];
-          for (int col = 0; col < 4; col++)
-            *dst++ = (srow[col] >> 8) | (srow[col] << 8);
-        }
-      }
-    DCFlushRange(fb2d_tex, sizeof(fb2d_tex));
-
-    // FB_R_CTRL.fb_depth: 1 = RGB565, others = ARGB1555 (RGB5A3 on GX)
-    GXTexObj texobj;
-    if (FB_R_CTRL.fb_depth == 1)
-      GX_InitTexObj(&texobj, fb2d_tex, 640, 480, GX_TF_RGB565,  GX_CLAMP, GX_CLAMP, GX_FALSE);
-    else
-      GX_InitTexObj(&texobj, fb2d_tex, 640, 480, GX_TF_RGB5A3,  GX_CLAMP, GX_CLAMP, GX_FALSE);
-    GX_InitTexObjLOD(&texobj, GX_NEAR, GX_NEAR, 0, 0, 0, GX_FALSE, GX_FALSE, GX_ANISO_1);
-    GX_LoadTexObj(&texobj, GX_TEXMAP0);
-
-    // VTXFMT1: XY+UV only, leaves VTXFMT0 (3D path) undisturbed.
-    GX_SetVtxAttrFmt(GX_VTXFMT1, GX_VA_POS,  GX_POS_XY,  GX_F32, 0);
-    GX_SetVtxAttrFmt(GX_VTXFMT1, GX_VA_TEX0, GX_TEX_ST,  GX_F32, 0);
-    GX_ClearVtxDesc();
-    GX_SetVtxDesc(GX_VA_POS,  GX_DIRECT);
-    GX_SetVtxDesc(GX_VA_TEX0, GX_DIRECT);
-    GX_SetNumChans(0);
-    GX_SetNumTexGens(1);
-    GX_SetTexCoordGen(GX_TEXCOORD0, GX_TG_MTX2x4, GX_TG_TEX0, GX_IDENTITY);
-    GX_SetTevOrder(GX_TEVSTAGE0, GX_TEXCOORD0, GX_TEXMAP0, GX_COLORNULL);
-    GX_SetTevOp(GX_TEVSTAGE0, GX_REPLACE);
-    GX_SetZMode(GX_FALSE, GX_ALWAYS, GX_FALSE);
-    GX_SetBlendMode(GX_BM_NONE, GX_BL_ONE, GX_BL_ZERO, GX_LO_CLEAR);
-
-    Mtx44 ortho;
-    guOrtho(ortho, 0, 480, 0, 640, 0, 1);
-    GX_LoadProjectionMtx(ortho, GX_ORTHOGRAPHIC);
-    Mtx mv;
-    guMtxIdentity(mv);
-    GX_LoadPosMtxImm(mv, GX_PNMTX0);
-
-    // In 4:3 mode, draw the 2D framebuffer into a centred 4:3 sub-rectangle
-    // so logo screens and 2D content have the same correct framing as 3D.
-    float x0_2d, x1_2d;
-    if (choose_fullscreen)
-    {
-      x0_2d = 0.f;
-      x1_2d = 640.f;
-    }
-    else
-    {
-      // 4:3 inside 16:9: side bars are (1 - 3/4) / 2 * 640 = 80 px each side
-      const float ratio = (4.f / 3.f) / (16.f / 9.f); // 0.75
-      float margin = (640.f * (1.f - ratio)) * 0.5f;   // 80 px
-      x0_2d = margin;
-      x1_2d = 640.f - margin;
-    }
+  }
 
-    GX_Begin(GX_QUADS, GX_VTXFMT1, 4);
-      GX_Position2f32(x0_2d,   0); GX_TexCoord2f32(0, 0);
-      GX_Position2f32(x1_2d,   0); GX_TexCoord2f32(1, 0);
-      GX_Position2f32(x1_2d, 480); GX_TexCoord2f32(1, 1);
-      GX_Position2f32(x0_2d, 480); GX_TexCoord2f32(0, 1);
-    GX_End();
+  // extend range
+  vtx_max_Z *= 1.001; // to not clip vtx_max verts
+  // vtx_min_Z*=0.999;
 
-    GX_DrawDone();
-    GX_CopyDisp(frameBuffer[fb], GX_TRUE);
-    VIDEO_SetNextFramebuffer(frameBuffer[fb]);
-    VIDEO_Flush();
-    VIDEO_WaitVSync();
-    FrameCount++;
-    return;
-  }
+  // convert to [-1 .. 0]
+  float p6 = -1 / (1 / vtx_max_Z - 1 / vtx_min_Z);
+  float p5 = p6 / vtx_min_Z;
 
-  DoRender();
+  // The projection matrix maps DC screen-space coords to GX clip space.
+  // X aspect ratio is NOT corrected here — DC vertices are already in screen
+  // space (x=[0..640]) and z is 1/W (depth), so a perspective matrix would
+  // incorrectly couple x and z. X is remapped at vertex submission instead.
+  // Positions are fetched from the TA vertex array as x*W, y*W, +W, so the z
+  // column is negated (GX looks down -z).
+  Mtx44 mtx =
+      {
+          {(2.f / dc_width), 0, -(640.f / dc_width), 0},
+          {0, -(2.f / dc_height), +(480.f / dc_height), 0},
+          {0, 0, -p5, p6},
+          {0, 0, 1, 0}};
 
-  FrameCount++;
-}
+  // load the matrix to GX
+  GX_LoadProjectionMtx(mtx, GX_PERSPECTIVE);
+  memcpy(mv_proj, mtx, sizeof(Mtx44));
+  mv_w_min = vtx_min_Z * 1.0001f;
+  mv_w_max = vtx_max_Z * 0.9995f;
 
-void EndRender() {}
+  // clear out other matrixes
+  Mtx modelview;
+  guMtxIdentity(modelview);
+  GX_LoadPosMtxImm(modelview, GX_PNMTX0);
 
+  if (efb_stale || frame_mv)
+    GxFillBackground((GXColor &)BGTest.col);
 
+  // Vertices are fetched by index straight from the TA vertex array
+  GX_ClearVtxDesc();
+  GX_SetVtxDesc(GX_VA_POS, GX_INDEX16);
+  GX_SetVtxDesc(GX_VA_CLR0, GX_INDEX16);
+  GX_SetVtxDesc(GX_VA_TEX0, GX_INDEX16);
+  GxSetArrays(0);
+  DCFlushRange(vertices, (curVTX - vertices) * sizeof(Vertex));
 
-// ============================
-// VertexDecoder struct: Handles the accumulation of vertex data into strips.
-// ============================
+  GX_SetBlendMode(GX_BM_NONE, GX_BL_SRCALPHA, GX_BL_INVSRCALPHA, GX_LO_CLEAR);
+
+  //		GX_SetAlphaCompare(GX_GREATER,0,GX_AOP,GX_ALWAYS,0);
+
+  GX_SetTevOp(GX_TEVSTAGE0, GX_MODULATE);
+  GX_SetTevOrder(GX_TEVSTAGE0, GX_TEXCOORD0, GX_TEXMAP0, GX_COLOR0A0);
+
+  last_textured = -1;
+  last_shadow = -1;
+}
 
-struct VertexDecoder
+static void GxBeginTranslucent()
 {
-  // list handling
-  __forceinline static void StartList(u32 ListType)
+  if (frame_mv)
   {
-    if (ListType == ListType_Translucent)
-      TransLST = curLST;
+    MvApply();
+    last_textured = -1;
+    frame_mv = false;
   }
-  __forceinline static void EndList(u32 ListType) {}
 
-  static u32 FLCOL(float *col)
-  {
-    u32 A = col[0] * 255;
-    u32 R = col[1] * 255;
-    u32 G = col[2] * 255;
-    u32 B = col[3] * 255;
-    if (A > 255)
-      A = 255;
-    if (R > 255)
-      R = 255;
-    if (G > 255)
-      G = 255;
-    if (B > 255)
-      B = 255;
-
-    return (A << 24) | (B << 16) | (G << 8) | R;
-  }
-  static u32 INTESITY(float inte)
-  {
-    u32 C = inte * 255;
-    if (C > 255)
-      C = 255;
-    return (0xFF << 24) | (C << 16) | (C << 8) | (C);
-  }
+  // enable blending & blending mode
+  GX_SetBlendMode(GX_BM_BLEND, GX_BL_SRCALPHA, GX_BL_INVSRCALPHA, GX_LO_CLEAR);
 
-  // Polys
-#define glob_param_bdc                 \
-  if ((curVTX - vertices) > 38 * 1024) \
-    reset_vtx_state();                 \
-  global_regd = true;                  \
-  curMod->pcw = pp->pcw;               \
-  curMod->isp = pp->isp;               \
-  curMod->tsp = pp->tsp;               \
-  curMod->tcw = pp->tcw;
-
-  __forceinline static void fastcall AppendPolyParam0(TA_PolyParam0 *pp)
-  {
-    glob_param_bdc;
-  }
-  __forceinline static void fastcall AppendPolyParam1(TA_PolyParam1 *pp)
-  {
-    glob_param_bdc;
-  }
-  __forceinline static void fastcall AppendPolyParam2A(TA_PolyParam2A *pp)
-  {
-    glob_param_bdc;
-  }
-  __forceinline static void fastcall AppendPolyParam2B(TA_PolyParam2B *pp)
-  {
-  }
-  __forceinline static void fastcall AppendPolyParam3(TA_PolyParam3 *pp)
-  {
-    glob_param_bdc;
-  }
-  __forceinline static void fastcall AppendPolyParam4A(TA_PolyParam4A *pp)
-  {
-    glob_param_bdc;
-  }
-  __forceinline static void fastcall AppendPolyParam4B(TA_PolyParam4B *pp)
-  {
-  }
+  // setup alpha compare
+}
 
-  // Poly Strip handling
-  // UPDATE SPRITES ON EDIT !
-  __forceinline static void StartPolyStrip()
+static void GxBindState(const PolyParam *mod)
+{
+  if (frame_mv && (int)mod->pcw.Shadow != last_shadow)
   {
-    curLST->ptr = curVTX;
+    last_shadow = mod->pcw.Shadow;
+    GX_SetDstAlpha(GX_ENABLE, last_shadow ? MV_SHADOW : 0);
   }
 
-  __forceinline static void EndPolyStrip()
+  int is_textured = mod->pcw.Texture ? 1 : 0;
+  if (is_textured != last_textured)
   {
-    curLST->count = (curVTX - curLST->ptr);
-    if (global_regd)
+    if (is_textured)
+    {
+      GX_SetNumTexGens(1);
+      GX_SetTevOrder(GX_TEVSTAGE0, GX_TEXCOORD0, GX_TEXMAP0, GX_COLOR0A0);
+      GX_SetTevOp(GX_TEVSTAGE0, GX_MODULATE);
+    }
+    else
     {
-      curLST->count |= 0x80000000;
-      global_regd = false;
-      curMod++;
+      GX_SetNumTexGens(0);
+      GX_SetTevOrder(GX_TEVSTAGE0, GX_TEXCOORDNULL, GX_TEXMAP_NULL, GX_COLOR0A0);
+      GX_SetTevOp(GX_TEVSTAGE0, GX_PASSCLR);
     }
-    curLST++;
+    last_textured = is_textured;
   }
+}
 
-// Standard vertex projection macro. PVR 'Z' is actually 1/W.
-//
-// Guard against zero/negative/NaN Z values that can arrive when the game reads
-// back EFB (framebuffer) data that the emulator hasn't rendered yet (e.g.
-// Castlevania: Resurrection shadow/reflection pass).  A bad Z causes W=1/Z to
-// become infinity or NaN, which then corrupts vtx_min_Z / vtx_max_Z, blows up
-// the projection matrix in DoRender(), and ultimately desyncs the GX FIFO
-// producing "GFX Fifo Opcode unknown (0x64)".
-//
-// Clamping to 0.0001f keeps W finite and pushes the vertex safely to the far
-// plane where it is invisible but harmless.
-#define vert_base(dst, _x, _y, _z) /*VertexCount++;*/         \
-  float _safe_z = (_z < 0.0001f) ? 0.0001f : _z;             \
-  float W = 1.0f / _safe_z;                                   \
-  curVTX[dst].x = VTX_TFX(_x) * W;                           \
-  curVTX[dst].y = VTX_TFY(_y) * W;                           \
-  if (W > 0.0f && W < vtx_min_Z)                             \
-    vtx_min_Z = W;                                            \
-  if (W > 0.0f && W > vtx_max_Z)                             \
-    vtx_max_Z = W;                                            \
-  curVTX[dst].z = W; /*Linearly scaled later*/
-
-  // Poly Vertex handlers
-#define vert_cvt_base vert_base(0, vtx->xyz[0], vtx->xyz[1], vtx->xyz[2])
-
-  // Handlers for various PVR vertex types (Packed color, Float color, Intensity, etc.)
-  //(Non-Textured, Packed Color)
-  __forceinline static void AppendPolyVertex0(TA_Vertex0 *vtx)
-  {
-    vert_cvt_base;
-    curVTX->col = ABGR8888(vtx->BaseCol);
-
-    curVTX++;
-  }
+static void GxDrawBatch(u32 base, const u16 *idx, u32 left)
+{
+  if (base != array_base)
+    GxSetArrays(base);
 
-  //(Non-Textured, Floating Color)
-  __forceinline static void AppendPolyVertex1(TA_Vertex1 *vtx)
+  // GX_Begin takes a 16 bit vertex count, 65535 is a whole number of triangles
+  while (left)
   {
-    vert_cvt_base;
-    curVTX->col = FLCOL(&vtx->BaseA);
+    u32 count = left < 65535 ? left : 65535;
+    left -= count;
 
-    curVTX++;
+    GX_Begin(GX_TRIANGLES, GX_VTXFMT0, count);
+    while (count--)
+    {
+      u16 n = *idx++;
+      GX_Position1x16(n);
+      GX_Color1x16(n);
+      GX_TexCoord1x16(n);
+    }
+    GX_End();
   }
+}
 
-  //(Non-Textured, Intensity)
-  __forceinline static void AppendPolyVertex2(TA_Vertex2 *vtx)
-  {
-    vert_cvt_base;
-    curVTX->col = INTESITY(vtx->BaseInt);
+static void GxEndFrame(bool to_texture)
+{
+  if (frame_mv)
+    MvApply();
 
-    curVTX++;
-  }
+  GX_DrawDone();
 
-  //(Textured, Packed Color)
-  __forceinline static void AppendPolyVertex3(TA_Vertex3 *vtx)
+  if (to_texture)
   {
-    vert_cvt_base;
-    curVTX->col = ABGR8888(vtx->BaseCol);
-
-    curVTX->u = vtx->u;
-    curVTX->v = vtx->v;
-
-    curVTX++;
+    u32 fmt = GxRttFormat(FB_W_CTRL);
+    TexCacheRTT *rt = TexCache_BeginRTT(vp_w, vp_h, fmt == GX_TF_RGBA8 ? 4 : 2);
+    if (rt)
+    {
+      DCInvalidateRange(rt->data, rt->data_size);
+      GX_SetTexCopySrc(0, 0, rt->width, rt->height);
+      GX_SetTexCopyDst(rt->width, rt->height, fmt, GX_FALSE);
+      GX_CopyTex(rt->data, GX_TRUE);
+      GX_PixModeSync();
+      GX_DrawDone();
+      TexCache_EndRTT(rt);
+    }
+    return;
   }
 
-  //(Textured, Packed Color, 16bit UV)
-  __forceinline static void AppendPolyVertex4(TA_Vertex4 *vtx)
-  {
-    vert_cvt_base;
-    curVTX->col = ABGR8888(vtx->BaseCol);
-
-    curVTX->u = CVT16UV(vtx->u);
-    curVTX->v = CVT16UV(vtx->v);
+  GX_CopyDisp(frameBuffer[fb], GX_TRUE);
 
-    curVTX++;
-  }
+  VIDEO_SetNextFramebuffer(frameBuffer[fb]);
 
-  //(Textured, Floating Color)
-  __forceinline static void AppendPolyVertex5A(TA_Vertex5A *vtx)
-  {
-    vert_cvt_base;
+  VIDEO_Flush();
 
-    curVTX->u = vtx->u;
-    curVTX->v = vtx->v;
-  }
-  __forceinline static void AppendPolyVertex5B(TA_Vertex5B *vtx)
-  {
-    curVTX->col = FLCOL(&vtx->BaseA);
-    curVTX++;
-  }
+  wii_audio_frame(); // Audio (Step AICA and push one frame of audio to ASND)
+  VIDEO_WaitVSync();  // Needed for O3 mode (else Dreamcast logo take 5 seconds instead of 9)
+}
 
-  //(Textured, Floating Color, 16bit UV)
-  __forceinline static void AppendPolyVertex6A(TA_Vertex6A *vtx)
+// ============================
+// 2D framebuffer
+// ============================
+// With no 3D frame the display shows what the CPU (or a DMA) wrote to the
+// framebuffer at FB_R_SOF1. It is kept as a GX texture, converted in rows of
+// 4 lines (one row of GX tiles): each row is fetched from VRAM and hashed,
+// and only converted again when its hash changed, so a still screen costs
+// the fetch and the hash and nothing is flushed or uploaded.
+//
+// Hashing rather than write tracking, as the texture cache does: the plugin
+// is not told about VRAM writes. The lock callbacks are stubs (drkPvr.cpp),
+// 64 bit area stores and DMAs go straight to VRAM, and the one hook on the
+// 32 bit area (pvr_vram_readback) is a single range for render targets that
+// syncs the threaded TA on every hit. The cost is every displayed line read
+// and hashed once per 2D frame: 600 KB of pixels for 640x480 565, over
+// twice that in cache lines as the 32 bit view interleaves the two banks
+// (0.16 ms a frame on an x86 host, 0.37 ms for 0888). 3D frames never pay it.
+//
+// FB_R_SOF1 is a 32 bit area address: consecutive words of a line are 8
+// bytes apart in the 64 bit view, in the bank given by address bit 22.
+// VRAM holds the guest (little endian) byte order.
+
+#define FB2D_MAX_W 640
+#define FB2D_MAX_H 576
+#define FB2D_ROW_WORDS (FB2D_MAX_W + 4)   // one line of 0888, plus tile padding
+
+static u8 *fb2d_tex;                        // GX tiles, RGB5A3/RGB565 or RGBA8
+static u32 fb2d_rows[4 * FB2D_ROW_WORDS];   // the 4 lines of the current tile row
+static u32 fb2d_row_hash[FB2D_MAX_H / 4];   // 0 = not converted
+static u32 fb2d_key[5];                     // layout the rows were converted for
+
+// Copies 'words' words of the line at 'addr32' out of the 64 bit view,
+// followed by 4 zero words of padding
+static void Fb2dFetch(u32 *dst, u32 addr32, u32 words)
+{
+  u32 end = addr32 + words * 4 - 1;
+  if (((addr32 ^ end) & ~0x3FFFFF) == 0)
   {
-    vert_cvt_base;
-
-    curVTX->u = CVT16UV(vtx->u);
-    curVTX->v = CVT16UV(vtx->v);
+    const u32 *src = (const u32 *)&params.vram[fast_ConvOffset32toOffset64(addr32)];
+    for (u32 i = 0; i < words; i++)
+      dst[i] = src[i * 2];
   }
-  __forceinline static void AppendPolyVertex6B(TA_Vertex6B *vtx)
+  else
   {
-    curVTX->col = FLCOL(&vtx->BaseA);
-    curVTX++;
+    // the line crosses a bank
+    for (u32 i = 0; i < words; i++)
+      dst[i] = *(u32 *)&params.vram[fast_ConvOffset32toOffset64(addr32 + i * 4)];
   }
+  dst[words] = dst[words + 1] = dst[words + 2] = dst[words + 3] = 0;
+}
 
-  //(Textured, Intensity)
-  __forceinline static void AppendPolyVertex7(TA_Vertex7 *vtx)
+static u32 Fb2dHash(const u32 *rows, u32 words)
+{
+  // two independent chains, the multiplies overlap
+  u32 h0 = 0x811C9DC5, h1 = 0x01000193;
+  for (u32 y = 0; y < 4; y++, rows += FB2D_ROW_WORDS)
   {
-    vert_cvt_base;
-    curVTX->u = vtx->u;
-    curVTX->v = vtx->v;
-
-    curVTX->col = INTESITY(vtx->BaseInt);
-
-    curVTX++;
+    u32 i = 0;
+    for (; i + 1 < words; i += 2)
+    {
+      h0 = (h0 ^ rows[i]) * 0x01000193;
+      h1 = (h1 ^ rows[i + 1]) * 0x01000193;
+    }
+    if (i < words)
+      h0 = (h0 ^ rows[i]) * 0x01000193;
   }
+  return (h0 ^ (h1 >> 3) ^ (h1 << 11)) | 1;
+}
 
-  //(Textured, Intensity, 16bit UV)
-  __forceinline static void AppendPolyVertex8(TA_Vertex8 *vtx)
+// 0555/565: one tile row. Broadway has no integer SIMD, so the pixels are
+// swapped two per 32 bit word (the two bytes of each half) and every tile
+// line is two word stores. 'set' forces the RGB5A3 opaque bit for 0555.
+static void Fb2dTiles16(u32 *dst, const u32 *rows, u32 w, u32 set)
+{
+  for (u32 x = 0; x < w; x += 4, dst += 8)
   {
-    vert_cvt_base;
-    curVTX->col = INTESITY(vtx->BaseInt);
-
-    curVTX->u = CVT16UV(vtx->u);
-    curVTX->v = CVT16UV(vtx->v);
-
-    curVTX++;
+    const u32 *s = rows + x / 2;
+    for (u32 y = 0; y < 4; y++, s += FB2D_ROW_WORDS)
+    {
+      u32 a = s[0], b = s[1];
+      dst[y * 2] = (((a >> 8) & 0x00FF00FF) | ((a << 8) & 0xFF00FF00)) | set;
+      dst[y * 2 + 1] = (((b >> 8) & 0x00FF00FF) | ((b << 8) & 0xFF00FF00)) | set;
+    }
   }
+}
 
-  //(Non-Textured, Packed Color, with Two Volumes)
-  __forceinline static void AppendPolyVertex9(TA_Vertex9 *vtx)
-  {
-    vert_cvt_base;
-    curVTX->col = ABGR8888(vtx->BaseCol0);
-
-    curVTX++;
-  }
+// 888/0888 (B, G, R bytes per pixel, 3 or 4 bytes apart): one RGBA8 tile
+// row, 32 bytes of AR pairs then 32 bytes of GB pairs per tile
+static void Fb2dTiles32(u16 *dst, const u32 *rows, u32 w, u32 bpp)
+{
+  for (u32 x = 0; x < w; x += 4, dst += 32)
+    for (u32 y = 0; y < 4; y++)
+    {
+      const u8 *s = (const u8 *)(rows + y * FB2D_ROW_WORDS) + x * bpp;
+      for (u32 i = 0; i < 4; i++, s += bpp)
+      {
+        dst[y * 4 + i] = 0xFF00 | s[2];
+        dst[16 + y * 4 + i] = (s[1] << 8) | s[0];
+      }
+    }
+}
 
-  //(Non-Textured, Intensity,	with Two Volumes)
-  __forceinline static void AppendPolyVertex10(TA_Vertex10 *vtx)
+// Brings fb2d_tex up to date with the framebuffer and sets up its texture
+// object. Returns the displayed part of the texture in *u1, *v1.
+static bool Fb2dUpdate(GXTexObj *texobj, float *u1, float *v1)
+{
+  if (!fb2d_tex)
   {
-    vert_cvt_base;
-    curVTX->col = INTESITY(vtx->BaseInt0);
-
-    curVTX++;
+    fb2d_tex = (u8 *)memalign(32, FB2D_MAX_W * FB2D_MAX_H * 4);
+    if (!fb2d_tex)
+      return false;
   }
 
-  //(Textured, Packed Color,	with Two Volumes)
-  __forceinline static void AppendPolyVertex11A(TA_Vertex11A *vtx)
-  {
-    vert_cvt_base;
-
-    curVTX->u = vtx->u0;
-    curVTX->v = vtx->v0;
+  // FB_R_SIZE: line size in words - 1, lines - 1, modulus (words between lines + 1)
+  u32 depth = FB_R_CTRL.fb_depth;
+  u32 bpp = depth < 2 ? 2 : depth + 1;       // 0555, 565, 888, 0888
+  u32 line_words = (FB_R_SIZE & 0x3FF) + 1;
+  u32 height = ((FB_R_SIZE >> 10) & 0x3FF) + 1;
+  u32 modulus = (FB_R_SIZE >> 20) & 0x3FF;
+  u32 gap = modulus ? modulus - 1 : 0;
+  u32 addr = FB_R_SOF1 & VRAM_MASK;
+  u32 line_step = (line_words + gap) * 4;
 
-    curVTX->col = ABGR8888(vtx->BaseCol0);
-  }
-  __forceinline static void AppendPolyVertex11B(TA_Vertex11B *vtx)
+  // Interlaced with the two fields on alternating lines: take both at once
+  if (SPG_CONTROL.interlace && gap == line_words && FB_R_SOF2 == FB_R_SOF1 + line_words * 4)
   {
-    curVTX++;
+    height *= 2;
+    line_step = line_words * 4;
   }
 
-  //(Textured, Packed Color, 16bit UV, with Two Volumes)
-  __forceinline static void AppendPolyVertex12A(TA_Vertex12A *vtx)
-  {
-    vert_cvt_base;
-
-    curVTX->u = CVT16UV(vtx->u0);
-    curVTX->v = CVT16UV(vtx->v0);
-
-    curVTX->col = ABGR8888(vtx->BaseCol0);
-  }
-  __forceinline static void AppendPolyVertex12B(TA_Vertex12B *vtx)
+  u32 width = line_words * 4 / bpp;
+  if (width > FB2D_MAX_W)
   {
-    curVTX++;
+    width = FB2D_MAX_W;
+    line_words = width * bpp / 4;
   }
+  if (height > FB2D_MAX_H)
+    height = FB2D_MAX_H;
+  u32 tex_w = (width + 3) & ~3;
+  u32 tex_h = (height + 3) & ~3;
 
-  //(Textured, Intensity,	with Two Volumes)
-  __forceinline static void AppendPolyVertex13A(TA_Vertex13A *vtx)
-  {
-    vert_cvt_base;
-    curVTX->u = vtx->u0;
-    curVTX->v = vtx->v0;
-    curVTX->col = INTESITY(vtx->BaseInt0);
-  }
-  __forceinline static void AppendPolyVertex13B(TA_Vertex13B *vtx)
+  u32 key[5] = { addr, line_words, height, line_step, depth };
+  if (memcmp(key, fb2d_key, sizeof(key)))
   {
-    curVTX++;
+    memcpy(fb2d_key, key, sizeof(key));
+    memset(fb2d_row_hash, 0, sizeof(fb2d_row_hash));
   }
 
-  //(Textured, Intensity, 16bit UV, with Two Volumes)
-  __forceinline static void AppendPolyVertex14A(TA_Vertex14A *vtx)
-  {
-    vert_cvt_base;
-    curVTX->u = CVT16UV(vtx->u0);
-    curVTX->v = CVT16UV(vtx->v0);
-    curVTX->col = INTESITY(vtx->BaseInt0);
-  }
-  __forceinline static void AppendPolyVertex14B(TA_Vertex14B *vtx)
-  {
-    curVTX++;
-  }
+  u32 row_size = tex_w * 4 * (bpp == 2 ? 2 : 4);
+  bool changed = false;
 
-  // Sprites
-  __forceinline static void AppendSpriteParam(TA_SpriteParam *spr)
+  for (u32 r = 0; r < tex_h / 4; r++)
   {
-    TA_SpriteParam *pp = spr;
-    glob_param_bdc;
+    for (u32 y = 0; y < 4; y++)
+    {
+      u32 line = r * 4 + y;
+      if (line < height)
+        Fb2dFetch(&fb2d_rows[y * FB2D_ROW_WORDS], addr + line * line_step, line_words);
+      else
+        memset(&fb2d_rows[y * FB2D_ROW_WORDS], 0, (line_words + 4) * 4);
+    }
+
+    u32 hash = Fb2dHash(fb2d_rows, line_words);
+    if (hash == fb2d_row_hash[r])
+      continue;
+    fb2d_row_hash[r] = hash;
+
+    u8 *dst = fb2d_tex + r * row_size;
+    if (bpp == 2)
+      Fb2dTiles16((u32 *)dst, fb2d_rows, tex_w, depth == 0 ? 0x80008000 : 0);
+    else
+      Fb2dTiles32((u16 *)dst, fb2d_rows, tex_w, bpp);
+    DCFlushRange(dst, row_size);
+    changed = true;
   }
 
-// Sprite Vertex Handlers
-/*
-__forceinline
-static void AppendSpriteVertex0A(TA_Sprite0A* sv)
-{
+  if (changed)
+    GX_InvalidateTexAll();
 
+  u32 fmt = bpp == 2 ? (depth == 1 ? GX_TF_RGB565 : GX_TF_RGB5A3) : GX_TF_RGBA8;
+  GX_InitTexObj(texobj, fb2d_tex, tex_w, tex_h, fmt, GX_CLAMP, GX_CLAMP, GX_FALSE);
+  GX_InitTexObjLOD(texobj, GX_NEAR, GX_NEAR, 0, 0, 0, GX_FALSE, GX_FALSE, GX_ANISO_1);
+  *u1 = (float)width / tex_w;
+  *v1 = (float)height / tex_h;
+  return true;
 }
-__forceinline
-static void AppendSpriteVertex0B(TA_Sprite0B* sv)
-{
 
-}
-*/
-#define sprite_uv(indx, u_name, v_name) \
-  curVTX[indx].u = CVT16UV(sv->u_name); \
-  curVTX[indx].v = CVT16UV(sv->v_name);
+// ============================
+// 2D FRAMES
+// ============================
 
-  // Sprites are converted to 4-vertex triangle strips.
-  __forceinline static void AppendSpriteVertexA(TA_Sprite1A *sv)
-  {
-    
-    StartPolyStrip();
-    curVTX[0].col = 0xFFFFFFFF;
-    curVTX[1].col = 0xFFFFFFFF;
-    curVTX[2].col = 0xFFFFFFFF;
-    curVTX[3].col = 0xFFFFFFFF;
+// 2D direct framebuffer mode (logo screens).
+// Read from FB_R_SOF1 (what the DC video hardware displays),
+// NOT FB_W_SOF1 (write destination, may be the back buffer).
+static void GxPresent2D()
+{
+    GxEfbFormat(false);
 
-    {
-      vert_base(2, sv->x0, sv->y0, sv->z0);
-    }
-    {
-      vert_base(3, sv->x1, sv->y1, sv->z1);
-    }
+    GXTexObj texobj;
+    float u1, v1;
+    if (!Fb2dUpdate(&texobj, &u1, &v1))
+      return;
+    GX_LoadTexObj(&texobj, GX_TEXMAP0);
 
-    curVTX[1].x = sv->x2;
-  }
-  __forceinline static void AppendSpriteVertexB(TA_Sprite1B *sv)
-  {
+    // VTXFMT1: XY+UV only, leaves VTXFMT0 (3D path) undisturbed.
+    GX_SetVtxAttrFmt(GX_VTXFMT1, GX_VA_POS,  GX_POS_XY,  GX_F32, 0);
+    GX_SetVtxAttrFmt(GX_VTXFMT1, GX_VA_TEX0, GX_TEX_ST,  GX_F32, 0);
+    GX_ClearVtxDesc();
+    GX_SetVtxDesc(GX_VA_POS,  GX_DIRECT);
+    GX_SetVtxDesc(GX_VA_TEX0, GX_DIRECT);
+    GX_SetNumChans(0);
+    GX_SetNumTexGens(1);
+    GX_SetTexCoordGen(GX_TEXCOORD0, GX_TG_MTX2x4, GX_TG_TEX0, GX_IDENTITY);
+    GX_SetTevOrder(GX_TEVSTAGE0, GX_TEXCOORD0, GX_TEXMAP0, GX_COLORNULL);
+    GX_SetTevOp(GX_TEVSTAGE0, GX_REPLACE);
+    GX_SetZMode(GX_FALSE, GX_ALWAYS, GX_FALSE);
+    GX_SetBlendMode(GX_BM_NONE, GX_BL_ONE, GX_BL_ZERO, GX_LO_CLEAR);
 
+    Mtx44 ortho;
+    guOrtho(ortho, 0, 480, 0, 640, 0, 1);
+    GX_LoadProjectionMtx(ortho, GX_ORTHOGRAPHIC);
+    Mtx mv;
+    guMtxIdentity(mv);
+    GX_LoadPosMtxImm(mv, GX_PNMTX0);
+
+    // In 4:3 mode, draw the 2D framebuffer into a centred 4:3 sub-rectangle
+    // so logo screens and 2D content have the same correct framing as 3D.
+    float x0_2d, x1_2d;
+    if (choose_fullscreen)
     {
-      vert_base(1, curVTX[1].x, sv->y2, sv->z2);
-    }
-    {
-      vert_base(0, sv->x3, sv->y3, sv->z2);
+      x0_2d = 0.f;
+      x1_2d = 640.f;
     }
-
-    sprite_uv(2, u0, v0);
-    sprite_uv(3, u1, v1);
-    sprite_uv(1, u2, v2);
-    sprite_uv(0, u0, v2); // or sprite_uv(u2,v0); ?
-
-    curVTX += 4;
-    //			VertexCount+=4;
-
-    // EndPolyStrip();
-    curLST->count = 4;
-    if (global_regd)
+    else
     {
-      curLST->count |= 0x80000000;
-      global_regd = false;
-      curMod++;
+      // 4:3 inside 16:9: side bars are (1 - 3/4) / 2 * 640 = 80 px each side
+      const float ratio = (4.f / 3.f) / (16.f / 9.f); // 0.75
+      float margin = (640.f * (1.f - ratio)) * 0.5f;   // 80 px
+      x0_2d = margin;
+      x1_2d = 640.f - margin;
     }
-    curLST++;
-  }
 
-  // ModVolumes
-  __forceinline static void AppendModVolParam(TA_ModVolParam *modv)
-  {
-  }
-
-  // ModVol Strip handling
-  __forceinline static void StartModVol(TA_ModVolParam *param)
-  {
-  }
-  __forceinline static void ModVolStripEnd()
-  {
-  }
+    GX_Begin(GX_QUADS, GX_VTXFMT1, 4);
+      GX_Position2f32(x0_2d,   0); GX_TexCoord2f32(0, 0);
+      GX_Position2f32(x1_2d,   0); GX_TexCoord2f32(u1, 0);
+      GX_Position2f32(x1_2d, 480); GX_TexCoord2f32(u1, v1);
+      GX_Position2f32(x0_2d, 480); GX_TexCoord2f32(0, v1);
+    GX_End();
 
-  // Mod Volume Vertex handlers
-  __forceinline static void AppendModVolVertexA(TA_ModVolA *mvv)
-  {
-  }
-  __forceinline static void AppendModVolVertexB(TA_ModVolB *mvv)
-  {
-  }
-  __forceinline static void SetTileClip(u32 xmin, u32 ymin, u32 xmax, u32 ymax)
-  {
-  }
-  __forceinline static void TileClipMode(u32 mode)
-  {
-  }
-  // Misc
-  __forceinline static void ListCont()
-  {
-  }
-  __forceinline static void ListInit()
-  {
-    // reset_vtx_state();
-  }
-  __forceinline static void SoftReset()
-  {
-    // reset_vtx_state();
-  }
-};
-// Setup related
+    GX_DrawDone();
+    GX_CopyDisp(frameBuffer[fb], GX_TRUE);
+    VIDEO_SetNextFramebuffer(frameBuffer[fb]);
+    VIDEO_Flush();
+    VIDEO_WaitVSync();
+}
 
 // ============================
-// Vertex Decoding-Converting
+// Statistics
 // ============================
 
-void SetFpsText(char *text)
+static void GxPrintStats()
 {
-  strcpy(fps_text, text);
-  printf(text);
-  // if (!IsFullscreen)
-  {
-    // SetWindowText((HWND)emu.GetRenderTarget(), fps_text);
-  }
+  if (texjob_thread != LWP_THREAD_NULL)
+    printf("TexJob: %d queued, %d inline (queue full)\n",
+           texjob_stats.queued, texjob_stats.inline_full);
+  memset(&texjob_stats, 0, sizeof(texjob_stats));
 }
 
 // ============================
 // Initialize the Wii Video and GX subsystem.
 // ============================
 
-bool InitRenderer()
+static bool GxInit()
 {
   // Obtain the preferred video mode from the system
   // This will correspond to the settings in the Wii menu
@@ -1967,66 +2356,77 @@ bool InitRenderer()
   printf("MEM1 free: %.2f MB\n", ((unat)SYS_GetArena1Hi() - (unat)SYS_GetArena1Lo()) / 1024.f / 1024);
   printf("MEM2 free: %.2f MB\n", ((unat)SYS_GetArena2Hi() - (unat)SYS_GetArena2Lo()) / 1024.f / 1024.f);
 
+  // Converted textures live in the MEM2 block reserved next to the guest VRAM
+  TSP wrap;
+  wrap.full = 0;
+  wrap.FlipU = wrap.FlipV = 1;
+  wrap.ClampU = wrap.ClampV = 1;
+  wrap.MipMapD = 0xF;
+  gx_backend.tsp_bits = wrap.full;
+  TexCache_Init(vram_buffer, VRAM_SIZE * 2, settings.TexCache.BudgetMB * 1024 * 1024, GxReadback);
+  BuildYUVTables();
+  if (settings.TexCache.AsyncDecode)
+    TexJob_Start();
+#ifdef TEXCONV_SELFTEST
+  TexConv_SelfTest();
+#endif
+
   printf("sizeof TextureCacheDesc: %d\n", sizeof(TextureCacheDesc));
   printf("sizeof GXTexObj: %d\n", sizeof(GXTexObj));
   printf("sizeof GXTlutObj: %d\n", sizeof(GXTlutObj));
 
-  return TileAccel.Init();
+  return true;
 }
 
 // ============================
 // TERM RENDERER
 // ============================
 
-void TermRenderer()
+static void GxTerm()
 {
-  TileAccel.Term();
+  TexJob_Stop();
+  TexCache_Term();
+
+  free(fb2d_tex);
+  fb2d_tex = 0;
+  memset(fb2d_key, 0, sizeof(fb2d_key));
 }
 
 // ============================
 // RESET RENDERER
 // ============================
 
-void ResetRenderer(bool Manual)
+static void GxReset(bool Manual)
 {
-  TileAccel.Reset(Manual);
-  VertexCount = 0;
-  FrameCount = 0;
+  if (texjob_thread != LWP_THREAD_NULL)
+    TexJob_Retire(true);
 }
 
-// Thread Start
-bool ThreadStart()
+RendBackend gx_backend =
 {
-  return true;
-}
+  "gxRend",
+  0,
 
-// Thread End
-void ThreadEnd()
-{
-}
+  GxInit,
+  GxTerm,
+  GxReset,
 
-// List Cont
-void ListCont()
-{
-  TileAccel.ListCont();
-}
+  GxBeginFrame,
+  GxEndFrame,
+  GxPresent2D,
 
-// List Init
-void ListInit()
-{
-  TileAccel.ListInit();
-}
+  GxBeginTranslucent,
+  GxBindState,
 
-// Soft Reset
-void SoftReset()
-{
-  TileAccel.SoftReset();
-}
+  GxTextureSize,
+  GxUpdateTexture,
+  GxBindTexture,
+  GxBindRenderTarget,
 
-// VRAM locked Write
-void VramLockedWrite(vram_block *bl)
-{
-}
+  GxDrawBatch,
+
+  GxPrintStats,
+};
 
 #include <vector>
 #include <string>
@@ -2046,4 +2446,6 @@ int GetFile(char *szFileName, char *szParse = 0, u32 flags = 0)
   }
   else
     return 0;
-}
\ No newline at end of file
+}
+
+#endif // REND_API == REND_WII
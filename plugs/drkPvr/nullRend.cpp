@@ -0,0 +1,114 @@
+// Null Rendering
+
+#include "config.h"
+
+// Null backend, only built for REND_NULL
+#if REND_API == REND_NULL
+
+#include "nullRend.h"
+
+/*
+Null backend: every frame goes through the TA, the render list compiler and
+the texture cache lookups (hashing included) the same way as with gxRend, then
+nothing is drawn. Textures are not converted, their entries are only marked as
+ready, so what is left is the CPU side of the PVR, the part ta_replay profiles
+on a host.
+*/
+
+#include "TexCache.h"
+
+// Render targets never get pixels, VRAM keeps what was there
+static void NullReadback(TexCacheRTT *rt)
+{
+}
+
+static bool NullInit()
+{
+  null_backend.tsp_bits = 0;
+  return TexCache_Init(0, 0, settings.TexCache.BudgetMB * 1024 * 1024, NullReadback);
+}
+
+static void NullTerm()
+{
+  TexCache_Term();
+}
+
+static void NullReset(bool Manual)
+{
+}
+
+static void NullBeginFrame(bool to_texture)
+{
+}
+
+static void NullEndFrame(bool to_texture)
+{
+}
+
+static void NullPresent2D()
+{
+}
+
+static void NullBeginTranslucent()
+{
+}
+
+static void NullBindState(const PolyParam *mod)
+{
+}
+
+// Keeps the cache accounting and eviction going without real storage
+static u32 NullTextureSize(const PolyParam *mod, u32 w, u32 h)
+{
+  return 32;
+}
+
+static void NullUpdateTexture(TexCacheEntry *entry, const PolyParam *mod, u32 w, u32 h)
+{
+  entry->valid = true;
+  TexCache_Converted(entry);
+}
+
+static void NullBindTexture(TexCacheEntry *entry)
+{
+}
+
+static void NullBindRenderTarget(TexCacheRTT *rt, const PolyParam *mod)
+{
+}
+
+static void NullDrawBatch(u32 base, const u16 *idx, u32 count)
+{
+}
+
+static void NullPrintStats()
+{
+}
+
+RendBackend null_backend =
+{
+  "nullRend",
+  0,
+
+  NullInit,
+  NullTerm,
+  NullReset,
+
+  NullBeginFrame,
+  NullEndFrame,
+  NullPresent2D,
+
+  NullBeginTranslucent,
+  NullBindState,
+
+  NullTextureSize,
+  NullUpdateTexture,
+  NullBindTexture,
+  NullBindRenderTarget,
+
+  NullDrawBatch,
+
+  NullPrintStats,
+};
+
+#endif // REND_API == REND_NULL
@@ -0,0 +1,7 @@
+// Null rendering, the frame driver without a GPU (see Renderer_if.h)
+
+#pragma once
+#include "drkPvr.h"
+#include "Renderer_if.h"
+
+extern RendBackend null_backend;
@@ -12,6 +12,18 @@
 
 u8 regs[RegSize];
 
+// PALETTE_RAM write revisions, per 16 and per 256 entry bank
+u32 pal_rev_16[64];
+u32 pal_rev_256[4];
+
+void Regs_PaletteDirty()
+{
+	for (u32 i = 0; i < 64; i++)
+		pal_rev_16[i]++;
+	for (u32 i = 0; i < 4; i++)
+		pal_rev_256[i]++;
+}
+
 u32 FASTCALL libPvr_ReadReg(u32 addr, u32 size)
 {
 	// The PVR only supports 32-bit aligned register accesses.
@@ -20,6 +32,10 @@ u32 FASTCALL libPvr_ReadReg(u32 addr, u32 size)
 	if (size != 4)
 		return 0;
 
+	// The SPG only steps on scanlines with events, work out the beam position
+	if ((addr & RegMask) == SPG_STATUS_addr)
+		spg_UpdateStatus();
+
 	return PvrReg(addr, u32);
 }
 
@@ -32,6 +48,9 @@ void FASTCALL libPvr_WriteReg(u32 paddr, u32 data, u32 size)
 
 	u32 addr = paddr & RegMask;
 
+	// Register writes can observe or reset TA state, drain batched SQ data first
+	TASplitter::TA_SQFlush();
+
 	switch (addr)
 	{
 		// ---- Read-only registers: ignore writes ----
@@ -41,14 +60,14 @@ void FASTCALL libPvr_WriteReg(u32 paddr, u32 data, u32 size)
 
 		// ---- Trigger: start the ISP/TSP rendering pipeline ----
 		case STARTRENDER_addr:
-			rend_start_render();
+			TASplitter::TA_Control(TASplitter::TA_CTRL_START_RENDER);
 			return;
 
 		// ---- TA_LIST_INIT: bit 31 triggers TA initialisation ----
 		case TA_LIST_INIT_addr:
 			if (data >> 31)
 			{
-				rend_list_init();
+				TASplitter::TA_Control(TASplitter::TA_CTRL_LIST_INIT);
 				data = 0;  // hardware clears the register after triggering
 			}
 			break;
@@ -61,7 +80,7 @@ void FASTCALL libPvr_WriteReg(u32 paddr, u32 data, u32 size)
 			if (data != 0)
 			{
 				if (data & 1)
-					rend_list_srst();
+					TASplitter::TA_Control(TASplitter::TA_CTRL_SOFT_RESET);
 				// bits 1 and 2 accepted but not currently emulated
 				data = 0;  // hardware self-clears
 			}
@@ -70,29 +89,61 @@ void FASTCALL libPvr_WriteReg(u32 paddr, u32 data, u32 size)
 		// ---- TA_LIST_CONT: a write (any value) resumes TA list processing ----
 		// The value is not stored; the write is purely a trigger.
 		case TA_LIST_CONT_addr:
-			rend_list_cont();
+			TASplitter::TA_Control(TASplitter::TA_CTRL_LIST_CONT);
 			return;  // do NOT write to register array
 
 		// ---- Registers that require video-sync recalculation ----
+		// (the SPG interrupt and vblank lines move its next event too)
+		// The 2D framebuffer path reads FB_R_CTRL and SPG_CONTROL while drawing
 		case FB_R_CTRL_addr:
 		case SPG_CONTROL_addr:
+			if (PvrReg(addr, u32) != data)
+				TASplitter::TA_WaitRender();
+			PvrReg(addr, u32) = data;
+			CalculateSync();
+			return;
+
 		case SPG_LOAD_addr:
+		case SPG_VBLANK_INT_addr:
+		case SPG_VBLANK_addr:
 			PvrReg(addr, u32) = data;
 			CalculateSync();
 			return;
 
+		// ---- Registers the renderer reads while drawing ----
+		// With the threaded TA the frames queued may not be drawn yet, they
+		// are drawn with the values they had at STARTRENDER (see ta.cpp)
+		case PARAM_BASE_addr:
+		case FB_W_CTRL_addr:
+		case FB_W_LINESTRIDE_addr:
+		case FB_W_SOF1_addr:
+		case FB_R_SOF1_addr:
+		case FB_R_SOF2_addr:
+		case FB_R_SIZE_addr:
+		case FB_X_CLIP_addr:
+		case FB_Y_CLIP_addr:
+		case FPU_SHAD_SCALE_addr:
+		case ISP_BACKGND_D_addr:
+		case ISP_BACKGND_T_addr:
+		case ISP_FEED_CFG_addr:
+		case TEXT_CONTROL_addr:
+		case PAL_RAM_CTRL_addr:
+		case PT_ALPHA_REF_addr:
+			if (PvrReg(addr, u32) != data)
+				TASplitter::TA_WaitRender();
+			break;
+
 		default:
-			// Palette RAM writes: track which palette entries have changed
-			// so the renderer can invalidate cached palette textures.
+			// Palette RAM writes: bump the revision of the banks holding the
+			// entry, so the palette cache only rehashes banks that were written.
 			if (addr >= PALETTE_RAM_START_addr && addr <= PALETTE_RAM_END_addr)
 			{
 				if (PvrReg(addr, u32) != data)
 				{
-					// TODO: implement palette dirty tracking
-					// u32 pal_index = (addr - PALETTE_RAM_START_addr) >> 2;
-					// pal_needs_update = true;
-					// pal_rev_256[pal_index >> 8]++;
-					// pal_rev_16[pal_index >> 4]++;
+					TASplitter::TA_WaitRender();
+					u32 pal_index = (addr - PALETTE_RAM_START_addr) >> 2;
+					pal_rev_256[pal_index >> 8]++;
+					pal_rev_16[pal_index >> 4]++;
 				}
 			}
 			break;
@@ -106,6 +157,7 @@ bool Regs_Init()
 	// Zero all registers so we start from a clean, deterministic state
 	// before Regs_Reset() applies the hardware power-on defaults.
 	memset(regs, 0, sizeof(regs));
+	Regs_PaletteDirty();
 	return true;
 }
 
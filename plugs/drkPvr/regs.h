@@ -15,6 +15,13 @@ bool Regs_Init();
 void Regs_Term();
 void Regs_Reset(bool Manual);
 
+// Palette RAM write revisions (bumped when an entry of the bank changes)
+extern u32 pal_rev_16[64];
+extern u32 pal_rev_256[4];
+
+// Mark every palette bank as changed, after writing regs[] directly
+void Regs_PaletteDirty();
+
 /*	
 	PVR registers
 */
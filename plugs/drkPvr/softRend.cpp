@@ -0,0 +1,1448 @@
+// Software Rendering
+
+/*
+CPU renderer for hosts without a GPU (headless Linux build machines), used
+for screenshots, regression runs and frame time benchmarks.
+
+StartRender turns the strips left by the TA decoder (ta_vtx.cpp) into screen
+space triangles, bins them into 32x32 tiles like the PVR2 region array does,
+then a pool of worker threads rasterises the tiles in parallel. Each worker
+renders one tile at a time into its own colour/depth buffer, so workers only
+share the tile counter.
+
+Inside a tile every triangle is walked span by span: the row interval covered
+by the three edges is solved directly, the interpolants for the whole span are
+computed in flat loops the compiler can vectorise (SSE/NEON/AltiVec, no
+intrinsics), then the span is textured, shaded and blended.
+
+Opaque modifier volumes darken shadowed polys with a per tile stencil pass
+before the translucent triangles are drawn. With autosort (ISP_FEED_CFG) the
+translucent triangles are set up back to front (SoftSetupSorted).
+
+Not handled yet: translucent modifier volumes, fog, offset colour, bilinear
+filtering and writing the rendered frame back to VRAM.
+*/
+
+#include "config.h"
+
+#if REND_API == REND_SOFT
+
+#include "softRend.h"
+#include "ta_vtx.h"
+#include "TexCache.h"
+#include "regs.h"
+#include <math.h>
+#include <pthread.h>
+#include <unistd.h>
+
+using namespace TASplitter;
+
+#define SOFT_WIDTH        640
+#define SOFT_HEIGHT       480
+#define SOFT_TILE         32
+#define SOFT_TILES_X      (SOFT_WIDTH / SOFT_TILE)
+#define SOFT_TILES_Y      (SOFT_HEIGHT / SOFT_TILE)
+#define SOFT_TILE_COUNT   (SOFT_TILES_X * SOFT_TILES_Y)
+#define SOFT_MAX_THREADS  16
+
+char fps_text[512];
+
+// ============================
+// Frame data
+// ============================
+
+// Rasteriser view of a PolyParam
+struct SoftMode
+{
+  u32 depth_mode;       // ISP DepthMode
+  u32 cull_mode;        // ISP CullMode
+  bool zwrite;
+  bool blend;           // translucent list
+  bool alpha_test;      // punch through list
+  bool gouraud;
+  bool use_alpha;
+  bool ignore_tex_alpha;
+  u8 shadow;            // SOFT_ST_SHADOW for opaque polys with the shadow bit
+  u32 shad_instr;
+  u32 src_instr;
+  u32 dst_instr;
+
+  const void *tex;      // decoded texture (TexCache entry), NULL if untextured
+  const u32 *pal;       // ARGB8888 palette if 'tex' holds u8 indices, else NULL
+  u32 tex_w, tex_h;
+  bool clamp_u, clamp_v;
+  bool flip_u, flip_v;
+};
+
+// a(x,y) = c + dx*x + dy*y
+struct SoftPlane
+{
+  float c, dx, dy;
+};
+
+enum SoftAttr
+{
+  SA_U,   // all attributes are stored divided by w
+  SA_V,
+  SA_R,
+  SA_G,
+  SA_B,
+  SA_A,
+  SA_COUNT
+};
+
+struct SoftTri
+{
+  SoftPlane edge[3];          // >= 0 inside
+  SoftPlane iw;               // 1/w, also the depth value
+  SoftPlane attr[SA_COUNT];
+  s32 x0, y0, x1, y1;         // pixel bounding box, inclusive
+  u32 mode;
+};
+
+// Modifier volume triangle
+struct SoftVolTri
+{
+  SoftPlane edge[3];
+  SoftPlane iw;
+  s32 x0, y0, x1, y1;
+  u32 volume;                 // soft_volumes index
+};
+
+// Tile stencil bits
+#define SOFT_ST_SHADOW 1      // the visible surface has the shadow bit
+#define SOFT_ST_PARITY 2      // odd number of faces of the open volume in front
+#define SOFT_ST_INSIDE 4      // modified by a closed volume
+
+// Per thread tile buffers
+struct SoftTileCtx
+{
+  ALIGN16 u32 col[SOFT_TILE * SOFT_TILE];
+  ALIGN16 float depth[SOFT_TILE * SOFT_TILE];
+  ALIGN16 u8 stencil[SOFT_TILE * SOFT_TILE];
+
+  // span scratch
+  ALIGN16 float z[SOFT_TILE];
+  ALIGN16 float rw[SOFT_TILE];
+  ALIGN16 float at[SA_COUNT][SOFT_TILE];
+  u8 pass[SOFT_TILE];
+};
+
+static Array<SoftTri> soft_tris;      // grow with the TA arena, kept between frames
+static Array<SoftMode> soft_modes;    // [0] is used until the first PolyParam
+static u32 soft_tri_count;
+
+static u32 soft_bin_start[SOFT_TILE_COUNT + 1];
+static u32 soft_bin_cursor[SOFT_TILE_COUNT];
+static Array<u32> soft_bin_data;
+
+// Modifier volumes, set up when TA_ModVolActive()
+static Array<SoftVolTri> soft_vol_tris;
+static Array<u32> soft_volumes;       // volume instruction, 1 inside or 2 outside
+static u32 soft_vol_tri_count;
+static u32 soft_vol_exclude;          // volumes with instruction 2
+static u32 soft_vbin_start[SOFT_TILE_COUNT + 1];
+static Array<u32> soft_vbin_data;
+static bool soft_mv_active;
+static u32 soft_trans_first;          // volumes apply before this triangle
+static u32 soft_shadow_scale;         // 0..256
+
+static u32 soft_bg_col;
+static float soft_bg_depth;
+static u32 soft_pt_ref;
+
+ALIGN16 static u32 soft_frame[SOFT_WIDTH * SOFT_HEIGHT];
+ALIGN16 static u32 soft_rtt_frame[SOFT_WIDTH * SOFT_HEIGHT];
+static u32 *soft_target = soft_frame;      // what the tiles are rendered to
+
+static struct
+{
+  u32 frames;
+  u32 tris;
+  u32 bin_refs;
+  double setup_time;
+  double raster_time;
+} soft_stats;
+
+// ============================
+// Colour helpers (ARGB8888 out)
+// ============================
+
+static INLINE u32 ARGB1555(u32 c)
+{
+  u32 r = (c >> 10) & 0x1F, g = (c >> 5) & 0x1F, b = c & 0x1F;
+  u32 a = (c & 0x8000) ? 0xFF : 0;
+  return (a << 24) | (((r << 3) | (r >> 2)) << 16) | (((g << 3) | (g >> 2)) << 8) | ((b << 3) | (b >> 2));
+}
+
+static INLINE u32 ARGB565(u32 c)
+{
+  u32 r = (c >> 11) & 0x1F, g = (c >> 5) & 0x3F, b = c & 0x1F;
+  return 0xFF000000 | (((r << 3) | (r >> 2)) << 16) | (((g << 2) | (g >> 4)) << 8) | ((b << 3) | (b >> 2));
+}
+
+static INLINE u32 ARGB4444(u32 c)
+{
+  u32 a = (c >> 12) & 0xF, r = (c >> 8) & 0xF, g = (c >> 4) & 0xF, b = c & 0xF;
+  return ((a * 0x11) << 24) | ((r * 0x11) << 16) | ((g * 0x11) << 8) | (b * 0x11);
+}
+
+static INLINE s32 soft_clamp255(s32 v)
+{
+  return v < 0 ? 0 : (v > 255 ? 255 : v);
+}
+
+static INLINE u32 ARGBYUV(s32 Y, s32 U, s32 V)
+{
+  s32 R = Y + ((V - 128) * 11 >> 3);
+  s32 G = Y - (((U - 128) * 11 + (V - 128) * 22) >> 5);
+  s32 B = Y + ((U - 128) * 55 >> 5);
+
+  return 0xFF000000 | (soft_clamp255(R) << 16) | (soft_clamp255(G) << 8) | soft_clamp255(B);
+}
+
+// ============================
+// Textures
+// ============================
+// Decoded to ARGB8888 into the texture cache (TexCache.h), which keeps them
+// across frames and re-decodes them when their VRAM contents change.
+// Paletted textures are kept as u8 indices and sampled through an ARGB8888
+// palette from the palette cache. Mipmapped textures are sampled from their
+// top level (TexCache_MipOffset), there is no LOD selection here.
+
+static Array<u16> soft_tex_raw;
+
+static INLINE u32 tex8(u32 addr)
+{
+  return params.vram[addr & VRAM_MASK];
+}
+
+static INLINE u32 tex16(u32 addr)
+{
+  return HOST_TO_LE16(*(u16 *)&params.vram[addr & VRAM_MASK & ~1]);
+}
+
+// input : x,y  output : texel index in twiddled (xyxyxyxy) order
+static u32 SoftTwiddle(u32 x, u32 y, u32 x_sz, u32 y_sz)
+{
+  u32 rv = 0;
+  u32 sh = 0;
+  x_sz >>= 1;
+  y_sz >>= 1;
+  while (x_sz != 0 || y_sz != 0)
+  {
+    if (y_sz)
+    {
+      rv |= (y & 1) << sh;
+      y_sz >>= 1; y >>= 1; sh++;
+    }
+    if (x_sz)
+    {
+      rv |= (x & 1) << sh;
+      x_sz >>= 1; x >>= 1; sh++;
+    }
+  }
+  return rv;
+}
+
+static void SoftTex_DecodePalette(TexCachePalette *pal)
+{
+  u32 *dst = (u32 *)pal->data;
+  const u32 *src = &PALETTE_RAM[pal->first];
+
+  for (u32 i = 0; i < pal->count; i++)
+  {
+    switch (pal->format)
+    {
+    case 0: dst[i] = ARGB1555(src[i]); break;
+    case 1: dst[i] = ARGB565(src[i]); break;
+    case 2: dst[i] = ARGB4444(src[i]); break;
+    default: dst[i] = src[i]; break;
+    }
+  }
+  pal->valid = true;
+}
+
+// Paletted : linear u8 indices
+static void SoftTex_DecodeIndices(u8 *dst, TCW tcw, TSP tsp, u32 w, u32 h)
+{
+  u32 addr = (tcw.NO_PAL.TexAddr << 3) & VRAM_MASK;
+
+  u32 tw_x[1024], tw_y[1024];
+  for (u32 x = 0; x < w; x++) tw_x[x] = SoftTwiddle(x, 0, w, h);
+  for (u32 y = 0; y < h; y++) tw_y[y] = SoftTwiddle(0, y, w, h);
+
+  if (tcw.NO_PAL.PixelFmt == 5)
+  {
+    addr += TexCache_MipOffset(tcw, tsp.TexU + 3) >> 1;
+
+    for (u32 y = 0; y < h; y++)
+      for (u32 x = 0; x < w; x++)
+      {
+        u32 idx = tw_x[x] | tw_y[y];
+        u32 b = tex8(addr + (idx >> 1));
+        *dst++ = (idx & 1) ? (b >> 4) : (b & 0xF);
+      }
+  }
+  else
+  {
+    addr += TexCache_MipOffset(tcw, tsp.TexU + 3);
+
+    for (u32 y = 0; y < h; y++)
+      for (u32 x = 0; x < w; x++)
+        *dst++ = tex8(addr + (tw_x[x] | tw_y[y]));
+  }
+}
+
+static void SoftTex_Decode(u32 *dst, TCW tcw, TSP tsp, u32 w, u32 h)
+{
+  u32 fmt = tcw.NO_PAL.PixelFmt;
+  u32 addr = (tcw.NO_PAL.TexAddr << 3) & VRAM_MASK;
+
+  // 16 bit formats : fetch raw texels in linear order first
+  u16 *raw = soft_tex_raw.data;
+
+  if (tcw.NO_PAL.ScanOrder && !tcw.NO_PAL.VQ_Comp)
+  {
+    u32 stride = w;
+    if (tcw.NO_PAL.StrideSel)
+      stride = (TEXT_CONTROL & 31) * 32;
+
+    for (u32 y = 0; y < h; y++)
+      for (u32 x = 0; x < w; x++)
+        *raw++ = tex16(addr + (y * stride + x) * 2);
+  }
+  else
+  {
+    u32 tw_x[1024], tw_y[1024];
+    for (u32 x = 0; x < w; x++) tw_x[x] = SoftTwiddle(x, 0, w, h);
+    for (u32 y = 0; y < h; y++) tw_y[y] = SoftTwiddle(0, y, w, h);
+
+    if (tcw.NO_PAL.VQ_Comp)
+    {
+      // 256 entry codebook of 2x2 texel blocks, stored in twiddled order
+      u32 codebook = addr;
+      addr += 256 * 4 * 2;
+      addr += TexCache_MipOffset(tcw, tsp.TexU + 3);
+
+      for (u32 y = 0; y < h; y++)
+        for (u32 x = 0; x < w; x++)
+        {
+          u32 idx = tw_x[x] | tw_y[y];
+          u32 entry = tex8(addr + (idx >> 2));
+          *raw++ = tex16(codebook + entry * 8 + (idx & 3) * 2);
+        }
+    }
+    else
+    {
+      addr += TexCache_MipOffset(tcw, tsp.TexU + 3) * 2;
+
+      for (u32 y = 0; y < h; y++)
+        for (u32 x = 0; x < w; x++)
+          *raw++ = tex16(addr + (tw_x[x] | tw_y[y]) * 2);
+    }
+  }
+
+  raw = soft_tex_raw.data;
+  u32 count = w * h;
+
+  switch (fmt)
+  {
+  case 0:
+  case 7: // Reserved, regarded as 1555
+    for (u32 i = 0; i < count; i++) dst[i] = ARGB1555(raw[i]);
+    break;
+
+  case 1:
+    for (u32 i = 0; i < count; i++) dst[i] = ARGB565(raw[i]);
+    break;
+
+  case 2:
+    for (u32 i = 0; i < count; i++) dst[i] = ARGB4444(raw[i]);
+    break;
+
+  case 3:
+    // YUV422 : each horizontal pixel pair is Y0:U , Y1:V
+    for (u32 i = 0; i < count; i += 2)
+    {
+      s32 U = raw[i] & 0xFF;
+      s32 V = raw[i + 1] & 0xFF;
+      dst[i] = ARGBYUV(raw[i] >> 8, U, V);
+      dst[i + 1] = ARGBYUV(raw[i + 1] >> 8, U, V);
+    }
+    break;
+
+  default:
+    // 4 : Bump map, not supported
+    for (u32 i = 0; i < count; i++) dst[i] = 0xFFFFFFFF;
+    break;
+  }
+}
+
+// Returns the decoded texture, or NULL if the cache is full. For paletted
+// textures the texture holds indices and '*pal' is set to their palette.
+static const void *SoftTex_Get(TCW tcw, TSP tsp, const u32 **pal)
+{
+  u32 w = 8 << tsp.TexU;
+  u32 h = 8 << tsp.TexV;
+  u32 fmt = tcw.NO_PAL.PixelFmt;
+  bool paletted = fmt == 5 || fmt == 6;
+
+  *pal = 0;
+  if (paletted)
+  {
+    TexCachePalette *p;
+    TexCacheResult res = fmt == 5 ? TexCache_LookupPalette(tcw.PAL.PalSelect << 4, 16, &p)
+                                  : TexCache_LookupPalette((tcw.PAL.PalSelect >> 4) << 8, 256, &p);
+    if (res == TC_FAIL)
+      return 0;
+    if (res == TC_CONVERT)
+      SoftTex_DecodePalette(p);
+    *pal = (const u32 *)p->data;
+  }
+
+  u32 src_addr;
+  u32 src_size = TexCache_SourceRange(tcw, tsp, &src_addr);
+
+  TexCacheEntry *entry;
+  TexCacheResult res = TexCache_Lookup(TexCache_MakeKey(tcw, tsp, 0), src_addr, src_size,
+                                       w * h * (paletted ? 1 : 4), &entry);
+  if (res == TC_FAIL)
+    return 0;
+
+  if (res == TC_CONVERT)
+  {
+    if (paletted)
+      SoftTex_DecodeIndices(entry->data, tcw, tsp, w, h);
+    else
+      SoftTex_Decode((u32 *)entry->data, tcw, tsp, w, h);
+    TexCache_Converted(entry);
+  }
+
+  return entry->data;
+}
+
+static INLINE u32 SoftTexCoord(float c, u32 size, bool clamp, bool flip)
+{
+  float f = c * size;
+  if (!(f > -1048576.f && f < 1048576.f))   // NaN, inf and huge repeats
+    f = 0;
+  s32 i = (s32)floorf(f);
+
+  if (clamp)
+    return i < 0 ? 0 : (i >= (s32)size ? size - 1 : i);
+
+  if (flip)
+  {
+    i &= size * 2 - 1;
+    return i >= (s32)size ? size * 2 - 1 - i : i;
+  }
+
+  return i & (size - 1);
+}
+
+// ============================
+// Setup and binning
+// ============================
+
+static void SoftBuildMode(SoftMode *m, PolyParam *pp)
+{
+  m->depth_mode = pp->isp.DepthMode;
+  m->cull_mode = pp->isp.CullMode;
+  m->zwrite = !pp->isp.ZWriteDis;
+  m->blend = pp->pcw.ListType == ListType_Translucent;
+  m->alpha_test = pp->pcw.ListType == ListType_Punch_Through;
+  m->gouraud = pp->pcw.Gouraud;
+  m->use_alpha = pp->tsp.UseAlpha;
+  m->ignore_tex_alpha = pp->tsp.IgnoreTexA;
+  m->shadow = pp->pcw.Shadow && !m->blend ? SOFT_ST_SHADOW : 0;
+  m->shad_instr = pp->tsp.ShadInstr;
+  m->src_instr = pp->tsp.SrcInstr;
+  m->dst_instr = pp->tsp.DstInstr;
+
+  // Autosorted translucent polys ignore the depth mode and never write Z
+  if (m->blend && !(ISP_FEED_CFG & 1))
+  {
+    m->depth_mode = 6;
+    m->zwrite = false;
+  }
+
+  m->tex = 0;
+  m->pal = 0;
+  if (pp->pcw.Texture)
+  {
+    m->tex = SoftTex_Get(pp->tcw, pp->tsp, &m->pal);
+    m->tex_w = 8 << pp->tsp.TexU;
+    m->tex_h = 8 << pp->tsp.TexV;
+    m->clamp_u = pp->tsp.ClampU;
+    m->clamp_v = pp->tsp.ClampV;
+    m->flip_u = pp->tsp.FlipU;
+    m->flip_v = pp->tsp.FlipV;
+  }
+}
+
+static INLINE void SoftMakePlane(SoftPlane *p, float f0, float f1, float f2,
+                                 const float *sx, const float *sy, float inv_area)
+{
+  float a1 = sx[1] - sx[0], b1 = sy[1] - sy[0];
+  float a2 = sx[2] - sx[0], b2 = sy[2] - sy[0];
+
+  p->dx = ((f1 - f0) * b2 - (f2 - f0) * b1) * inv_area;
+  p->dy = ((f2 - f0) * a1 - (f1 - f0) * a2) * inv_area;
+  p->c = f0 - p->dx * sx[0] - p->dy * sy[0];
+}
+
+// Edges and pixel bounding box of a screen space triangle, false when it is
+// off screen
+static bool SoftSetupEdges(SoftPlane *edge, s32 &x0, s32 &y0, s32 &x1, s32 &y1,
+                           const float *sx, const float *sy, float area)
+{
+  float minx = sx[0], maxx = sx[0], miny = sy[0], maxy = sy[0];
+  for (u32 i = 1; i < 3; i++)
+  {
+    if (sx[i] < minx) minx = sx[i];
+    if (sx[i] > maxx) maxx = sx[i];
+    if (sy[i] < miny) miny = sy[i];
+    if (sy[i] > maxy) maxy = sy[i];
+  }
+  if (maxx < 0 || maxy < 0 || minx >= SOFT_WIDTH || miny >= SOFT_HEIGHT)
+    return false;
+
+  x0 = minx < 0 ? 0 : (s32)minx;
+  y0 = miny < 0 ? 0 : (s32)miny;
+  x1 = maxx >= SOFT_WIDTH - 1 ? SOFT_WIDTH - 1 : (s32)maxx;
+  y1 = maxy >= SOFT_HEIGHT - 1 ? SOFT_HEIGHT - 1 : (s32)maxy;
+
+  // edge a->b : cross(b-a, p-a), flipped so the inside is positive
+  float sign = area > 0 ? 1.f : -1.f;
+  for (u32 e = 0; e < 3; e++)
+  {
+    u32 a = e, b = (e + 1) % 3;
+    edge[e].dx = -(sy[b] - sy[a]) * sign;
+    edge[e].dy = (sx[b] - sx[a]) * sign;
+    edge[e].c = ((sy[b] - sy[a]) * sx[a] - (sx[b] - sx[a]) * sy[a]) * sign;
+  }
+  return true;
+}
+
+static bool SoftSetupTri(SoftTri *t, const Vertex *v0, const Vertex *v1, const Vertex *v2,
+                         u32 mode, bool odd)
+{
+  const Vertex *v[3] = {v0, v1, v2};
+  const SoftMode &m = soft_modes[mode];
+  float sx[3], sy[3], iw[3];
+
+  for (u32 i = 0; i < 3; i++)
+  {
+    if (!(v[i]->z > 0.f))   // also rejects NaN
+      return false;
+    iw[i] = 1.f / v[i]->z;
+    sx[i] = v[i]->x * iw[i];
+    sy[i] = v[i]->y * iw[i];
+  }
+
+  float area = (sx[1] - sx[0]) * (sy[2] - sy[0]) - (sx[2] - sx[0]) * (sy[1] - sy[0]);
+  if (!(area != 0.f) || area != area)
+    return false;
+
+  // every other triangle of a strip has the opposite winding
+  float facing = odd ? -area : area;
+  if ((m.cull_mode == 2 && facing < 0) || (m.cull_mode == 3 && facing > 0))
+    return false;
+
+  if (!SoftSetupEdges(t->edge, t->x0, t->y0, t->x1, t->y1, sx, sy, area))
+    return false;
+
+  float inv_area = 1.f / area;
+  SoftMakePlane(&t->iw, iw[0], iw[1], iw[2], sx, sy, inv_area);
+
+  if (m.tex)
+  {
+    SoftMakePlane(&t->attr[SA_U], v0->u * iw[0], v1->u * iw[1], v2->u * iw[2], sx, sy, inv_area);
+    SoftMakePlane(&t->attr[SA_V], v0->v * iw[0], v1->v * iw[1], v2->v * iw[2], sx, sy, inv_area);
+  }
+
+  // flat shaded polys take the colour of the last vertex
+  u32 col[3];
+  col[0] = m.gouraud ? v0->col : v2->col;
+  col[1] = m.gouraud ? v1->col : v2->col;
+  col[2] = v2->col;
+
+  for (u32 c = 0; c < 4; c++)
+  {
+    u32 shift = c == 3 ? 24 : 16 - c * 8;   // R G B A
+    float f[3];
+    for (u32 i = 0; i < 3; i++)
+      f[i] = ((col[i] >> shift) & 0xFF) * iw[i];
+    SoftMakePlane(&t->attr[SA_R + c], f[0], f[1], f[2], sx, sy, inv_area);
+  }
+
+  t->mode = mode;
+  return true;
+}
+
+// Binning : count, prefix sum, fill. Triangles keep submission order in
+// every bin, which is the draw order. Returns the number of references.
+template <typename T>
+static u32 SoftBin(const T *tris, u32 count, u32 *start, Array<u32> &data)
+{
+  memset(soft_bin_cursor, 0, sizeof(soft_bin_cursor));
+  for (u32 i = 0; i < count; i++)
+  {
+    const T &t = tris[i];
+    for (s32 ty = t.y0 / SOFT_TILE; ty <= t.y1 / SOFT_TILE; ty++)
+      for (s32 tx = t.x0 / SOFT_TILE; tx <= t.x1 / SOFT_TILE; tx++)
+        soft_bin_cursor[ty * SOFT_TILES_X + tx]++;
+  }
+
+  start[0] = 0;
+  for (u32 i = 0; i < SOFT_TILE_COUNT; i++)
+  {
+    start[i + 1] = start[i] + soft_bin_cursor[i];
+    soft_bin_cursor[i] = start[i];
+  }
+
+  u32 refs = start[SOFT_TILE_COUNT];
+  if (refs > data.Size)
+    data.Resize(refs + refs / 2, false);
+
+  for (u32 i = 0; i < count; i++)
+  {
+    const T &t = tris[i];
+    for (s32 ty = t.y0 / SOFT_TILE; ty <= t.y1 / SOFT_TILE; ty++)
+      for (s32 tx = t.x0 / SOFT_TILE; tx <= t.x1 / SOFT_TILE; tx++)
+        data[soft_bin_cursor[ty * SOFT_TILES_X + tx]++] = i;
+  }
+  return refs;
+}
+
+// Opaque modifier volumes, closed ones only. Returns false when the frame
+// has nothing to modify.
+static bool SoftSetupVolumes()
+{
+  if (!TA_ModVolActive())
+    return false;
+
+  if (modTriCount > soft_vol_tris.Size)
+    soft_vol_tris.Resize(modTriCount + modTriCount / 2, false);
+  if (modParamCount > soft_volumes.Size)
+    soft_volumes.Resize(modParamCount + modParamCount / 2, false);
+
+  u32 count = 0, closed = 0;
+  u32 volume = 0;
+  soft_vol_exclude = 0;
+
+  for (u32 p = 0; p < modParamCount; p++)
+  {
+    const ModParam &mp = modParams[p];
+    if (mp.list != ListType_Opaque_Modifier_Volume)
+      continue;
+
+    for (u32 i = 0; i < mp.count; i++)
+    {
+      const ModTriangle &mt = modTris[mp.first + i];
+      SoftVolTri *t = &soft_vol_tris[count];
+      float sx[3] = {mt.x0, mt.x1, mt.x2};
+      float sy[3] = {mt.y0, mt.y1, mt.y2};
+
+      float area = (sx[1] - sx[0]) * (sy[2] - sy[0]) - (sx[2] - sx[0]) * (sy[1] - sy[0]);
+      if (!(area != 0.f) || area != area)
+        continue;
+      if (!SoftSetupEdges(t->edge, t->x0, t->y0, t->x1, t->y1, sx, sy, area))
+        continue;
+      SoftMakePlane(&t->iw, mt.z0, mt.z1, mt.z2, sx, sy, 1.f / area);
+      t->volume = volume;
+      count++;
+    }
+
+    u32 instr = mp.isp.DepthMode;
+    if (instr == 1 || instr == 2)
+    {
+      soft_volumes[volume++] = instr;
+      soft_vol_exclude += instr == 2;
+      closed = count;
+    }
+  }
+
+  // Triangles of a volume left open are dropped
+  soft_vol_tri_count = closed;
+  if (!volume)
+    return false;
+
+  // Intensity mode scales by FPU_SHAD_SCALE, parameter selection mode (the
+  // second parameter set is not decoded) is drawn at half intensity
+  soft_shadow_scale = (FPU_SHAD_SCALE & 0x100) ? FPU_SHAD_SCALE & 0xFF : 128;
+  return true;
+}
+
+// soft_modes[0] is the default state, PolyParam n is soft_modes[n + 1]
+static u32 SoftSetupSorted(u32 tri_count, u32 sort_mode)
+{
+  u32 count;
+  const SortTri *tri = TA_SortTranslucent(sort_mode, &count);
+
+  for (u32 i = 0; i < count; i++, tri++)
+  {
+    if (SoftSetupTri(&soft_tris[tri_count], &vertices[tri->v[0]], &vertices[tri->v[1]],
+                     &vertices[tri->v[2]], tri->mod + 1, false))
+      tri_count++;
+  }
+  return tri_count;
+}
+
+static void SoftSetup()
+{
+  TexCache_BeginFrame();
+
+  Vertex bg;
+  decode_pvr_background(&bg);
+  soft_bg_col = bg.col;
+
+  _ISP_BACKGND_D_type bg_d;
+  bg_d.i = ISP_BACKGND_D & ~(0xF);
+  soft_bg_depth = bg_d.f;
+  soft_pt_ref = PT_ALPHA_REF & 0xFF;
+
+  // A strip of n vertices has n-2 triangles
+  u32 max_tris = curVTX - vertices;
+  if (max_tris > soft_tris.Size)
+    soft_tris.Resize(max_tris + max_tris / 2, false);
+  u32 max_modes = (curMod - listModes) + 1;
+  if (max_modes > soft_modes.Size)
+    soft_modes.Resize(max_modes + max_modes / 2, false);
+
+  // Default state for strips submitted before any PolyParam
+  memset(&soft_modes[0], 0, sizeof(SoftMode));
+  soft_modes[0].depth_mode = 6;
+  soft_modes[0].zwrite = true;
+  soft_modes[0].gouraud = true;
+
+  u32 mode = 0;
+  u32 mode_count = 1;
+  u32 tri_count = 0;
+  Vertex *vtx = vertices;
+  PolyParam *pp = listModes;
+
+  // Autosorted translucent strips are set up in depth order once the whole
+  // list has been walked (their modes must exist by then)
+  u32 sort_mode = TA_SortMode();
+  VertexList *sort_end = TA_SortEnd(sort_mode);
+
+  soft_trans_first = ~0u;
+
+  for (VertexList *lst = lists; lst != curLST; lst++)
+  {
+    if (lst == TransLST)
+      soft_trans_first = tri_count;
+    if (lst == sort_end)
+      tri_count = SoftSetupSorted(tri_count, sort_mode);
+
+    s32 count = lst->count;
+    if (count < 0)
+    {
+      SoftBuildMode(&soft_modes[mode_count], pp++);
+      mode = mode_count++;
+      count &= 0x7FFF;
+    }
+
+    if (!(sort_end && lst >= TransLST && lst < sort_end))
+    {
+      for (s32 i = 2; i < count; i++)
+      {
+        if (SoftSetupTri(&soft_tris[tri_count], &vtx[i - 2], &vtx[i - 1], &vtx[i], mode, i & 1))
+          tri_count++;
+      }
+    }
+    vtx += count;
+  }
+  if (sort_end == curLST)
+    tri_count = SoftSetupSorted(tri_count, sort_mode);
+  soft_tri_count = tri_count;
+
+  u32 refs = SoftBin(soft_tris.data, tri_count, soft_bin_start, soft_bin_data);
+
+  soft_mv_active = SoftSetupVolumes();
+  if (soft_mv_active)
+    refs += SoftBin(soft_vol_tris.data, soft_vol_tri_count, soft_vbin_start, soft_vbin_data);
+
+  soft_stats.tris += tri_count;
+  soft_stats.bin_refs += refs;
+}
+
+// ============================
+// Rasterisation
+// ============================
+
+static INLINE u32 SoftBlendFactor(u32 instr, u32 other, u32 sa, u32 da)
+{
+  switch (instr)
+  {
+  case 0: return 0;
+  case 1: return 255;
+  case 2: return other;
+  case 3: return 255 - other;
+  case 4: return sa;
+  case 5: return 255 - sa;
+  case 6: return da;
+  default: return 255 - da;
+  }
+}
+
+static void SoftShadeSpan(SoftTileCtx *ctx, const SoftTri *t, const SoftMode &m,
+                          s32 xs, s32 xe, s32 y, s32 px0, s32 py0)
+{
+  const u32 n = xe - xs + 1;
+  const float xc0 = xs + 0.5f;
+  const float yc = y + 0.5f;
+
+  float *__restrict z = ctx->z;
+  float *__restrict rw = ctx->rw;
+  u8 *__restrict pass = ctx->pass;
+
+  // Interpolants for the whole span, plain loops so they vectorise
+  const float iw_row = t->iw.c + t->iw.dy * yc;
+  const float iw_dx = t->iw.dx;
+  for (u32 i = 0; i < n; i++)
+    z[i] = iw_row + iw_dx * (xc0 + i);
+  for (u32 i = 0; i < n; i++)
+    rw[i] = 1.f / z[i];
+
+  for (u32 k = (m.tex ? SA_U : SA_R); k < SA_COUNT; k++)
+  {
+    float *__restrict a = ctx->at[k];
+    const float row = t->attr[k].c + t->attr[k].dy * yc;
+    const float dx = t->attr[k].dx;
+    for (u32 i = 0; i < n; i++)
+      a[i] = (row + dx * (xc0 + i)) * rw[i];
+  }
+
+  const u32 offs = (y - py0) * SOFT_TILE + (xs - px0);
+  float *__restrict zbuf = &ctx->depth[offs];
+  u32 *__restrict cbuf = &ctx->col[offs];
+  u8 *__restrict sbuf = &ctx->stencil[offs];
+
+  switch (m.depth_mode)
+  {
+  case 0: for (u32 i = 0; i < n; i++) pass[i] = 0; break;
+  case 1: for (u32 i = 0; i < n; i++) pass[i] = z[i] < zbuf[i]; break;
+  case 2: for (u32 i = 0; i < n; i++) pass[i] = z[i] == zbuf[i]; break;
+  case 3: for (u32 i = 0; i < n; i++) pass[i] = z[i] <= zbuf[i]; break;
+  case 4: for (u32 i = 0; i < n; i++) pass[i] = z[i] > zbuf[i]; break;
+  case 5: for (u32 i = 0; i < n; i++) pass[i] = z[i] != zbuf[i]; break;
+  case 6: for (u32 i = 0; i < n; i++) pass[i] = z[i] >= zbuf[i]; break;
+  default: for (u32 i = 0; i < n; i++) pass[i] = 1; break;
+  }
+
+  const void *tex = m.tex;
+
+  for (u32 i = 0; i < n; i++)
+  {
+    if (!pass[i])
+      continue;
+
+    s32 r = soft_clamp255((s32)ctx->at[SA_R][i]);
+    s32 g = soft_clamp255((s32)ctx->at[SA_G][i]);
+    s32 b = soft_clamp255((s32)ctx->at[SA_B][i]);
+    s32 a = soft_clamp255((s32)ctx->at[SA_A][i]);
+
+    if (tex)
+    {
+      u32 tu = SoftTexCoord(ctx->at[SA_U][i], m.tex_w, m.clamp_u, m.flip_u);
+      u32 tv = SoftTexCoord(ctx->at[SA_V][i], m.tex_h, m.clamp_v, m.flip_v);
+      u32 ofs = tv * m.tex_w + tu;
+      u32 texel = m.pal ? m.pal[((const u8 *)tex)[ofs]] : ((const u32 *)tex)[ofs];
+
+      s32 ta = m.ignore_tex_alpha ? 255 : (texel >> 24);
+      s32 tr = (texel >> 16) & 0xFF;
+      s32 tg = (texel >> 8) & 0xFF;
+      s32 tb = texel & 0xFF;
+
+      switch (m.shad_instr)
+      {
+      case 0: // Decal
+        r = tr; g = tg; b = tb; a = ta;
+        break;
+      case 1: // Modulate
+        r = (r * tr) >> 8; g = (g * tg) >> 8; b = (b * tb) >> 8; a = ta;
+        break;
+      case 2: // Decal Alpha
+        r = (tr * ta + r * (255 - ta)) >> 8;
+        g = (tg * ta + g * (255 - ta)) >> 8;
+        b = (tb * ta + b * (255 - ta)) >> 8;
+        break;
+      default: // Modulate Alpha
+        r = (r * tr) >> 8; g = (g * tg) >> 8; b = (b * tb) >> 8; a = (a * ta) >> 8;
+        break;
+      }
+    }
+
+    if (!m.use_alpha)
+      a = 255;
+
+    if (m.alpha_test && (u32)a < soft_pt_ref)
+      continue;
+
+    if (m.blend)
+    {
+      u32 d = cbuf[i];
+      s32 da = d >> 24, dr = (d >> 16) & 0xFF, dg = (d >> 8) & 0xFF, db = d & 0xFF;
+
+      r = (r * SoftBlendFactor(m.src_instr, dr, a, da) + dr * SoftBlendFactor(m.dst_instr, r, a, da)) / 255;
+      g = (g * SoftBlendFactor(m.src_instr, dg, a, da) + dg * SoftBlendFactor(m.dst_instr, g, a, da)) / 255;
+      b = (b * SoftBlendFactor(m.src_instr, db, a, da) + db * SoftBlendFactor(m.dst_instr, b, a, da)) / 255;
+      a = (a * SoftBlendFactor(m.src_instr, da, a, da) + da * SoftBlendFactor(m.dst_instr, a, a, da)) / 255;
+
+      r = r > 255 ? 255 : r;
+      g = g > 255 ? 255 : g;
+      b = b > 255 ? 255 : b;
+      a = a > 255 ? 255 : a;
+    }
+
+    cbuf[i] = (a << 24) | (r << 16) | (g << 8) | b;
+    if (m.zwrite)
+      zbuf[i] = z[i];
+    if (!m.blend)
+      sbuf[i] = m.shadow;
+  }
+}
+
+// Solves the covered interval of pixel centres of row y, within [xmin, xmax].
+// With half_open, centres on a right or bottom edge are left out, so a centre
+// on an edge shared by two triangles is covered exactly once.
+static INLINE bool SoftSpan(const SoftPlane *edge, s32 y, s32 xmin, s32 xmax, s32 &xs, s32 &xe,
+                            bool half_open = false)
+{
+  const float yc = y + 0.5f;
+  float lo = xmin + 0.5f;
+  float hi = xmax + (half_open ? 1.f : 0.5f);
+
+  for (u32 e = 0; e < 3; e++)
+  {
+    float a = edge[e].dx;
+    float k = edge[e].c + edge[e].dy * yc;
+    if (a > 0)
+    {
+      float x = -k / a;
+      if (x > lo) lo = x;
+    }
+    else if (a < 0)
+    {
+      float x = -k / a;
+      if (x < hi) hi = x;
+    }
+    else if (k < 0 || (half_open && k == 0 && edge[e].dy < 0))
+    {
+      lo = hi + 1;
+    }
+  }
+
+  if (!(lo <= hi))
+    return false;
+
+  xs = (s32)ceilf(lo - 0.5f);
+  xe = half_open ? (s32)ceilf(hi - 0.5f) - 1 : (s32)floorf(hi - 0.5f);
+  if (xs < xmin) xs = xmin;
+  if (xe > xmax) xe = xmax;
+  return xs <= xe;
+}
+
+static void SoftDrawTri(SoftTileCtx *ctx, const SoftTri *t, s32 px0, s32 py0)
+{
+  const SoftMode &m = soft_modes[t->mode];
+
+  s32 xmin = t->x0 > px0 ? t->x0 : px0;
+  s32 xmax = t->x1 < px0 + SOFT_TILE - 1 ? t->x1 : px0 + SOFT_TILE - 1;
+  s32 ymin = t->y0 > py0 ? t->y0 : py0;
+  s32 ymax = t->y1 < py0 + SOFT_TILE - 1 ? t->y1 : py0 + SOFT_TILE - 1;
+
+  s32 xs, xe;
+  for (s32 y = ymin; y <= ymax; y++)
+  {
+    if (SoftSpan(t->edge, y, xmin, xmax, xs, xe))
+      SoftShadeSpan(ctx, t, m, xs, xe, y, px0, py0);
+  }
+}
+
+// ============================
+// Modifier volumes
+// ============================
+// Stencil style, per tile, once the opaque and punch through triangles are
+// drawn: every volume face in front of the stored depth flips the parity
+// bit, closing the volume folds the parity into the inside bit (inclusion)
+// or its complement (exclusion). Pixels whose visible surface has the shadow
+// bit and ended up inside are then darkened. Translucent volumes are not
+// applied.
+
+static void SoftVolumeTri(SoftTileCtx *ctx, const SoftVolTri *t, s32 px0, s32 py0)
+{
+  s32 xmin = t->x0 > px0 ? t->x0 : px0;
+  s32 xmax = t->x1 < px0 + SOFT_TILE - 1 ? t->x1 : px0 + SOFT_TILE - 1;
+  s32 ymin = t->y0 > py0 ? t->y0 : py0;
+  s32 ymax = t->y1 < py0 + SOFT_TILE - 1 ? t->y1 : py0 + SOFT_TILE - 1;
+
+  s32 xs, xe;
+  for (s32 y = ymin; y <= ymax; y++)
+  {
+    if (!SoftSpan(t->edge, y, xmin, xmax, xs, xe, true))
+      continue;
+
+    const u32 n = xe - xs + 1;
+    const float xc0 = xs + 0.5f;
+    const float iw_row = t->iw.c + t->iw.dy * (y + 0.5f);
+    const float iw_dx = t->iw.dx;
+    const u32 offs = (y - py0) * SOFT_TILE + (xs - px0);
+    const float *__restrict zbuf = &ctx->depth[offs];
+    u8 *__restrict sbuf = &ctx->stencil[offs];
+
+    for (u32 i = 0; i < n; i++)
+      sbuf[i] ^= (iw_row + iw_dx * (xc0 + i) > zbuf[i]) ? SOFT_ST_PARITY : 0;
+  }
+}
+
+// Returns 1 for an exclusion volume
+static INLINE u32 SoftCloseVolume(u8 *__restrict st, u32 instr)
+{
+  u8 want = instr == 1 ? SOFT_ST_PARITY : 0;
+  for (u32 i = 0; i < SOFT_TILE * SOFT_TILE; i++)
+  {
+    u8 s = st[i];
+    if ((s & SOFT_ST_PARITY) == want)
+      s |= SOFT_ST_INSIDE;
+    st[i] = s & ~SOFT_ST_PARITY;
+  }
+  return instr == 2;
+}
+
+static void SoftApplyVolumes(SoftTileCtx *ctx, u32 tile, s32 px0, s32 py0)
+{
+  u8 *st = ctx->stencil;
+  u32 seen_exclude = 0;
+  u32 volume = ~0u;
+
+  for (u32 b = soft_vbin_start[tile]; b < soft_vbin_start[tile + 1]; b++)
+  {
+    const SoftVolTri *t = &soft_vol_tris[soft_vbin_data[b]];
+    if (t->volume != volume)
+    {
+      if (volume != ~0u)
+        seen_exclude += SoftCloseVolume(st, soft_volumes[volume]);
+      volume = t->volume;
+    }
+    SoftVolumeTri(ctx, t, px0, py0);
+  }
+  if (volume != ~0u)
+    seen_exclude += SoftCloseVolume(st, soft_volumes[volume]);
+
+  // The whole tile is outside the exclusion volumes that do not reach it
+  if (seen_exclude < soft_vol_exclude)
+  {
+    for (u32 i = 0; i < SOFT_TILE * SOFT_TILE; i++)
+      st[i] |= SOFT_ST_INSIDE;
+  }
+
+  const u32 scale = soft_shadow_scale;
+  for (u32 i = 0; i < SOFT_TILE * SOFT_TILE; i++)
+  {
+    if ((st[i] & (SOFT_ST_SHADOW | SOFT_ST_INSIDE)) != (SOFT_ST_SHADOW | SOFT_ST_INSIDE))
+      continue;
+    u32 c = ctx->col[i];
+    u32 rb = (((c & 0xFF00FF) * scale) >> 8) & 0xFF00FF;
+    u32 g = (((c & 0xFF00) * scale) >> 8) & 0xFF00;
+    ctx->col[i] = (c & 0xFF000000) | rb | g;
+  }
+}
+
+static void SoftRenderTile(SoftTileCtx *ctx, u32 tile)
+{
+  s32 px0 = (tile % SOFT_TILES_X) * SOFT_TILE;
+  s32 py0 = (tile / SOFT_TILES_X) * SOFT_TILE;
+
+  for (u32 i = 0; i < SOFT_TILE * SOFT_TILE; i++)
+  {
+    ctx->col[i] = soft_bg_col;
+    ctx->depth[i] = soft_bg_depth;
+  }
+
+  u32 b = soft_bin_start[tile];
+  u32 end = soft_bin_start[tile + 1];
+
+  if (soft_mv_active)
+  {
+    memset(ctx->stencil, 0, sizeof(ctx->stencil));
+    for (; b < end && soft_bin_data[b] < soft_trans_first; b++)
+      SoftDrawTri(ctx, &soft_tris[soft_bin_data[b]], px0, py0);
+    SoftApplyVolumes(ctx, tile, px0, py0);
+  }
+
+  for (; b < end; b++)
+    SoftDrawTri(ctx, &soft_tris[soft_bin_data[b]], px0, py0);
+
+  for (u32 y = 0; y < SOFT_TILE; y++)
+    memcpy(&soft_target[(py0 + y) * SOFT_WIDTH + px0], &ctx->col[y * SOFT_TILE], SOFT_TILE * 4);
+}
+
+// ============================
+// Worker pool
+// ============================
+// The emulation thread renders tiles too, the workers only help it. A frame
+// is started by bumping soft_pool_frame; everyone then pulls tile indices off
+// soft_next_tile until they run out.
+
+static SoftTileCtx soft_ctx[SOFT_MAX_THREADS];
+static pthread_t soft_threads[SOFT_MAX_THREADS];
+static u32 soft_thread_count;              // workers, not counting the caller
+static pthread_mutex_t soft_pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t soft_pool_start = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t soft_pool_done = PTHREAD_COND_INITIALIZER;
+static u32 soft_pool_frame;
+static u32 soft_pool_busy;
+static bool soft_pool_quit;
+static volatile u32 soft_next_tile;
+
+static void SoftWorkTiles(SoftTileCtx *ctx)
+{
+  for (;;)
+  {
+    u32 tile = __sync_fetch_and_add(&soft_next_tile, 1);
+    if (tile >= SOFT_TILE_COUNT)
+      break;
+    SoftRenderTile(ctx, tile);
+  }
+}
+
+static void *SoftWorker(void *param)
+{
+  SoftTileCtx *ctx = (SoftTileCtx *)param;
+  u32 seen = 0;
+
+  pthread_mutex_lock(&soft_pool_lock);
+  for (;;)
+  {
+    while (seen == soft_pool_frame && !soft_pool_quit)
+      pthread_cond_wait(&soft_pool_start, &soft_pool_lock);
+    if (soft_pool_quit)
+      break;
+    seen = soft_pool_frame;
+    pthread_mutex_unlock(&soft_pool_lock);
+
+    SoftWorkTiles(ctx);
+
+    pthread_mutex_lock(&soft_pool_lock);
+    if (--soft_pool_busy == 0)
+      pthread_cond_signal(&soft_pool_done);
+  }
+  pthread_mutex_unlock(&soft_pool_lock);
+  return 0;
+}
+
+static void SoftPoolStart()
+{
+  u32 threads = settings.SoftRend.Threads;
+  if (threads == 0)
+  {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = cpus > 0 ? (u32)cpus : 1;
+  }
+  if (threads > SOFT_MAX_THREADS)
+    threads = SOFT_MAX_THREADS;
+
+  soft_pool_quit = false;
+  soft_thread_count = 0;
+  for (u32 i = 1; i < threads; i++)
+  {
+    if (pthread_create(&soft_threads[soft_thread_count], 0, SoftWorker, &soft_ctx[i]) != 0)
+      break;
+    soft_thread_count++;
+  }
+
+  printf("softRend: %u raster threads\n", soft_thread_count + 1);
+}
+
+static void SoftPoolStop()
+{
+  pthread_mutex_lock(&soft_pool_lock);
+  soft_pool_quit = true;
+  pthread_cond_broadcast(&soft_pool_start);
+  pthread_mutex_unlock(&soft_pool_lock);
+
+  for (u32 i = 0; i < soft_thread_count; i++)
+    pthread_join(soft_threads[i], 0);
+  soft_thread_count = 0;
+}
+
+static void SoftRaster()
+{
+  soft_next_tile = 0;
+
+  pthread_mutex_lock(&soft_pool_lock);
+  soft_pool_busy = soft_thread_count;
+  soft_pool_frame++;
+  pthread_cond_broadcast(&soft_pool_start);
+  pthread_mutex_unlock(&soft_pool_lock);
+
+  SoftWorkTiles(&soft_ctx[0]);
+
+  pthread_mutex_lock(&soft_pool_lock);
+  while (soft_pool_busy)
+    pthread_cond_wait(&soft_pool_done, &soft_pool_lock);
+  pthread_mutex_unlock(&soft_pool_lock);
+}
+
+// ============================
+// 2D framebuffer
+// ============================
+
+// Copies the displayed framebuffer (FB_R_SOF1, 32 bit VRAM view)
+static void SoftPresentFb()
+{
+  // It may have been rendered to
+  TexCache_ReadbackRender(0, VRAM_SIZE - 1);
+
+  u32 base = FB_R_SOF1 & 0x00FFFFFF;
+  u32 line_words = (FB_R_SIZE & 0x3FF) + 1;
+  u32 lines = ((FB_R_SIZE >> 10) & 0x3FF) + 1;
+  u32 modulus = (FB_R_SIZE >> 20) & 0x3FF;
+  u32 stride = (line_words + modulus - 1) * 4;
+  u32 depth = FB_R_CTRL.fb_depth;
+  u32 bpp = depth == 2 ? 3 : (depth == 3 ? 4 : 2);
+
+  u32 width = line_words * 4 / bpp;
+  if (width > SOFT_WIDTH) width = SOFT_WIDTH;
+  if (lines > SOFT_HEIGHT) lines = SOFT_HEIGHT;
+
+  memset(soft_frame, 0, sizeof(soft_frame));
+
+  for (u32 y = 0; y < lines; y++)
+  {
+    u32 *dst = &soft_frame[y * SOFT_WIDTH];
+    u32 line = base + y * stride;
+
+    for (u32 x = 0; x < width; x++)
+    {
+      u32 offs = line + x * bpp;
+      u32 c;
+      if (bpp == 2)
+      {
+        u32 w = vri(offs & ~3);
+        c = (offs & 2) ? (w >> 16) : (w & 0xFFFF);
+        c = depth == 1 ? ARGB565(c) : (ARGB1555(c) | 0xFF000000);
+      }
+      else if (bpp == 4)
+      {
+        c = vri(offs) | 0xFF000000;
+      }
+      else
+      {
+        c = 0xFF000000;
+        for (u32 i = 0; i < 3; i++)
+          c |= ((vri((offs + i) & ~3) >> (((offs + i) & 3) * 8)) & 0xFF) << (i * 8);
+      }
+      dst[x] = c;
+    }
+  }
+}
+
+// ============================
+// Render to texture
+// ============================
+// Rendered off screen and kept as ARGB8888 (TexCache.h). Textures are always
+// decoded from VRAM here, so sampling a render target writes it back.
+
+static void SoftRenderToTexture()
+{
+  soft_target = soft_rtt_frame;
+  SoftSetup();
+  SoftRaster();
+  soft_target = soft_frame;
+
+  TexCacheRTT *rt = TexCache_BeginRTT(SOFT_WIDTH, SOFT_HEIGHT, 4);
+  if (!rt)
+    return;
+
+  u32 *dst = (u32 *)rt->data;
+  for (u32 y = 0; y < rt->height; y++)
+    memcpy(&dst[y * rt->width], &soft_rtt_frame[y * SOFT_WIDTH], rt->width * 4);
+
+  TexCache_EndRTT(rt);
+}
+
+static void SoftReadback(TexCacheRTT *rt)
+{
+  const u32 *src = (const u32 *)rt->data;
+  for (u32 y = 0; y < rt->height; y++)
+    TexCache_PackRTTLine(rt, y, &src[y * rt->width]);
+}
+
+// ============================
+// Renderer interface
+// ============================
+
+void VBlank() {}
+
+void StartRender()
+{
+  u32 VtxCnt = curVTX - vertices;
+  VertexCount += VtxCnt;
+
+  double t0 = os_GetSeconds();
+
+  // Geometry rendered to the texture area is a render to texture,
+  // nothing to display
+  if ((FB_W_SOF1 & 0x1000000) && VtxCnt)
+  {
+    SoftRenderToTexture();
+    soft_stats.raster_time += os_GetSeconds() - t0;
+    reset_vtx_state();
+    return;
+  }
+
+  if (FB_W_SOF1 & 0x1000000)
+  {
+    SoftPresentFb();
+    soft_stats.setup_time += os_GetSeconds() - t0;
+  }
+  else
+  {
+    SoftSetup();
+    double t1 = os_GetSeconds();
+    SoftRaster();
+    soft_stats.setup_time += t1 - t0;
+    soft_stats.raster_time += os_GetSeconds() - t1;
+  }
+
+  reset_vtx_state();
+  soft_stats.frames++;
+  FrameCount++;
+
+  if (settings.SoftRend.DumpFrames && (FrameCount % settings.SoftRend.DumpFrames) == 0)
+  {
+    char name[32];
+    sprintf(name, "soft_%05u.ppm", FrameCount);
+    char *path = GetEmuPath("data/");
+    strcat(path, name);
+    SoftRend_SaveFrame(path);
+    free(path);
+  }
+}
+
+void EndRender() {}
+
+void SetFpsText(char *text)
+{
+  strcpy(fps_text, text);
+  printf("%s", text);
+
+  if (soft_stats.frames)
+  {
+    double frames = soft_stats.frames;
+    printf("softRend: %.0f tris/frame, %.0f tile refs/frame, "
+           "setup %.2f ms, raster %.2f ms (%u threads)\n",
+           soft_stats.tris / frames, soft_stats.bin_refs / frames,
+           soft_stats.setup_time * 1000 / frames, soft_stats.raster_time * 1000 / frames,
+           soft_thread_count + 1);
+    TexCache_PrintStats();
+  }
+  memset(&soft_stats, 0, sizeof(soft_stats));
+
+  if (ta_sort_stats.frames)
+    printf("autosort: %.0f tris, %.3f ms per frame\n",
+           (double)ta_sort_stats.tris / ta_sort_stats.frames, ta_sort_stats.time * 1000 / ta_sort_stats.frames);
+  memset(&ta_sort_stats, 0, sizeof(ta_sort_stats));
+
+  TA_ArenaPrintStats();
+}
+
+const u32 *SoftRend_GetFrame(u32 *width, u32 *height)
+{
+  *width = SOFT_WIDTH;
+  *height = SOFT_HEIGHT;
+  return soft_frame;
+}
+
+bool SoftRend_SaveFrame(const char *path)
+{
+  FILE *f = fopen(path, "wb");
+  if (!f)
+  {
+    printf("softRend: unable to open %s\n", path);
+    return false;
+  }
+
+  fprintf(f, "P6\n%d %d\n255\n", SOFT_WIDTH, SOFT_HEIGHT);
+
+  u8 line[SOFT_WIDTH * 3];
+  for (u32 y = 0; y < SOFT_HEIGHT; y++)
+  {
+    const u32 *src = &soft_frame[y * SOFT_WIDTH];
+    for (u32 x = 0; x < SOFT_WIDTH; x++)
+    {
+      line[x * 3 + 0] = src[x] >> 16;
+      line[x * 3 + 1] = src[x] >> 8;
+      line[x * 3 + 2] = src[x];
+    }
+    fwrite(line, 1, sizeof(line), f);
+  }
+
+  fclose(f);
+  return true;
+}
+
+bool InitRenderer()
+{
+  soft_tex_raw.Resize(1024 * 1024, false);
+  soft_bin_data.Resize(64 * 1024, false);
+  memset(soft_frame, 0, sizeof(soft_frame));
+  memset(&soft_stats, 0, sizeof(soft_stats));
+
+  TexCache_Init(0, 0, settings.TexCache.BudgetMB * 1024 * 1024, SoftReadback);
+  SoftPoolStart();
+  return TileAccel_Init();
+}
+
+void TermRenderer()
+{
+  SoftPoolStop();
+  TileAccel_Term();
+  TexCache_Term();
+
+  soft_tex_raw.Free();
+  soft_bin_data.Free();
+}
+
+void ResetRenderer(bool Manual)
+{
+  TileAccel_Reset(Manual);
+  TexCache_Clear();
+  VertexCount = 0;
+  FrameCount = 0;
+}
+
+bool ThreadStart()
+{
+  return true;
+}
+
+void ThreadEnd()
+{
+}
+
+void ListCont()
+{
+  TileAccel_ListCont();
+}
+
+void ListInit()
+{
+  TileAccel_ListInit();
+}
+
+void SoftReset()
+{
+  TileAccel_SoftReset();
+}
+
+void VramLockedWrite(vram_block *bl)
+{
+}
+
+#endif // REND_API == REND_SOFT
@@ -5,4 +5,10 @@ bool spg_Init();
 void spg_Term();
 void spg_Reset(bool Manual);
 void CalculateSync();
+
+// Brings SPG_STATUS (scanline, vsync) up to date, before it is read
+void spg_UpdateStatus();
+
+// Frames to skip in a row, adapted at vblank (Emulation.FrameSkip, see ta_vtx.h)
+extern u32 spg_FrameSkip;
 void FASTCALL libPvr_UpdatePvr(u32 cycles);
\ No newline at end of file
@@ -1,4 +1,16 @@
 #include "ta.h"
+#include "ta_vtx.h"
+#include "ta_capture.h"
+#include "regs.h"
+#include "TexCache.h"
+#include "Renderer_if.h"
+#include <malloc.h>
+
+#if HOST_OS == OS_WII
+#include <gccore.h>
+#else
+#include <pthread.h>
+#endif
 
 // Tile Accelerator (TA) state machine for PowerVR2 (Dreamcast) emulation
 // Handles DMA and Store Queue writes, dispatches polygon/vertex/control params
@@ -7,16 +19,551 @@ namespace TASplitter
 {
     // Current active command handler (state machine pointer)
     TaListFP* TaCmd = nullptr;
+
+    // Filled by the splitters built with TA_FEAT_STATS
+    TaParseStats ta_parse_stats;
 }
 
 using namespace TASplitter;
 
+// Threaded TA
+// With Emulation.ThreadedTA set, parsing and drawing move to a render thread.
+// The SH4 thread copies TA packets and control register writes (list init,
+// list continue, soft reset, start render) into a single producer / single
+// consumer ring, and the render thread runs them through TaCmd and the
+// backend in the same order. The ring itself takes no lock; the mutex and
+// condition variables are only used to put an idle side to sleep.
+//
+// The two sides meet only at frame boundaries:
+//  - STARTRENDER is queued and the SH4 carries on. render_end_pending_cycles
+//    is estimated from the packets queued for the frame, as the vertex count
+//    is not known yet.
+//  - When the render end interrupt is due, the SH4 waits for that frame to
+//    be drawn (TA_WaitRender).
+//  - The SH4 keeps running while a frame is drawn, and may write registers
+//    and palette RAM for the next one. Writes to those the renderer reads
+//    (FB_W_*, FB_X/Y_CLIP, ISP_*, FPU_SHAD_SCALE, TEXT_CONTROL, PAL_RAM_CTRL,
+//    PT_ALPHA_REF, PARAM_BASE, palette RAM, and FB_R_SOF1/2, FB_R_SIZE,
+//    FB_R_CTRL and SPG_CONTROL for the 2D framebuffer path) wait for the
+//    frames queued to be drawn first (regs.cpp), so a frame is drawn with
+//    the values it had at STARTRENDER. Fog is not drawn, its registers are
+//    not waited on.
+//  - VRAM is shared as on the hardware: textures written by the SH4 while a
+//    frame samples them race there too. The render thread never writes VRAM:
+//    render targets reach it on the SH4 thread only, when a STARTRENDER is
+//    queued (once the frames before it are drawn, so the frame can sample
+//    or display them), and on VRAM reads after a sync (libPvr_VramRead).
+//  - List end interrupts are counted by the render thread and raised from
+//    the SH4 thread by TA_Update.
+//  - Reset and shutdown drain the ring first (TA_ThreadSync).
+//
+// The ring is made of 32 byte slots. Every entry starts with a header slot
+// (TaRingHeader) followed by 'count' packets; an entry never wraps, the tail
+// of the ring is skipped with a TA_RING_WRAP header instead.
+#define TA_RING_SIZE        8192                // in 32 byte slots, power of 2 (256 KB)
+#define TA_RING_MASK        (TA_RING_SIZE - 1)
+#define TA_RING_CHUNK       2048                // max packets per entry, <= TA_RING_SIZE/2 - 1
+#define TA_THREAD_STACK     (256 * 1024)
+#define TA_THREAD_PRIORITY  70                  // above the emulation thread (64)
+
+#define TA_RING_DATA 0
+#define TA_RING_CTRL 1
+#define TA_RING_WRAP 2
+
+struct TaRingHeader
+{
+    u32 type;       // TA_RING_*
+    u32 count;      // TA_RING_DATA: packets following the header
+    u32 ctrl;       // TA_RING_CTRL: TA_CTRL_*
+    u32 fb_w_sof1;  // TA_RING_CTRL: FB_W_SOF1 when it was written
+};
+
+static Ta_Dma* ta_ring = 0;
+static volatile u32 ta_ring_write = 0;      // written by the SH4 thread only
+static volatile u32 ta_ring_read = 0;       // written by the render thread only, after an entry is done
+static volatile u32 ta_frames_queued = 0;   // STARTRENDERs queued
+static volatile u32 ta_frames_done = 0;     // STARTRENDERs drawn
+static volatile u32 ta_irq_posted[5];       // list end interrupts, per list type
+static u32 ta_irq_raised[5];
+static u32 ta_frame_packets = 0;            // packets queued since the last STARTRENDER
+
+static bool ta_thread_active = false;
+static volatile bool ta_thread_run = false;
+static volatile bool ta_rend_waiting = false;   // render thread asleep on ta_cond_data
+static volatile bool ta_sh4_waiting = false;    // SH4 thread asleep on ta_cond_progress
+
+#if HOST_OS == OS_WII
+static lwp_t ta_thread;
+static mutex_t ta_lock;
+static cond_t ta_cond_data;
+static cond_t ta_cond_progress;
+
+#define ta_mutex_lock()     LWP_MutexLock(ta_lock)
+#define ta_mutex_unlock()   LWP_MutexUnlock(ta_lock)
+#define ta_cond_wait(c)     LWP_CondWait(c, ta_lock)
+#define ta_cond_signal(c)   LWP_CondSignal(c)
+#else
+static pthread_t ta_thread;
+static pthread_mutex_t ta_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ta_cond_data = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t ta_cond_progress = PTHREAD_COND_INITIALIZER;
+
+#define ta_mutex_lock()     pthread_mutex_lock(&ta_lock)
+#define ta_mutex_unlock()   pthread_mutex_unlock(&ta_lock)
+#define ta_cond_wait(c)     pthread_cond_wait(&c, &ta_lock)
+#define ta_cond_signal(c)   pthread_cond_signal(&c)
+#endif
+
+static void TaSQ_Reset();
+
+// Runs 'count' packets through the state machine, on the thread that parses
+static void TaRun_Data(Ta_Dma* ta_data, u32 count)
+{
+    Ta_Dma* ta_data_end = ta_data + count - 1;
+    do
+    {
+        ta_parse_stats.entries++;
+        ta_data = TASplitter::TaCmd(ta_data, ta_data_end);
+    }
+    while (ta_data <= ta_data_end);
+}
+
+// Runs a control register write on the current thread. 'fb_w_sof1' is the
+// FB_W_SOF1 the SH4 had at the write, for the frame skip decision.
+static void TaRun_Control(u32 ctrl, u32 fb_w_sof1)
+{
+    switch (ctrl)
+    {
+        case TASplitter::TA_CTRL_LIST_INIT:
+            ta_list_fb_w_sof1 = fb_w_sof1;
+            rend_list_init();
+            break;
+        case TASplitter::TA_CTRL_LIST_CONT:    rend_list_cont(); break;
+        case TASplitter::TA_CTRL_SOFT_RESET:   rend_list_srst(); break;
+        case TASplitter::TA_CTRL_START_RENDER:
+            if (TileAccel_StartRender())
+                rend_start_render();
+            break;
+    }
+}
+
+// SH4 side: sleep until the render thread retires an entry or a frame.
+// The waiting flag is set before the last check and read by the render thread
+// after it publishes, so one of the two always sees the other.
+static void TaRing_WaitProgress()
+{
+    u32 read = ta_ring_read;
+    u32 done = ta_frames_done;
+
+    ta_mutex_lock();
+    ta_sh4_waiting = true;
+    ta_barrier();
+    while (ta_ring_read == read && ta_frames_done == done && ta_thread_run)
+        ta_cond_wait(ta_cond_progress);
+    ta_sh4_waiting = false;
+    ta_mutex_unlock();
+}
+
+static void TaRing_WaitSpace(u32 slots)
+{
+    while (TA_RING_SIZE - (ta_ring_write - ta_ring_read) < slots)
+        TaRing_WaitProgress();
+}
+
+static void TaRing_Publish(u32 write)
+{
+    ta_barrier();
+    ta_ring_write = write;
+    ta_barrier();
+    if (ta_rend_waiting)
+    {
+        ta_mutex_lock();
+        ta_cond_signal(ta_cond_data);
+        ta_mutex_unlock();
+    }
+}
+
+// Returns room for 'slots' contiguous slots at ta_ring_write
+static TaRingHeader* TaRing_Reserve(u32 slots)
+{
+    u32 tail = TA_RING_SIZE - (ta_ring_write & TA_RING_MASK);
+    if (tail < slots)
+    {
+        TaRing_WaitSpace(tail);
+        ((TaRingHeader*)&ta_ring[ta_ring_write & TA_RING_MASK])->type = TA_RING_WRAP;
+        TaRing_Publish(ta_ring_write + tail);
+    }
+    TaRing_WaitSpace(slots);
+    return (TaRingHeader*)&ta_ring[ta_ring_write & TA_RING_MASK];
+}
+
+static void TaRing_PushData(Ta_Dma* data, u32 count)
+{
+    ta_frame_packets += count;
+
+    while (count)
+    {
+        u32 chunk = count < TA_RING_CHUNK ? count : TA_RING_CHUNK;
+
+        TaRingHeader* hdr = TaRing_Reserve(chunk + 1);
+        hdr->type  = TA_RING_DATA;
+        hdr->count = chunk;
+        memcpy((Ta_Dma*)hdr + 1, data, chunk * sizeof(Ta_Dma));
+        TaRing_Publish(ta_ring_write + chunk + 1);
+
+        data  += chunk;
+        count -= chunk;
+    }
+}
+
+static void TaRing_PushControl(u32 ctrl)
+{
+    TaRingHeader* hdr = TaRing_Reserve(1);
+    hdr->type = TA_RING_CTRL;
+    hdr->ctrl = ctrl;
+    hdr->fb_w_sof1 = FB_W_SOF1;
+    TaRing_Publish(ta_ring_write + 1);
+}
+
+// Render thread: parse and draw everything queued, in order
+static void* TaThread_Main(void* arg)
+{
+    for (;;)
+    {
+        if (ta_ring_read == ta_ring_write)
+        {
+            ta_mutex_lock();
+            ta_rend_waiting = true;
+            ta_barrier();
+            while (ta_ring_read == ta_ring_write && ta_thread_run)
+                ta_cond_wait(ta_cond_data);
+            ta_rend_waiting = false;
+            ta_mutex_unlock();
+
+            if (ta_ring_read == ta_ring_write)
+                break;  // stopped, and nothing left to do
+        }
+        ta_barrier();
+
+        u32 read = ta_ring_read;
+        TaRingHeader* hdr = (TaRingHeader*)&ta_ring[read & TA_RING_MASK];
+
+        switch (hdr->type)
+        {
+            case TA_RING_DATA:
+                TaRun_Data((Ta_Dma*)hdr + 1, hdr->count);
+                read += hdr->count + 1;
+                break;
+
+            case TA_RING_CTRL:
+                TaRun_Control(hdr->ctrl, hdr->fb_w_sof1);
+                if (hdr->ctrl == TASplitter::TA_CTRL_START_RENDER)
+                    ta_frames_done++;
+                read += 1;
+                break;
+
+            case TA_RING_WRAP:
+                read += TA_RING_SIZE - (read & TA_RING_MASK);
+                break;
+        }
+
+        ta_barrier();
+        ta_ring_read = read;
+        ta_barrier();
+        if (ta_sh4_waiting)
+        {
+            ta_mutex_lock();
+            ta_cond_signal(ta_cond_progress);
+            ta_mutex_unlock();
+        }
+    }
+    return 0;
+}
+
+namespace TASplitter
+{
+    bool TA_ThreadStart()
+    {
+        if (!settings.Emulation.ThreadedTA)
+            return true;
+
+        ta_ring = (Ta_Dma*)memalign(32, TA_RING_SIZE * sizeof(Ta_Dma));
+        if (!ta_ring)
+        {
+            printf("drkpvr: no memory for the TA ring, running the TA inline\n");
+            return true;
+        }
+
+        ta_ring_write = ta_ring_read = 0;
+        ta_frames_queued = ta_frames_done = 0;
+        memset((void*)ta_irq_posted, 0, sizeof(ta_irq_posted));
+        memset(ta_irq_raised, 0, sizeof(ta_irq_raised));
+        ta_frame_packets = 0;
+        ta_thread_run = true;
+
+#if HOST_OS == OS_WII
+        LWP_MutexInit(&ta_lock, false);
+        LWP_CondInit(&ta_cond_data);
+        LWP_CondInit(&ta_cond_progress);
+        bool started = LWP_CreateThread(&ta_thread, TaThread_Main, NULL, NULL, TA_THREAD_STACK, TA_THREAD_PRIORITY) >= 0;
+#else
+        bool started = pthread_create(&ta_thread, 0, TaThread_Main, 0) == 0;
+#endif
+        if (!started)
+        {
+            printf("drkpvr: failed to start the TA thread, running the TA inline\n");
+            ta_thread_run = false;
+            free(ta_ring);
+            ta_ring = 0;
+            return true;
+        }
+
+        ta_thread_active = true;
+        printf("drkpvr: TA parsing and rendering on a separate thread\n");
+        return true;
+    }
+
+    void TA_ThreadStop()
+    {
+        if (!ta_thread_active)
+            return;
+
+        TA_ThreadSync();
+
+        ta_mutex_lock();
+        ta_thread_run = false;
+        ta_cond_signal(ta_cond_data);
+        ta_mutex_unlock();
+
+#if HOST_OS == OS_WII
+        LWP_JoinThread(ta_thread, NULL);
+        LWP_CondDestroy(ta_cond_data);
+        LWP_CondDestroy(ta_cond_progress);
+        LWP_MutexDestroy(ta_lock);
+#else
+        pthread_join(ta_thread, 0);
+#endif
+        ta_thread_active = false;
+        TA_Update();
+
+        free(ta_ring);
+        ta_ring = 0;
+    }
+
+    bool TA_ThreadActive()
+    {
+        return ta_thread_active;
+    }
+
+    void TA_ThreadSync()
+    {
+        if (!ta_thread_active)
+            return;
+
+        while (ta_ring_read != ta_ring_write)
+            TaRing_WaitProgress();
+        ta_barrier();
+    }
+
+    void TA_Control(u32 ctrl)
+    {
+        if (ta_capture_active)
+            TaCapture_Control(ctrl);
+
+        if (ctrl == TA_CTRL_START_RENDER)
+        {
+            // The vertex count is only known once the frame is parsed, the
+            // threaded TA uses the packet count (one vertex is one or two)
+            u32 cost = ta_thread_active ? ta_frame_packets : (u32)(curVTX - vertices);
+            ta_frame_packets = 0;
+
+            render_end_pending_cycles = cost * 15;
+            if (render_end_pending_cycles < 50000)
+                render_end_pending_cycles = 50000;
+        }
+
+        // ta_main starts over from a PCW
+        if (ctrl == TA_CTRL_LIST_INIT || ctrl == TA_CTRL_SOFT_RESET)
+            TaSQ_Reset();
+
+        // Render targets to VRAM, the render thread does not write it. The
+        // frames before are normally drawn already (their render end waited).
+        if (ctrl == TA_CTRL_START_RENDER && ta_thread_active)
+        {
+            TA_WaitRender();
+            TexCache_Readback(0, VRAM_SIZE - 1);
+        }
+
+        if (!ta_thread_active)
+        {
+            TaRun_Control(ctrl, FB_W_SOF1);
+            return;
+        }
+
+        TaRing_PushControl(ctrl);
+        if (ctrl == TA_CTRL_START_RENDER)
+            ta_frames_queued++;
+    }
+
+    void TA_WaitRender()
+    {
+        if (!ta_thread_active)
+            return;
+
+        while (ta_frames_done != ta_frames_queued)
+            TaRing_WaitProgress();
+        ta_barrier();
+        TA_Update();
+    }
+
+    void TA_Update()
+    {
+        if (!ta_ring)
+            return;
+
+        for (u32 i = 0; i < 5; i++)
+        {
+            u32 posted = ta_irq_posted[i];
+            if (posted != ta_irq_raised[i])
+            {
+                ta_irq_raised[i] = posted;
+                params.RaiseInterrupt(ListEndInterrupt[i]);
+            }
+        }
+    }
+
+    void TA_ListEnd(u32 list)
+    {
+        if (!ta_thread_active)
+        {
+            params.RaiseInterrupt(ListEndInterrupt[list]);
+            return;
+        }
+
+        // Render thread: the SH4 thread raises it (TA_Update)
+        if (list < 5)
+            ta_irq_posted[list]++;
+    }
+}
+
+// Store Queue batching
+// Games push most of their geometry through SQ prefs, 32 bytes at a time.
+// Feeding each one to TaCmd on its own means one state machine entry per
+// packet, and ta_poly_data never gets to loop over a strip. SQ packets are
+// instead collected here and handed to TaCmd in bulk, exactly like a DMA.
+// The batch is drained:
+//  - on an End Of List control param, so list end interrupts are not delayed
+//  - when it is full
+//  - before a DMA submission, so DMA and SQ data stay in order
+//  - before any PVR register write (list init, start render, soft reset ...)
+//  - at vblank
+// The second half of a 64 byte param or vertex holds arbitrary data, so the
+// End Of List check follows the packet sizes the way ta_main does (TaSQ_Step)
+// and only reads the PCW of packets that start a param or vertex. DMA data is
+// stepped through too, the two paths share the stream.
+// ta_parse_stats.entries counts the resulting state machine entries.
+#define TA_SQ_BATCH_SIZE 256   // in 32 byte packets, 8 KB
+
+ALIGN(32) static Ta_Dma ta_sq_batch[TA_SQ_BATCH_SIZE];
+static u32    ta_sq_batch_count = 0;
+
+// Position in the TA stream, as seen by ta_main
+static u32 ta_sq_cont = 0;                  // 32 byte halves left of the current param/vertex
+static u32 ta_sq_list = ListType_None;      // open list
+static u32 ta_sq_vtx_size = SZ32;           // vertex size set by the last param
+
+static void TaSQ_Reset()
+{
+    ta_sq_cont = 0;
+    ta_sq_list = ListType_None;
+    ta_sq_vtx_size = SZ32;
+}
+
+// Steps over one 32 byte packet, true if it is an End Of List control param
+static bool TaSQ_Step(const Ta_Dma* pkt)
+{
+    if (ta_sq_cont)
+    {
+        ta_sq_cont--;
+        return false;
+    }
+
+    PCW pcw = pkt->pcw;
+    u32 size = SZ32;
+
+    switch (pcw.ParaType)
+    {
+        case ParamType_End_Of_List:
+            ta_sq_list = ListType_None;
+            return true;
+
+        case ParamType_Polygon_or_Modifier_Volume:
+            if (ta_sq_list == ListType_None)
+                ta_sq_list = pcw.ListType;
+            if (IsModVolList(ta_sq_list))
+                ta_sq_vtx_size = SZ64;
+            else
+            {
+                // Polygon types 2 and 4 are 64 bytes, vertex types 5, 6, 11-14 too
+                if (pcw.Col_Type == 2 && (pcw.Volume || (pcw.Texture && pcw.Offset)))
+                    size = SZ64;
+                ta_sq_vtx_size = pcw.Texture && (pcw.Volume || pcw.Col_Type == 1) ? SZ64 : SZ32;
+            }
+            break;
+
+        case ParamType_Sprite:
+            if (ta_sq_list == ListType_None)
+                ta_sq_list = pcw.ListType;
+            ta_sq_vtx_size = SZ64;
+            break;
+
+        case ParamType_Vertex_Parameter:
+            size = ta_sq_vtx_size;
+            break;
+    }
+
+    ta_sq_cont = size - 1;
+    return false;
+}
+
+namespace TASplitter
+{
+    void TA_SQFlush()
+    {
+        if (ta_sq_batch_count == 0)
+            return;
+
+        verify(TaCmd != nullptr);
+
+        if (ta_capture_active)
+            TaCapture_Data(ta_sq_batch, ta_sq_batch_count);
+
+        u32 count = ta_sq_batch_count;
+        ta_sq_batch_count = 0;
+
+        if (ta_thread_active)
+            TaRing_PushData(ta_sq_batch, count);
+        else
+            TaRun_Data(ta_sq_batch, count);
+    }
+
+    void TA_SQDiscard()
+    {
+        ta_sq_batch_count = 0;
+        TaSQ_Reset();
+    }
+}
+
 // Store Queue path: single 32-byte write (e.g. via SQ registers)
 void libPvr_TaSQ(u32* data)
 {
-    verify(TaCmd != nullptr);
-    Ta_Dma* t = (Ta_Dma*)data;
-    TaCmd(t, t);
+    u32* dst = (u32*)&ta_sq_batch[ta_sq_batch_count++];
+
+    dst[0] = data[0]; dst[1] = data[1]; dst[2] = data[2]; dst[3] = data[3];
+    dst[4] = data[4]; dst[5] = data[5]; dst[6] = data[6]; dst[7] = data[7];
+
+    if (TaSQ_Step((Ta_Dma*)dst) || ta_sq_batch_count == TA_SQ_BATCH_SIZE)
+        TA_SQFlush();
 }
 
 // DMA path: process a contiguous block of 32-byte TA entries
@@ -26,14 +573,23 @@ void libPvr_TaDMA(u32* data, u32 size)
     verify(TaCmd != nullptr);
     verify(size > 0);
 
-    Ta_Dma* ta_data     = (Ta_Dma*)data;
-    Ta_Dma* ta_data_end = ta_data + size - 1;
+    // Anything the SQs queued up comes first
+    TA_SQFlush();
 
-    do
+    if (ta_capture_active)
+        TaCapture_Data(data, size);
+
+    // Keeps the SQ side in step with the stream
+    for (u32 i = 0; i < size; i++)
+        TaSQ_Step((Ta_Dma*)data + i);
+
+    if (ta_thread_active)
     {
-        ta_data = TaCmd(ta_data, ta_data_end);
+        TaRing_PushData((Ta_Dma*)data, size);
+        return;
     }
-    while (ta_data <= ta_data_end);
+
+    TaRun_Data((Ta_Dma*)data, size);
 }
 
 namespace TASplitter
@@ -7,6 +7,27 @@ namespace TASplitter
 	void TA_ListCont();
 	void TA_ListInit();
 	void TA_SoftReset();
+	void TA_SQFlush();		//drain the batched SQ packets into TaCmd
+	void TA_SQDiscard();	//drop them (reset)
+
+	//Threaded TA (Emulation.ThreadedTA) : the SH4 thread only queues TA data and
+	//control writes, a render thread parses and draws them. See ta.cpp
+	const u32 TA_CTRL_LIST_INIT=0;
+	const u32 TA_CTRL_LIST_CONT=1;
+	const u32 TA_CTRL_SOFT_RESET=2;
+	const u32 TA_CTRL_START_RENDER=3;
+
+	bool TA_ThreadStart();
+	void TA_ThreadStop();
+	bool TA_ThreadActive();		//the render thread parses and draws
+	void TA_ThreadSync();		//wait until the render thread has consumed everything queued
+	void TA_Control(u32 ctrl);	//TA_CTRL_* register write, queued or run inline
+	void TA_WaitRender();		//wait until the last STARTRENDER has been drawn
+	void TA_Update();			//SH4 side : raise the list end interrupts posted by the render thread
+	void TA_ListEnd(u32 list);	//called by the splitter when a list ends
+
+	//full memory barrier, for the state the SH4 and render threads share without a lock
+	#define ta_barrier() __sync_synchronize()
 	extern void  Dma(u32* data,u32 size);
     extern void  SQ(u32* data);
 
@@ -59,7 +80,33 @@ namespace TASplitter
 	//Splitter function (normaly ta_dma_main , modified for split dma's)
 	extern TaListFP* TaCmd;
 
-	template<class TA_decoder>
+	//FifoSplitter features , fixed at compile time. A disabled feature is not
+	//decoded at all : its data is only stepped over
+	const u32 TA_FEAT_MODVOL=1;		//modifier volume params and triangles
+	const u32 TA_FEAT_SPRITE=2;		//sprite params and vertices
+	const u32 TA_FEAT_STATS=4;		//count what is parsed in ta_parse_stats
+	const u32 TA_FEAT_DEFAULT=TA_FEAT_MODVOL|TA_FEAT_SPRITE;
+
+	struct TaParseStats
+	{
+		u32 lists;
+		u32 params;			//polygon , sprite and modifier volume params
+		u32 runs;			//vertex handler calls , one per run of vertices of the same type
+		u32 vertices;		//polygon vertices
+		u32 sprites;
+		u32 modvol_tris;
+		u32 entries;		//TaCmd calls , counted by ta.cpp in every build
+	};
+	extern TaParseStats ta_parse_stats;
+
+#define TA_STAT(name,n) if (features&TA_FEAT_STATS) ta_parse_stats.name+=(n)
+
+	//The TA state machine. TA_decoder gets the decoded params and vertices , see
+	//VertexDecoder (ta_vtx.cpp). Vertex data is handed over a run at a time : the
+	//handler picked by the last param (ta_poly_data<type,size> , ta_sprite_data ,
+	//ta_mod_vol_data) decodes every vertex up to the end of the strip or of the
+	//data , with the vertex type known at compile time
+	template<class TA_decoder,u32 features=TA_FEAT_DEFAULT>
 	class FifoSplitter
 	{
 	public:
@@ -168,60 +215,76 @@ namespace TASplitter
 		}
 		static Ta_Dma*  ta_modvolB_32(Ta_Dma* data,Ta_Dma* data_end)
 		{
-			TA_decoder::AppendModVolVertexB((TA_ModVolB*)data);
+			if (features&TA_FEAT_MODVOL)
+				TA_decoder::AppendModVolVertexB((TA_ModVolB*)data);
 			TaCmd=ta_main;
 			return data+SZ32;
 		}
 		
+		//64B triangles , the whole run
 		static Ta_Dma*  ta_mod_vol_data(Ta_Dma* data,Ta_Dma* data_end)
 		{
-			TA_VertexParam* vp=(TA_VertexParam*)data;
-			if (data==data_end)
-			{
-				TA_decoder::AppendModVolVertexA(&vp->mvolA);
-				//32B more needed , 32B done :)
-				TaCmd=ta_modvolB_32;
-				return data+SZ32;
-			}
-			else
+			do
 			{
+				TA_VertexParam* vp=(TA_VertexParam*)data;
+				TA_STAT(modvol_tris,1);
+				if (data==data_end)
+				{
+					if (features&TA_FEAT_MODVOL)
+						TA_decoder::AppendModVolVertexA(&vp->mvolA);
+					//32B more needed , 32B done :)
+					TaCmd=ta_modvolB_32;
+					return data+SZ32;
+				}
+
 				//all 64B done
-				TA_decoder::AppendModVolVertexA(&vp->mvolA);
-				TA_decoder::AppendModVolVertexB(&vp->mvolB);
-				return data+SZ64;
+				if (features&TA_FEAT_MODVOL)
+				{
+					TA_decoder::AppendModVolVertexA(&vp->mvolA);
+					TA_decoder::AppendModVolVertexB(&vp->mvolB);
+				}
+				data+=SZ64;
 			}
+			while (data<=data_end && data->pcw.ParaType==ParamType_Vertex_Parameter);
+			return data;
 		}
 		static Ta_Dma*  ta_spriteB_data(Ta_Dma* data,Ta_Dma* data_end)
 		{
 			//32B more needed , 32B done :)
 			TaCmd=ta_main;
 			
-			TA_decoder::AppendSpriteVertexB((TA_Sprite1B*)data);
+			if (features&TA_FEAT_SPRITE)
+				TA_decoder::AppendSpriteVertexB((TA_Sprite1B*)data);
 
 			return data+SZ32;
 		}
+		//64B sprites , the whole run
 		static Ta_Dma*  ta_sprite_data(Ta_Dma* data,Ta_Dma* data_end)
 		{
-			if (data==data_end)
-			{
-				//32B more needed , 32B done :)
-				TaCmd=ta_spriteB_data;
-				
-				TA_VertexParam* vp=(TA_VertexParam*)data;
-
-				TA_decoder::AppendSpriteVertexA(&vp->spr1A);
-				return data+SZ32;
-			}
-			else
+			do
 			{
 				TA_VertexParam* vp=(TA_VertexParam*)data;
+				TA_STAT(sprites,1);
+				if (data==data_end)
+				{
+					//32B more needed , 32B done :)
+					TaCmd=ta_spriteB_data;
 
-				TA_decoder::AppendSpriteVertexA(&vp->spr1A);
-				TA_decoder::AppendSpriteVertexB(&vp->spr1B);
+					if (features&TA_FEAT_SPRITE)
+						TA_decoder::AppendSpriteVertexA(&vp->spr1A);
+					return data+SZ32;
+				}
 
 				//all 64B done
-				return data+SZ64;
+				if (features&TA_FEAT_SPRITE)
+				{
+					TA_decoder::AppendSpriteVertexA(&vp->spr1A);
+					TA_decoder::AppendSpriteVertexB(&vp->spr1B);
+				}
+				data+=SZ64;
 			}
+			while (data<=data_end && data->pcw.ParaType==ParamType_Vertex_Parameter);
+			return data;
 		}
 
 		template <u32 poly_type,u32 poly_size>
@@ -234,17 +297,26 @@ namespace TASplitter
 				StripStarted=true;
 			}
 
-			while
-				(
-				poly_size==SZ32 ? 
-				(data<=data_end)	//If SZ32 && we have 32 bytes left process em
-				: 
-				(data<data_end)		//If SZ32 && we have 32 bytes left skip em
-				)
+			if (poly_size==SZ32)
+			{
+				//32B vertices : the decoder takes the whole run , up to the strip end
+				//or the end of the data
+				if (data>data_end)
+					return data;
+				Ta_Dma* last=TA_decoder::template AppendPolyVertexRun<poly_type>(data,data_end);
+				TA_STAT(vertices,last-data+1);
+				data=last;
+				if (data->pcw.EndOfStrip)
+					goto strip_end;
+				return data+SZ32;
+			}
+
+			while (data<data_end)	//64B vertices , a lone 32B half is handled below
 			{
 				verify(data->pcw.ParaType==ParamType_Vertex_Parameter);
 
 				ta_handle_poly<poly_type,0,false>(data,0);
+				TA_STAT(vertices,1);
 		
 				if (data->pcw.EndOfStrip)
 					goto strip_end;
@@ -257,6 +329,7 @@ namespace TASplitter
 			if ((poly_size!=SZ32) && (data==data_end))//32B part of 64B
 			{
 				ta_handle_poly<poly_type,1,false>(data,0);
+				TA_STAT(vertices,1);
 				if (data->pcw.EndOfStrip)
 					TaCmd=ta_handle_poly<poly_type,2,true>;//end strip after part B is  done :)
 				else
@@ -321,7 +394,8 @@ public:
 						}
 
 						//printf("End list %X\n",CurrentList);
-						params.RaiseInterrupt(ListEndInterrupt[CurrentList]);
+						TA_STAT(lists,1);
+						TA_ListEnd(CurrentList);
 						ListIsFinished[CurrentList]=true;
 						CurrentList=ListType_None;
 						VerxexDataFP=0;
@@ -356,9 +430,11 @@ public:
 						if (CurrentList==ListType_None)
 							ta_list_start(data->pcw.ListType);	//start a list ;)
 
+						TA_STAT(params,1);
 						if (IsModVolList(CurrentList))
 						{	//accept mod data
-							TA_decoder::StartModVol((TA_ModVolParam*)data);
+							if (features&TA_FEAT_MODVOL)
+								TA_decoder::StartModVol((TA_ModVolParam*)data);
 							VerxexDataFP=ta_mod_vol_data;
 							data+=SZ32;
 						}
@@ -399,9 +475,11 @@ public:
 						if (CurrentList==ListType_None)
 							ta_list_start(data->pcw.ListType);	//start a list ;)
 
+						TA_STAT(params,1);
 						VerxexDataFP=ta_sprite_data;
 						//printf("Sprite \n");
-						TA_decoder::AppendSpriteParam((TA_SpriteParam*)data);
+						if (features&TA_FEAT_SPRITE)
+							TA_decoder::AppendSpriteParam((TA_SpriteParam*)data);
 						data+=SZ32;
 					}
 					break;
@@ -412,6 +490,7 @@ public:
 					{
 						//printf("VTX:0x%08X\n",VerxexDataFP);
 						verify(VerxexDataFP!=0);
+						TA_STAT(runs,1);
 						data=VerxexDataFP(data,data_end);
 					}
 					break;
@@ -687,605 +766,12 @@ public:
 	};
 
 
-	//Well , olny in a C++ world you have to do smth like that ...
-	template <class TA_decoder> u32 FifoSplitter<TA_decoder> ::CurrentList;
-	template <class TA_decoder> TaListFP* FifoSplitter<TA_decoder> ::VerxexDataFP;
-	template <class TA_decoder> bool FifoSplitter<TA_decoder> ::ListIsFinished[5];
-	template <class TA_decoder> u32 FifoSplitter<TA_decoder> ::ta_type_lut[256];
-	template <class TA_decoder> bool FifoSplitter<TA_decoder> ::StripStarted;
-
-	template<class TA_decoder>
-	class FifoSplitterEx
-	{
-	public:
-		//TA fifo state variables
-		//Current List
-		static u32 CurrentList; 
-		//Vertex Handler function :)
-		static TaListFP* VerxexDataFP;
-		//finished lists
-		static bool ListIsFinished[5];
-
-		//splitter function lookup
-		static u32 ta_type_lut[256];
-
-		//helper function for dummy dma's.Handles 32B and then switches to ta_main for next data
-		static Ta_Dma*  ta_dummy_32(Ta_Dma* data,Ta_Dma* data_end)
-		{
-			TaCmd=ta_main;
-			return data+SZ32;
-		}
-		static Ta_Dma*  ta_modvolB_32(Ta_Dma* data,Ta_Dma* data_end)
-		{
-			//TA_decoder::AppendModVolVertexB((TA_ModVolB*)data);
-			TaCmd=ta_main;
-			return data+SZ32;
-		}
-		//Second part of poly data
-		template <int t>
-		static Ta_Dma*  ta_poly_B_32(Ta_Dma* data,Ta_Dma* data_end)
-		{
-			if (t==2)
-				TA_decoder::AppendPolyParam2B((TA_PolyParam2B*)data);
-			else
-				TA_decoder::AppendPolyParam4B((TA_PolyParam4B*)data);
-	
-			TaCmd=ta_main;
-			return data+SZ32;
-		}
-
-		static Ta_Dma*  ta_poly_data_B_32(Ta_Dma* data,Ta_Dma* data_end)
-		{
-			TA_decoder::AppendPolyVertexData32Part(data);
-			TaCmd=ta_main;
-			return data+SZ32;
-		}
-
-		//Code Splitter/routers
-		static Ta_Dma*  ta_mod_vol_data(Ta_Dma* data,Ta_Dma* data_end)
-		{
-			TA_VertexParam* vp=(TA_VertexParam*)data;
-			if (data==data_end)
-			{
-				//TA_decoder::AppendModVolVertexA(&vp->mvolA);
-				//32B more needed , 32B done :)
-				TaCmd=ta_modvolB_32;
-				return data+SZ32;
-			}
-			else
-			{
-				//all 64B done
-				//TA_decoder::AppendModVolVertexA(&vp->mvolA);
-				//TA_decoder::AppendModVolVertexB(&vp->mvolB);
-				return data+SZ64;
-			}
-		}
-		static Ta_Dma*  ta_spriteB_data(Ta_Dma* data,Ta_Dma* data_end)
-		{
-			//32B more needed , 32B done :)
-			TaCmd=ta_main;
-			
-		//	TA_decoder::AppendSpriteVertexB((TA_Sprite1B*)data);
-
-			return data+SZ32;
-		}
-		static Ta_Dma*  ta_sprite_data(Ta_Dma* data,Ta_Dma* data_end)
-		{
-			if (data==data_end)
-			{
-				//32B more needed , 32B done :)
-				TaCmd=ta_spriteB_data;
-				
-				TA_VertexParam* vp=(TA_VertexParam*)data;
-
-				//TA_decoder::AppendSpriteVertexA(&vp->spr1A);
-				return data+SZ32;
-			}
-			else
-			{
-				TA_VertexParam* vp=(TA_VertexParam*)data;
-
-				//TA_decoder::AppendSpriteVertexA(&vp->spr1A);
-				//TA_decoder::AppendSpriteVertexB(&vp->spr1B);
-
-				//all 64B done
-				return data+SZ64;
-			}
-		}
-
-
-		//Transfer polygon data
-		template <u32 poly_size,bool FirstTransfer>
-		static Ta_Dma*  ta_poly_data(Ta_Dma* data,Ta_Dma* data_end)
-		{
-			do
-			{
-				if (data->pcw.full<0xE0000000)
-					goto strip_end;
-
-				if (poly_size==SZ32)
-					TA_decoder::AppendPolyVertexData32(data);
-				else
-					TA_decoder::AppendPolyVertexData(data);		
-
-				data+=poly_size;
-			}
-			while
-				(
-				poly_size==SZ32 ? 
-				(data<=data_end)	//If SZ32 && we have 32 bytes left process em
-				: 
-				(data<data_end)		//If SZ32 && we have 32 bytes left skip em
-				);
-
-			
-			if ((poly_size==SZ64) && (data==data_end))//32B part of 64B
-			{
-				TA_decoder::AppendPolyVertexData32(data);
-				TaCmd=ta_poly_data_B_32;
-				data+=SZ32;
-			}
-			else if (FirstTransfer==true)
-			{
-				//strip didnt finish at once.. continue it later :P
-				VerxexDataFP=TaCmd=ta_poly_data<poly_size,false>;
-			}
-			
-			return data;
-
-strip_end:
-			if (FirstTransfer!=true)	//if strip wasnt started this time
-			{
-				VerxexDataFP=ta_poly_data<poly_size,false>;
-				TaCmd=ta_main;
-			}
-
-			return data;
-		}
-
-		/*
-		Volume,Col_Type,Texture,Offset,Gouraud,16bit_UV
-		
-		0	0	0	(0)	x	invalid	Polygon Type 0	Polygon Type 0
-		0	0	1	x	x	0		Polygon Type 0	Polygon Type 3
-		0	0	1	x	x	1		Polygon Type 0	Polygon Type 4
-
-		0	1	0	(0)	x	invalid	Polygon Type 0	Polygon Type 1
-		0	1	1	x	x	0		Polygon Type 0	Polygon Type 5
-		0	1	1	x	x	1		Polygon Type 0	Polygon Type 6
-
-		0	2	0	(0)	x	invalid	Polygon Type 1	Polygon Type 2
-		0	2	1	0	x	0		Polygon Type 1	Polygon Type 7
-		0	2	1	0	x	1		Polygon Type 1	Polygon Type 8
-		0	2	1	1	x	0		Polygon Type 2	Polygon Type 7
-		0	2	1	1	x	1		Polygon Type 2	Polygon Type 8
-
-		0	3	0	(0)	x	invalid	Polygon Type 0	Polygon Type 2
-		0	3	1	x	x	0		Polygon Type 0	Polygon Type 7
-		0	3	1	x	x	1		Polygon Type 0	Polygon Type 8
-
-		1	0	0	(0)	x	invalid	Polygon Type 3	Polygon Type 9
-		1	0	1	x	x	0		Polygon Type 3	Polygon Type 11
-		1	0	1	x	x	1		Polygon Type 3	Polygon Type 12
-
-		1	2	0	(0)	x	invalid	Polygon Type 4	Polygon Type 10
-		1	2	1	x	x	0		Polygon Type 4	Polygon Type 13
-		1	2	1	x	x	1		Polygon Type 4	Polygon Type 14
-
-		1	3	0	(0)	x	invalid	Polygon Type 3	Polygon Type 10
-		1	3	1	x	x	0		Polygon Type 3	Polygon Type 13
-		1	3	1	x	x	1		Polygon Type 3	Polygon Type 14
-		
-		Sprites :
-		(0)	(0)	0	(0)	(0)	invalid	Sprite	Sprite Type 0
-		(0)	(0)	1	x	(0)	(1)		Sprite	Sprite Type 1
-
-		*/
-		//helpers 0-14
-		static u32  poly_data_type_id(PCW pcw)
-		{
-			if (pcw.Texture)
-			{
-				//textured
-				if (pcw.Volume==0)
-				{	//single volume
-					if (pcw.Col_Type==0)
-					{
-						if (pcw.UV_16bit==0)
-							return 3;					//(Textured, Packed Color , 32b uv)
-						else
-							return 4;					//(Textured, Packed Color , 16b uv)
-					}
-					else if (pcw.Col_Type==1)
-					{
-						if (pcw.UV_16bit==0)
-							return 5;					//(Textured, Floating Color , 32b uv)
-						else
-							return 6;					//(Textured, Floating Color , 16b uv)
-					}
-					else
-					{
-						if (pcw.UV_16bit==0)
-							return 7;					//(Textured, Intensity , 32b uv)
-						else
-							return 8;					//(Textured, Intensity , 16b uv)
-					}
-				}
-				else
-				{
-					//two volumes
-					if (pcw.Col_Type==0)
-					{
-						if (pcw.UV_16bit==0)
-							return 11;					//(Textured, Packed Color, with Two Volumes)	
-
-						else
-							return 12;					//(Textured, Packed Color, 16bit UV, with Two Volumes)
-
-					}
-					else if (pcw.Col_Type==1)
-					{
-						//die ("invalid");
-						return 0xFFFFFFFF;
-					}
-					else
-					{
-						if (pcw.UV_16bit==0)
-							return 13;					//(Textured, Intensity, with Two Volumes)	
-
-						else
-							return 14;					//(Textured, Intensity, 16bit UV, with Two Volumes)
-					}
-				}
-			}
-			else
-			{
-				//non textured
-				if (pcw.Volume==0)
-				{	//single volume
-					if (pcw.Col_Type==0)
-						return 0;						//(Non-Textured, Packed Color)
-					else if (pcw.Col_Type==1)
-						return 1;						//(Non-Textured, Floating Color)
-					else
-						return 2;						//(Non-Textured, Intensity)
-				}
-				else
-				{
-					//two volumes
-					if (pcw.Col_Type==0)
-						return 9;						//(Non-Textured, Packed Color, with Two Volumes)
-					else if (pcw.Col_Type==1)
-					{
-						//die ("invalid");
-						return 0xFFFFFFFF;
-					}
-					else
-						return 10;						//(Non-Textured, Intensity, with Two Volumes)
-				}
-			}
-			//dbgbreak;
-			return 0xFFFFFFFF;
-		}
-		//0-4 | 0x80
-		static u32  poly_header_type_size(PCW pcw)
-		{
-			if (pcw.Volume == 0)
-			{
-				if ( pcw.Col_Type<2 ) //0,1
-				{
-					return 0  | 0;	//Polygon Type 0 -- SZ32
-				}
-				else if ( pcw.Col_Type == 2 )
-				{
-					if (pcw.Texture)
-					{
-						if (pcw.Offset)
-						{
-							return 2 | 0x80;	//Polygon Type 2 -- SZ64
-						}
-						else
-						{
-							return 1 | 0;	//Polygon Type 1 -- SZ32
-						}
-					}
-					else
-					{
-						return 1 | 0;	//Polygon Type 1 -- SZ32
-					}
-				}
-				else	//col_type ==3
-				{
-					return 0 | 0;	//Polygon Type 0 -- SZ32
-				}
-			}
-			else
-			{
-				if ( pcw.Col_Type==0 ) //0
-				{
-					return 3 | 0;	//Polygon Type 3 -- SZ32
-				}
-				else if ( pcw.Col_Type==2 ) //2
-				{
-					return 4 | 0x80;	//Polygon Type 4 -- SZ64
-				}
-				else if ( pcw.Col_Type==3 ) //3
-				{
-					return 3 | 0;	//Polygon Type 3 -- SZ32
-				}
-				else
-				{
-					return 0xFFDDEEAA;//die ("data->pcw.Col_Type==1 && volume ==1");
-				}
-			}
-		}
-
-
-		static void  ta_list_start(u32 new_list)
-		{
-			verify(CurrentList==ListType_None);
-			verify(ListIsFinished[new_list]==false);
-			//printf("Starting list %d\n",new_list);
-			CurrentList=new_list;
-			TA_decoder::StartList(CurrentList);
-		}
-		
-		static void  fastcall AppendPolyParam2Full(Ta_Dma* pp)
-		{
-			TA_decoder::AppendPolyParam2A((TA_PolyParam2A*)&pp[0]);
-			TA_decoder::AppendPolyParam2B((TA_PolyParam2B*)&pp[1]);
-		}
-
-		static void  fastcall AppendPolyParam4Full(Ta_Dma* pp)
-		{
-			TA_decoder::AppendPolyParam4A((TA_PolyParam4A*)&pp[0]);
-			TA_decoder::AppendPolyParam4B((TA_PolyParam4B*)&pp[1]);
-		}
-
-public:
-#define GROUP_EN() if (data->pcw.Group_En){ TA_decoder::TileClipMode(data->pcw.User_Clip);}
-		static Ta_Dma*  ta_main(Ta_Dma* data,Ta_Dma* data_end)
-		{
-			//u32 ci=size;
-			do
-			{
-				//Variable size
-				switch (data->pcw.ParaType)
-				{
-//					default:__assume(0);
-					//Control parameter
-					//32B
-				case ParamType_End_Of_List:
-					{
-						if (VerxexDataFP)
-						{
-						//	TA_decoder::EndParam();
-							VerxexDataFP=0;
-						}
-						if (CurrentList==ListType_None)
-						{
-							CurrentList=data->pcw.ListType;
-							//printf("End_Of_List : list error\n");
-						}
-						else
-						{
-							//end of list should be all 0's ...
-							TA_decoder::EndList(CurrentList);//end a list olny if it was realy started
-						}
-
-						//printf("End list %X\n",CurrentList);
-						params.RaiseInterrupt(ListEndInterrupt[CurrentList]);
-						ListIsFinished[CurrentList]=true;
-						CurrentList=ListType_None;
-						data+=SZ32;
-					}
-					break;
-					//32B
-				case ParamType_User_Tile_Clip:
-					{
-						TA_decoder::SetTileClip(data->data_32[3]&63,data->data_32[4]&31,data->data_32[5]&63,data->data_32[6]&31);
-						//*couh* ignore it :p
-						data+=SZ32;
-					}
-					break;	
-					//32B
-				case ParamType_Object_List_Set:
-					{
-						die("ParamType_Object_List_Set");
-						//*couh* ignore it :p
-						data+=SZ32;
-					}
-					break;
-
-					//Global Parameter
-					//ModVolue :32B
-					//PolyType :32B/64B
-				case ParamType_Polygon_or_Modifier_Volume:
-					{
-						//this is here to make up for C++'s limitations
-						//Yep , C++ IS lame & limited
-						static TaListFP* ta_poly_data_lut[2] = 
-						{
-							ta_poly_data<SZ32,true>,
-							ta_poly_data<SZ64,true>,
-						};
-						//32/64b , full
-						static TaPolyParamFP* ta_poly_param_lut[5]=
-						{
-							(TaPolyParamFP*)TA_decoder::AppendPolyParam0,
-							(TaPolyParamFP*)TA_decoder::AppendPolyParam1,
-							(TaPolyParamFP*)AppendPolyParam2Full,
-							(TaPolyParamFP*)TA_decoder::AppendPolyParam3,
-							(TaPolyParamFP*)AppendPolyParam4Full
-						};
-						//64b , first part
-						static TaPolyParamFP* ta_poly_param_a_lut[5]=
-						{
-							(TaPolyParamFP*)0,
-							(TaPolyParamFP*)0,
-							(TaPolyParamFP*)TA_decoder::AppendPolyParam2A,
-							(TaPolyParamFP*)0,
-							(TaPolyParamFP*)TA_decoder::AppendPolyParam4A
-						};
-
-						//64b , , second part
-						static TaListFP* ta_poly_param_b_lut[5]=
-						{
-							(TaListFP*)0,
-							(TaListFP*)0,
-							(TaListFP*)ta_poly_B_32<2>,
-							(TaListFP*)0,
-							(TaListFP*)ta_poly_B_32<4>
-						};
-
-						GROUP_EN();
-						if (CurrentList==ListType_None)
-							ta_list_start(data->pcw.ListType);	//start a list ;)
-						if (!IsModVolList(CurrentList))
-						{
-
-							u32 uid=ta_type_lut[data->pcw.obj_ctrl];
-							u32 pdsz=(u8)(uid)&1;
-							u32 ppsz=(u8)(uid)&(32);
-							u32 ppid=(u8)(uid>>8);
-
-							VerxexDataFP=ta_poly_data_lut[pdsz];
-							
-							if (ppsz==0 || data != data_end)
-							{
-								ta_poly_param_lut[ppid](data);
-								data=(Ta_Dma*) &((u8*)data)[ppsz+32];
-							}
-							else
-							{
-								//64b , first part
-								ta_poly_param_a_lut[ppid](data);
-								//Handle next 32B ;)
-								TaCmd=ta_poly_param_b_lut[ppid];
-								data+=SZ32;
-								return data;
-							}
-						}
-						else
-						{	//accept mod data
-							//TA_decoder::StartModVol((TA_ModVolParam*)data);
-							VerxexDataFP=ta_mod_vol_data;
-							data+=SZ32;
-						}
-					}
-					break;
-					//32B
-					//Sets Sprite info , and switches to ta_sprite_data function
-				case ParamType_Sprite:
-					{
-						GROUP_EN();
-						if (CurrentList==ListType_None)
-							ta_list_start(data->pcw.ListType);	//start a list ;)
-
-						VerxexDataFP=ta_sprite_data;
-						//printf("Sprite \n");
-						//TA_decoder::AppendSpriteParam((TA_SpriteParam*)data);
-						data+=SZ32;
-					}
-					break;
-
-				case ParamType_Vertex_Parameter:
-					{
-						verify(VerxexDataFP!=0);
-						data=VerxexDataFP(data,data_end);
-					}
-					break;
-					//not handled
-					//Assumed to be 32B
-				case 3:
-				case 6:
-					{
-						die("Unhadled parameter");
-						data+=SZ32;
-					}
-					break;
-				}
-			}
-			while(data<=data_end);
-			return data;
-		}
-		//Rest shit
-		FifoSplitterEx()
-		{
-			Init();
-		}
-		static bool Init()
-		{
-			for (int i=0;i<256;i++)
-			{
-				PCW pcw;
-				pcw.obj_ctrl=i;
-				u32 rv=0;
-				rv=	poly_data_type_id(pcw);
-				if (rv==5||rv==6||rv==11||rv==12||rv==13||rv==14)
-					rv=1;
-				else
-					rv=0;
-				u32 type= poly_header_type_size(pcw);
-
-				if (type& 0x80)
-					rv|=32;
-				
-				rv|=(type&0x7F)<<8;
-
-				ta_type_lut[i]=rv;
-			}
-
-			ListIsFinished[0]=ListIsFinished[1]=ListIsFinished[2]=ListIsFinished[3]=ListIsFinished[4]=false;
-			return true;
-		}
-
-		~FifoSplitterEx()
-		{
-			Term();
-		}
-		static void Term()
-		{
-			//ta_alloc_release_all();
-		}
-
-		static void Reset(bool manual)
-		{
-			//*couh* right ...
-		}
-		//called when writes are made to these registers..
-		static void SoftReset()
-		{
-			TA_SoftReset();
-			ListIsFinished[0]=ListIsFinished[1]=ListIsFinished[2]=ListIsFinished[3]=ListIsFinished[4]=false;
-			CurrentList=ListType_None;
-
-			TA_decoder::SoftReset();
-		}
-		static void ListInit()
-		{
-			TA_ListInit();
-			//reset TA input
-			TaCmd=ta_main;
-
-			ListIsFinished[0]=ListIsFinished[1]=ListIsFinished[2]=ListIsFinished[3]=ListIsFinished[4]=false;
-			CurrentList=ListType_None;
-
-			TA_decoder::ListInit();
-		}
-		static void ListCont()
-		{
-			TA_ListCont();
-			ListIsFinished[0]=ListIsFinished[1]=ListIsFinished[2]=ListIsFinished[3]=ListIsFinished[4]=false;
-			TA_decoder::ListCont();
-		}
-	};
-
-
+#undef TA_STAT
 
 	//Well , olny in a C++ world you have to do smth like that ...
-	template <class TA_decoder> u32 FifoSplitterEx<TA_decoder> ::CurrentList;
-	template <class TA_decoder> TaListFP* FifoSplitterEx<TA_decoder> ::VerxexDataFP;
-	template <class TA_decoder> bool FifoSplitterEx<TA_decoder> ::ListIsFinished[5];
-	template <class TA_decoder> u32 FifoSplitterEx<TA_decoder> ::ta_type_lut[256];
+	template <class TA_decoder,u32 features> u32 FifoSplitter<TA_decoder,features> ::CurrentList;
+	template <class TA_decoder,u32 features> TaListFP* FifoSplitter<TA_decoder,features> ::VerxexDataFP;
+	template <class TA_decoder,u32 features> bool FifoSplitter<TA_decoder,features> ::ListIsFinished[5];
+	template <class TA_decoder,u32 features> u32 FifoSplitter<TA_decoder,features> ::ta_type_lut[256];
+	template <class TA_decoder,u32 features> bool FifoSplitter<TA_decoder,features> ::StripStarted;
 }
\ No newline at end of file
@@ -0,0 +1,148 @@
+// TA capture (see ta_capture.h)
+
+#include "ta_capture.h"
+#include "ta.h"
+#include "regs.h"
+
+bool ta_capture_active;
+
+static FILE *cap_file;
+static TaCaptureHeader cap_header;
+static u32 cap_skip;                // frames still to let through
+static Array<u8> cap_data;          // TA packets of the current chunk
+static u32 cap_data_size;
+static u8 *cap_vram_shadow;         // VRAM and registers as last written
+static u8 *cap_reg_shadow;
+static Array<u8> cap_diff;
+
+static void WriteChunk(u32 type, const void *data, u32 size)
+{
+    TaCaptureChunk chunk;
+    chunk.type = type;
+    chunk.size = size;
+    fwrite(&chunk, sizeof(chunk), 1, cap_file);
+    fwrite(data, 1, size, cap_file);
+}
+
+static void FlushData()
+{
+    if (cap_data_size)
+        WriteChunk(TACAP_DATA, cap_data.data, cap_data_size);
+    cap_data_size = 0;
+}
+
+// Writes the pages of 'mem' that differ from 'shadow' as one chunk
+static void WriteDiff(u32 type, const u8 *mem, u8 *shadow, u32 size, u32 page)
+{
+    u32 used = 0;
+    for (u32 offs = 0; offs < size; offs += page)
+    {
+        if (memcmp(mem + offs, shadow + offs, page) == 0)
+            continue;
+
+        memcpy(shadow + offs, mem + offs, page);
+        if (used + 4 + page > cap_diff.Size)
+            cap_diff.Resize(cap_diff.Size * 2 + 4 + page, false);
+        memcpy(&cap_diff[used], &offs, 4);
+        memcpy(&cap_diff[used + 4], mem + offs, page);
+        used += 4 + page;
+    }
+    if (used)
+        WriteChunk(type, cap_diff.data, used);
+}
+
+static void CloseCapture()
+{
+    if (!cap_file)
+        return;
+
+    FlushData();
+    fseek(cap_file, 0, SEEK_SET);
+    fwrite(&cap_header, sizeof(cap_header), 1, cap_file);
+    fclose(cap_file);
+    cap_file = 0;
+    ta_capture_active = false;
+    printf("TA capture: %u frames recorded\n", cap_header.frames);
+
+    free(cap_vram_shadow);
+    free(cap_reg_shadow);
+    cap_vram_shadow = 0;
+    cap_reg_shadow = 0;
+}
+
+void TaCapture_Init()
+{
+    if (!settings.Capture.Frames || cap_file)
+        return;
+
+    // Shadows start zeroed, like VRAM and the registers on replay
+    cap_vram_shadow = (u8 *)calloc(VRAM_SIZE, 1);
+    cap_reg_shadow = (u8 *)calloc(RegSize, 1);
+
+    char *path = GetEmuPath("data/ta_capture.bin");
+    cap_file = cap_vram_shadow && cap_reg_shadow ? fopen(path, "wb") : 0;
+    if (!cap_file)
+    {
+        printf("TA capture: cannot open %s\n", path);
+        free(path);
+        free(cap_vram_shadow);
+        free(cap_reg_shadow);
+        cap_vram_shadow = 0;
+        cap_reg_shadow = 0;
+        return;
+    }
+    printf("TA capture: recording %u frames to %s\n", settings.Capture.Frames, path);
+    free(path);
+
+    memset(&cap_header, 0, sizeof(cap_header));
+    memcpy(cap_header.magic, TACAP_MAGIC, 8);
+    cap_header.version = TACAP_VERSION;
+    cap_header.endian = TACAP_ENDIAN;
+    cap_header.vram_size = VRAM_SIZE;
+    cap_header.reg_size = RegSize;
+    fwrite(&cap_header, sizeof(cap_header), 1, cap_file);
+
+    cap_skip = settings.Capture.Skip;
+    cap_data_size = 0;
+    cap_diff.Resize(TACAP_VRAM_PAGE * 16, false);
+    ta_capture_active = true;
+}
+
+void TaCapture_Term()
+{
+    CloseCapture();
+}
+
+void TaCapture_Data(const void *data, u32 count)
+{
+    if (cap_skip)
+        return;
+
+    u32 size = count * 32;
+    if (cap_data_size + size > cap_data.Size)
+        cap_data.Resize((cap_data_size + size) * 2, false);
+    memcpy(&cap_data[cap_data_size], data, size);
+    cap_data_size += size;
+}
+
+void TaCapture_Control(u32 ctrl)
+{
+    if (cap_skip)
+    {
+        // The first recorded frame starts after a STARTRENDER
+        if (ctrl == TASplitter::TA_CTRL_START_RENDER)
+            cap_skip--;
+        return;
+    }
+
+    FlushData();
+    if (ctrl == TASplitter::TA_CTRL_START_RENDER)
+    {
+        WriteDiff(TACAP_REGS, regs, cap_reg_shadow, RegSize, TACAP_REG_PAGE);
+        WriteDiff(TACAP_VRAM, params.vram, cap_vram_shadow, VRAM_SIZE, TACAP_VRAM_PAGE);
+    }
+    WriteChunk(TACAP_CTRL, &ctrl, 4);
+
+    if (ctrl == TASplitter::TA_CTRL_START_RENDER && ++cap_header.frames == settings.Capture.Frames)
+        CloseCapture();
+}
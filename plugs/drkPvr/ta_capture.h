@@ -0,0 +1,64 @@
+#pragma once
+#include "drkPvr.h"
+
+// ============================================================================
+// TA capture
+// ============================================================================
+// With Capture.Frames set, everything the TA is fed is recorded to
+// data/ta_capture.bin: the TA packets (DMA and store queue, in arrival
+// order), the TA control register writes, and at every STARTRENDER the PVR
+// registers and VRAM that changed since the previous frame. Replaying the
+// file through the TA and a backend (tools/ta_replay.cpp) redraws the frames
+// without the CPU core.
+//
+// Capture.Skip frames are let through first. Recording starts and stops on a
+// STARTRENDER, so every recorded frame is complete.
+//
+// File layout: a TaCaptureHeader, then chunks of a TaCaptureChunk header and
+// 'size' bytes of payload. Data is stored in the byte order of the capturing
+// host (see TaCaptureHeader::endian), VRAM and registers as 32 bit words.
+// ============================================================================
+
+#define TACAP_MAGIC      "NDCTACAP"
+#define TACAP_VERSION    1
+#define TACAP_ENDIAN     0x01020304     // as written by the capturing host
+
+#define TACAP_VRAM_PAGE  4096           // VRAM diff granularity, in bytes
+#define TACAP_REG_PAGE   256            // register file diff granularity
+
+enum TaCaptureChunkType
+{
+    TACAP_DATA = 1,     // TA packets, size/32 of them
+    TACAP_CTRL = 2,     // u32 TA_CTRL_* ; TA_CTRL_START_RENDER ends a frame
+    TACAP_REGS = 3,     // { u32 offset; u8 data[TACAP_REG_PAGE]; } * n
+    TACAP_VRAM = 4,     // { u32 offset; u8 data[TACAP_VRAM_PAGE]; } * n, 64 bit VRAM view
+};
+
+struct TaCaptureHeader
+{
+    char magic[8];
+    u32 version;
+    u32 endian;
+    u32 vram_size;
+    u32 reg_size;
+    u32 frames;         // frames in the file, 0 if the capture was not closed
+    u32 reserved;
+};
+
+struct TaCaptureChunk
+{
+    u32 type;           // TaCaptureChunkType
+    u32 size;           // payload bytes
+};
+
+extern bool ta_capture_active;
+
+// Start/stop as selected by the Capture settings
+void TaCapture_Init();
+void TaCapture_Term();
+
+// 'count' 32 byte TA packets, before they are parsed or queued
+void TaCapture_Data(const void *data, u32 count);
+
+// TA control register write (TA_CTRL_*)
+void TaCapture_Control(u32 ctrl);
@@ -0,0 +1,1350 @@
+// TA vertex decoding, shared by the renderer backends (see ta_vtx.h)
+
+#include "ta_vtx.h"
+#include "regs.h"
+#include "spg.h"
+#include <malloc.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define TA_VTX_SSE2
+#endif
+
+using namespace TASplitter;
+
+// ============================
+// Vertex arena (see ta_vtx.h)
+// ============================
+// Room is checked once per strip (StartPolyStrip): every array keeps some
+// slack past its limit so the strip being decoded, and the PolyParam written
+// before it, always fit. Strips longer than the vertex slack (TA_VTX_SLACK,
+// ta_vtx.h) are split as they are decoded. Growing copies the used part to a larger block and
+// rebases the cursors; the old block is freed at once, the previous frame has
+// been drawn (GX_DrawDone) before the next one is decoded.
+
+#define TA_VTX_CHUNK 16384  // growth steps
+#define TA_LST_CHUNK 4096
+#define TA_LST_SLACK 16
+
+// Past the vertex limit: the last strip started below it (up to TA_VTX_SLACK
+// vertices), and once the cap is reached, the dropped strips decoded after it
+#define TA_VTX_BLOCK_SLACK (TA_VTX_SLACK * 2)
+
+Vertex *vertices;
+VertexList *lists;
+PolyParam *listModes;
+
+Vertex *curVTX;
+VertexList *curLST;
+VertexList *TransLST = 0;
+VertexList *TransEndLST = 0;
+PolyParam *curMod;
+bool global_regd;
+
+TaArenaStats ta_arena_stats;
+
+static u32 vtx_size, lst_size, mod_size;   // capacity, slack not included
+static Vertex *vtx_limit;                  // grow when a strip starts past these
+static VertexList *lst_limit;
+static PolyParam *mod_limit;
+
+// Set when the cap is reached: strips are decoded into the slack and dropped
+static bool arena_clip;
+static Vertex *clip_vtx;
+static VertexList *clip_lst;
+static PolyParam *clip_mod;
+
+static u32 ArenaCap()
+{
+  u32 cap = settings.Emulation.MaxVertices * 1024;
+  if (cap < TA_VTX_CHUNK)
+    cap = TA_VTX_CHUNK;
+  return cap > TA_ARENA_MAX_VTX ? TA_ARENA_MAX_VTX : cap;
+}
+
+// Moves 'used' elements to a block of 'size' + 'slack', returns the new block
+template <typename T>
+static T *ArenaResize(T *old, u32 used, u32 size, u32 slack)
+{
+  T *block = (T *)memalign(32, (size + slack) * sizeof(T));
+  if (!block)
+    return 0;
+  if (old)
+  {
+    memcpy(block, old, used * sizeof(T));
+    free(old);
+  }
+  return block;
+}
+
+static void ArenaLimits()
+{
+  vtx_limit = vertices + vtx_size;
+  lst_limit = lists + lst_size;
+  mod_limit = listModes + mod_size;
+}
+
+static bool ArenaInit()
+{
+  vtx_size = TA_VTX_CHUNK;
+  lst_size = TA_LST_CHUNK;
+  mod_size = TA_LST_CHUNK;
+  vertices = ArenaResize<Vertex>(0, 0, vtx_size, TA_VTX_BLOCK_SLACK);
+  lists = ArenaResize<VertexList>(0, 0, lst_size, TA_LST_SLACK);
+  listModes = ArenaResize<PolyParam>(0, 0, mod_size, TA_LST_SLACK);
+  ArenaLimits();
+  memset(&ta_arena_stats, 0, sizeof(ta_arena_stats));
+  return vertices && lists && listModes;
+}
+
+static void ArenaTerm()
+{
+  free(vertices);
+  free(lists);
+  free(listModes);
+  vertices = 0;
+  lists = 0;
+  listModes = 0;
+  curVTX = 0;
+  curLST = 0;
+  curMod = 0;
+}
+
+// Grows 'arr' by one chunk, up to 'cap' elements. Cursors into it are rebased
+// by the caller from the returned element offset.
+template <typename T>
+static bool ArenaGrow(T *&arr, u32 &size, u32 used, u32 chunk, u32 slack, u32 cap)
+{
+  if (size >= cap)
+    return false;
+  u32 new_size = size + chunk > cap ? cap : size + chunk;
+  T *block = ArenaResize<T>(arr, used, new_size, slack);
+  if (!block)
+    return false;
+  arr = block;
+  size = new_size;
+  ta_arena_stats.grows++;
+  return true;
+}
+
+// Out of room at the start of a strip: grow, or drop the rest of the frame
+static void ArenaFull()
+{
+  if (arena_clip)
+    return;
+
+  u32 cap = ArenaCap();
+  u32 vtx = curVTX - vertices;
+  u32 lst = curLST - lists;
+  u32 mod = curMod - listModes;
+  s32 trans = TransLST ? TransLST - lists : -1;
+  s32 trans_end = TransEndLST ? TransEndLST - lists : -1;
+
+  // Every strip has at least one vertex, so lists never outnumber vertices
+  bool ok = true;
+  if (curVTX >= vtx_limit)
+    ok &= ArenaGrow(vertices, vtx_size, vtx, TA_VTX_CHUNK, TA_VTX_BLOCK_SLACK, cap);
+  if (curLST >= lst_limit)
+    ok &= ArenaGrow(lists, lst_size, lst, TA_LST_CHUNK, TA_LST_SLACK, cap);
+  if (curMod >= mod_limit)
+    ok &= ArenaGrow(listModes, mod_size, mod + 1, TA_LST_CHUNK, TA_LST_SLACK, cap);
+
+  curVTX = vertices + vtx;
+  curLST = lists + lst;
+  curMod = listModes + mod;
+  TransLST = trans < 0 ? 0 : lists + trans;
+  TransEndLST = trans_end < 0 ? 0 : lists + trans_end;
+  ArenaLimits();
+
+  if (!ok)
+  {
+    if (!ta_arena_stats.clipped)
+      printf("TA: vertex arena full (%u vertices, %u strips), dropping the rest of the frame\n",
+             vtx, lst);
+    ta_arena_stats.clipped++;
+    arena_clip = true;
+    clip_vtx = curVTX;
+    clip_lst = curLST;
+    clip_mod = curMod;
+  }
+}
+
+// A strip decoded past the cap: forget it
+static void ArenaDropStrip()
+{
+  curVTX = clip_vtx;
+  curLST = clip_lst;
+  curMod = clip_mod;
+  global_regd = false;
+}
+
+void TA_ArenaPrintStats()
+{
+  printf("TA arena: peak %u/%u vertices, %u/%u strips, %u/%u params, %u grows",
+         ta_arena_stats.vtx_peak, vtx_size, ta_arena_stats.lst_peak, lst_size,
+         ta_arena_stats.mod_peak, mod_size, ta_arena_stats.grows);
+  if (ta_arena_stats.clipped)
+    printf(", %u frames clipped at the cap", ta_arena_stats.clipped);
+  printf("\n");
+  memset(&ta_arena_stats, 0, sizeof(ta_arena_stats));
+
+  if (ta_parse_stats.runs)
+    printf("TA parse: %u lists, %u params, %u vertices in %u runs, %u sprites, %u modvol triangles, "
+           "%u state machine entries\n",
+           ta_parse_stats.lists, ta_parse_stats.params, ta_parse_stats.vertices, ta_parse_stats.runs,
+           ta_parse_stats.sprites, ta_parse_stats.modvol_tris, ta_parse_stats.entries);
+  else if (ta_parse_stats.entries)
+    printf("TA parse: %u state machine entries\n", ta_parse_stats.entries);
+  memset(&ta_parse_stats, 0, sizeof(ta_parse_stats));
+}
+
+// ============================
+// Modifier volume arena (see ta_vtx.h)
+// ============================
+// Sized by the vertex cap too, grown by doubling when a triangle or a
+// parameter does not fit. Volumes past the cap are dropped.
+
+#define TA_MV_CHUNK 1024
+
+ModTriangle *modTris;
+ModParam *modParams;
+u32 modTriCount;
+u32 modParamCount;
+bool ta_shadow_used;
+
+static u32 mv_tri_size, mv_param_size;
+
+template <typename T>
+static bool ModVolReserve(T *&arr, u32 &size, u32 used)
+{
+  if (used < size)
+    return true;
+  return ArenaGrow(arr, size, used, size > TA_MV_CHUNK ? size : TA_MV_CHUNK, 0, ArenaCap());
+}
+
+static void ModVolTerm()
+{
+  free(modTris);
+  free(modParams);
+  modTris = 0;
+  modParams = 0;
+  mv_tri_size = mv_param_size = 0;
+  modTriCount = modParamCount = 0;
+}
+
+bool TA_ModVolActive()
+{
+  return settings.Emulation.ModVolMode && ta_shadow_used && modTriCount;
+}
+
+float vtx_min_Z;
+float vtx_max_Z;
+
+// Debug builds count what the TA parses (TA_ArenaPrintStats)
+#ifdef RELEASE
+#define TILE_ACCEL_FEATURES TA_FEAT_DEFAULT
+#else
+#define TILE_ACCEL_FEATURES (TA_FEAT_DEFAULT | TA_FEAT_STATS)
+#endif
+
+struct VertexDecoder;
+FifoSplitter<VertexDecoder, TILE_ACCEL_FEATURES> TileAccel;
+
+// Sprites and modifier volumes of a skipped frame are not even handed over
+struct SkipDecoder;
+FifoSplitter<SkipDecoder, 0> TileSkip;
+
+// Helpers to read float/int values directly from the virtualized PVR VRAM.
+f32 vrf(u32 addr)
+{
+  return *(f32 *)&params.vram[fast_ConvOffset32toOffset64(addr)];
+}
+
+u32 vri(u32 addr)
+{
+  return *(u32 *)&params.vram[fast_ConvOffset32toOffset64(addr)];
+}
+
+// Primary decoder that translates raw PVR vertex data into the 'Vertex' struct.
+void decode_pvr_vertex(u32 base, u32 ptr, Vertex *cv)
+{
+  // ISP
+  // TSP
+  // TCW
+  ISP_TSP isp;
+  TSP tsp;
+  TCW tcw;
+
+  isp.full = vri(base);
+  tsp.full = vri(base + 4);
+  tcw.full = vri(base + 8);
+  (void)tsp;
+  (void)tcw; // Currently unused but may be needed later
+
+  // Read coordinates: PVR positions are typically already transformed.
+  // XYZ
+  // UV
+  // Base Col
+  // Offset Col
+
+  // XYZ are _allways_ there :)
+  cv->x = vrf(ptr);
+  ptr += 4;
+  cv->y = vrf(ptr);
+  ptr += 4;
+  cv->z = vrf(ptr);
+  ptr += 4;
+
+  // Handle Texture Coordinates (UVs)
+  if (isp.Texture)
+  { // Do texture , if any
+    if (isp.UV_16b)
+    {
+      u32 uv = vri(ptr);
+      cv->u = CVT16UV((u16)uv);
+      cv->v = CVT16UV((u16)(uv >> 16));
+      ptr += 4;
+    }
+    else
+    {
+      cv->u = vrf(ptr);
+      ptr += 4;
+      cv->v = vrf(ptr);
+      ptr += 4;
+    }
+  }
+
+  // Handle Vertex Color
+  u32 col = vri(ptr);
+  ptr += 4;
+  cv->col = col; // ABGR8888(col);
+  if (isp.Offset)
+  {
+    // Skip offset color for now (used for specular-like highlights)
+    (void)vri(ptr);
+    ptr += 4;
+     //	vert_packed_color_(cv->spc,col);
+  }
+}
+
+// Resets internal pointers for the next frame's vertex list.
+void reset_vtx_state()
+{
+  if (curVTX)
+  {
+    u32 vtx = curVTX - vertices;
+    u32 lst = curLST - lists;
+    u32 mod = curMod - listModes;
+    if (vtx > ta_arena_stats.vtx_peak)
+      ta_arena_stats.vtx_peak = vtx;
+    if (lst > ta_arena_stats.lst_peak)
+      ta_arena_stats.lst_peak = lst;
+    if (mod > ta_arena_stats.mod_peak)
+      ta_arena_stats.mod_peak = mod;
+  }
+  arena_clip = false;
+
+  curVTX = vertices;
+  curLST = lists;
+  curMod = listModes;
+  TransLST = 0;
+  TransEndLST = 0;
+  global_regd = false;
+  modTriCount = 0;
+  modParamCount = 0;
+  ta_shadow_used = false;
+  vtx_min_Z = 128 * 1024; // if someone uses more, i realy realy dont care
+  vtx_max_Z = 0;          // lower than 0 is invalid for pvr .. i wonder if SA knows that.
+}
+
+void decode_pvr_background(Vertex *cv)
+{
+  u32 param_base = PARAM_BASE & 0xF00000;
+  _ISP_BACKGND_D_type bg_d;
+  _ISP_BACKGND_T_type bg_t;
+
+  bg_d.i = ISP_BACKGND_D & ~(0xF);
+  bg_t.full = ISP_BACKGND_T;
+  (void)bg_d; // Currently unused but may be needed later
+
+  bool PSVM = FPU_SHAD_SCALE & 0x100; // double parameters for volumes
+
+  // Get the strip base
+  u32 strip_base = param_base + bg_t.tag_address * 4;
+  // Calculate the vertex size
+  u32 strip_vs = 3 + bg_t.skip;
+  u32 strip_vert_num = bg_t.tag_offset;
+
+  if (PSVM && bg_t.shadow)
+  {
+    strip_vs += bg_t.skip; // 2x the size needed :p
+  }
+  strip_vs *= 4;
+  // Get vertex ptr
+  u32 vertex_ptr = strip_vert_num * strip_vs + strip_base + 3 * 4;
+  // now , all the info is ready :p
+
+  decode_pvr_vertex(strip_base, vertex_ptr, cv);
+}
+
+#define VTX_TFX(x) (x)
+#define VTX_TFY(y) (y)
+
+// ============================
+// VertexDecoder struct: Handles the accumulation of vertex data into strips.
+// ============================
+
+struct VertexDecoder
+{
+  // list handling
+  __forceinline static void StartList(u32 ListType)
+  {
+    if (ListType == ListType_Translucent)
+    {
+      TransLST = curLST;
+      TransEndLST = 0;
+    }
+  }
+  __forceinline static void EndList(u32 ListType)
+  {
+    if (ListType == ListType_Translucent)
+      TransEndLST = curLST;
+  }
+
+  // Float colour component to 0..255, negative and NaN give 0
+  static INLINE u32 FLCLAMP(float c)
+  {
+    c *= 255;
+    return !(c > 0) ? 0 : c > 255 ? 255 : (u32)c;
+  }
+  // ARGB floats to packed ABGR (R in the low byte)
+  static u32 FLCOL(float *col)
+  {
+#ifdef TA_VTX_SSE2
+    __m128 c = _mm_mul_ps(_mm_loadu_ps(col), _mm_set1_ps(255));
+    c = _mm_min_ps(_mm_max_ps(c, _mm_setzero_ps()), _mm_set1_ps(255));
+    __m128i i = _mm_shuffle_epi32(_mm_cvttps_epi32(c), _MM_SHUFFLE(0, 3, 2, 1));
+    i = _mm_packs_epi32(i, i);
+    return _mm_cvtsi128_si32(_mm_packus_epi16(i, i));
+#else
+    return (FLCLAMP(col[0]) << 24) | (FLCLAMP(col[3]) << 16) | (FLCLAMP(col[2]) << 8) | FLCLAMP(col[1]);
+#endif
+  }
+  static u32 INTESITY(float inte)
+  {
+    u32 C = FLCLAMP(inte);
+    return (0xFF << 24) | (C << 16) | (C << 8) | (C);
+  }
+
+  // Polys
+#define glob_param_bdc                \
+  global_regd = true;                 \
+  ta_shadow_used |= pp->pcw.Shadow;   \
+  curMod->pcw = pp->pcw;              \
+  curMod->isp = pp->isp; \
+  curMod->tsp = pp->tsp; \
+  curMod->tcw = pp->tcw;
+
+  __forceinline static void fastcall AppendPolyParam0(TA_PolyParam0 *pp)
+  {
+    glob_param_bdc;
+  }
+  __forceinline static void fastcall AppendPolyParam1(TA_PolyParam1 *pp)
+  {
+    glob_param_bdc;
+  }
+  __forceinline static void fastcall AppendPolyParam2A(TA_PolyParam2A *pp)
+  {
+    glob_param_bdc;
+  }
+  __forceinline static void fastcall AppendPolyParam2B(TA_PolyParam2B *pp)
+  {
+  }
+  __forceinline static void fastcall AppendPolyParam3(TA_PolyParam3 *pp)
+  {
+    glob_param_bdc;
+  }
+  __forceinline static void fastcall AppendPolyParam4A(TA_PolyParam4A *pp)
+  {
+    glob_param_bdc;
+  }
+  __forceinline static void fastcall AppendPolyParam4B(TA_PolyParam4B *pp)
+  {
+  }
+
+  // Poly Strip handling
+  // UPDATE SPRITES ON EDIT !
+  __forceinline static void StartPolyStrip()
+  {
+    if (curVTX >= vtx_limit || curLST >= lst_limit || curMod >= mod_limit)
+      ArenaFull();
+    curLST->ptr = curVTX;
+  }
+
+  __forceinline static void EndPolyStrip()
+  {
+    curLST->count = (curVTX - curLST->ptr);
+    if (global_regd)
+    {
+      curLST->count |= 0x80000000;
+      global_regd = false;
+      curMod++;
+    }
+    curLST++;
+    if (arena_clip)
+      ArenaDropStrip();
+  }
+
+  // The strip being decoded filled the slack: end it and go on with a new
+  // strip that starts with its last two vertices. TA_VTX_SLACK is even, so
+  // the new strip keeps the triangle winding.
+  static void SplitStrip()
+  {
+    Vertex v0 = curVTX[-2];
+    Vertex v1 = curVTX[-1];
+    EndPolyStrip();
+    StartPolyStrip();
+    curVTX[0] = v0;
+    curVTX[1] = v1;
+    curVTX += 2;
+  }
+
+  __forceinline static void StripRoom()
+  {
+    if (curVTX - curLST->ptr >= TA_VTX_SLACK)
+      SplitStrip();
+  }
+
+// Standard vertex projection macro. PVR 'Z' is actually 1/W.
+//
+// Guard against zero/negative/NaN Z values that can arrive when the game reads
+// back EFB (framebuffer) data that the emulator hasn't rendered yet (e.g.
+// Castlevania: Resurrection shadow/reflection pass).  A bad Z causes W=1/Z to
+// become infinity or NaN, which then corrupts vtx_min_Z / vtx_max_Z, blows up
+// the projection matrix in DoRender(), and ultimately desyncs the GX FIFO
+// producing "GFX Fifo Opcode unknown (0x64)".
+//
+// Clamping to 0.0001f keeps W finite and pushes the vertex safely to the far
+// plane where it is invisible but harmless.
+#define vert_base(dst, _x, _y, _z) /*VertexCount++;*/         \
+  float _safe_z = (_z < 0.0001f) ? 0.0001f : _z;             \
+  float W = 1.0f / _safe_z;                                   \
+  curVTX[dst].x = VTX_TFX(_x) * W;                           \
+  curVTX[dst].y = VTX_TFY(_y) * W;                           \
+  if (W > 0.0f && W < vtx_min_Z)                             \
+    vtx_min_Z = W;                                            \
+  if (W > 0.0f && W > vtx_max_Z)                             \
+    vtx_max_Z = W;                                            \
+  curVTX[dst].z = W; /*Linearly scaled later*/
+
+  // Poly Vertex handlers
+#define vert_cvt_base \
+  StripRoom();        \
+  vert_base(0, vtx->xyz[0], vtx->xyz[1], vtx->xyz[2])
+
+  // Handlers for various PVR vertex types (Packed color, Float color, Intensity, etc.)
+  //(Non-Textured, Packed Color)
+  __forceinline static void AppendPolyVertex0(TA_Vertex0 *vtx)
+  {
+    vert_cvt_base;
+    curVTX->col = vtx->BaseCol;
+
+    curVTX++;
+  }
+
+  //(Non-Textured, Floating Color)
+  __forceinline static void AppendPolyVertex1(TA_Vertex1 *vtx)
+  {
+    vert_cvt_base;
+    curVTX->col = FLCOL(&vtx->BaseA);
+
+    curVTX++;
+  }
+
+  //(Non-Textured, Intensity)
+  __forceinline static void AppendPolyVertex2(TA_Vertex2 *vtx)
+  {
+    vert_cvt_base;
+    curVTX->col = INTESITY(vtx->BaseInt);
+
+    curVTX++;
+  }
+
+  //(Textured, Packed Color)
+  __forceinline static void AppendPolyVertex3(TA_Vertex3 *vtx)
+  {
+    vert_cvt_base;
+    curVTX->col = vtx->BaseCol;
+
+    curVTX->u = vtx->u;
+    curVTX->v = vtx->v;
+
+    curVTX++;
+  }
+
+  //(Textured, Packed Color, 16bit UV)
+  __forceinline static void AppendPolyVertex4(TA_Vertex4 *vtx)
+  {
+    vert_cvt_base;
+    curVTX->col = vtx->BaseCol;
+
+    curVTX->u = CVT16UV(vtx->u);
+    curVTX->v = CVT16UV(vtx->v);
+
+    curVTX++;
+  }
+
+  //(Textured, Floating Color)
+  __forceinline static void AppendPolyVertex5A(TA_Vertex5A *vtx)
+  {
+    vert_cvt_base;
+
+    curVTX->u = vtx->u;
+    curVTX->v = vtx->v;
+  }
+  __forceinline static void AppendPolyVertex5B(TA_Vertex5B *vtx)
+  {
+    curVTX->col = FLCOL(&vtx->BaseA);
+    curVTX++;
+  }
+
+  //(Textured, Floating Color, 16bit UV)
+  __forceinline static void AppendPolyVertex6A(TA_Vertex6A *vtx)
+  {
+    vert_cvt_base;
+
+    curVTX->u = CVT16UV(vtx->u);
+    curVTX->v = CVT16UV(vtx->v);
+  }
+  __forceinline static void AppendPolyVertex6B(TA_Vertex6B *vtx)
+  {
+    curVTX->col = FLCOL(&vtx->BaseA);
+    curVTX++;
+  }
+
+  //(Textured, Intensity)
+  __forceinline static void AppendPolyVertex7(TA_Vertex7 *vtx)
+  {
+    vert_cvt_base;
+    curVTX->u = vtx->u;
+    curVTX->v = vtx->v;
+
+    curVTX->col = INTESITY(vtx->BaseInt);
+
+    curVTX++;
+  }
+
+  //(Textured, Intensity, 16bit UV)
+  __forceinline static void AppendPolyVertex8(TA_Vertex8 *vtx)
+  {
+    vert_cvt_base;
+    curVTX->col = INTESITY(vtx->BaseInt);
+
+    curVTX->u = CVT16UV(vtx->u);
+    curVTX->v = CVT16UV(vtx->v);
+
+    curVTX++;
+  }
+
+  //(Non-Textured, Packed Color, with Two Volumes)
+  __forceinline static void AppendPolyVertex9(TA_Vertex9 *vtx)
+  {
+    vert_cvt_base;
+    curVTX->col = vtx->BaseCol0;
+
+    curVTX++;
+  }
+
+  //(Non-Textured, Intensity,	with Two Volumes)
+  __forceinline static void AppendPolyVertex10(TA_Vertex10 *vtx)
+  {
+    vert_cvt_base;
+    curVTX->col = INTESITY(vtx->BaseInt0);
+
+    curVTX++;
+  }
+
+  // Colour and UV of one 32 byte vertex, as the AppendPolyVertexN handlers
+  template <u32 poly_type>
+  static INLINE void RunAttr(Vertex *dst, TA_VertexParam *vp)
+  {
+    switch (poly_type)
+    {
+    case 0:
+      dst->col = vp->vtx0.BaseCol;
+      break;
+    case 1:
+      dst->col = FLCOL(&vp->vtx1.BaseA);
+      break;
+    case 2:
+      dst->col = INTESITY(vp->vtx2.BaseInt);
+      break;
+    case 3:
+      dst->col = vp->vtx3.BaseCol;
+      dst->u = vp->vtx3.u;
+      dst->v = vp->vtx3.v;
+      break;
+    case 4:
+      dst->col = vp->vtx4.BaseCol;
+      dst->u = CVT16UV(vp->vtx4.u);
+      dst->v = CVT16UV(vp->vtx4.v);
+      break;
+    case 7:
+      dst->col = INTESITY(vp->vtx7.BaseInt);
+      dst->u = vp->vtx7.u;
+      dst->v = vp->vtx7.v;
+      break;
+    case 8:
+      dst->col = INTESITY(vp->vtx8.BaseInt);
+      dst->u = CVT16UV(vp->vtx8.u);
+      dst->v = CVT16UV(vp->vtx8.v);
+      break;
+    case 9:
+      dst->col = vp->vtx9.BaseCol0;
+      break;
+    case 10:
+      dst->col = INTESITY(vp->vtx10.BaseInt0);
+      break;
+    }
+  }
+
+  // Bulk path for the 32 byte vertex types: decodes the run starting at
+  // 'data' up to the end of the strip or 'data_end' (inclusive), straight
+  // into the vertex arena, and returns the last vertex. The Z range is kept
+  // in registers for the whole run. With SSE2 vertices go four at a time:
+  // one division for the four W = 1/z and vector min/max for the Z range.
+  template <u32 poly_type>
+  static Ta_Dma *AppendPolyVertexRun(Ta_Dma *data, Ta_Dma *data_end)
+  {
+    Ta_Dma *last = data;
+    for (;;)
+    {
+      verify(last->pcw.ParaType == ParamType_Vertex_Parameter);
+      if (last->pcw.EndOfStrip || last == data_end)
+        break;
+      last++;
+    }
+    u32 count = last - data + 1;
+
+    // At most up to the slack, then split the strip
+    for (;;)
+    {
+      u32 room = TA_VTX_SLACK - (curVTX - curLST->ptr);
+      if (count <= room)
+        break;
+      DecodeRun<poly_type>(data, room);
+      data += room;
+      count -= room;
+      SplitStrip();
+    }
+    DecodeRun<poly_type>(data, count);
+    return last;
+  }
+
+  template <u32 poly_type>
+  static void DecodeRun(Ta_Dma *data, u32 count)
+  {
+    Vertex *dst = curVTX;
+    float zmin = vtx_min_Z;
+    float zmax = vtx_max_Z;
+    u32 i = 0;
+
+#ifdef TA_VTX_SSE2
+    if (count >= 4)
+    {
+      __m128 zmin4 = _mm_set1_ps(zmin);
+      __m128 zmax4 = _mm_set1_ps(zmax);
+      for (; i + 4 <= count; i += 4)
+      {
+        TA_VertexParam *vp = (TA_VertexParam *)&data[i];
+        __m128 z = _mm_setr_ps(vp[0].vtx0.xyz[2], ((TA_VertexParam *)&data[i + 1])->vtx0.xyz[2],
+                               ((TA_VertexParam *)&data[i + 2])->vtx0.xyz[2],
+                               ((TA_VertexParam *)&data[i + 3])->vtx0.xyz[2]);
+        // max(c, z) is z < c ? c : z, a NaN z is kept like in vert_base
+        __m128 w = _mm_div_ps(_mm_set1_ps(1.0f), _mm_max_ps(_mm_set1_ps(0.0001f), z));
+
+        // Only W > 0 counts for the range (false for NaN)
+        __m128 pos = _mm_cmpgt_ps(w, _mm_setzero_ps());
+        zmin4 = _mm_min_ps(zmin4, _mm_or_ps(_mm_and_ps(pos, w), _mm_andnot_ps(pos, zmin4)));
+        zmax4 = _mm_max_ps(zmax4, _mm_and_ps(pos, w));
+
+        ALIGN16 float W[4];
+        _mm_store_ps(W, w);
+        for (u32 j = 0; j < 4; j++)
+        {
+          TA_VertexParam *v = (TA_VertexParam *)&data[i + j];
+          dst[i + j].x = VTX_TFX(v->vtx0.xyz[0]) * W[j];
+          dst[i + j].y = VTX_TFY(v->vtx0.xyz[1]) * W[j];
+          dst[i + j].z = W[j];
+          RunAttr<poly_type>(&dst[i + j], v);
+        }
+      }
+      zmin4 = _mm_min_ps(zmin4, _mm_shuffle_ps(zmin4, zmin4, _MM_SHUFFLE(1, 0, 3, 2)));
+      zmax4 = _mm_max_ps(zmax4, _mm_shuffle_ps(zmax4, zmax4, _MM_SHUFFLE(1, 0, 3, 2)));
+      zmin = _mm_cvtss_f32(_mm_min_ss(zmin4, _mm_shuffle_ps(zmin4, zmin4, 1)));
+      zmax = _mm_cvtss_f32(_mm_max_ss(zmax4, _mm_shuffle_ps(zmax4, zmax4, 1)));
+    }
+#endif
+
+    for (; i < count; i++)
+    {
+      TA_VertexParam *v = (TA_VertexParam *)&data[i];
+      float z = v->vtx0.xyz[2] < 0.0001f ? 0.0001f : v->vtx0.xyz[2];
+      float W = 1.0f / z;
+      dst[i].x = VTX_TFX(v->vtx0.xyz[0]) * W;
+      dst[i].y = VTX_TFY(v->vtx0.xyz[1]) * W;
+      dst[i].z = W;
+      if (W > 0.0f && W < zmin)
+        zmin = W;
+      if (W > 0.0f && W > zmax)
+        zmax = W;
+      RunAttr<poly_type>(&dst[i], v);
+    }
+
+    vtx_min_Z = zmin;
+    vtx_max_Z = zmax;
+    curVTX += count;
+  }
+
+  //(Textured, Packed Color,	with Two Volumes)
+  __forceinline static void AppendPolyVertex11A(TA_Vertex11A *vtx)
+  {
+    vert_cvt_base;
+
+    curVTX->u = vtx->u0;
+    curVTX->v = vtx->v0;
+
+    curVTX->col = vtx->BaseCol0;
+  }
+  __forceinline static void AppendPolyVertex11B(TA_Vertex11B *vtx)
+  {
+    curVTX++;
+  }
+
+  //(Textured, Packed Color, 16bit UV, with Two Volumes)
+  __forceinline static void AppendPolyVertex12A(TA_Vertex12A *vtx)
+  {
+    vert_cvt_base;
+
+    curVTX->u = CVT16UV(vtx->u0);
+    curVTX->v = CVT16UV(vtx->v0);
+
+    curVTX->col = vtx->BaseCol0;
+  }
+  __forceinline static void AppendPolyVertex12B(TA_Vertex12B *vtx)
+  {
+    curVTX++;
+  }
+
+  //(Textured, Intensity,	with Two Volumes)
+  __forceinline static void AppendPolyVertex13A(TA_Vertex13A *vtx)
+  {
+    vert_cvt_base;
+    curVTX->u = vtx->u0;
+    curVTX->v = vtx->v0;
+    curVTX->col = INTESITY(vtx->BaseInt0);
+  }
+  __forceinline static void AppendPolyVertex13B(TA_Vertex13B *vtx)
+  {
+    curVTX++;
+  }
+
+  //(Textured, Intensity, 16bit UV, with Two Volumes)
+  __forceinline static void AppendPolyVertex14A(TA_Vertex14A *vtx)
+  {
+    vert_cvt_base;
+    curVTX->u = CVT16UV(vtx->u0);
+    curVTX->v = CVT16UV(vtx->v0);
+    curVTX->col = INTESITY(vtx->BaseInt0);
+  }
+  __forceinline static void AppendPolyVertex14B(TA_Vertex14B *vtx)
+  {
+    curVTX++;
+  }
+
+  // Sprites
+  __forceinline static void AppendSpriteParam(TA_SpriteParam *spr)
+  {
+    TA_SpriteParam *pp = spr;
+    glob_param_bdc;
+  }
+
+// Sprite Vertex Handlers
+/*
+__forceinline
+static void AppendSpriteVertex0A(TA_Sprite0A* sv)
+{
+
+}
+__forceinline
+static void AppendSpriteVertex0B(TA_Sprite0B* sv)
+{
+
+}
+*/
+#define sprite_uv(indx, u_name, v_name) \
+  curVTX[indx].u = CVT16UV(sv->u_name); \
+  curVTX[indx].v = CVT16UV(sv->v_name);
+
+  // Sprites are converted to 4-vertex triangle strips.
+  __forceinline static void AppendSpriteVertexA(TA_Sprite1A *sv)
+  {
+    
+    StartPolyStrip();
+    curVTX[0].col = 0xFFFFFFFF;
+    curVTX[1].col = 0xFFFFFFFF;
+    curVTX[2].col = 0xFFFFFFFF;
+    curVTX[3].col = 0xFFFFFFFF;
+
+    {
+      vert_base(2, sv->x0, sv->y0, sv->z0);
+    }
+    {
+      vert_base(3, sv->x1, sv->y1, sv->z1);
+    }
+
+    curVTX[1].x = sv->x2;
+  }
+  __forceinline static void AppendSpriteVertexB(TA_Sprite1B *sv)
+  {
+
+    {
+      vert_base(1, curVTX[1].x, sv->y2, sv->z2);
+    }
+    {
+      vert_base(0, sv->x3, sv->y3, sv->z2);
+    }
+
+    sprite_uv(2, u0, v0);
+    sprite_uv(3, u1, v1);
+    sprite_uv(1, u2, v2);
+    sprite_uv(0, u0, v2); // or sprite_uv(u2,v0); ?
+
+    curVTX += 4;
+    //			VertexCount+=4;
+
+    // EndPolyStrip();
+    curLST->count = 4;
+    if (global_regd)
+    {
+      curLST->count |= 0x80000000;
+      global_regd = false;
+      curMod++;
+    }
+    curLST++;
+    if (arena_clip)
+      ArenaDropStrip();
+  }
+
+  // ModVolumes
+  __forceinline static void AppendModVolParam(TA_ModVolParam *modv)
+  {
+  }
+
+  // ModVol Strip handling
+  __forceinline static void StartModVol(TA_ModVolParam *param)
+  {
+    if (!ModVolReserve(modParams, mv_param_size, modParamCount))
+      return;
+    ModParam *mp = &modParams[modParamCount++];
+    mp->isp = param->isp;
+    mp->list = param->pcw.ListType;
+    mp->first = modTriCount;
+    mp->count = 0;
+  }
+  __forceinline static void ModVolStripEnd()
+  {
+  }
+
+  // Mod Volume Vertex handlers
+  // Every vertex parameter is one triangle, A holds up to x2, B the rest.
+  // Triangles without a parameter to belong to, or past the cap, are dropped.
+  __forceinline static void AppendModVolVertexA(TA_ModVolA *mvv)
+  {
+    if (!modParamCount || !ModVolReserve(modTris, mv_tri_size, modTriCount))
+      return;
+    ModTriangle *t = &modTris[modTriCount];
+    t->x0 = mvv->x0;
+    t->y0 = mvv->y0;
+    t->z0 = mvv->z0;
+    t->x1 = mvv->x1;
+    t->y1 = mvv->y1;
+    t->z1 = mvv->z1;
+    t->x2 = mvv->x2;
+  }
+  __forceinline static void AppendModVolVertexB(TA_ModVolB *mvv)
+  {
+    if (!modParamCount || modTriCount >= mv_tri_size)
+      return;
+    ModTriangle *t = &modTris[modTriCount++];
+    t->y2 = mvv->y2;
+    t->z2 = mvv->z2;
+    modParams[modParamCount - 1].count++;
+  }
+  __forceinline static void SetTileClip(u32 xmin, u32 ymin, u32 xmax, u32 ymax)
+  {
+  }
+  __forceinline static void TileClipMode(u32 mode)
+  {
+  }
+  // Misc
+  __forceinline static void ListCont()
+  {
+  }
+  __forceinline static void ListInit()
+  {
+    // reset_vtx_state();
+  }
+  __forceinline static void SoftReset()
+  {
+    // reset_vtx_state();
+  }
+};
+
+// ============================
+// SkipDecoder: frame skipping (see ta_vtx.h)
+// ============================
+// Runs the TA data of a skipped frame through the same state machine, so
+// list boundaries, ListIsFinished and the list end interrupts are exactly
+// those of a drawn frame, but decodes and stores nothing.
+
+#define SKIP_HANDLER(name, arg) \
+  __forceinline static void name(arg) {}
+
+struct SkipDecoder
+{
+  SKIP_HANDLER(StartList, u32 ListType)
+  SKIP_HANDLER(EndList, u32 ListType)
+
+  SKIP_HANDLER(fastcall AppendPolyParam0, TA_PolyParam0 *pp)
+  SKIP_HANDLER(fastcall AppendPolyParam1, TA_PolyParam1 *pp)
+  SKIP_HANDLER(fastcall AppendPolyParam2A, TA_PolyParam2A *pp)
+  SKIP_HANDLER(fastcall AppendPolyParam2B, TA_PolyParam2B *pp)
+  SKIP_HANDLER(fastcall AppendPolyParam3, TA_PolyParam3 *pp)
+  SKIP_HANDLER(fastcall AppendPolyParam4A, TA_PolyParam4A *pp)
+  SKIP_HANDLER(fastcall AppendPolyParam4B, TA_PolyParam4B *pp)
+
+  SKIP_HANDLER(StartPolyStrip, )
+  SKIP_HANDLER(EndPolyStrip, )
+
+  SKIP_HANDLER(AppendPolyVertex0, TA_Vertex0 *vtx)
+  SKIP_HANDLER(AppendPolyVertex1, TA_Vertex1 *vtx)
+  SKIP_HANDLER(AppendPolyVertex2, TA_Vertex2 *vtx)
+  SKIP_HANDLER(AppendPolyVertex3, TA_Vertex3 *vtx)
+  SKIP_HANDLER(AppendPolyVertex4, TA_Vertex4 *vtx)
+  SKIP_HANDLER(AppendPolyVertex5A, TA_Vertex5A *vtx)
+  SKIP_HANDLER(AppendPolyVertex5B, TA_Vertex5B *vtx)
+  SKIP_HANDLER(AppendPolyVertex6A, TA_Vertex6A *vtx)
+  SKIP_HANDLER(AppendPolyVertex6B, TA_Vertex6B *vtx)
+  SKIP_HANDLER(AppendPolyVertex7, TA_Vertex7 *vtx)
+  SKIP_HANDLER(AppendPolyVertex8, TA_Vertex8 *vtx)
+  SKIP_HANDLER(AppendPolyVertex9, TA_Vertex9 *vtx)
+  SKIP_HANDLER(AppendPolyVertex10, TA_Vertex10 *vtx)
+  SKIP_HANDLER(AppendPolyVertex11A, TA_Vertex11A *vtx)
+  SKIP_HANDLER(AppendPolyVertex11B, TA_Vertex11B *vtx)
+  SKIP_HANDLER(AppendPolyVertex12A, TA_Vertex12A *vtx)
+  SKIP_HANDLER(AppendPolyVertex12B, TA_Vertex12B *vtx)
+  SKIP_HANDLER(AppendPolyVertex13A, TA_Vertex13A *vtx)
+  SKIP_HANDLER(AppendPolyVertex13B, TA_Vertex13B *vtx)
+  SKIP_HANDLER(AppendPolyVertex14A, TA_Vertex14A *vtx)
+  SKIP_HANDLER(AppendPolyVertex14B, TA_Vertex14B *vtx)
+
+  // Only looks for the end of the run, as VertexDecoder does
+  template <u32 poly_type>
+  static Ta_Dma *AppendPolyVertexRun(Ta_Dma *data, Ta_Dma *data_end)
+  {
+    while (!data->pcw.EndOfStrip && data != data_end)
+      data++;
+    return data;
+  }
+
+  SKIP_HANDLER(AppendSpriteParam, TA_SpriteParam *spr)
+  SKIP_HANDLER(AppendSpriteVertexA, TA_Sprite1A *sv)
+  SKIP_HANDLER(AppendSpriteVertexB, TA_Sprite1B *sv)
+
+  SKIP_HANDLER(AppendModVolParam, TA_ModVolParam *modv)
+  SKIP_HANDLER(StartModVol, TA_ModVolParam *param)
+  SKIP_HANDLER(ModVolStripEnd, )
+  SKIP_HANDLER(AppendModVolVertexA, TA_ModVolA *mvv)
+  SKIP_HANDLER(AppendModVolVertexB, TA_ModVolB *mvv)
+
+  __forceinline static void SetTileClip(u32 xmin, u32 ymin, u32 xmax, u32 ymax) {}
+  SKIP_HANDLER(TileClipMode, u32 mode)
+
+  SKIP_HANDLER(ListCont, )
+  SKIP_HANDLER(ListInit, )
+  SKIP_HANDLER(SoftReset, )
+};
+
+#undef SKIP_HANDLER
+
+bool ta_frame_skipped;
+u32 ta_skip_count;
+u32 ta_skip_lost;
+u32 ta_list_fb_w_sof1;
+static u32 skip_run;          // frames skipped in a row
+static bool last_rtt;         // the previous STARTRENDER rendered to texture
+
+bool TileAccel_Init()
+{
+  if (!ArenaInit())
+    return false;
+  reset_vtx_state();
+  ta_frame_skipped = last_rtt = false;
+  skip_run = 0;
+  TileSkip.Init();
+  return TileAccel.Init();
+}
+
+void TileAccel_Term()
+{
+  TileAccel.Term();
+  ModVolTerm();
+  ArenaTerm();
+}
+
+void TileAccel_Reset(bool Manual)
+{
+  TileAccel.Reset(Manual);
+}
+
+void TileAccel_ListCont()
+{
+  if (ta_frame_skipped)
+    TileSkip.ListCont();
+  else
+    TileAccel.ListCont();
+}
+
+void TileAccel_ListInit()
+{
+  // The render target is only final at STARTRENDER. A frame that may render
+  // to texture (the previous one did, or FB_W_SOF1 already points there) is
+  // decoded in full, and STARTRENDER can still drop it.
+  bool may_rtt = last_rtt || (ta_list_fb_w_sof1 & 0x1000000);
+  ta_frame_skipped = skip_run < spg_FrameSkip && !may_rtt;
+  if (ta_frame_skipped)
+    TileSkip.ListInit();
+  else
+    TileAccel.ListInit();
+}
+
+void TileAccel_SoftReset()
+{
+  TileSkip.SoftReset();
+  TileAccel.SoftReset();
+}
+
+bool TileAccel_StartRender()
+{
+  // A render to texture is always drawn, later frames sample the result
+  last_rtt = (FB_W_SOF1 & 0x1000000) != 0;
+  bool draw = !ta_frame_skipped && (last_rtt || skip_run >= spg_FrameSkip);
+
+  // Skipped at LIST_INIT but rendering to texture: its lists were never
+  // decoded, the texture keeps its old contents. last_rtt makes the next
+  // frame decode in full.
+  if (ta_frame_skipped && last_rtt)
+    ta_skip_lost++;
+
+  if (draw)
+  {
+    skip_run = 0;
+    return true;
+  }
+
+  // The backend resets the vertex state after drawing, do it for it
+  reset_vtx_state();
+  skip_run++;
+  ta_skip_count++;
+  return false;
+}
+
+// ============================
+// Translucent autosort (see ta_vtx.h)
+// ============================
+
+TaSortStats ta_sort_stats;
+
+static Array<SortTri> sort_tris;    // submission order
+static Array<SortTri> sort_out;     // draw order
+static Array<u32> sort_first;       // first triangle of every item, and the end
+static Array<u32> sort_key[2];
+static Array<u32> sort_item[2];
+
+// Grows 'a' to at least 'size' elements, never shrinks
+template <class T>
+static void SortReserve(Array<T> &a, u32 size)
+{
+  if (size > a.Size)
+    a.Resize(size + size / 2, false);
+}
+
+// Float to an unsigned key with the same order
+static INLINE u32 SortKey(float f)
+{
+  u32 u;
+  memcpy(&u, &f, 4);
+  return u ^ ((u32)((s32)u >> 31) | 0x80000000);
+}
+
+// LSD radix sort of the (key, item) pairs in buffer 0, 11 bit digits.
+// Returns the buffer holding the result.
+static u32 SortRadix(u32 count)
+{
+  u32 src = 0;
+
+  for (u32 shift = 0; shift < 32; shift += 11)
+  {
+    u32 hist[2048];
+    memset(hist, 0, sizeof(hist));
+
+    const u32 *key = sort_key[src].data;
+    const u32 *item = sort_item[src].data;
+
+    for (u32 i = 0; i < count; i++)
+      hist[(key[i] >> shift) & 2047]++;
+
+    // Every key has the same digit, the order does not change
+    if (hist[(key[0] >> shift) & 2047] == count)
+      continue;
+
+    u32 sum = 0;
+    for (u32 d = 0; d < 2048; d++)
+    {
+      u32 c = hist[d];
+      hist[d] = sum;
+      sum += c;
+    }
+
+    u32 *dst_key = sort_key[src ^ 1].data;
+    u32 *dst_item = sort_item[src ^ 1].data;
+    for (u32 i = 0; i < count; i++)
+    {
+      u32 pos = hist[(key[i] >> shift) & 2047]++;
+      dst_key[pos] = key[i];
+      dst_item[pos] = item[i];
+    }
+    src ^= 1;
+  }
+  return src;
+}
+
+u32 TA_SortMode()
+{
+  // Presort: the game already ordered the list
+  if (ISP_FEED_CFG & 1)
+    return 0;
+  return settings.Emulation.AlphaSortMode;
+}
+
+VertexList *TA_SortEnd(u32 mode)
+{
+  if (!mode || !TransLST)
+    return 0;
+
+  VertexList *end = TransEndLST ? TransEndLST : curLST;
+  return end > TransLST ? end : 0;
+}
+
+const SortTri *TA_SortTranslucent(u32 mode, u32 *count)
+{
+  double t0 = os_GetSeconds();
+  VertexList *end = TA_SortEnd(mode);
+
+  *count = 0;
+  if (!end)
+    return 0;
+
+  // Vertex and PolyParam of the first translucent strip
+  u32 vtx = 0;
+  s32 mod = -1;
+  for (VertexList *lst = lists; lst != TransLST; lst++)
+  {
+    s32 c = lst->count;
+    if (c < 0)
+    {
+      mod++;
+      c &= 0x7FFF;
+    }
+    vtx += c;
+  }
+
+  // A strip of n vertices has n-2 triangles
+  u32 max_tris = curVTX - vertices;
+  SortReserve(sort_tris, max_tris);
+  SortReserve(sort_out, max_tris);
+  SortReserve(sort_first, max_tris + 1);
+  for (u32 i = 0; i < 2; i++)
+  {
+    SortReserve(sort_key[i], max_tris);
+    SortReserve(sort_item[i], max_tris);
+  }
+
+  u32 tris = 0;
+  u32 items = 0;
+  for (VertexList *lst = TransLST; lst != end; lst++)
+  {
+    s32 c = lst->count;
+    if (c < 0)
+    {
+      mod++;
+      c &= 0x7FFF;
+    }
+
+    if (mod >= 0 && c >= 3)
+    {
+      float strip_z = 0;
+      u32 strip_first = tris;
+
+      for (s32 i = 0; i < c - 2; i++)
+      {
+        SortTri &t = sort_tris[tris++];
+        u32 v = vtx + i;
+        t.v[0] = (i & 1) ? v + 1 : v;
+        t.v[1] = (i & 1) ? v : v + 1;
+        t.v[2] = v + 2;
+        t.mod = mod;
+
+        if (mode == 2)
+        {
+          float z = vertices[v].z + vertices[v + 1].z + vertices[v + 2].z;
+          sort_first[items] = tris - 1;
+          sort_key[0][items] = SortKey(z * (1.f / 3.f));
+          sort_item[0][items] = items;
+          items++;
+        }
+      }
+
+      if (mode != 2)
+      {
+        for (s32 i = 0; i < c; i++)
+          strip_z += vertices[vtx + i].z;
+        sort_first[items] = strip_first;
+        sort_key[0][items] = SortKey(strip_z / c);
+        sort_item[0][items] = items;
+        items++;
+      }
+    }
+    vtx += c;
+  }
+  sort_first[items] = tris;
+
+  if (items)
+  {
+    const u32 *order = sort_item[SortRadix(items)].data;
+    SortTri *out = sort_out.data;
+    for (u32 i = 0; i < items; i++)
+    {
+      u32 it = order[i];
+      for (u32 t = sort_first[it]; t < sort_first[it + 1]; t++)
+        *out++ = sort_tris[t];
+    }
+  }
+
+  ta_sort_stats.frames++;
+  ta_sort_stats.tris += tris;
+  ta_sort_stats.time += os_GetSeconds() - t0;
+
+  *count = tris;
+  return sort_out.data;
+}
@@ -0,0 +1,245 @@
+#pragma once
+#include "drkPvr.h"
+#include "ta.h"
+
+// ============================================================================
+// TA vertex storage, shared by every renderer backend.
+//
+// The TA state machine (FifoSplitter<VertexDecoder>, ta_vtx.cpp) decodes the
+// incoming parameters into the arrays below; the backend walks them in
+// StartRender and calls reset_vtx_state() once the frame has been drawn.
+//
+// The arrays live in a grow-only arena: they start small, grow in chunks
+// while a frame is decoded (the contents are copied, so they stay contiguous
+// for indexed drawing) up to Emulation.MaxVertices, and are reused by every
+// following frame. Past the cap the rest of the frame is dropped and counted.
+//
+// lists[] holds one entry per strip. A negative count (bit 31 set) means the
+// strip starts with a new PolyParam, taken in order from listModes[]; the
+// vertex count is in the low 15 bits. Vertices are stored as x*W, y*W, W
+// (W = 1/z from the TA), so screen space is x/W, y/W.
+// ============================================================================
+
+struct Vertex
+{
+  float u, v;        // Texture coordinates
+  unsigned int col;  // Vertex color
+  float x, y, z;     // 3D coordinates
+};
+
+// Structures to manage the internal drawing lists and state
+// passed from the Dreamcast's Tile Accelerator.
+struct VertexList
+{
+  union
+  {
+    Vertex *ptr;
+    s32 count;
+  };
+};
+
+struct PolyParam
+{
+  PCW pcw;
+  ISP_TSP isp;
+
+  TSP tsp;
+  TCW tcw;
+};
+
+extern Vertex *vertices;
+extern VertexList *lists;
+extern PolyParam *listModes;
+
+extern Vertex *curVTX;
+extern VertexList *curLST;
+extern VertexList *TransLST;   // first strip of the translucent list, if any
+extern VertexList *TransEndLST; // one past its last strip, 0 while the list is open
+extern PolyParam *curMod;
+extern float vtx_min_Z;
+extern float vtx_max_Z;
+
+// Resets internal pointers for the next frame's vertex list.
+void reset_vtx_state();
+
+// Room is checked when a strip starts, and a strip may then add up to
+// TA_VTX_SLACK vertices (longer ones are split, see VertexDecoder::SplitStrip).
+// The cap is not tied to 16 bit indices: the draw batches index from a base
+// vertex of their own (Renderer_if.cpp), SortTri holds 32 bit indices. 256K
+// vertices is well past what the PVR parameter buffer can hold for a frame.
+#define TA_VTX_SLACK 4096
+#define TA_ARENA_MAX_VTX (256 * 1024)
+
+struct TaArenaStats
+{
+  u32 vtx_peak;   // high-water marks since the last TA_ArenaPrintStats
+  u32 lst_peak;
+  u32 mod_peak;
+  u32 grows;      // reallocations since the last TA_ArenaPrintStats
+  u32 clipped;    // frames truncated at the cap, since the last TA_ArenaPrintStats
+};
+
+extern TaArenaStats ta_arena_stats;
+
+// Print and clear the arena statistics, and the TA parse statistics
+// (TASplitter::ta_parse_stats, debug builds)
+void TA_ArenaPrintStats();
+
+// FifoSplitter<VertexDecoder> entry points (rend_init, rend_list_init ...)
+bool TileAccel_Init();
+void TileAccel_Term();
+void TileAccel_Reset(bool Manual);
+void TileAccel_ListCont();
+void TileAccel_ListInit();
+void TileAccel_SoftReset();
+
+// ============================================================================
+// Frame skipping
+//
+// With Emulation.FrameSkip set, SPG adapts spg_FrameSkip to the host time
+// the last frames took against their emulated length. Up to that many frames
+// in a row are then skipped, decided at TA_LIST_INIT: from there on their TA
+// data goes through FifoSplitter<SkipDecoder>, which keeps the list
+// boundaries and list end interrupts but decodes no vertex, and STARTRENDER
+// draws nothing (the render end interrupts are still raised on time).
+//
+// Renders to texture are never skipped. Whether a frame renders to texture
+// is only final at STARTRENDER (FB_W_SOF1), so a frame is decoded in full
+// when the previous one rendered to texture or FB_W_SOF1 already points to
+// texture memory at TA_LIST_INIT (ta_list_fb_w_sof1, sampled by the SH4 even
+// with the threaded TA); STARTRENDER may still drop such a frame.
+// A skipped frame that turns out to render to texture is counted in
+// ta_skip_lost, and the next frame is decoded in full.
+// ============================================================================
+
+extern bool ta_frame_skipped;   // the current frame goes through the SkipDecoder
+extern u32 ta_skip_count;       // frames skipped, cleared by the FPS counter
+extern u32 ta_skip_lost;        // renders to texture lost to a skip, cleared by the FPS counter
+extern u32 ta_list_fb_w_sof1;   // FB_W_SOF1 at the last TA_LIST_INIT write (ta.cpp)
+
+// STARTRENDER: false when the frame was skipped and must not be drawn
+bool TileAccel_StartRender();
+
+// ============================================================================
+// Modifier volumes
+//
+// Triangles of the modifier volume lists are stored apart from the strips,
+// as the TA sent them: screen x, y and z (1/w, larger is nearer). modParams[]
+// has one entry per volume parameter, in order, with the triangles that
+// follow it. The ISP DepthMode field of a volume parameter is the volume
+// instruction: 0 adds its triangles to the open volume, 1 (inside last poly)
+// and 2 (outside last poly) add them and close the volume.
+//
+// A polygon with the shadow bit set is modified where it is the visible
+// surface inside a closed inclusion volume, or outside an exclusion one.
+// Backends only walk the volumes when TA_ModVolActive().
+// ============================================================================
+
+struct ModTriangle
+{
+  float x0, y0, z0;
+  float x1, y1, z1;
+  float x2, y2, z2;
+};
+
+struct ModParam
+{
+  ISP_TSP isp;    // DepthMode: volume instruction
+  u32 list;       // ListType_Opaque_Modifier_Volume or the translucent one
+  u32 first;      // first triangle in modTris
+  u32 count;
+};
+
+extern ModTriangle *modTris;
+extern ModParam *modParams;
+extern u32 modTriCount;
+extern u32 modParamCount;
+extern bool ta_shadow_used;     // a PolyParam of this frame has the shadow bit
+
+// Volumes are enabled (Emulation.ModVolMode), present, and used this frame
+bool TA_ModVolActive();
+
+union _ISP_BACKGND_T_type
+{
+  struct
+  {
+    u32 tag_offset : 3;
+    u32 tag_address : 21;
+    u32 skip : 3;
+    u32 shadow : 1;
+    u32 cache_bypass : 1;
+  };
+  u32 full;
+};
+
+union _ISP_BACKGND_D_type
+{
+  u32 i;
+  f32 f;
+};
+
+// Conversion logic to translate Dreamcast VRAM addressing (32-bit interleaved)
+// into a linear 64-bit bank structure compatible with the emulator's memory map.
+static INLINE u32 fast_ConvOffset32toOffset64(u32 offset32)
+{
+  offset32 &= VRAM_MASK;
+  u32 bank = ((offset32 >> 22) & 0x1) << 2;
+  u32 lower = offset32 & 0x3;
+  u32 addr_shifted = (offset32 & 0x3FFFFC) << 1;
+  return addr_shifted | bank | lower;
+}
+
+// Helpers to read float/int values directly from the virtualized PVR VRAM.
+f32 vrf(u32 addr);
+u32 vri(u32 addr);
+
+// Converts 16-bit PVR UV coordinates to 32-bit floats.
+static INLINE f32 CVT16UV(u32 uv)
+{
+  uv <<= 16;
+  f32 f;
+  memcpy(&f, &uv, 4);
+  return f;
+}
+
+// Primary decoder that translates raw PVR vertex data into the 'Vertex' struct.
+void decode_pvr_vertex(u32 base, u32 ptr, Vertex *cv);
+
+// Decodes the background polygon vertex described by ISP_BACKGND_T.
+void decode_pvr_background(Vertex *cv);
+
+// ============================================================================
+// Translucent autosort
+//
+// With ISP_FEED_CFG set to autosort the PVR orders translucent polygons by
+// depth itself. TA_SortTranslucent approximates it as selected by
+// Emulation.AlphaSortMode: 1 sorts whole strips, 2 splits the strips into
+// triangles and sorts those. The key is the mean W of the vertices (1/z, so
+// smaller is farther), farthest drawn first, with a stable O(n) radix sort:
+// equal keys keep submission order. The buffers grow as needed and are kept
+// between frames.
+// ============================================================================
+
+struct SortTri
+{
+  u32 v[3];   // vertex indices, strip winding already applied
+  u32 mod;    // listModes index
+};
+
+struct TaSortStats
+{
+  u32 frames;
+  u32 tris;
+  double time;
+};
+
+extern TaSortStats ta_sort_stats;
+
+// Sort mode for this frame, 0 when the translucent list is drawn as submitted
+u32 TA_SortMode();
+
+// Strips covered by the sort: [TransLST, TA_SortEnd()), or 0 when not sorting
+VertexList *TA_SortEnd(u32 mode);
+
+// Translucent triangles in draw order, valid until the next call
+const SortTri *TA_SortTranslucent(u32 mode, u32 *count);
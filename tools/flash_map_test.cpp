@@ -0,0 +1,117 @@
+// flash_map_test : guest writes to BIOS/flash images mapped with
+// Emulator.MapFiles (dc/mem/memutil.cpp).
+//
+// usage: flash_map_test [scratch directory]
+//
+// Maps a flash image over its arena slot, the way LoadBiosFiles does, then
+// writes it the way the guest does (sh4_area0.cpp stores into flash_b.data):
+//   - default image (private mapping): the writes land, the file is unchanged
+//   - writeback file (shared mapping): the writes reach the file on save
+// and checks the BIOS mapping reads back the image. Exits with 1 on failure,
+// a write to a read-only mapping kills it with SIGSEGV.
+//
+// Built by the FLASH_MAP_TEST cmake option, as a host tool, see
+// CMakeREADME.txt for the configure line.
+
+#include "types.h"
+#include "dc/mem/sh4_mem.h"
+#include "dc/mem/memutil.h"
+#include "dc/mem/_vmem.h"
+#include <sys/mman.h>
+
+// Host glue normally provided by the emulator core
+__settings settings;
+bool _vmem_arena_hugetlb = false;
+VArray2 mem_b;
+VArray2 bios_b;
+VArray2 flash_b;
+u8 fastcall _vmem_ReadMem8(u32 Address) { return 0; }  // LoadBinfileToSh4Mem, unused
+
+static u32 failures = 0;
+
+static void Check(bool ok, const char* what)
+{
+    printf("%s: %s\n", ok ? "ok  " : "FAIL", what);
+    if (!ok)
+        failures++;
+}
+
+static void MakeImage(const char* path, u32 size, u8 seed)
+{
+    FILE* f = fopen(path, "wb");
+    for (u32 i = 0; i < size; i++)
+        fputc((u8)(i * 7 + seed), f);
+    fclose(f);
+}
+
+// True if the file still holds the image MakeImage wrote
+static bool IsImage(const char* path, u32 size, u8 seed)
+{
+    FILE* f = fopen(path, "rb");
+    if (!f)
+        return false;
+    bool same = true;
+    for (u32 i = 0; i < size && same; i++)
+        same = fgetc(f) == (u8)(i * 7 + seed);
+    fclose(f);
+    return same;
+}
+
+static u32 FileWord(const char* path, u32 offset)
+{
+    u32 rv = 0;
+    FILE* f = fopen(path, "rb");
+    fseek(f, offset, SEEK_SET);
+    fread(&rv, 4, 1, f);
+    fclose(f);
+    return rv;
+}
+
+// Guest flash write, as WriteMem_area0 does it
+static void GuestFlashWrite32(u32 offset, u32 data)
+{
+    *(u32*)&flash_b.data[offset] = data;
+}
+
+int main(int argc, char** argv)
+{
+    const char* dir = argc > 1 ? argv[1] : "/tmp";
+    char bios_path[512], flash_path[512];
+    sprintf(bios_path, "%s/flash_map_test_bios.bin", dir);
+    sprintf(flash_path, "%s/flash_map_test_flash.bin", dir);
+
+    // The BIOS and flash slots of the arena, page aligned as in _vmem.cpp
+    u8* arena = (u8*)mmap(0, BIOS_SIZE + FLASH_SIZE, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    bios_b.data = arena;
+    bios_b.size = BIOS_SIZE;
+    flash_b.data = arena + BIOS_SIZE;
+    flash_b.size = FLASH_SIZE;
+
+    settings.emulator.MapFiles = true;
+
+    MakeImage(bios_path, BIOS_SIZE, 1);
+    Check(LoadFileToSh4Bootrom(bios_path), "BIOS mapped");
+    Check(bios_b.data[0x1234] == (u8)(0x1234 * 7 + 1), "BIOS reads the image");
+
+    // Default image: private, copy on write
+    MakeImage(flash_path, FLASH_SIZE, 2);
+    Check(LoadFileToSh4Flashrom(flash_path, false), "default flash mapped");
+    GuestFlashWrite32(0x1A000, 0xDEADBEEF);
+    Check(*(u32*)&flash_b.data[0x1A000] == 0xDEADBEEF, "default flash takes guest writes");
+    UnmapSh4RomFiles();
+    Check(IsImage(flash_path, FLASH_SIZE, 2), "default flash image left unchanged");
+
+    // Writeback file: shared, saving syncs it
+    Check(LoadFileToSh4Flashrom(flash_path, true), "writeback flash mapped");
+    GuestFlashWrite32(0x1A000, 0xDEADBEEF);
+    Check(SaveSh4FlashromToFile(flash_path), "writeback flash saved");
+    Check(FileWord(flash_path, 0x1A000) == 0xDEADBEEF, "writeback flash file has the write");
+    UnmapSh4RomFiles();
+
+    remove(bios_path);
+    remove(flash_path);
+
+    printf("flash_map_test: %s\n", failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,310 @@
+// ta_bench : TA parser throughput (plugs/drkPvr/ta.h, FifoSplitter) in packets/s.
+//
+// usage: ta_bench [strip length] [packets per dma | sq]
+//
+// Builds synthetic TA frames, one per kind of data a game sends (32 and 64
+// byte polygon vertices, sprites, modifier volumes, and a frame mixing them
+// over the lists), and pushes each one through the TA the way a TA DMA does,
+// or 32 bytes at a time through the store queue path with 'sq', over and
+// over. Every frame is parsed and decoded into the vertex arena and then
+// dropped, nothing is drawn. Prints 32 byte packets/s, vertices/s and the
+// state machine entries per frame (ta_parse_stats.entries).
+//
+// Built by the TA_BENCH cmake option, as a host tool (REND_NULL), see
+// CMakeREADME.txt for the configure line.
+
+#include "plugs/drkPvr/drkPvr.h"
+#include "plugs/drkPvr/ta.h"
+#include "plugs/drkPvr/ta_vtx.h"
+#include "plugs/drkPvr/regs.h"
+#include <sys/time.h>
+#include <stdarg.h>
+
+using namespace TASplitter;
+
+// Host glue normally provided by the emulator core
+u32 Array_T_id_count;
+
+double os_GetSeconds()
+{
+    timeval tv;
+    gettimeofday(&tv, 0);
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+char* GetEmuPath(const char* subpath)
+{
+    char* path = (char*)malloc(strlen(subpath) + 1);
+    strcpy(path, subpath);
+    return path;
+}
+
+int msgboxf(const char* text, unsigned int type, ...)
+{
+    va_list args;
+    va_start(args, type);
+    vprintf(text, args);
+    va_end(args);
+    return 0;
+}
+
+int cfgLoadInt(const char* section, const char* key, int def) { return def; }
+void cfgSaveInt(const char* section, const char* key, int value) {}
+
+s32 FASTCALL libPvr_Init(pvr_init_params* param);
+void FASTCALL libPvr_Term();
+void libPvr_TaDMA(u32* data, u32 size);
+void libPvr_TaSQ(u32* data);
+
+static u8 vram[VRAM_SIZE];
+
+static void FASTCALL RaiseInterrupt(HollyInterruptID intr) {}
+
+#define BENCH_STRIPS 1024   // per list, well under the vertex arena cap
+
+enum BenchKind
+{
+    BENCH_VTX32,        // untextured packed colour strips, 32B vertices (type 0)
+    BENCH_VTX32_TEX,    // textured packed colour strips, 32B vertices (type 3)
+    BENCH_VTX64,        // textured floating colour strips, 64B vertices (type 5)
+    BENCH_SPRITE,       // textured sprites, 64B each
+    BENCH_MODVOL,       // modifier volume triangles, 64B each
+    BENCH_MIXED,        // one list of each of the above
+};
+
+static const char* bench_names[] =
+{
+    "32B strips",
+    "32B textured strips",
+    "64B strips",
+    "sprites",
+    "modifier volumes",
+    "mixed lists",
+};
+
+struct BenchFrame
+{
+    Array<Ta_Dma> data;
+    u32 size;           // packets
+    u32 vertices;       // polygon and sprite vertices, modifier volume triangles
+};
+
+static Ta_Dma* Emit(BenchFrame& frame, u32 para_type, u32 list_type)
+{
+    if (frame.size == frame.data.Size)
+        frame.data.Resize(frame.data.Size * 2 + 1024, false);
+    Ta_Dma* pkt = &frame.data[frame.size++];
+    memset(pkt, 0, sizeof(*pkt));
+    pkt->pcw.ParaType = para_type;
+    pkt->pcw.ListType = list_type;
+    return pkt;
+}
+
+// Second half of a 64B parameter, no PCW
+static u32* EmitB(BenchFrame& frame)
+{
+    Ta_Dma* pkt = Emit(frame, 0, 0);
+    return (u32*)pkt;
+}
+
+static void EmitXYZ(f32* xyz, u32 i)
+{
+    xyz[0] = (f32)(i * 7 % 640);
+    xyz[1] = (f32)(i * 13 % 480);
+    xyz[2] = 1.0f / (1 + i % 64);
+}
+
+static void EmitEndOfList(BenchFrame& frame, u32 list_type)
+{
+    Emit(frame, ParamType_End_Of_List, list_type);
+}
+
+static void EmitStrips(BenchFrame& frame, u32 list_type, u32 strip_len, bool textured, bool float_col)
+{
+    for (u32 s = 0; s < BENCH_STRIPS; s++)
+    {
+        Ta_Dma* pp = Emit(frame, ParamType_Polygon_or_Modifier_Volume, list_type);
+        pp->pcw.Texture = textured;
+        pp->pcw.Col_Type = float_col ? 1 : 0;
+        pp->pcw.Gouraud = 1;
+
+        for (u32 i = 0; i < strip_len; i++)
+        {
+            Ta_Dma* v = Emit(frame, ParamType_Vertex_Parameter, list_type);
+            v->pcw.EndOfStrip = i == strip_len - 1;
+            TA_VertexParam* vp = (TA_VertexParam*)v;
+            EmitXYZ(vp->vtx0.xyz, s * strip_len + i);
+            if (float_col)
+            {
+                vp->vtx5A.u = vp->vtx5A.v = 0.5f;
+                f32* col = (f32*)EmitB(frame);
+                col[0] = col[1] = col[2] = col[3] = 1.0f;
+            }
+            else if (textured)
+            {
+                vp->vtx3.u = vp->vtx3.v = 0.5f;
+                vp->vtx3.BaseCol = 0xFF808080;
+            }
+            else
+                vp->vtx0.BaseCol = 0xFF808080;
+        }
+        frame.vertices += strip_len;
+    }
+    EmitEndOfList(frame, list_type);
+}
+
+static void EmitSprites(BenchFrame& frame, u32 list_type)
+{
+    Ta_Dma* sp = Emit(frame, ParamType_Sprite, list_type);
+    sp->pcw.Texture = 1;
+    ((TA_SpriteParam*)sp)->BaseCol = 0xFFFFFFFF;
+
+    for (u32 s = 0; s < BENCH_STRIPS; s++)
+    {
+        Ta_Dma* v = Emit(frame, ParamType_Vertex_Parameter, list_type);
+        v->pcw.EndOfStrip = 1;
+        TA_Sprite1A* a = &((TA_VertexParam*)v)->spr1A;
+        a->x0 = a->x1 = (f32)(s % 640);
+        a->y0 = (f32)(s % 480);
+        a->y1 = a->y0 + 16;
+        a->z0 = a->z1 = 1.0f;
+        a->x2 = a->x0 + 16;
+
+        TA_Sprite1B* b = (TA_Sprite1B*)EmitB(frame);
+        b->y2 = a->y1;
+        b->z2 = 1.0f;
+        b->x3 = a->x2;
+        b->y3 = a->y0;
+        frame.vertices += 4;
+    }
+    EmitEndOfList(frame, list_type);
+}
+
+static void EmitModVols(BenchFrame& frame, u32 list_type)
+{
+    for (u32 s = 0; s < BENCH_STRIPS / 8; s++)
+    {
+        Emit(frame, ParamType_Polygon_or_Modifier_Volume, list_type);
+
+        // A closed volume, 8 triangles
+        for (u32 t = 0; t < 8; t++)
+        {
+            Ta_Dma* v = Emit(frame, ParamType_Vertex_Parameter, list_type);
+            TA_ModVolA* a = &((TA_VertexParam*)v)->mvolA;
+            a->x0 = (f32)(t * 8);
+            a->y0 = (f32)(s % 480);
+            a->z0 = 1.0f;
+            a->x1 = a->x0 + 8;
+            a->y1 = a->y0;
+            a->z1 = 1.0f;
+            a->x2 = a->x0;
+
+            TA_ModVolB* b = (TA_ModVolB*)EmitB(frame);
+            b->y2 = a->y0 + 8;
+            b->z2 = 1.0f;
+            frame.vertices++;
+        }
+    }
+    EmitEndOfList(frame, list_type);
+}
+
+static void BuildFrame(BenchFrame& frame, BenchKind kind, u32 strip_len)
+{
+    frame.size = 0;
+    frame.vertices = 0;
+
+    switch (kind)
+    {
+    case BENCH_VTX32:     EmitStrips(frame, ListType_Opaque, strip_len, false, false); break;
+    case BENCH_VTX32_TEX: EmitStrips(frame, ListType_Opaque, strip_len, true, false); break;
+    case BENCH_VTX64:     EmitStrips(frame, ListType_Opaque, strip_len, true, true); break;
+    case BENCH_SPRITE:    EmitSprites(frame, ListType_Punch_Through); break;
+    case BENCH_MODVOL:    EmitModVols(frame, ListType_Opaque_Modifier_Volume); break;
+
+    case BENCH_MIXED:
+        EmitStrips(frame, ListType_Opaque, strip_len, true, false);
+        EmitModVols(frame, ListType_Opaque_Modifier_Volume);
+        EmitStrips(frame, ListType_Translucent, strip_len, true, true);
+        EmitSprites(frame, ListType_Punch_Through);
+        break;
+    }
+}
+
+// Parses 'frame' until 'min_time' has passed, returns the frames per second.
+// 'chunk' 0 sends the packets through the store queue path.
+static double Bench(BenchFrame& frame, u32 chunk, double min_time, u32* frames_run)
+{
+    u32 frames = 0;
+    double t0 = os_GetSeconds();
+    double elapsed;
+    do
+    {
+        for (u32 n = 0; n < 16; n++)
+        {
+            TA_Control(TA_CTRL_LIST_INIT);
+            if (chunk == 0)
+            {
+                for (u32 pos = 0; pos < frame.size; pos++)
+                    libPvr_TaSQ((u32*)&frame.data[pos]);
+                TA_SQFlush();
+            }
+            for (u32 pos = 0; chunk && pos < frame.size; pos += chunk)
+            {
+                u32 size = frame.size - pos < chunk ? frame.size - pos : chunk;
+                libPvr_TaDMA((u32*)&frame.data[pos], size);
+            }
+            reset_vtx_state();
+        }
+        frames += 16;
+        elapsed = os_GetSeconds() - t0;
+    }
+    while (elapsed < min_time);
+
+    *frames_run = frames;
+    return frames / elapsed;
+}
+
+int main(int argc, char** argv)
+{
+    u32 strip_len = argc > 1 ? atoi(argv[1]) : 8;
+    bool sq = argc > 2 && strcmp(argv[2], "sq") == 0;
+    u32 chunk = argc > 2 && !sq ? atoi(argv[2]) : 0;
+    if (strip_len < 3)
+        strip_len = 3;
+
+    LoadSettings();
+    settings.Emulation.ThreadedTA = 0;
+    settings.Emulation.FrameSkip = 0;
+    settings.Capture.Frames = 0;
+
+    pvr_init_params init;
+    memset(&init, 0, sizeof(init));
+    init.vram = vram;
+    init.RaiseInterrupt = RaiseInterrupt;
+    if (libPvr_Init(&init) != rv_ok)
+        return 1;
+
+    printf("ta_bench: %u vertices per strip, %s\n", strip_len,
+           sq ? "store queues" : chunk ? "split dma" : "one dma per frame");
+
+    BenchFrame frame;
+    for (u32 kind = BENCH_VTX32; kind <= BENCH_MIXED; kind++)
+    {
+        BuildFrame(frame, (BenchKind)kind, strip_len);
+        u32 dma_size = sq ? 0 : chunk ? chunk : frame.size;
+        u32 frames;
+
+        // Warm up the vertex arena, then measure
+        Bench(frame, dma_size, 0, &frames);
+        ta_parse_stats.entries = 0;
+        double fps = Bench(frame, dma_size, 0.5, &frames);
+
+        printf("%-20s: %6u packets/frame, %6.2f M packets/s, %6.2f M vertices/s, %7.0f frames/s, "
+               "%6u entries/frame\n",
+               bench_names[kind], frame.size, frame.size * fps / 1e6, frame.vertices * fps / 1e6, fps,
+               ta_parse_stats.entries / frames);
+    }
+
+    libPvr_Term();
+    return 0;
+}
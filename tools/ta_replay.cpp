@@ -0,0 +1,254 @@
+// ta_replay : replays a TA capture (plugs/drkPvr/ta_capture.h) through the TA
+// and the renderer backend the PVR plugin is built with, without the CPU core.
+//
+// usage: ta_replay <capture> [passes] [-dump <prefix>]
+//
+// For every frame it prints the TA data size, the vertex / strip / PolyParam
+// counts, the time spent parsing the TA data and the time spent in
+// STARTRENDER, then the backend statistics. With -dump the frames are saved
+// as <prefix>NNNNN.ppm (software renderer).
+//
+// Built by the TA_REPLAY cmake option, as a host tool (REND_SOFT). With
+// TA_REPLAY_NULL it uses the null renderer (REND_NULL) instead: the frames are
+// parsed, compiled into batches and their textures looked up, but not drawn,
+// so the render time is the CPU side of the PVR alone. See CMakeREADME.txt for
+// the configure line.
+
+#include "plugs/drkPvr/drkPvr.h"
+#include "plugs/drkPvr/ta.h"
+#include "plugs/drkPvr/ta_vtx.h"
+#include "plugs/drkPvr/ta_capture.h"
+#include "plugs/drkPvr/regs.h"
+#include "plugs/drkPvr/Renderer_if.h"
+#include <sys/time.h>
+#include <stdarg.h>
+
+// Host glue normally provided by the emulator core
+u32 Array_T_id_count;
+
+double os_GetSeconds()
+{
+    timeval tv;
+    gettimeofday(&tv, 0);
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+char* GetEmuPath(const char* subpath)
+{
+    char* path = (char*)malloc(strlen(subpath) + 1);
+    strcpy(path, subpath);
+    return path;
+}
+
+int msgboxf(const char* text, unsigned int type, ...)
+{
+    va_list args;
+    va_start(args, type);
+    vprintf(text, args);
+    va_end(args);
+    return 0;
+}
+
+int cfgLoadInt(const char* section, const char* key, int def) { return def; }
+void cfgSaveInt(const char* section, const char* key, int value) {}
+
+s32 FASTCALL libPvr_Init(pvr_init_params* param);
+void FASTCALL libPvr_Term();
+void libPvr_TaDMA(u32* data, u32 size);
+
+static u8 vram[VRAM_SIZE];
+
+static void FASTCALL RaiseInterrupt(HollyInterruptID intr) {}
+
+static void Swap32(void* data, u32 size)
+{
+    u32* p = (u32*)data;
+    for (u32 i = 0; i < size / 4; i++)
+        p[i] = (p[i] >> 24) | ((p[i] >> 8) & 0xFF00) | ((p[i] << 8) & 0xFF0000) | (p[i] << 24);
+}
+
+// Copies { u32 offset; u8 data[page]; } records into 'mem'
+static void ApplyDiff(u8* mem, u32 mem_size, u8* chunk, u32 size, u32 page)
+{
+    for (u32 pos = 0; pos + 4 + page <= size; pos += 4 + page)
+    {
+        u32 offs;
+        memcpy(&offs, chunk + pos, 4);
+        if (offs + page <= mem_size)
+            memcpy(mem + offs, chunk + pos + 4, page);
+    }
+}
+
+struct FrameStats
+{
+    u32 data_size;
+    double parse_time;
+};
+
+int main(int argc, char** argv)
+{
+    const char* file_name = 0;
+    const char* dump_prefix = 0;
+    u32 passes = 1;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-dump") && i + 1 < argc)
+            dump_prefix = argv[++i];
+        else if (!file_name)
+            file_name = argv[i];
+        else
+            passes = atoi(argv[i]);
+    }
+    if (!file_name || !passes)
+    {
+        printf("usage: ta_replay <capture> [passes] [-dump <prefix>]\n");
+        return 1;
+    }
+
+    FILE* f = fopen(file_name, "rb");
+    if (!f)
+    {
+        printf("ta_replay: cannot open %s\n", file_name);
+        return 1;
+    }
+
+    TaCaptureHeader header;
+    if (fread(&header, sizeof(header), 1, f) != 1 || memcmp(header.magic, TACAP_MAGIC, 8))
+    {
+        printf("ta_replay: %s is not a TA capture\n", file_name);
+        return 1;
+    }
+    bool swap = header.endian != TACAP_ENDIAN;
+    if (swap)
+        Swap32(&header.version, sizeof(header) - 8);
+    if (header.version != TACAP_VERSION || header.vram_size != VRAM_SIZE || header.reg_size != RegSize)
+    {
+        printf("ta_replay: unsupported capture (version %u)\n", header.version);
+        return 1;
+    }
+    long data_start = ftell(f);
+
+    // Parse inline so the parse and render times can be told apart
+    LoadSettings();
+    settings.Emulation.ThreadedTA = 0;
+    settings.Emulation.FrameSkip = 0;
+    settings.Capture.Frames = 0;
+    settings.OSD.ShowStats = 1;
+
+    pvr_init_params init;
+    memset(&init, 0, sizeof(init));
+    init.vram = vram;
+    init.RaiseInterrupt = RaiseInterrupt;
+    if (libPvr_Init(&init) != rv_ok)
+        return 1;
+
+    printf("ta_replay: %s, %u frames%s, %s\n", file_name, header.frames,
+           header.frames ? "" : " (capture not closed)", swap ? "byte swapped" : "native byte order");
+
+    Array<u8> chunk_data;
+    chunk_data.Resize(1024 * 1024, false);
+    double total_parse = 0, total_render = 0;
+    u32 total_frames = 0;
+
+    for (u32 pass = 0; pass < passes; pass++)
+    {
+        fseek(f, data_start, SEEK_SET);
+        memset(vram, 0, sizeof(vram));
+        memset(regs, 0, sizeof(regs));
+        Regs_PaletteDirty();
+
+        FrameStats frame;
+        memset(&frame, 0, sizeof(frame));
+        u32 frame_num = 0;
+
+        TaCaptureChunk chunk;
+        while (fread(&chunk, sizeof(chunk), 1, f) == 1)
+        {
+            if (swap)
+                Swap32(&chunk, sizeof(chunk));
+            if (chunk.size > chunk_data.Size)
+                chunk_data.Resize(chunk.size, false);
+            if (fread(chunk_data.data, 1, chunk.size, f) != chunk.size)
+                break;
+            if (swap)
+                Swap32(chunk_data.data, chunk.size);
+
+            switch (chunk.type)
+            {
+            case TACAP_DATA:
+            {
+                double t0 = os_GetSeconds();
+                libPvr_TaDMA((u32*)chunk_data.data, chunk.size / 32);
+                frame.parse_time += os_GetSeconds() - t0;
+                frame.data_size += chunk.size;
+                break;
+            }
+
+            case TACAP_REGS:
+                ApplyDiff(regs, RegSize, chunk_data.data, chunk.size, TACAP_REG_PAGE);
+                Regs_PaletteDirty();
+                break;
+
+            case TACAP_VRAM:
+                ApplyDiff(vram, VRAM_SIZE, chunk_data.data, chunk.size, TACAP_VRAM_PAGE);
+                break;
+
+            case TACAP_CTRL:
+            {
+                u32 ctrl;
+                memcpy(&ctrl, chunk_data.data, 4);
+                if (ctrl != TASplitter::TA_CTRL_START_RENDER)
+                {
+                    TASplitter::TA_Control(ctrl);
+                    break;
+                }
+
+                u32 vtx = curVTX - vertices;
+                u32 strips = curLST - lists;
+                u32 modes = curMod - listModes;
+
+                double t0 = os_GetSeconds();
+                TASplitter::TA_Control(ctrl);
+                double render_time = os_GetSeconds() - t0;
+
+                if (pass == 0)
+                    printf("frame %5u: %7u KB TA, %6u vertices, %5u strips, %5u params, "
+                           "parse %6.3f ms, render %6.3f ms\n",
+                           frame_num, frame.data_size / 1024, vtx, strips, modes,
+                           frame.parse_time * 1000, render_time * 1000);
+
+#if REND_API == REND_SOFT
+                if (dump_prefix && pass == 0)
+                {
+                    char name[512];
+                    sprintf(name, "%s%05u.ppm", dump_prefix, frame_num);
+                    SoftRend_SaveFrame(name);
+                }
+#endif
+                total_parse += frame.parse_time;
+                total_render += render_time;
+                total_frames++;
+                frame_num++;
+                memset(&frame, 0, sizeof(frame));
+                break;
+            }
+
+            default:
+                printf("ta_replay: unknown chunk type %u\n", chunk.type);
+                break;
+            }
+        }
+    }
+
+    if (total_frames)
+        printf("%u frames, parse %.3f ms, render %.3f ms per frame\n", total_frames,
+               total_parse * 1000 / total_frames, total_render * 1000 / total_frames);
+
+    char stats[] = "ta_replay\n";
+    rend_set_fps_text(stats);
+
+    libPvr_Term();
+    fclose(f);
+    return 0;
+}
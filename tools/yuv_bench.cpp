@@ -0,0 +1,126 @@
+// yuv_bench : checks the YUV converter macroblock decoders (dc/pvr/pvr_yuv.h)
+// against the per-pixel reference and measures their throughput.
+//
+// usage: yuv_bench [macroblocks]
+//
+// Converts a 640x480 frame (40x30 macroblocks) over and over, the way an FMV
+// is fed to the converter, and prints macroblocks/s for 4:2:0 and 4:2:2.
+//
+// Built by the YUV_BENCH cmake option, as a host tool, see CMakeREADME.txt
+// for the configure line.
+
+#include "dc/pvr/pvr_yuv.h"
+#include <sys/time.h>
+
+#define MB_X 40
+#define MB_Y 30
+#define PITCH (MB_X * 16 * 2)
+
+static double GetSeconds()
+{
+    timeval tv;
+    gettimeofday(&tv, 0);
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+// Per-pixel reference, as the converter did it before pvr_yuv
+static u8 RefY(const u8* Y, int x, int y)
+{
+    if (x > 7) { x -= 8; Y += 64; }
+    if (y > 7) { y -= 8; Y += 128; }
+#if HOST_ENDIAN == ENDIAN_BIG
+    return *(const u8*)((unat)&Y[x + y * 8] ^ 3);
+#else
+    return Y[x + y * 8];
+#endif
+}
+
+static void RefBlock(const u8* src, u8* dst, u32 pitch, bool is422)
+{
+    u32 uv_size = is422 ? 128 : 64;
+    const u8* U = src;
+    const u8* V = src + uv_size;
+    const u8* Y = src + uv_size * 2;
+
+    for (int y = 0; y < 16; y++) {
+        int cy = is422 ? y : y >> 1;
+        for (int x = 0; x < 16; x += 2) {
+            u8 yuyv[4];
+            yuyv[0] = U[(x >> 1) + cy * 8];
+            yuyv[1] = RefY(Y, x, y);
+            yuyv[2] = V[(x >> 1) + cy * 8];
+            yuyv[3] = RefY(Y, x + 1, y);
+            *(u32*)&dst[y * pitch + x * 2] = *(u32*)yuyv;
+        }
+    }
+}
+
+static bool Check(bool is422, const u32* src, u8* out, u8* ref)
+{
+    u32 block_size = is422 ? 512 : 384;
+    for (u32 b = 0; b < MB_X * MB_Y; b++) {
+        u32 offs = (b % MB_X) * 32 + (b / MB_X) * 16 * PITCH;
+        const u8* block = (const u8*)src + b * block_size;
+        RefBlock(block, ref + offs, PITCH, is422);
+        if (is422)
+            YUV_Block422(block, out + offs, PITCH);
+        else
+            YUV_Block420(block, out + offs, PITCH);
+    }
+    return memcmp(out, ref, PITCH * MB_Y * 16) == 0;
+}
+
+static double Bench(bool is422, const u32* src, u8* out, u32 total, bool reference)
+{
+    u32 block_size = is422 ? 512 : 384;
+    double t0 = GetSeconds();
+    for (u32 n = 0; n < total; n++) {
+        u32 b = n % (MB_X * MB_Y);
+        u32 offs = (b % MB_X) * 32 + (b / MB_X) * 16 * PITCH;
+        const u8* block = (const u8*)src + b * block_size;
+        if (reference)
+            RefBlock(block, out + offs, PITCH, is422);
+        else if (is422)
+            YUV_Block422(block, out + offs, PITCH);
+        else
+            YUV_Block420(block, out + offs, PITCH);
+    }
+    return total / (GetSeconds() - t0);
+}
+
+int main(int argc, char** argv)
+{
+    u32 total = argc > 1 ? atoi(argv[1]) : 200000;
+    if (!total)
+        total = 200000;
+
+    u32 src_words = MB_X * MB_Y * 512 / 4;
+    u32* src = (u32*)malloc(src_words * 4);
+    u8* out = (u8*)malloc(PITCH * MB_Y * 16);
+    u8* ref = (u8*)malloc(PITCH * MB_Y * 16);
+
+    u32 seed = 0x12345678;
+    for (u32 i = 0; i < src_words; i++) {
+        seed = seed * 1664525 + 1013904223;
+        src[i] = seed;
+    }
+
+    int failed = 0;
+    for (int is422 = 0; is422 < 2; is422++) {
+        const char* name = is422 ? "4:2:2" : "4:2:0";
+        if (!Check(is422 != 0, src, out, ref)) {
+            printf("%s: output differs from the reference\n", name);
+            failed = 1;
+            continue;
+        }
+        double ref_rate = Bench(is422 != 0, src, out, total / 4, true);
+        double rate = Bench(is422 != 0, src, out, total, false);
+        printf("%s: %.0f macroblocks/s (reference %.0f, %.2fx), %.1f 640x480 frames/s\n",
+               name, rate, ref_rate, rate / ref_rate, rate / (MB_X * MB_Y));
+    }
+
+    free(src);
+    free(out);
+    free(ref);
+    return failed;
+}
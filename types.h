@@ -232,6 +232,7 @@ struct __settings
 	{
 		bool AutoStart;
 		bool NoConsole;
+		bool MapFiles;		//mmap bios/flash/vmu files instead of reading them (POSIX hosts)
 	} emulator;
 };
 extern __settings settings;
@@ -49,6 +49,7 @@
 #include "dc\sh4\ccn.h"
 #include "dc\sh4\rec_v2\ngen.h"
 #include "dc\mem\sh4_mem.h"
+#include "dc\mem\mem_prof.h"
 #include "emitter\PPCEmit\ppc_emitter.h"
 
 // wii_driver.cpp defines its own higher-level wrappers for these names.
@@ -607,7 +608,10 @@ DynarecCodeEntry* ngen_Compile(DecodedBlock* block,bool force_checks)
 					else
 					{
 						ppc_li(ppc_rarg0,op->rs1._imm);
+#ifndef MEM_PROFILER
+						//call the handler directly, the profiler wants it via ReadMem*
 						fuct=ptr;
+#endif
 					}
 				}
 				else